@@ -0,0 +1,223 @@
+#include "bakedtexture.h"
+#include "glstate.h"
+#include "mappedfile.h"
+#include "mipmap.h"
+#include "stb_image.h"
+#include "texturecompress.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// S3TC is an extension, so glad's core profile header leaves the enums out
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+static const uint32_t MAX_LEVELS = 32;
+static const uint64_t LEVEL_ALIGNMENT = 16;
+
+static BlockFormat blockFormat(BakedFormat format)
+{
+	switch (format)
+	{
+	case BAKED_BC1: return BLOCK_BC1;
+	case BAKED_BC3: return BLOCK_BC3;
+	case BAKED_BC4: return BLOCK_BC4;
+	case BAKED_BC5: return BLOCK_BC5;
+	default: return BLOCK_BC7;
+	}
+}
+
+size_t bakedLevelSize(BakedFormat format, int width, int height)
+{
+	if (format == BAKED_RGBA8)
+		return (size_t)width * height * 4;
+	return compressedSize(blockFormat(format), width, height);
+}
+
+unsigned int bakedInternalFormat(BakedFormat format)
+{
+	switch (format)
+	{
+	case BAKED_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case BAKED_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BAKED_BC4: return GL_COMPRESSED_RED_RGTC1;
+	case BAKED_BC5: return GL_COMPRESSED_RG_RGTC2;
+	case BAKED_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	default: return GL_RGBA8;
+	}
+}
+
+bool bakedFormatSupported(BakedFormat format)
+{
+	if (format == BAKED_RGBA8)
+		return true;
+	if (format == BAKED_BC4 || format == BAKED_BC5)
+		return GLAD_GL_VERSION_3_0 != 0;
+	if (format == BAKED_BC7)
+		return GLAD_GL_VERSION_4_2 != 0;
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+			return true;
+	}
+	return false;
+}
+
+static uint64_t alignLevel(uint64_t offset)
+{
+	return (offset + LEVEL_ALIGNMENT - 1) & ~(LEVEL_ALIGNMENT - 1);
+}
+
+bool cookTexture(const std::string& source, const std::string& output, BakedFormat format,
+	CompressionQuality quality, CompressionReport* report)
+{
+	int width, height, channels;
+	unsigned char* data = stbi_load(source.c_str(), &width, &height, &channels, 4);
+	if (!data)
+	{
+		std::cout << "ERROR::BAKEDTEXTURE::FAILED_TO_LOAD " << source << " (" << stbi_failure_reason() << ")" << std::endl;
+		return false;
+	}
+	std::vector<size_t> offsets;
+	std::vector<unsigned char> chain(mipChainOffsets(width, height, offsets));
+	memcpy(chain.data(), data, (size_t)width * height * 4);
+	stbi_image_free(data);
+	// BC4/BC5 hold data (heights, normals) rather than colours, so they are filtered as stored
+	bool srgb = format != BAKED_BC4 && format != BAKED_BC5;
+	buildMipChain(chain.data(), width, height, offsets, MIP_KAISER, srgb);
+
+	BakedTextureHeader header = { BAKED_TEXTURE_MAGIC, BAKED_TEXTURE_VERSION, (uint32_t)format, (uint32_t)width, (uint32_t)height, (uint32_t)offsets.size() };
+	std::vector<BakedLevel> table(offsets.size());
+	uint64_t offset = sizeof(header) + sizeof(BakedLevel) * table.size();
+	int w = width, h = height;
+	for (size_t level = 0; level < table.size(); level++)
+	{
+		offset = alignLevel(offset);
+		table[level].offset = offset;
+		table[level].size = bakedLevelSize(format, w, h);
+		table[level].width = (uint32_t)w;
+		table[level].height = (uint32_t)h;
+		offset += table[level].size;
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+
+	std::vector<unsigned char> file((size_t)offset, 0);
+	memcpy(file.data(), &header, sizeof(header));
+	memcpy(file.data() + sizeof(header), table.data(), sizeof(BakedLevel) * table.size());
+	for (size_t level = 0; level < table.size(); level++)
+	{
+		const unsigned char* texels = chain.data() + offsets[level];
+		unsigned char* out = file.data() + table[level].offset;
+		if (format == BAKED_RGBA8)
+			memcpy(out, texels, (size_t)table[level].size);
+		else if (report)
+		{
+			CompressionReport levelReport = compressTexture(blockFormat(format), texels, table[level].width, table[level].height, out, quality);
+			if (level == 0)
+				*report = levelReport;
+			else
+				report->milliseconds += levelReport.milliseconds;
+		}
+		else
+			compressImage(blockFormat(format), texels, table[level].width, table[level].height, out, quality);
+	}
+
+	std::ofstream stream(output.c_str(), std::ios::binary | std::ios::trunc);
+	stream.write((const char*)file.data(), (std::streamsize)file.size());
+	stream.close();
+	if (!stream)
+	{
+		std::cout << "ERROR::BAKEDTEXTURE::FAILED_TO_WRITE " << output << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// why a mapped file is not a baked texture we can load, or null
+static const char* validate(const MappedFile& mapped, const BakedTextureHeader& header, const BakedLevel* table)
+{
+	if (header.magic != BAKED_TEXTURE_MAGIC)
+		return "not a baked texture";
+	if (header.version != BAKED_TEXTURE_VERSION)
+		return "unsupported version";
+	if (header.format >= BAKED_FORMAT_COUNT)
+		return "unknown format";
+	if (header.levels == 0 || header.levels > MAX_LEVELS || header.width == 0 || header.height == 0)
+		return "bad dimensions";
+	if (mapped.size < sizeof(header) + sizeof(BakedLevel) * header.levels)
+		return "truncated level table";
+	uint32_t w = header.width, h = header.height;
+	for (uint32_t level = 0; level < header.levels; level++)
+	{
+		const BakedLevel& entry = table[level];
+		if (entry.width != w || entry.height != h || entry.size != bakedLevelSize((BakedFormat)header.format, w, h))
+			return "bad level size";
+		if (entry.offset > mapped.size || entry.size > mapped.size - entry.offset)
+			return "truncated level";
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+	return nullptr;
+}
+
+unsigned int loadBakedTexture(const std::string& path)
+{
+	MappedFile mapped;
+	const char* failure = mapFile(path, mapped);
+	if (failure)
+	{
+		std::cout << "ERROR::BAKEDTEXTURE::FAILED_TO_LOAD " << path << " (" << failure << ")" << std::endl;
+		return 0;
+	}
+	BakedTextureHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(&header, mapped.data, std::min(mapped.size, sizeof(header)));
+	// the level table follows the 24-byte header, so it is 8-byte aligned in the mapping
+	const BakedLevel* table = (const BakedLevel*)(mapped.data + sizeof(header));
+	failure = mapped.size < sizeof(header) ? "truncated header" : validate(mapped, header, table);
+	if (!failure && !bakedFormatSupported((BakedFormat)header.format))
+		failure = "compressed format not supported by the driver";
+	if (failure)
+	{
+		std::cout << "ERROR::BAKEDTEXTURE::FAILED_TO_LOAD " << path << " (" << failure << ")" << std::endl;
+		unmapFile(mapped);
+		return 0;
+	}
+
+	BakedFormat format = (BakedFormat)header.format;
+	GLenum internalFormat = bakedInternalFormat(format);
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glState().bindTexture(0, GL_TEXTURE_2D, texture);
+	glTexStorage2D(GL_TEXTURE_2D, header.levels, internalFormat, header.width, header.height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// client pointers into the mapping: GL reads the pages as it copies them in
+	glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	for (uint32_t level = 0; level < header.levels; level++)
+	{
+		const BakedLevel& entry = table[level];
+		const void* texels = mapped.data + entry.offset;
+		if (format == BAKED_RGBA8)
+			glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, entry.width, entry.height, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+		else
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, entry.width, entry.height, internalFormat, (GLsizei)entry.size, texels);
+	}
+	// the uploads have taken their copies by the time they return
+	unmapFile(mapped);
+	return texture;
+}
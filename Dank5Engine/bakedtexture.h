@@ -0,0 +1,65 @@
+#ifndef BAKEDTEXTURE_H
+#define BAKEDTEXTURE_H
+
+#include "texturecompress.h"
+
+#include <cstdint>
+#include <string>
+
+// Baked textures: a whole mip chain in one file, ready to upload. cookTexture() decodes
+// an image and writes its levels offline; loadBakedTexture() maps the file and hands
+// every level to GL straight from the mapping, with no decoding and no copy of its own.
+//	header | level table | levels from level 0, each at a 16-byte aligned offset
+// Fields are little endian. RGBA8 levels are tightly packed rows, BCn levels rows of
+// 4x4 blocks as glCompressedTexSubImage2D takes them.
+
+enum BakedFormat {
+	BAKED_RGBA8,
+	BAKED_BC1,
+	BAKED_BC3,
+	BAKED_BC7,
+	// added after BC7 so the values already in files keep their meaning
+	BAKED_BC4,
+	BAKED_BC5,
+	BAKED_FORMAT_COUNT
+};
+
+// "D5TX"
+const uint32_t BAKED_TEXTURE_MAGIC = 0x58543544;
+// bump when the layout changes, the loader rejects other versions
+const uint32_t BAKED_TEXTURE_VERSION = 1;
+
+struct BakedTextureHeader {
+	uint32_t magic;
+	uint32_t version;
+	// a BakedFormat
+	uint32_t format;
+	uint32_t width, height;
+	uint32_t levels;
+};
+
+struct BakedLevel {
+	// from the start of the file
+	uint64_t offset;
+	uint64_t size;
+	uint32_t width, height;
+};
+
+// bytes of one level
+size_t bakedLevelSize(BakedFormat format, int width, int height);
+// the sized internal format the texture is created with
+unsigned int bakedInternalFormat(BakedFormat format);
+// BC1/BC3 need GL_EXT_texture_compression_s3tc, BC4/BC5 (RGTC) are core since 3.0 and BC7
+// since 4.2; needs a current context
+bool bakedFormatSupported(BakedFormat format);
+
+// decodes source with stb_image, builds its mip chain (Kaiser filtered, in linear light
+// but for BC4/BC5) and writes it baked to output; false (with an ERROR:: line) on
+// failure. BCn levels are compressed at quality on every
+// hardware thread; report, if given, gets level 0's PSNR and the time for all levels.
+bool cookTexture(const std::string& source, const std::string& output, BakedFormat format,
+	CompressionQuality quality = COMPRESS_NORMAL, CompressionReport* report = nullptr);
+// creates an immutable texture from a baked file; 0 (with an ERROR:: line) on failure
+unsigned int loadBakedTexture(const std::string& path);
+
+#endif
@@ -0,0 +1,534 @@
+#include "batchmath.h"
+
+// SIMD paths as in culling.cpp, AVX-512 from the compiler's own macro
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#	define DANK5_MATRIX_SSE 1
+#	include <glm/simd/matrix.h>
+#endif
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+#	define DANK5_MATRIX_AVX2 1
+#endif
+#if defined(__AVX512F__) && DANK5_MATRIX_AVX2
+#	define DANK5_MATRIX_AVX512 1
+#endif
+
+#if DANK5_MATRIX_AVX2 || DANK5_MATRIX_AVX512
+#	include <immintrin.h>
+#endif
+
+void TransformArrays::resize(unsigned int count)
+{
+	px.resize(count); py.resize(count); pz.resize(count);
+	qx.resize(count); qy.resize(count); qz.resize(count); qw.resize(count);
+	sx.resize(count); sy.resize(count); sz.resize(count);
+}
+
+void TransformArrays::set(unsigned int i, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	px[i] = position.x; py[i] = position.y; pz[i] = position.z;
+	qx[i] = rotation.x; qy[i] = rotation.y; qz[i] = rotation.z; qw[i] = rotation.w;
+	sx[i] = scale.x; sy[i] = scale.y; sz[i] = scale.z;
+}
+
+// the widest path the build has, up to path
+static MatrixPath availablePath(MatrixPath path)
+{
+#if !DANK5_MATRIX_AVX512
+	if (path == MATRIX_AVX512)
+		path = MATRIX_AVX2;
+#endif
+#if !DANK5_MATRIX_AVX2
+	if (path == MATRIX_AVX2)
+		path = MATRIX_SSE;
+#endif
+#if !DANK5_MATRIX_SSE
+	if (path == MATRIX_SSE)
+		path = MATRIX_SCALAR;
+#endif
+	return path;
+}
+
+MatrixPath matrixPath()
+{
+	return availablePath(MATRIX_AVX512);
+}
+
+const char* matrixPathName(MatrixPath path)
+{
+	switch (availablePath(path))
+	{
+	case MATRIX_AVX512:
+		return "avx512";
+	case MATRIX_AVX2:
+		return "avx2";
+	case MATRIX_SSE:
+		return "sse2";
+	default:
+		return "scalar";
+	}
+}
+
+// ------------------------------------------------------------------------
+// scalar paths (glm), also the tails of the SoA paths
+
+static void composeScalar(const TransformArrays& t, unsigned int first, glm::mat4* out)
+{
+	for (unsigned int i = first; i < t.size(); i++)
+	{
+		glm::mat3 r = glm::mat3_cast(glm::quat(t.qw[i], t.qx[i], t.qy[i], t.qz[i]));
+		out[i] = glm::mat4(
+			glm::vec4(r[0] * t.sx[i], 0.0f),
+			glm::vec4(r[1] * t.sy[i], 0.0f),
+			glm::vec4(r[2] * t.sz[i], 0.0f),
+			glm::vec4(t.px[i], t.py[i], t.pz[i], 1.0f));
+	}
+}
+
+// left advances by leftStep matrices per product: 0 for one shared left matrix
+static void multiplyScalar(const glm::mat4* left, unsigned int leftStep, const glm::mat4* right, unsigned int count, glm::mat4* out)
+{
+	for (unsigned int i = 0; i < count; i++)
+		out[i] = left[i * leftStep] * right[i];
+}
+
+static void normalScalar(const glm::mat4* in, unsigned int first, unsigned int count, glm::mat4* out)
+{
+	for (unsigned int i = first; i < count; i++)
+		out[i] = glm::transpose(glm::inverse(in[i]));
+}
+
+// ------------------------------------------------------------------------
+// SoA kernels, written once over a lane type: V holds element e (column * 4 + row) of WIDTH
+// matrices, gather/scatter convert from and to glm::mat4 arrays with 4x4 transposes
+
+#if DANK5_MATRIX_SSE
+struct LanesSSE {
+	typedef __m128 V;
+	static const unsigned int WIDTH = 4;
+
+	static V load(const float* p) { return _mm_loadu_ps(p); }
+	static V set(float f) { return _mm_set1_ps(f); }
+	static V add(V a, V b) { return _mm_add_ps(a, b); }
+	static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+	static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+	static V div(V a, V b) { return _mm_div_ps(a, b); }
+
+	static void gather(const glm::mat4* in, V m[16])
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			V r0 = load(&in[0][c][0]), r1 = load(&in[1][c][0]), r2 = load(&in[2][c][0]), r3 = load(&in[3][c][0]);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			m[c * 4 + 0] = r0; m[c * 4 + 1] = r1; m[c * 4 + 2] = r2; m[c * 4 + 3] = r3;
+		}
+	}
+
+	static void scatter(const V m[16], glm::mat4* out)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			V r0 = m[c * 4 + 0], r1 = m[c * 4 + 1], r2 = m[c * 4 + 2], r3 = m[c * 4 + 3];
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(&out[0][c][0], r0);
+			_mm_storeu_ps(&out[1][c][0], r1);
+			_mm_storeu_ps(&out[2][c][0], r2);
+			_mm_storeu_ps(&out[3][c][0], r3);
+		}
+	}
+};
+#endif
+
+#if DANK5_MATRIX_AVX2
+struct LanesAVX2 {
+	typedef __m256 V;
+	static const unsigned int WIDTH = 8;
+
+	static V load(const float* p) { return _mm256_loadu_ps(p); }
+	static V set(float f) { return _mm256_set1_ps(f); }
+	static V add(V a, V b) { return _mm256_add_ps(a, b); }
+	static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+	static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+	static V div(V a, V b) { return _mm256_div_ps(a, b); }
+
+	// a 4x4 transpose in each 128-bit lane
+	static void transpose(V& a, V& b, V& c, V& d)
+	{
+		V t0 = _mm256_unpacklo_ps(a, b), t1 = _mm256_unpacklo_ps(c, d);
+		V t2 = _mm256_unpackhi_ps(a, b), t3 = _mm256_unpackhi_ps(c, d);
+		a = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+		b = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+		c = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		d = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	// lane 0 holds matrices 0-3, lane 1 matrices 4-7
+	static void gather(const glm::mat4* in, V m[16])
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			V r[4];
+			for (int k = 0; k < 4; k++)
+				r[k] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&in[k][c][0])), _mm_loadu_ps(&in[k + 4][c][0]), 1);
+			transpose(r[0], r[1], r[2], r[3]);
+			for (int k = 0; k < 4; k++)
+				m[c * 4 + k] = r[k];
+		}
+	}
+
+	static void scatter(const V m[16], glm::mat4* out)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			V r[4] = { m[c * 4 + 0], m[c * 4 + 1], m[c * 4 + 2], m[c * 4 + 3] };
+			transpose(r[0], r[1], r[2], r[3]);
+			for (int k = 0; k < 4; k++)
+			{
+				_mm_storeu_ps(&out[k][c][0], _mm256_castps256_ps128(r[k]));
+				_mm_storeu_ps(&out[k + 4][c][0], _mm256_extractf128_ps(r[k], 1));
+			}
+		}
+	}
+};
+
+static inline __m256 multiplyAdd(__m256 a, __m256 b, __m256 c)
+{
+#if defined(__FMA__) || defined(_MSC_VER)
+	return _mm256_fmadd_ps(a, b, c);
+#else
+	return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+#endif
+
+#if DANK5_MATRIX_AVX512
+struct LanesAVX512 {
+	typedef __m512 V;
+	static const unsigned int WIDTH = 16;
+
+	static V load(const float* p) { return _mm512_loadu_ps(p); }
+	static V set(float f) { return _mm512_set1_ps(f); }
+	static V add(V a, V b) { return _mm512_add_ps(a, b); }
+	static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+	static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+	static V div(V a, V b) { return _mm512_div_ps(a, b); }
+
+	// a 4x4 transpose in each 128-bit lane
+	static void transpose(V& a, V& b, V& c, V& d)
+	{
+		V t0 = _mm512_unpacklo_ps(a, b), t1 = _mm512_unpacklo_ps(c, d);
+		V t2 = _mm512_unpackhi_ps(a, b), t3 = _mm512_unpackhi_ps(c, d);
+		a = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+		b = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+		c = _mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		d = _mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+
+	// lane l holds matrices 4l to 4l + 3
+	static void gather(const glm::mat4* in, V m[16])
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			V r[4];
+			for (int k = 0; k < 4; k++)
+			{
+				r[k] = _mm512_insertf32x4(_mm512_setzero_ps(), _mm_loadu_ps(&in[k][c][0]), 0);
+				r[k] = _mm512_insertf32x4(r[k], _mm_loadu_ps(&in[k + 4][c][0]), 1);
+				r[k] = _mm512_insertf32x4(r[k], _mm_loadu_ps(&in[k + 8][c][0]), 2);
+				r[k] = _mm512_insertf32x4(r[k], _mm_loadu_ps(&in[k + 12][c][0]), 3);
+			}
+			transpose(r[0], r[1], r[2], r[3]);
+			for (int k = 0; k < 4; k++)
+				m[c * 4 + k] = r[k];
+		}
+	}
+
+	static void scatter(const V m[16], glm::mat4* out)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			V r[4] = { m[c * 4 + 0], m[c * 4 + 1], m[c * 4 + 2], m[c * 4 + 3] };
+			transpose(r[0], r[1], r[2], r[3]);
+			for (int k = 0; k < 4; k++)
+			{
+				_mm_storeu_ps(&out[k][c][0], _mm512_extractf32x4_ps(r[k], 0));
+				_mm_storeu_ps(&out[k + 4][c][0], _mm512_extractf32x4_ps(r[k], 1));
+				_mm_storeu_ps(&out[k + 8][c][0], _mm512_extractf32x4_ps(r[k], 2));
+				_mm_storeu_ps(&out[k + 12][c][0], _mm512_extractf32x4_ps(r[k], 3));
+			}
+		}
+	}
+};
+#endif
+
+// WIDTH transforms at a time; the index of the first one left for the scalar tail
+template<typename L>
+static unsigned int composeLanes(const TransformArrays& t, glm::mat4* out)
+{
+	typedef typename L::V V;
+	const unsigned int count = t.size();
+	const V one = L::set(1.0f), zero = L::set(0.0f);
+	unsigned int i = 0;
+	for (; i + L::WIDTH <= count; i += L::WIDTH)
+	{
+		V x = L::load(&t.qx[i]), y = L::load(&t.qy[i]), z = L::load(&t.qz[i]), w = L::load(&t.qw[i]);
+		V sx = L::load(&t.sx[i]), sy = L::load(&t.sy[i]), sz = L::load(&t.sz[i]);
+		// the terms of glm::mat3_cast
+		V x2 = L::add(x, x), y2 = L::add(y, y), z2 = L::add(z, z);
+		V xx = L::mul(x, x2), yy = L::mul(y, y2), zz = L::mul(z, z2);
+		V xy = L::mul(x, y2), xz = L::mul(x, z2), yz = L::mul(y, z2);
+		V wx = L::mul(w, x2), wy = L::mul(w, y2), wz = L::mul(w, z2);
+		V m[16];
+		m[0] = L::mul(L::sub(one, L::add(yy, zz)), sx);
+		m[1] = L::mul(L::add(xy, wz), sx);
+		m[2] = L::mul(L::sub(xz, wy), sx);
+		m[3] = zero;
+		m[4] = L::mul(L::sub(xy, wz), sy);
+		m[5] = L::mul(L::sub(one, L::add(xx, zz)), sy);
+		m[6] = L::mul(L::add(yz, wx), sy);
+		m[7] = zero;
+		m[8] = L::mul(L::add(xz, wy), sz);
+		m[9] = L::mul(L::sub(yz, wx), sz);
+		m[10] = L::mul(L::sub(one, L::add(xx, yy)), sz);
+		m[11] = zero;
+		m[12] = L::load(&t.px[i]);
+		m[13] = L::load(&t.py[i]);
+		m[14] = L::load(&t.pz[i]);
+		m[15] = one;
+		L::scatter(m, out + i);
+	}
+	return i;
+}
+
+// transpose(inverse(m)) by cofactors from 2x2 subdeterminants: the inverse is the transposed
+// cofactor matrix over the determinant, so the normal matrix is the cofactor matrix itself
+template<typename L>
+static unsigned int normalLanes(const glm::mat4* in, unsigned int count, glm::mat4* out)
+{
+	typedef typename L::V V;
+	const V one = L::set(1.0f);
+	unsigned int i = 0;
+	for (; i + L::WIDTH <= count; i += L::WIDTH)
+	{
+		V m[16];
+		L::gather(in + i, m);
+		// a[r][c] = row r, column c
+		V a[4][4];
+		for (int c = 0; c < 4; c++)
+			for (int r = 0; r < 4; r++)
+				a[r][c] = m[c * 4 + r];
+		V s0 = L::sub(L::mul(a[0][0], a[1][1]), L::mul(a[1][0], a[0][1]));
+		V s1 = L::sub(L::mul(a[0][0], a[1][2]), L::mul(a[1][0], a[0][2]));
+		V s2 = L::sub(L::mul(a[0][0], a[1][3]), L::mul(a[1][0], a[0][3]));
+		V s3 = L::sub(L::mul(a[0][1], a[1][2]), L::mul(a[1][1], a[0][2]));
+		V s4 = L::sub(L::mul(a[0][1], a[1][3]), L::mul(a[1][1], a[0][3]));
+		V s5 = L::sub(L::mul(a[0][2], a[1][3]), L::mul(a[1][2], a[0][3]));
+		V c0 = L::sub(L::mul(a[2][0], a[3][1]), L::mul(a[3][0], a[2][1]));
+		V c1 = L::sub(L::mul(a[2][0], a[3][2]), L::mul(a[3][0], a[2][2]));
+		V c2 = L::sub(L::mul(a[2][0], a[3][3]), L::mul(a[3][0], a[2][3]));
+		V c3 = L::sub(L::mul(a[2][1], a[3][2]), L::mul(a[3][1], a[2][2]));
+		V c4 = L::sub(L::mul(a[2][1], a[3][3]), L::mul(a[3][1], a[2][3]));
+		V c5 = L::sub(L::mul(a[2][2], a[3][3]), L::mul(a[3][2], a[2][3]));
+		V det = L::add(L::add(L::sub(L::mul(s0, c5), L::mul(s1, c4)), L::add(L::mul(s2, c3), L::mul(s3, c2))),
+			L::sub(L::mul(s5, c0), L::mul(s4, c1)));
+		V scale = L::div(one, det);
+
+		// inverse row r, column c, which is element c * 4 + r of the inverse and so
+		// element r * 4 + c of its transpose
+		V b[16];
+		b[0] = L::add(L::sub(L::mul(a[1][1], c5), L::mul(a[1][2], c4)), L::mul(a[1][3], c3));
+		b[1] = L::sub(L::sub(L::mul(a[0][2], c4), L::mul(a[0][1], c5)), L::mul(a[0][3], c3));
+		b[2] = L::add(L::sub(L::mul(a[3][1], s5), L::mul(a[3][2], s4)), L::mul(a[3][3], s3));
+		b[3] = L::sub(L::sub(L::mul(a[2][2], s4), L::mul(a[2][1], s5)), L::mul(a[2][3], s3));
+		b[4] = L::sub(L::sub(L::mul(a[1][2], c2), L::mul(a[1][0], c5)), L::mul(a[1][3], c1));
+		b[5] = L::add(L::sub(L::mul(a[0][0], c5), L::mul(a[0][2], c2)), L::mul(a[0][3], c1));
+		b[6] = L::sub(L::sub(L::mul(a[3][2], s2), L::mul(a[3][0], s5)), L::mul(a[3][3], s1));
+		b[7] = L::add(L::sub(L::mul(a[2][0], s5), L::mul(a[2][2], s2)), L::mul(a[2][3], s1));
+		b[8] = L::add(L::sub(L::mul(a[1][0], c4), L::mul(a[1][1], c2)), L::mul(a[1][3], c0));
+		b[9] = L::sub(L::sub(L::mul(a[0][1], c2), L::mul(a[0][0], c4)), L::mul(a[0][3], c0));
+		b[10] = L::add(L::sub(L::mul(a[3][0], s4), L::mul(a[3][1], s2)), L::mul(a[3][3], s0));
+		b[11] = L::sub(L::sub(L::mul(a[2][1], s2), L::mul(a[2][0], s4)), L::mul(a[2][3], s0));
+		b[12] = L::sub(L::sub(L::mul(a[1][1], c1), L::mul(a[1][0], c3)), L::mul(a[1][2], c0));
+		b[13] = L::add(L::sub(L::mul(a[0][0], c3), L::mul(a[0][1], c1)), L::mul(a[0][2], c0));
+		b[14] = L::sub(L::sub(L::mul(a[3][1], s1), L::mul(a[3][0], s3)), L::mul(a[3][2], s0));
+		b[15] = L::add(L::sub(L::mul(a[2][0], s3), L::mul(a[2][1], s1)), L::mul(a[2][2], s0));
+		for (int e = 0; e < 16; e++)
+			b[e] = L::mul(b[e], scale);
+		L::scatter(b, out + i);
+	}
+	return i;
+}
+
+// ------------------------------------------------------------------------
+// products, one matrix at a time
+
+#if DANK5_MATRIX_SSE
+static void multiplySSE(const glm::mat4* left, unsigned int leftStep, const glm::mat4* right, unsigned int count, glm::mat4* out)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const glm::mat4& l = left[i * leftStep];
+		glm_vec4 a[4], b[4], product[4];
+		for (int c = 0; c < 4; c++)
+		{
+			a[c] = _mm_loadu_ps(&l[c][0]);
+			b[c] = _mm_loadu_ps(&right[i][c][0]);
+		}
+		glm_mat4_mul(a, b, product);
+		for (int c = 0; c < 4; c++)
+			_mm_storeu_ps(&out[i][c][0], product[c]);
+	}
+}
+
+static void normalSSE(const glm::mat4* in, unsigned int count, glm::mat4* out)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		glm_vec4 m[4], inverse[4], transposed[4];
+		for (int c = 0; c < 4; c++)
+			m[c] = _mm_loadu_ps(&in[i][c][0]);
+		glm_mat4_inverse(m, inverse);
+		glm_mat4_transpose(inverse, transposed);
+		for (int c = 0; c < 4; c++)
+			_mm_storeu_ps(&out[i][c][0], transposed[c]);
+	}
+}
+#endif
+
+#if DANK5_MATRIX_AVX2
+// two columns of the product per register: column j = sum over k of left[k] * right[j][k],
+// with left[k] in both lanes and right[j][k] broadcast within each lane
+static void multiplyAVX2(const glm::mat4* left, unsigned int leftStep, const glm::mat4* right, unsigned int count, glm::mat4* out)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const glm::mat4& l = left[i * leftStep];
+		__m256 l0 = _mm256_broadcast_ps((const __m128*)&l[0][0]);
+		__m256 l1 = _mm256_broadcast_ps((const __m128*)&l[1][0]);
+		__m256 l2 = _mm256_broadcast_ps((const __m128*)&l[2][0]);
+		__m256 l3 = _mm256_broadcast_ps((const __m128*)&l[3][0]);
+		__m256 r01 = _mm256_loadu_ps(&right[i][0][0]);
+		__m256 r23 = _mm256_loadu_ps(&right[i][2][0]);
+		__m256 p01 = _mm256_mul_ps(l0, _mm256_permute_ps(r01, 0x00));
+		__m256 p23 = _mm256_mul_ps(l0, _mm256_permute_ps(r23, 0x00));
+		p01 = multiplyAdd(l1, _mm256_permute_ps(r01, 0x55), p01);
+		p23 = multiplyAdd(l1, _mm256_permute_ps(r23, 0x55), p23);
+		p01 = multiplyAdd(l2, _mm256_permute_ps(r01, 0xAA), p01);
+		p23 = multiplyAdd(l2, _mm256_permute_ps(r23, 0xAA), p23);
+		p01 = multiplyAdd(l3, _mm256_permute_ps(r01, 0xFF), p01);
+		p23 = multiplyAdd(l3, _mm256_permute_ps(r23, 0xFF), p23);
+		_mm256_storeu_ps(&out[i][0][0], p01);
+		_mm256_storeu_ps(&out[i][2][0], p23);
+	}
+}
+#endif
+
+#if DANK5_MATRIX_AVX512
+// the whole product in one register, left[k] in all four lanes
+static void multiplyAVX512(const glm::mat4* left, unsigned int leftStep, const glm::mat4* right, unsigned int count, glm::mat4* out)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const glm::mat4& l = left[i * leftStep];
+		__m512 l0 = _mm512_broadcast_f32x4(_mm_loadu_ps(&l[0][0]));
+		__m512 l1 = _mm512_broadcast_f32x4(_mm_loadu_ps(&l[1][0]));
+		__m512 l2 = _mm512_broadcast_f32x4(_mm_loadu_ps(&l[2][0]));
+		__m512 l3 = _mm512_broadcast_f32x4(_mm_loadu_ps(&l[3][0]));
+		__m512 r = _mm512_loadu_ps(&right[i][0][0]);
+		__m512 p = _mm512_mul_ps(l0, _mm512_permute_ps(r, 0x00));
+		p = _mm512_fmadd_ps(l1, _mm512_permute_ps(r, 0x55), p);
+		p = _mm512_fmadd_ps(l2, _mm512_permute_ps(r, 0xAA), p);
+		p = _mm512_fmadd_ps(l3, _mm512_permute_ps(r, 0xFF), p);
+		_mm512_storeu_ps(&out[i][0][0], p);
+	}
+}
+#endif
+
+static void multiply(const glm::mat4* left, unsigned int leftStep, const glm::mat4* right, unsigned int count, glm::mat4* out, MatrixPath path)
+{
+	switch (availablePath(path))
+	{
+#if DANK5_MATRIX_AVX512
+	case MATRIX_AVX512:
+		multiplyAVX512(left, leftStep, right, count, out);
+		return;
+#endif
+#if DANK5_MATRIX_AVX2
+	case MATRIX_AVX2:
+		multiplyAVX2(left, leftStep, right, count, out);
+		return;
+#endif
+#if DANK5_MATRIX_SSE
+	case MATRIX_SSE:
+		multiplySSE(left, leftStep, right, count, out);
+		return;
+#endif
+	default:
+		multiplyScalar(left, leftStep, right, count, out);
+	}
+}
+
+// ------------------------------------------------------------------------
+
+void composeTransforms(const TransformArrays& transforms, glm::mat4* out, MatrixPath path)
+{
+	unsigned int done = 0;
+	switch (availablePath(path))
+	{
+#if DANK5_MATRIX_AVX512
+	case MATRIX_AVX512:
+		done = composeLanes<LanesAVX512>(transforms, out);
+		break;
+#endif
+#if DANK5_MATRIX_AVX2
+	case MATRIX_AVX2:
+		done = composeLanes<LanesAVX2>(transforms, out);
+		break;
+#endif
+#if DANK5_MATRIX_SSE
+	case MATRIX_SSE:
+		done = composeLanes<LanesSSE>(transforms, out);
+		break;
+#endif
+	default:
+		break;
+	}
+	composeScalar(transforms, done, out);
+}
+
+void multiplyMatrices(const glm::mat4& left, const glm::mat4* right, unsigned int count, glm::mat4* out, MatrixPath path)
+{
+	// out may be right, never left
+	glm::mat4 shared = left;
+	multiply(&shared, 0, right, count, out, path);
+}
+
+void multiplyMatrices(const glm::mat4* left, const glm::mat4* right, unsigned int count, glm::mat4* out, MatrixPath path)
+{
+	multiply(left, 1, right, count, out, path);
+}
+
+void normalMatrices(const glm::mat4* in, unsigned int count, glm::mat4* out, MatrixPath path)
+{
+	unsigned int done = 0;
+	switch (availablePath(path))
+	{
+#if DANK5_MATRIX_AVX512
+	case MATRIX_AVX512:
+		done = normalLanes<LanesAVX512>(in, count, out);
+		break;
+#endif
+#if DANK5_MATRIX_AVX2
+	case MATRIX_AVX2:
+		done = normalLanes<LanesAVX2>(in, count, out);
+		break;
+#endif
+#if DANK5_MATRIX_SSE
+	case MATRIX_SSE:
+		normalSSE(in, count, out);
+		return;
+#endif
+	default:
+		break;
+	}
+	normalScalar(in, done, count, out);
+}
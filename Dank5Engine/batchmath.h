@@ -0,0 +1,50 @@
+#ifndef BATCHMATH_H
+#define BATCHMATH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+
+// Matrix kernels over arrays of transforms: model->world composition from position,
+// rotation and scale, products like viewProjection * world (world->clip) or parent * local
+// (model->world), and normal matrices, with SSE (glm's own kernels from glm/simd/matrix.h),
+// AVX2 and AVX-512 paths. The wide paths do products two columns (AVX2) or a whole matrix
+// (AVX-512) per instruction, and composition and inversion 8 or 16 matrices at a time in
+// SoA registers. Outputs may alias inputs.
+
+// positions, rotations (unit quaternions) and scales in SoA layout
+struct TransformArrays {
+	std::vector<float> px, py, pz;
+	std::vector<float> qx, qy, qz, qw;
+	std::vector<float> sx, sy, sz;
+
+	unsigned int size() const { return (unsigned int)px.size(); }
+	void resize(unsigned int count);
+	void set(unsigned int i, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+};
+
+enum MatrixPath {
+	MATRIX_SCALAR,
+	MATRIX_SSE,
+	MATRIX_AVX2,
+	MATRIX_AVX512
+};
+
+// out[i] = translate(position) * mat4_cast(rotation) * scale(scale) for every transform
+void composeTransforms(const TransformArrays& transforms, glm::mat4* out, MatrixPath path = MATRIX_AVX512);
+// out[i] = left * right[i], e.g. world->clip from viewProjection and world matrices
+void multiplyMatrices(const glm::mat4& left, const glm::mat4* right, unsigned int count, glm::mat4* out, MatrixPath path = MATRIX_AVX512);
+// out[i] = left[i] * right[i], e.g. model->world from parent world and local matrices
+void multiplyMatrices(const glm::mat4* left, const glm::mat4* right, unsigned int count, glm::mat4* out, MatrixPath path = MATRIX_AVX512);
+// out[i] = transpose(inverse(in[i])), the normal matrix of each; like glm::inverse,
+// singular matrices give infinities
+void normalMatrices(const glm::mat4* in, unsigned int count, glm::mat4* out, MatrixPath path = MATRIX_AVX512);
+
+// every kernel takes the widest path the build has up to the one asked for (the default
+// asks for the widest there is); this is the widest
+MatrixPath matrixPath();
+// "avx512", "avx2", "sse2" or "scalar"
+const char* matrixPathName(MatrixPath path);
+
+#endif
@@ -0,0 +1,123 @@
+#include "bench.h"
+#include "headless.h"
+#include "glstate.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// dank5_bench [--list] [--quick] [--frames N] [filter...]
+// runs every benchmark whose name contains one of the filters (all of them without filters)
+
+static const char* currentBench = "";
+static bool currentFailed = false;
+
+std::vector<BenchCase>& benchCases()
+{
+	static std::vector<BenchCase> cases;
+	return cases;
+}
+
+BenchRegistrar::BenchRegistrar(const char* name, bool needsGL, BenchFunction run)
+{
+	benchCases().push_back({ name, needsGL, run });
+}
+
+double benchNow()
+{
+	using namespace std::chrono;
+	return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+void benchReport(const char* metric, double value, const char* unit)
+{
+	std::cout << "  " << currentBench << "." << metric << ": " << value << " " << unit << std::endl;
+}
+
+void benchFail(const char* message)
+{
+	std::cout << "  " << currentBench << " FAILED: " << message << std::endl;
+	currentFailed = true;
+}
+
+static bool selected(const char* name, const std::vector<std::string>& filters)
+{
+	if (filters.empty())
+		return true;
+	for (const std::string& f : filters)
+		if (std::strstr(name, f.c_str()))
+			return true;
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	BenchContext ctx = { nullptr, false, 500 };
+	std::vector<std::string> filters;
+	bool list = false;
+	for (int i = 1; i < argc; i++) {
+		if (!std::strcmp(argv[i], "--list"))
+			list = true;
+		else if (!std::strcmp(argv[i], "--quick"))
+			ctx.quick = true;
+		else if (!std::strcmp(argv[i], "--frames") && i + 1 < argc)
+			ctx.frames = (unsigned int)std::atoi(argv[++i]);
+		else
+			filters.push_back(argv[i]);
+	}
+	if (ctx.quick && ctx.frames > 50)
+		ctx.frames = 50;
+
+	std::vector<BenchCase> run;
+	bool needsGL = false;
+	for (const BenchCase& c : benchCases()) {
+		if (!selected(c.name, filters))
+			continue;
+		run.push_back(c);
+		needsGL |= c.needsGL;
+	}
+
+	if (list) {
+		for (const BenchCase& c : run)
+			std::cout << c.name << (c.needsGL ? " (gl)" : "") << std::endl;
+		return 0;
+	}
+
+	// one context shared by all GL benchmarks, same size as the test.cpp window
+	HeadlessContext* gl = nullptr;
+	if (needsGL) {
+		gl = new HeadlessContext(800, 600);
+		if (!gl->valid()) {
+			std::cout << "Failed to create headless GL context" << std::endl;
+			delete gl;
+			return -1;
+		}
+		std::cout << "GL: " << gl->renderer() << " | " << gl->version() << std::endl;
+	}
+
+	int failures = 0;
+	for (const BenchCase& c : run) {
+		currentBench = c.name;
+		currentFailed = false;
+		std::cout << "[" << c.name << "]" << std::endl;
+		ctx.gl = c.needsGL ? gl : nullptr;
+		if (gl) {
+			// benchmarks create and delete their own objects, start each from a clean cache
+			glState().invalidate();
+			gl->bind();
+		}
+		c.run(ctx);
+		// anything that bypassed the state cache shows up here
+		if (c.needsGL && glState().validate() != 0)
+			benchFail("GL state cache out of sync with the context");
+		if (currentFailed)
+			failures++;
+	}
+
+	delete gl;
+	if (failures)
+		std::cout << failures << " benchmark(s) failed" << std::endl;
+	return failures ? 1 : 0;
+}
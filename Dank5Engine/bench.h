@@ -0,0 +1,59 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <vector>
+
+class HeadlessContext;
+
+// what every benchmark gets handed by dank5_bench
+struct BenchContext {
+	// offscreen GL context, only set for benchmarks registered with needsGL
+	HeadlessContext* gl;
+	// smaller problem sizes for a quick smoke run (--quick)
+	bool quick;
+	// frames to render in the render benchmarks (--frames N)
+	unsigned int frames;
+};
+
+typedef void (*BenchFunction)(BenchContext& ctx);
+
+struct BenchCase {
+	const char* name;
+	bool needsGL;
+	BenchFunction run;
+};
+
+// all benchmarks linked into dank5_bench, in registration order
+std::vector<BenchCase>& benchCases();
+
+// registers a benchmark during static initialisation, use DANK5_BENCH instead
+struct BenchRegistrar {
+	BenchRegistrar(const char* name, bool needsGL, BenchFunction run);
+};
+
+// defines and registers a benchmark:  DANK5_BENCH(name, needsGL) { ... }
+#define DANK5_BENCH(name, needsGL) \
+	static void bench_##name(BenchContext& ctx); \
+	static BenchRegistrar benchRegistrar_##name(#name, needsGL, bench_##name); \
+	static void bench_##name(BenchContext& ctx)
+
+// monotonic wall clock in milliseconds
+double benchNow();
+// prints one result line of the running benchmark
+void benchReport(const char* metric, double value, const char* unit);
+// marks the running benchmark as failed, dank5_bench then exits non-zero
+void benchFail(const char* message);
+
+// keeps the optimiser from throwing away a computed result
+template<typename T>
+inline void benchKeep(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r"(&value) : "memory");
+#else
+	static const void* volatile sink;
+	sink = &value;
+#endif
+}
+
+#endif
@@ -0,0 +1,195 @@
+#include "bench.h"
+#include "headless.h"
+#include "bakedtexture.h"
+#include "glstate.h"
+#include "mipmap.h"
+#include "stb_image.h"
+
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// texture startup: stbi_load + glTexImage2D + glGenerateMipmap (what test.cpp did)
+// against baked files mapped and uploaded level by level. Cold loads first drop the
+// file from the page cache, warm loads find it there.
+
+// drops the file's pages from the page cache; false where that isn't possible
+static bool evict(const char* path)
+{
+#ifdef _WIN32
+	(void)path;
+	return false;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	// written pages have to be clean before they can be dropped
+	fdatasync(fd);
+	bool evicted = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	close(fd);
+	return evicted;
+#endif
+}
+
+static unsigned int loadDecoded(const char* path)
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glState().bindTexture(0, GL_TEXTURE_2D, texture);
+	int width, height, channels;
+	unsigned char* data = stbi_load(path, &width, &height, &channels, 4);
+	if (data)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	stbi_image_free(data);
+	return texture;
+}
+
+// milliseconds for one load, everything finished on the GPU
+template<typename Load>
+static double timeLoad(BenchContext& ctx, Load load, unsigned int& texture)
+{
+	double start = benchNow();
+	texture = load();
+	ctx.gl->finish();
+	return benchNow() - start;
+}
+
+static std::vector<unsigned char> readLevel(unsigned int texture, int level, int& width, int& height)
+{
+	glState().bindTexture(0, GL_TEXTURE_2D, texture);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+	std::vector<unsigned char> texels((size_t)width * height * 4);
+	glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+	return texels;
+}
+
+static double psnr(const unsigned char* a, const unsigned char* b, size_t texels, int channels)
+{
+	double error = 0.0;
+	for (size_t i = 0; i < texels; i++)
+		for (int c = 0; c < channels; c++)
+		{
+			double d = (double)a[i * 4 + c] - b[i * 4 + c];
+			error += d * d;
+		}
+	error /= (double)texels * channels;
+	return error > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / error) : 99.0;
+}
+
+static long fileSize(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return 0;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fclose(file);
+	return size;
+}
+
+DANK5_BENCH(baked_texture, true)
+{
+	const unsigned int warmRuns = ctx.quick ? 3 : 20;
+	static const char* names[BAKED_FORMAT_COUNT] = { "rgba8", "bc1", "bc3", "bc7", "bc4", "bc5" };
+	// what each format stores: RGB for BC1, R for BC4, RG for BC5
+	static const int checkedChannels[BAKED_FORMAT_COUNT] = { 4, 3, 4, 4, 1, 2 };
+
+	int width, height, channels;
+	unsigned char* source = stbi_load("container.jpg", &width, &height, &channels, 4);
+	if (!source)
+	{
+		benchFail("failed to load container.jpg (run dank5_bench from the build directory)");
+		return;
+	}
+	std::vector<size_t> offsets;
+	std::vector<unsigned char> chain(mipChainOffsets(width, height, offsets));
+	memcpy(chain.data(), source, (size_t)width * height * 4);
+	stbi_image_free(source);
+	buildMipChain(chain.data(), width, height, offsets, MIP_KAISER);
+
+	// the decode path
+	bool cold = evict("container.jpg");
+	unsigned int texture;
+	double elapsed = timeLoad(ctx, [] { return loadDecoded("container.jpg"); }, texture);
+	glState().deleteTextures(1, &texture);
+	if (cold)
+		benchReport("decode_cold", elapsed, "ms");
+	elapsed = 0.0;
+	for (unsigned int i = 0; i < warmRuns; i++)
+	{
+		elapsed += timeLoad(ctx, [] { return loadDecoded("container.jpg"); }, texture);
+		glState().deleteTextures(1, &texture);
+	}
+	benchReport("decode_warm", elapsed / warmRuns, "ms");
+
+	for (int format = 0; format < BAKED_FORMAT_COUNT; format++)
+	{
+		std::string name = names[format];
+		std::string path = "container_" + name + ".d5tex";
+		if (!bakedFormatSupported((BakedFormat)format))
+		{
+			benchReport((name + "_unsupported").c_str(), 1, "");
+			continue;
+		}
+		double start = benchNow();
+		if (!cookTexture("container.jpg", path, (BakedFormat)format))
+		{
+			benchFail(("failed to cook " + path).c_str());
+			continue;
+		}
+		benchReport((name + "_cook").c_str(), benchNow() - start, "ms");
+		benchReport((name + "_size").c_str(), fileSize(path.c_str()) / 1024.0, "KB");
+
+		if (evict(path.c_str()))
+		{
+			elapsed = timeLoad(ctx, [&path] { return loadBakedTexture(path); }, texture);
+			glState().deleteTextures(1, &texture);
+			benchReport((name + "_cold").c_str(), elapsed, "ms");
+		}
+		elapsed = 0.0;
+		for (unsigned int i = 0; i < warmRuns; i++)
+		{
+			elapsed += timeLoad(ctx, [&path] { return loadBakedTexture(path); }, texture);
+			if (i + 1 < warmRuns)
+				glState().deleteTextures(1, &texture);
+		}
+		benchReport((name + "_warm").c_str(), elapsed / warmRuns, "ms");
+		if (!texture)
+		{
+			benchFail(("failed to load " + path).c_str());
+			continue;
+		}
+
+		// RGBA8 has to come back exactly; BCn as GL decodes it, close to the source
+		size_t checked[2] = { 0, offsets.size() - 1 };
+		for (size_t level : checked)
+		{
+			int w, h;
+			std::vector<unsigned char> texels = readLevel(texture, (int)level, w, h);
+			const unsigned char* expected = chain.data() + offsets[level];
+			if (format == BAKED_RGBA8)
+			{
+				if (memcmp(texels.data(), expected, texels.size()) != 0)
+					benchFail("baked RGBA8 level differs from the mip chain");
+			}
+			else if (level == 0)
+			{
+				double quality = psnr(texels.data(), expected, (size_t)w * h, checkedChannels[format]);
+				benchReport((name + "_psnr").c_str(), quality, "dB");
+				if (quality < 30.0)
+					benchFail(("decoded " + name + " is far from the source").c_str());
+			}
+		}
+		glState().deleteTextures(1, &texture);
+	}
+}
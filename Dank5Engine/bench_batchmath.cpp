@@ -0,0 +1,118 @@
+#include "bench.h"
+#include "batchmath.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// batch matrix kernels over 100k transforms per SIMD path against glm one matrix at a time:
+// TRS composition, viewProjection * world, parent * local and normal matrices
+
+static float randomUnit()
+{
+	return (float)rand() / RAND_MAX * 2.0f - 1.0f;
+}
+
+static bool close(const glm::mat4* a, const glm::mat4* b, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++)
+		for (int c = 0; c < 4; c++)
+			for (int r = 0; r < 4; r++)
+				if (std::fabs(a[i][c][r] - b[i][c][r]) > 1e-3f * (1.0f + std::fabs(b[i][c][r])))
+					return false;
+	return true;
+}
+
+// kernel(path) over every path, timed per call and checked against the scalar output
+template<typename Kernel>
+static void runPaths(const char* kind, unsigned int count, unsigned int repeats, std::vector<glm::mat4>& out, Kernel kernel)
+{
+	const MatrixPath paths[] = { MATRIX_SCALAR, MATRIX_SSE, MATRIX_AVX2, MATRIX_AVX512 };
+	std::vector<glm::mat4> reference;
+	double scalar = 0.0;
+	for (MatrixPath path : paths)
+	{
+		// paths the build doesn't have fall back to one already measured
+		if (path != MATRIX_SCALAR && std::string(matrixPathName(path)) == matrixPathName((MatrixPath)(path - 1)))
+			continue;
+		double best = 1e30;
+		for (unsigned int r = 0; r < repeats; r++)
+		{
+			double start = benchNow();
+			kernel(path);
+			best = std::min(best, benchNow() - start);
+		}
+		if (path == MATRIX_SCALAR)
+		{
+			reference = out;
+			scalar = best;
+		}
+		else if (!close(out.data(), reference.data(), count))
+			benchFail("SIMD path disagrees with glm");
+		std::string metric = std::string(kind) + "_" + matrixPathName(path);
+		benchReport(metric.c_str(), count / best, "matrices/ms");
+		if (path != MATRIX_SCALAR)
+		{
+			metric += "_speedup";
+			benchReport(metric.c_str(), scalar / best, "x");
+		}
+	}
+	benchKeep(out);
+}
+
+DANK5_BENCH(batch_matrix, false)
+{
+	// not a multiple of 16, so the SoA paths run their scalar tails too
+	const unsigned int count = ctx.quick ? 10007 : 100007;
+	const unsigned int repeats = ctx.quick ? 5 : 20;
+	srand(11);
+	TransformArrays transforms;
+	transforms.resize(count);
+	std::vector<glm::mat4> parents(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		glm::vec3 position(randomUnit() * 100.0f, randomUnit() * 100.0f, randomUnit() * 100.0f);
+		glm::quat rotation = glm::angleAxis(randomUnit() * 3.14159f, glm::normalize(glm::vec3(randomUnit(), randomUnit(), randomUnit()) + glm::vec3(0.0f, 0.01f, 0.0f)));
+		glm::vec3 scale(0.5f + randomUnit() * 0.25f, 1.0f + randomUnit() * 0.5f, 1.5f + randomUnit() * 0.25f);
+		transforms.set(i, position, rotation, scale);
+		parents[i] = glm::rotate(glm::translate(glm::mat4(1.0f), -position), randomUnit(), glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 500.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 viewProjection = projection * view;
+	std::cout << "  path: " << matrixPathName(matrixPath()) << std::endl;
+
+	std::vector<glm::mat4> locals(count), out(count);
+	composeTransforms(transforms, locals.data(), MATRIX_SCALAR);
+	// the scalar path is glm itself: translate * rotate * scale
+	for (unsigned int i = 0; i < count; i += 101)
+	{
+		glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(transforms.px[i], transforms.py[i], transforms.pz[i])) *
+			glm::mat4_cast(glm::quat(transforms.qw[i], transforms.qx[i], transforms.qy[i], transforms.qz[i])) *
+			glm::scale(glm::mat4(1.0f), glm::vec3(transforms.sx[i], transforms.sy[i], transforms.sz[i]));
+		if (!close(&locals[i], &m, 1))
+		{
+			benchFail("composition isn't translate * rotate * scale");
+			break;
+		}
+	}
+
+	runPaths("compose", count, repeats, out, [&](MatrixPath path) {
+		composeTransforms(transforms, out.data(), path);
+	});
+	runPaths("model_world", count, repeats, out, [&](MatrixPath path) {
+		multiplyMatrices(parents.data(), locals.data(), count, out.data(), path);
+	});
+	runPaths("world_clip", count, repeats, out, [&](MatrixPath path) {
+		multiplyMatrices(viewProjection, locals.data(), count, out.data(), path);
+	});
+	runPaths("normal", count, repeats, out, [&](MatrixPath path) {
+		normalMatrices(locals.data(), count, out.data(), path);
+	});
+}
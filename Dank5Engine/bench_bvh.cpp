@@ -0,0 +1,174 @@
+#include "bench.h"
+#include "bvh.h"
+#include "culling.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+// BVH build, frustum and ray queries and refit, against brute force over the same boxes
+
+static float randomUnit()
+{
+	return rand() / (float)RAND_MAX;
+}
+
+// brute-force picking: slab test against every box
+static int raycastBrute(const std::vector<AABB>& boxes, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* distance)
+{
+	glm::vec3 inv = 1.0f / direction;
+	int hit = -1;
+	float closest = maxDistance;
+	for (unsigned int i = 0; i < boxes.size(); i++)
+	{
+		float t = intersectAABB(origin, inv, boxes[i].min, boxes[i].max, closest);
+		if (t >= 0.0f && (hit < 0 || t < closest))
+		{
+			closest = t;
+			hit = (int)i;
+		}
+	}
+	*distance = closest;
+	return hit;
+}
+
+DANK5_BENCH(bvh, false)
+{
+	const unsigned int count = ctx.quick ? 100000 : 1000000;
+	const unsigned int repeats = ctx.quick ? 3 : 10;
+	const unsigned int rays = ctx.quick ? 100 : 1000;
+	srand(11);
+	std::vector<AABB> boxes(count);
+	BoundingBoxes soa;
+	soa.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		glm::vec3 center(rand() % 1000 - 500.0f, rand() % 1000 - 500.0f, rand() % 1000 - 500.0f);
+		glm::vec3 half(0.5f + rand() % 4);
+		boxes[i].min = center - half;
+		boxes[i].max = center + half;
+		soa.set(i, boxes[i].min, boxes[i].max);
+	}
+
+	BVH bvh;
+	double start = benchNow();
+	bvh.build(boxes.data(), count);
+	benchReport("build", benchNow() - start, "ms");
+	benchReport("nodes", bvh.nodeCount(), "nodes");
+
+	// frustum: the bench camera at a few headings, BVH against the SIMD linear cull
+	std::vector<unsigned int> reference(count), visible(count);
+	double bvhTime = 0.0, linearTime = 0.0;
+	unsigned int totalVisible = 0;
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 500.0f);
+	for (unsigned int r = 0; r < repeats; r++)
+	{
+		float yaw = glm::radians(360.0f * r / repeats);
+		glm::vec3 eye(0.0f, 0.0f, 3.0f);
+		glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(sinf(yaw), 0.0f, -cosf(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+		Frustum frustum = extractFrustum(projection * view);
+
+		start = benchNow();
+		unsigned int expected = cullBoxes(frustum, soa, reference.data());
+		linearTime += benchNow() - start;
+		start = benchNow();
+		unsigned int n = bvh.queryFrustum(frustum, visible.data());
+		bvhTime += benchNow() - start;
+
+		std::sort(visible.begin(), visible.begin() + n);
+		if (n != expected || !std::equal(reference.begin(), reference.begin() + n, visible.begin()))
+			benchFail("BVH frustum query disagrees with the linear cull");
+		totalVisible += n;
+	}
+	benchReport("frustum_linear", linearTime / repeats, "ms");
+	benchReport("frustum_bvh", bvhTime / repeats, "ms");
+	benchReport("frustum_visible", totalVisible / repeats, "objects");
+
+	// picking: random rays from inside the scene, brute force only over a subset of them
+	const unsigned int bruteRays = std::max(1u, rays / 20);
+	std::vector<glm::vec3> origins(rays), directions(rays);
+	for (unsigned int i = 0; i < rays; i++)
+	{
+		origins[i] = glm::vec3(randomUnit(), randomUnit(), randomUnit()) * 1000.0f - 500.0f;
+		directions[i] = glm::normalize(glm::vec3(randomUnit(), randomUnit(), randomUnit()) * 2.0f - 1.0f);
+	}
+	unsigned int hits = 0;
+	start = benchNow();
+	for (unsigned int i = 0; i < rays; i++)
+		hits += bvh.raycast(origins[i], directions[i], FLT_MAX) >= 0;
+	benchReport("ray_bvh", (benchNow() - start) * 1000.0 / rays, "us/ray");
+	benchReport("ray_hits", 100.0 * hits / rays, "%");
+	start = benchNow();
+	for (unsigned int i = 0; i < bruteRays; i++)
+	{
+		float expected, distance = FLT_MAX;
+		int reference = raycastBrute(boxes, origins[i], directions[i], FLT_MAX, &expected);
+		int hit = bvh.raycast(origins[i], directions[i], FLT_MAX, &distance);
+		// overlapping boxes can tie, so compare the distance rather than the object
+		if ((hit < 0) != (reference < 0) || (hit >= 0 && distance != expected))
+			benchFail("BVH raycast disagrees with brute force");
+	}
+	benchReport("ray_brute", (benchNow() - start) * 1000.0 / bruteRays, "us/ray");
+
+	// refit with 1% of the objects moved a little
+	const unsigned int moved = count / 100;
+	start = benchNow();
+	for (unsigned int r = 0; r < repeats; r++)
+	{
+		for (unsigned int i = 0; i < moved; i++)
+		{
+			unsigned int object = rand() % count;
+			glm::vec3 offset = glm::vec3(randomUnit(), randomUnit(), randomUnit()) - 0.5f;
+			boxes[object].min += offset;
+			boxes[object].max += offset;
+			bvh.update(object, boxes[object]);
+		}
+		bvh.refit();
+	}
+	benchReport("refit", (benchNow() - start) / repeats, "ms");
+	start = benchNow();
+	bvh.build(boxes.data(), count);
+	benchReport("rebuild", benchNow() - start, "ms");
+
+	// objects spaced geometrically along both directions of every axis: each SAH split
+	// peels only a few off the ends of the centroid range, so the tree gets deeper than
+	// the fixed traversal stack
+	const unsigned int chain = 250;
+	std::vector<AABB> skewed(6 * chain);
+	BoundingBoxes skewedSoa;
+	skewedSoa.resize(6 * chain);
+	for (unsigned int i = 0; i < 6 * chain; i++)
+	{
+		glm::vec3 center(0.0f);
+		center[i / chain % 3] = (i < 3 * chain ? 1e-20f : -1e-20f) * powf(1.36f, (float)(i % chain));
+		skewed[i].min = center - 0.5f;
+		skewed[i].max = center + 0.5f;
+		skewedSoa.set(i, skewed[i].min, skewed[i].max);
+	}
+	BVH deep;
+	deep.build(skewed.data(), 6 * chain);
+	benchReport("skewed_depth", deep.depth(), "levels");
+	Frustum along = extractFrustum(projection * glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	unsigned int expected = cullBoxes(along, skewedSoa, reference.data());
+	unsigned int n = deep.queryFrustum(along, visible.data());
+	std::sort(visible.begin(), visible.begin() + n);
+	if (n != expected || !std::equal(reference.begin(), reference.begin() + n, visible.begin()))
+		benchFail("deep BVH frustum query disagrees with the linear cull");
+	for (unsigned int i = 0; i < 6 * chain; i += 7)
+	{
+		// from just past an object towards the far end of its chain
+		glm::vec3 direction(0.0f);
+		direction[i / chain % 3] = i < 3 * chain ? 1.0f : -1.0f;
+		glm::vec3 origin = (skewed[i].min + skewed[i].max) * 0.5f + direction;
+		float expectedDistance, distance = FLT_MAX;
+		int reference = raycastBrute(skewed, origin, direction, FLT_MAX, &expectedDistance);
+		int hit = deep.raycast(origin, direction, FLT_MAX, &distance);
+		if ((hit < 0) != (reference < 0) || (hit >= 0 && distance != expectedDistance))
+			benchFail("deep BVH raycast disagrees with brute force");
+	}
+}
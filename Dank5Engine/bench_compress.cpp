@@ -0,0 +1,81 @@
+#include "bench.h"
+#include "texturecompress.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// BCn encoder throughput and quality on container.jpg for every format and preset, then
+// BC7 over 1..N threads (the output has to be the same at every count)
+
+DANK5_BENCH(texture_compress, false)
+{
+	static const BlockFormat formats[] = { BLOCK_BC1, BLOCK_BC3, BLOCK_BC4, BLOCK_BC5, BLOCK_BC7 };
+	static const CompressionQuality qualities[] = { COMPRESS_FAST, COMPRESS_NORMAL, COMPRESS_BEST };
+	const unsigned int repeats = ctx.quick ? 1 : 5;
+
+	int width, height, channels;
+	unsigned char* source = stbi_load("container.jpg", &width, &height, &channels, 4);
+	if (!source)
+	{
+		benchFail("failed to load container.jpg (run dank5_bench from the build directory)");
+		return;
+	}
+	std::vector<unsigned char> rgba(source, source + (size_t)width * height * 4);
+	stbi_image_free(source);
+	const double texels = (double)width * height;
+	std::cout << "  path: " << compressionPath() << std::endl;
+
+	std::vector<unsigned char> blocks(compressedSize(BLOCK_BC7, width, height));
+	for (BlockFormat format : formats)
+	{
+		// each preset has to be at least as close to the source as the one before it
+		double previousPsnr = 0.0;
+		for (CompressionQuality quality : qualities)
+		{
+			std::string name = std::string(blockFormatName(format)) + "_" + compressionQualityName(quality);
+			std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+			double best = 1e30, psnr = 0.0;
+			for (unsigned int r = 0; r < repeats; r++)
+			{
+				CompressionReport report = compressTexture(format, rgba.data(), width, height, blocks.data(), quality, 1);
+				best = std::min(best, report.milliseconds);
+				psnr = report.psnr;
+			}
+			benchReport((name + "_rate").c_str(), texels / best / 1000.0, "Mtexels/s");
+			benchReport((name + "_psnr").c_str(), psnr, "dB");
+			if (psnr < 30.0)
+				benchFail((name + " is far from the source").c_str());
+			if (psnr < previousPsnr)
+				benchFail((name + " is further from the source than the faster preset").c_str());
+			previousPsnr = psnr;
+		}
+	}
+
+	// thread scaling, against the single threaded blocks
+	std::vector<unsigned char> reference(blocks.size());
+	compressImage(BLOCK_BC7, rgba.data(), width, height, reference.data(), COMPRESS_NORMAL, 1);
+	unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> counts;
+	for (unsigned int threads = 1; threads < hardware; threads *= 2)
+		counts.push_back(threads);
+	counts.push_back(hardware);
+	for (unsigned int threads : counts)
+	{
+		double best = 1e30;
+		for (unsigned int r = 0; r < repeats; r++)
+		{
+			std::fill(blocks.begin(), blocks.end(), 0);
+			double start = benchNow();
+			compressImage(BLOCK_BC7, rgba.data(), width, height, blocks.data(), COMPRESS_NORMAL, threads);
+			best = std::min(best, benchNow() - start);
+			if (blocks != reference)
+				benchFail("threaded BC7 output differs from single threaded");
+		}
+		benchReport(("bc7_threads_" + std::to_string(threads)).c_str(), texels / best / 1000.0, "Mtexels/s");
+	}
+}
@@ -0,0 +1,82 @@
+#include "bench.h"
+#include "culling.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// frustum culling throughput over a large random scene, per SIMD path
+
+typedef unsigned int (*SphereCull)(const Frustum&, const BoundingSpheres&, unsigned int*);
+typedef unsigned int (*BoxCull)(const Frustum&, const BoundingBoxes&, unsigned int*);
+
+static unsigned int spheresScalar(const Frustum& f, const BoundingSpheres& s, unsigned int* v)
+{
+	return cullSpheresScalar(f, s, 0, v);
+}
+
+static unsigned int boxesScalar(const Frustum& f, const BoundingBoxes& b, unsigned int* v)
+{
+	return cullBoxesScalar(f, b, 0, v);
+}
+
+// the camera of test.cpp in the middle of a 1000 unit cube of objects
+static Frustum benchFrustum()
+{
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 500.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return extractFrustum(projection * view);
+}
+
+template<typename Bounds, typename Cull>
+static void runPaths(const char* kind, const Frustum& frustum, const Bounds& bounds, const Cull* paths, const char** names, unsigned int pathCount, unsigned int repeats)
+{
+	const unsigned int count = bounds.size();
+	std::vector<unsigned int> reference(count), visible(count);
+	unsigned int expected = paths[0](frustum, bounds, reference.data());
+	for (unsigned int p = 0; p < pathCount; p++)
+	{
+		unsigned int n = 0;
+		double start = benchNow();
+		for (unsigned int r = 0; r < repeats; r++)
+			n = paths[p](frustum, bounds, visible.data());
+		double elapsed = (benchNow() - start) / repeats;
+		if (n != expected || !std::equal(reference.begin(), reference.begin() + n, visible.begin()))
+			benchFail("SIMD path disagrees with the scalar path");
+		std::string metric = std::string(kind) + "_" + names[p];
+		benchReport(metric.c_str(), count / elapsed, "objects/ms");
+	}
+	std::string metric = std::string(kind) + "_visible";
+	benchReport(metric.c_str(), expected, "objects");
+}
+
+DANK5_BENCH(cull_1m, false)
+{
+	const unsigned int count = ctx.quick ? 100000 : 1000000;
+	const unsigned int repeats = ctx.quick ? 3 : 10;
+	srand(7);
+	BoundingSpheres spheres;
+	BoundingBoxes boxes;
+	spheres.resize(count);
+	boxes.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		glm::vec3 center(rand() % 1000 - 500.0f, rand() % 1000 - 500.0f, rand() % 1000 - 500.0f);
+		glm::vec3 half(0.5f + rand() % 4);
+		spheres.set(i, center, glm::length(half));
+		boxes.set(i, center - half, center + half);
+	}
+	Frustum frustum = benchFrustum();
+	std::cout << "  path: " << cullingPath() << std::endl;
+
+	const char* names[] = { "scalar", "sse", "avx" };
+	const SphereCull spherePaths[] = { spheresScalar, cullSpheresSSE, cullSpheresAVX };
+	const BoxCull boxPaths[] = { boxesScalar, cullBoxesSSE, cullBoxesAVX };
+	runPaths("spheres", frustum, spheres, spherePaths, names, 3, repeats);
+	runPaths("boxes", frustum, boxes, boxPaths, names, 3, repeats);
+}
@@ -0,0 +1,232 @@
+#include "bench.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// stb_image decode throughput per format, with the AVX2 kernels against the baseline
+// (SSE2 for JPEG, the scalar loops for PNG). MB/s are of decoded pixels. The PNGs are
+// written here with stored (uncompressed) deflate blocks and one filter for every row,
+// so inflate is a copy and the time is the unfiltering that the kernels replace.
+
+static void putBig32(std::vector<unsigned char>& out, uint32_t value)
+{
+	out.push_back((unsigned char)(value >> 24));
+	out.push_back((unsigned char)(value >> 16));
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)value);
+}
+
+static uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+{
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+	}
+	return ~crc;
+}
+
+static void putChunk(std::vector<unsigned char>& png, const char* type, const std::vector<unsigned char>& data)
+{
+	putBig32(png, (uint32_t)data.size());
+	size_t start = png.size();
+	png.insert(png.end(), type, type + 4);
+	png.insert(png.end(), data.begin(), data.end());
+	putBig32(png, crc32(&png[start], png.size() - start));
+}
+
+static int paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if (pa <= pb && pa <= pc)
+		return a;
+	return pb <= pc ? b : c;
+}
+
+// an 8-bit PNG of the pixels with every row filtered with 'filter' (0 none .. 4 paeth)
+static std::vector<unsigned char> encodePNG(const std::vector<unsigned char>& pixels, int width, int height, int channels, int filter)
+{
+	size_t stride = (size_t)width * channels;
+	std::vector<unsigned char> filtered;
+	filtered.reserve((stride + 1) * height);
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* row = &pixels[y * stride];
+		const unsigned char* prior = y > 0 ? row - stride : nullptr;
+		filtered.push_back((unsigned char)filter);
+		for (size_t k = 0; k < stride; k++)
+		{
+			int a = k >= (size_t)channels ? row[k - channels] : 0;
+			int b = prior ? prior[k] : 0;
+			int c = prior && k >= (size_t)channels ? prior[k - channels] : 0;
+			int predicted = 0;
+			switch (filter)
+			{
+			case 1: predicted = a; break;
+			case 2: predicted = b; break;
+			case 3: predicted = (a + b) >> 1; break;
+			case 4: predicted = paeth(a, b, c); break;
+			}
+			filtered.push_back((unsigned char)(row[k] - predicted));
+		}
+	}
+
+	// zlib stream of stored blocks
+	std::vector<unsigned char> zlib = { 0x78, 0x01 };
+	size_t offset = 0;
+	do
+	{
+		size_t size = std::min<size_t>(filtered.size() - offset, 65535);
+		zlib.push_back(offset + size == filtered.size() ? 1 : 0);
+		zlib.push_back((unsigned char)size);
+		zlib.push_back((unsigned char)(size >> 8));
+		zlib.push_back((unsigned char)~size);
+		zlib.push_back((unsigned char)(~size >> 8));
+		zlib.insert(zlib.end(), filtered.begin() + offset, filtered.begin() + offset + size);
+		offset += size;
+	} while (offset < filtered.size());
+	uint32_t s1 = 1, s2 = 0;
+	for (size_t i = 0; i < filtered.size(); i++)
+	{
+		s1 = (s1 + filtered[i]) % 65521;
+		s2 = (s2 + s1) % 65521;
+	}
+	putBig32(zlib, (s2 << 16) | s1);
+
+	static const unsigned char signature[] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	std::vector<unsigned char> png(signature, signature + 8);
+	std::vector<unsigned char> header;
+	putBig32(header, (uint32_t)width);
+	putBig32(header, (uint32_t)height);
+	header.push_back(8);
+	header.push_back(channels == 4 ? 6 : 2);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	putChunk(png, "IHDR", header);
+	putChunk(png, "IDAT", zlib);
+	putChunk(png, "IEND", std::vector<unsigned char>());
+	return png;
+}
+
+// smooth gradients with noise, so every filter leaves something to undo
+static std::vector<unsigned char> photoLike(int width, int height, int channels)
+{
+	std::vector<unsigned char> pixels((size_t)width * height * channels);
+	uint32_t seed = 12345;
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+			for (int c = 0; c < channels; c++)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				int value = (x * (c + 1) + y * (3 - c)) / 4 + (int)(seed >> 28);
+				pixels[((size_t)y * width + x) * channels + c] = (unsigned char)value;
+			}
+	return pixels;
+}
+
+struct DecodeCase {
+	std::string name;
+	std::vector<unsigned char> file;
+	int desiredChannels;
+	// the pixels a generated PNG was written from, null for files
+	const std::vector<unsigned char>* source;
+	int sourceChannels;
+};
+
+// decodes the case 'count' times, returns the MB/s and the last decode
+static double decodeRate(const DecodeCase& test, unsigned int count, std::vector<unsigned char>& pixels)
+{
+	size_t bytes = 0;
+	double start = benchNow();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		int width, height, channels;
+		unsigned char* data = stbi_load_from_memory(test.file.data(), (int)test.file.size(), &width, &height, &channels, test.desiredChannels);
+		if (!data)
+		{
+			benchFail(("failed to decode " + test.name + ": " + stbi_failure_reason()).c_str());
+			return 0.0;
+		}
+		size_t size = (size_t)width * height * (test.desiredChannels ? test.desiredChannels : channels);
+		if (i + 1 == count)
+			pixels.assign(data, data + size);
+		bytes += size;
+		stbi_image_free(data);
+	}
+	return bytes / (1024.0 * 1024.0) / ((benchNow() - start) / 1000.0);
+}
+
+static bool roundTrips(const std::vector<unsigned char>& source, int sourceChannels, const std::vector<unsigned char>& decoded, int channels)
+{
+	size_t pixels = source.size() / sourceChannels;
+	if (decoded.size() != pixels * channels)
+		return false;
+	for (size_t p = 0; p < pixels; p++)
+		for (int c = 0; c < channels; c++)
+		{
+			int expected = c < sourceChannels ? source[p * sourceChannels + c] : 255;
+			if (decoded[p * channels + c] != expected)
+				return false;
+		}
+	return true;
+}
+
+DANK5_BENCH(decode_formats, false)
+{
+	const unsigned int count = ctx.quick ? 10 : 100;
+	std::vector<DecodeCase> cases;
+
+	std::ifstream file("container.jpg", std::ios::binary);
+	std::vector<unsigned char> jpeg((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (jpeg.empty())
+	{
+		benchFail("failed to load container.jpg (run dank5_bench from the build directory)");
+		return;
+	}
+	cases.push_back({ "jpeg_rgba", jpeg, 4, nullptr, 0 });
+	cases.push_back({ "jpeg_rgb", jpeg, 3, nullptr, 0 });
+
+	static const char* filters[] = { "none", "sub", "up", "avg", "paeth" };
+	std::vector<unsigned char> rgb = photoLike(512, 512, 3), rgba = photoLike(512, 512, 4);
+	for (int filter = 0; filter < 5; filter++)
+	{
+		std::vector<unsigned char> rgbFile = encodePNG(rgb, 512, 512, 3, filter);
+		cases.push_back({ std::string("png_rgba_") + filters[filter], encodePNG(rgba, 512, 512, 4, filter), 4, &rgba, 4 });
+		cases.push_back({ std::string("png_rgb_") + filters[filter], rgbFile, 3, &rgb, 3 });
+		// RGB files loaded as RGBA, as the texture loaders do
+		cases.push_back({ std::string("png_rgb_to_rgba_") + filters[filter], rgbFile, 4, &rgb, 3 });
+	}
+
+	for (size_t i = 0; i < cases.size(); i++)
+	{
+		const DecodeCase& test = cases[i];
+		std::vector<unsigned char> baseline, avx2;
+		// an untimed decode first: the first large allocations fault in fresh pages and
+		// move glibc's mmap threshold, which otherwise lands on whichever path runs first
+		decodeRate(test, 1, baseline);
+		stbi_set_avx2_on_load(0);
+		double baselineRate = decodeRate(test, count, baseline);
+		stbi_set_avx2_on_load(1);
+		double avx2Rate = decodeRate(test, count, avx2);
+		benchReport((test.name + "_baseline").c_str(), baselineRate, "MB/s");
+		benchReport((test.name + "_avx2").c_str(), avx2Rate, "MB/s");
+		benchReport((test.name + "_speedup").c_str(), avx2Rate / baselineRate, "x");
+		if (baseline != avx2)
+			benchFail((test.name + ": AVX2 decode differs from the baseline").c_str());
+		// the generated PNGs also have to round trip
+		if (test.source && !roundTrips(*test.source, test.sourceChannels, avx2, test.desiredChannels))
+			benchFail((test.name + ": decoded pixels differ from the encoded ones").c_str());
+	}
+	stbi_set_avx2_on_load(1);
+}
@@ -0,0 +1,199 @@
+#include "bench.h"
+#include "ecs.h"
+#include "jobsystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// archetype ECS: 1M entities with position, velocity and lifetime integrated through a
+// query, against the same loop over plain arrays (what memory bandwidth allows) and over
+// individually allocated objects in shuffled order (pointer chasing); plus command buffer
+// playback and a schedule of systems sharing a phase
+
+struct Position {
+	float x, y, z;
+};
+
+struct Velocity {
+	float x, y, z;
+};
+
+struct Lifetime {
+	float seconds;
+};
+
+struct Tagged {
+	unsigned int frame;
+};
+
+// one entity as a heap object, for the pointer chasing case
+struct GameObject {
+	Position position;
+	Velocity velocity;
+	Lifetime lifetime;
+	// what an object typically carries besides the fields the loop touches
+	char other[84];
+};
+
+static const float STEP = 1.0f / 60.0f;
+
+// a lambda rather than a function, so the queries inline it
+static const auto integrate = [](Position& p, const Velocity& v, Lifetime& l) {
+	p.x += v.x * STEP;
+	p.y += v.y * STEP;
+	p.z += v.z * STEP;
+	l.seconds -= STEP;
+};
+
+// bytes a step moves per entity: position and lifetime read and written, velocity read
+static const double BYTES_PER_ENTITY = 2.0 * sizeof(Position) + sizeof(Velocity) + 2.0 * sizeof(Lifetime);
+
+static Velocity velocityOf(unsigned int i)
+{
+	return Velocity{ (float)(i % 7) - 3.0f, (float)(i % 5) - 2.0f, (float)(i % 3) - 1.0f };
+}
+
+// best of repeats, in milliseconds
+template<typename F>
+static double bestOf(unsigned int repeats, F step)
+{
+	double best = 1e30;
+	for (unsigned int r = 0; r < repeats; r++)
+	{
+		double start = benchNow();
+		step();
+		best = std::min(best, benchNow() - start);
+	}
+	return best;
+}
+
+static void reportStep(const char* metric, unsigned int count, double milliseconds)
+{
+	benchReport(metric, count * BYTES_PER_ENTITY / (milliseconds * 1e6), "GB/s");
+}
+
+DANK5_BENCH(ecs_iterate, false)
+{
+	const unsigned int count = ctx.quick ? 200000 : 1000000;
+	const unsigned int repeats = ctx.quick ? 5 : 20;
+
+	EntityWorld world;
+	std::vector<Entity> entities(count);
+	double start = benchNow();
+	for (unsigned int i = 0; i < count; i++)
+		entities[i] = world.create(Position{ (float)i, 0.0f, 0.0f }, velocityOf(i), Lifetime{ 100.0f });
+	benchReport("create", (benchNow() - start) * 1e6 / count, "ns/entity");
+
+	unsigned int steps = 0;
+	double ecs = bestOf(repeats, [&] {
+		world.each<Position, const Velocity, Lifetime>(integrate);
+		steps++;
+	});
+	reportStep("query_each", count, ecs);
+	double ecsParallel = bestOf(repeats, [&] {
+		world.parallelEach<Position, const Velocity, Lifetime>(jobSystem(), integrate);
+		steps++;
+	});
+	reportStep("query_parallel_each", count, ecsParallel);
+
+	// every entity moved by its velocity once a step
+	for (unsigned int i = 0; i < count; i += 997)
+	{
+		const Position& p = *world.get<Position>(entities[i]);
+		Velocity v = velocityOf(i);
+		float expected = (float)i + v.x * STEP * steps;
+		if (std::fabs(p.x - expected) > 1e-3f * (1.0f + std::fabs(expected)) || world.get<Lifetime>(entities[i])->seconds >= 100.0f)
+		{
+			benchFail("a query missed or repeated entities");
+			break;
+		}
+	}
+
+	// the same loop over plain arrays: the bandwidth bound
+	{
+		std::vector<Position> positions(count);
+		std::vector<Velocity> velocities(count);
+		std::vector<Lifetime> lifetimes(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			positions[i] = Position{ (float)i, 0.0f, 0.0f };
+			velocities[i] = velocityOf(i);
+			lifetimes[i].seconds = 100.0f;
+		}
+		double arrays = bestOf(repeats, [&] {
+			for (unsigned int i = 0; i < count; i++)
+				integrate(positions[i], velocities[i], lifetimes[i]);
+		});
+		reportStep("plain_arrays", count, arrays);
+		benchReport("query_vs_arrays", arrays / ecs, "x");
+		benchKeep(positions);
+	}
+
+	// objects allocated one by one and visited in shuffled order
+	{
+		std::vector<std::unique_ptr<GameObject>> objects(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			objects[i].reset(new GameObject());
+			objects[i]->velocity = velocityOf(i);
+		}
+		srand(5);
+		for (unsigned int i = count - 1; i > 0; i--)
+			std::swap(objects[i], objects[((unsigned int)rand() * 32768u + (unsigned int)rand()) % (i + 1)]);
+		double pointers = bestOf(ctx.quick ? 2 : 5, [&] {
+			for (auto& object : objects)
+				integrate(object->position, object->velocity, object->lifetime);
+		});
+		reportStep("pointer_chasing", count, pointers);
+	}
+
+	// structural changes through a command buffer: 1% destroyed, 1% tagged, 1% created
+	EntityCommands commands;
+	for (unsigned int i = 0; i < count / 100; i++)
+	{
+		commands.destroy(entities[i * 100]);
+		commands.add(entities[i * 100 + 1], Tagged{ 1 });
+		commands.create(Position{ 0.0f, 0.0f, 0.0f }, Velocity{ 1.0f, 0.0f, 0.0f });
+	}
+	start = benchNow();
+	unsigned int applied = commands.playback(world);
+	benchReport("playback_3pct", (benchNow() - start) * 1000.0, "us");
+	if (applied != 3 * (count / 100) || world.size() != count || world.alive(entities[0]) ||
+		!world.has<Tagged>(entities[1]) || world.get<Tagged>(entities[1])->frame != 1)
+		benchFail("command playback went wrong");
+	unsigned int tagged = 0;
+	world.eachChunk<const Tagged>([&](unsigned int chunkCount, const Entity*, const Tagged*) { tagged += chunkCount; });
+	if (tagged != count / 100)
+		benchFail("tagged entities missing from their archetype");
+	std::cout << "  archetypes: " << world.archetypes() << std::endl;
+
+	// movement and ageing touch different components and share a phase; expiry
+	// reads what both write and waits for them
+	SystemSchedule schedule;
+	schedule.add("move", componentMask<Velocity>(), componentMask<Position>(), [](EntityWorld& w, JobSystem& jobs, EntityCommands&) {
+		w.parallelEach<Position, const Velocity>(jobs, [](Position& p, const Velocity& v) {
+			p.x += v.x * STEP;
+			p.y += v.y * STEP;
+			p.z += v.z * STEP;
+		});
+	});
+	schedule.add("age", 0, componentMask<Lifetime>(), [](EntityWorld& w, JobSystem& jobs, EntityCommands&) {
+		w.parallelEach<Lifetime>(jobs, [](Lifetime& l) { l.seconds -= STEP; });
+	});
+	schedule.add("expire", componentMask<Position, Lifetime>(), 0, [](EntityWorld& w, JobSystem&, EntityCommands& c) {
+		w.eachChunk<const Position, const Lifetime>([&c](unsigned int n, const Entity* e, const Position* p, const Lifetime* l) {
+			for (unsigned int i = 0; i < n; i++)
+				if (l[i].seconds < 0.0f || p[i].x < -1e6f)
+					c.destroy(e[i]);
+		});
+	});
+	schedule.print();
+	if (schedule.phases() != 2)
+		benchFail("independent systems didn't share a phase");
+	double frame = bestOf(repeats, [&] { schedule.run(world, jobSystem()); });
+	benchReport("schedule_frame", frame, "ms");
+}
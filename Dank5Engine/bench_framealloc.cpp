@@ -0,0 +1,213 @@
+#include "bench.h"
+#include "batchmath.h"
+#include "culling.h"
+#include "framealloc.h"
+#include "jobsystem.h"
+#include "renderqueue.h"
+#include "transforms.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+// heap allocations per frame of a CPU frame (transform update, culling, world->clip
+// matrices, per-job temporaries, render queue) with its per-frame memory from the frame
+// allocator and thread scratch, against the same frame on std::vector; steady-state
+// frames on the arenas must not allocate at all. Plus arena against heap allocation cost.
+
+// every heap allocation in dank5_bench goes through here; only frame_alloc turns the
+// counting on, the other benchmarks pay one relaxed load
+static std::atomic<bool> countAllocations(false);
+static std::atomic<unsigned long long> heapAllocations(0);
+
+void* operator new(size_t size)
+{
+	if (countAllocations.load(std::memory_order_relaxed))
+		heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+static const unsigned int OBJECTS = 20000;
+// jobs per frame touching their own temporaries
+static const unsigned int GRAIN = 1024;
+
+struct FrameScene {
+	TransformHierarchy transforms;
+	std::vector<unsigned int> nodes;
+	BoundingSpheres bounds;
+	RenderQueue queue;
+	glm::mat4 view;
+	glm::mat4 viewProjection;
+
+	FrameScene() : queue(OBJECTS)
+	{
+		srand(3);
+		bounds.resize(OBJECTS);
+		for (unsigned int i = 0; i < OBJECTS; i++)
+		{
+			glm::vec3 position(rand() % 400 - 200.0f, rand() % 400 - 200.0f, rand() % 400 - 200.0f);
+			nodes.push_back(transforms.create(TRANSFORM_NONE, position));
+			bounds.set(i, position, 0.8660254f);
+		}
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 500.0f);
+		view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		viewProjection = projection * view;
+	}
+};
+
+// the frame's per-frame memory, from the arenas or from the heap
+template<typename T>
+struct FrameArray {
+	ArenaVector<T> arena;
+	std::vector<T> heap;
+	bool useArena;
+
+	FrameArray(bool useArena, size_t count) : arena(ArenaAllocator<T>(frameAllocator().current())), useArena(useArena)
+	{
+		if (useArena)
+			arena.resize(count);
+		else
+			heap.resize(count);
+	}
+	T* data() { return useArena ? arena.data() : heap.data(); }
+};
+
+static void runFrame(FrameScene& scene, unsigned int frame, bool useArena)
+{
+	frameAllocator().beginFrame();
+	for (unsigned int i = frame % 100; i < OBJECTS; i += 100)
+		scene.transforms.setPosition(scene.nodes[i], glm::vec3(i % 400 - 200.0f, frame * 0.01f, i % 300 - 150.0f));
+	scene.transforms.update(&jobSystem());
+
+	FrameArray<unsigned int> visible(useArena, OBJECTS);
+	unsigned int visibleCount = cullSpheres(extractFrustum(scene.viewProjection), scene.bounds, visible.data());
+	FrameArray<glm::mat4> clip(useArena, visibleCount);
+	for (unsigned int v = 0; v < visibleCount; v++)
+		clip.data()[v] = scene.transforms.world(scene.nodes[visible.data()[v]]);
+	multiplyMatrices(scene.viewProjection, clip.data(), visibleCount, clip.data());
+
+	// view depths, computed by jobs through a temporary of their own each
+	FrameArray<float> depths(useArena, visibleCount);
+	jobSystem().parallelFor(0, visibleCount, GRAIN, [&](unsigned int begin, unsigned int end) {
+		ScratchScope scope;
+		std::vector<glm::vec4> heapPositions;
+		glm::vec4* positions;
+		if (useArena)
+			positions = scope.arena.allocate<glm::vec4>(end - begin);
+		else
+		{
+			heapPositions.resize(end - begin);
+			positions = heapPositions.data();
+		}
+		for (unsigned int v = begin; v < end; v++)
+			positions[v - begin] = scene.view * scene.transforms.world(scene.nodes[visible.data()[v]])[3];
+		for (unsigned int v = begin; v < end; v++)
+			depths.data()[v] = -positions[v - begin].z;
+	});
+
+	scene.queue.clear();
+	for (unsigned int v = 0; v < visibleCount; v++)
+	{
+		DrawPacket packet = { 1, 1, 1, visible.data()[v], GL_TRIANGLES, 0, 36, 0, false };
+		scene.queue.submit(packet, depths.data()[v]);
+	}
+	scene.queue.sort();
+	benchKeep(clip);
+}
+
+// heap allocations per frame over frames after a warm-up
+static double allocationsPerFrame(FrameScene& scene, unsigned int frames, bool useArena, double& milliseconds)
+{
+	for (unsigned int f = 0; f < 4; f++)
+		runFrame(scene, f, useArena);
+	heapAllocations.store(0);
+	countAllocations.store(true);
+	double start = benchNow();
+	for (unsigned int f = 0; f < frames; f++)
+		runFrame(scene, 4 + f, useArena);
+	milliseconds = (benchNow() - start) / frames;
+	countAllocations.store(false);
+	return (double)heapAllocations.load() / frames;
+}
+
+DANK5_BENCH(frame_alloc, false)
+{
+	const unsigned int frames = ctx.quick ? 20 : 200;
+	FrameScene scene;
+
+	double heapFrame = 0.0, arenaFrame = 0.0;
+	double heap = allocationsPerFrame(scene, frames, false, heapFrame);
+	double arena = allocationsPerFrame(scene, frames, true, arenaFrame);
+	benchReport("heap_allocs_per_frame", heap, "allocs");
+	benchReport("heap_frame", heapFrame, "ms");
+	benchReport("arena_allocs_per_frame", arena, "allocs");
+	benchReport("arena_frame", arenaFrame, "ms");
+	if (arena != 0.0)
+		benchFail("steady-state frames allocated from the heap");
+	if (frameAllocator().current().overflows() || frameAllocator().previous().overflows() || threadScratch().overflows())
+		benchFail("the frame ran out of arena");
+	frameAllocator().print();
+	threadScratch().print("scratch");
+
+	// small allocations one by one: a bump against malloc and free
+	const unsigned int count = ctx.quick ? 100000 : 1000000;
+	std::vector<void*> pointers(count);
+	double start = benchNow();
+	for (unsigned int i = 0; i < count; i++)
+		pointers[i] = malloc(16 + (i & 63));
+	for (unsigned int i = 0; i < count; i++)
+		free(pointers[i]);
+	benchReport("heap_alloc", (benchNow() - start) * 1e6 / count, "ns");
+	LinearArena bump(count * 96);
+	start = benchNow();
+	for (unsigned int i = 0; i < count; i++)
+		pointers[i] = bump.allocate(16 + (i & 63));
+	bump.reset();
+	benchReport("arena_alloc", (benchNow() - start) * 1e6 / count, "ns");
+	benchKeep(pointers);
+
+	// what doesn't fit goes to the heap until the reset
+	LinearArena small(1024);
+	void* inside = small.allocate(512);
+	void* outside = small.allocate(2048);
+	ArenaMark mark = small.mark();
+	small.allocate(4096);
+	small.rewind(mark);
+	if (!inside || !outside || small.overflows() != 2 || small.used() > 1024)
+		benchFail("arena overflow fallback went wrong");
+	small.reset();
+}
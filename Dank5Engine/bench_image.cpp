@@ -0,0 +1,88 @@
+#include "bench.h"
+#include "imagedecoder.h"
+#include "stb_image.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+// decoding a texture set: stbi_load one file after the other against the ImageDecoder
+// pool at 1..N threads (N = hardware threads, at least 2)
+
+static double decodeAll(ImageDecoder& decoder, unsigned int count, const std::vector<unsigned char>& reference)
+{
+	DecodedImage image;
+	unsigned int decoded = 0;
+	while (decoder.wait(image))
+	{
+		if (!image.pixels || memcmp(image.pixels, reference.data(), reference.size()) != 0)
+			benchFail("pool decode differs from stbi_load");
+		stbi_image_free(image.pixels);
+		decoded++;
+	}
+	if (decoded != count)
+		benchFail("completion queue lost images");
+	return decoded;
+}
+
+DANK5_BENCH(image_decode, false)
+{
+	const unsigned int count = ctx.quick ? 50 : 500;
+	std::vector<std::string> paths(count, "container.jpg");
+
+	int width, height, channels;
+	unsigned char* first = stbi_load("container.jpg", &width, &height, &channels, 4);
+	if (!first)
+	{
+		benchFail("failed to load container.jpg (run dank5_bench from the build directory)");
+		return;
+	}
+	std::vector<unsigned char> reference(first, first + (size_t)width * height * 4);
+	stbi_image_free(first);
+
+	double start = benchNow();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned char* pixels = stbi_load(paths[i].c_str(), &width, &height, &channels, 4);
+		benchKeep(pixels);
+		stbi_image_free(pixels);
+	}
+	double serial = benchNow() - start;
+	benchReport("serial", count / serial * 1000.0, "images/s");
+
+	unsigned int maxThreads = std::thread::hardware_concurrency();
+	if (maxThreads < 2)
+		maxThreads = 2;
+	for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		ImageDecoder decoder(threads);
+		start = benchNow();
+		decoder.decodeFiles(paths, 4);
+		decodeAll(decoder, count, reference);
+		double elapsed = benchNow() - start;
+		std::string metric = "threads_" + std::to_string(threads);
+		benchReport(metric.c_str(), count / elapsed * 1000.0, "images/s");
+		benchReport((metric + "_speedup").c_str(), serial / elapsed, "x");
+		if (threads < maxThreads && threads * 2 > maxThreads)
+			threads = maxThreads / 2;
+	}
+
+	// blobs already in memory (e.g. from a pack file)
+	std::ifstream file("container.jpg", std::ios::binary);
+	std::vector<unsigned char> blob((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	ImageDecoder decoder;
+	start = benchNow();
+	for (unsigned int i = 0; i < count; i++)
+		decoder.decodeMemory(blob.data(), blob.size(), i, 4);
+	decodeAll(decoder, count, reference);
+	benchReport("memory", count / (benchNow() - start) * 1000.0, "images/s");
+
+	// failures come back through the queue with this thread's reason
+	decoder.decodeFile("missing.jpg", 7);
+	DecodedImage missing;
+	if (!decoder.wait(missing) || missing.pixels || missing.tag != 7 || strcmp(missing.failure, "can't fopen") != 0)
+		benchFail("missing file not reported");
+}
@@ -0,0 +1,155 @@
+#include "bench.h"
+#include "jobsystem.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// job system: model matrices rebuilt with parallelFor (the per-object work test.cpp does
+// each frame) and empty jobs through one counter, over 1..N threads; plus checks of
+// nested parallelFor and continuations, run oversubscribed as well
+
+// what test.cpp does per cube: translate, then rotate about a fixed axis
+static void buildModels(const std::vector<glm::vec3>& positions, std::vector<glm::mat4>& models, unsigned int first, unsigned int last)
+{
+	for (unsigned int i = first; i < last; i++)
+	{
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), positions[i]);
+		models[i] = glm::rotate(model, glm::radians(20.0f * (i % 360)), glm::vec3(1.0f, 0.3f, 0.5f));
+	}
+}
+
+static void emptyJob(void*, unsigned int, unsigned int)
+{
+}
+
+// each link of a chain of continuations checks that the one before it ran
+struct ChainLink {
+	std::atomic<unsigned int>* progress;
+	unsigned int position;
+	bool* ordered;
+};
+
+static void chainJob(void* data, unsigned int, unsigned int)
+{
+	ChainLink& link = *(ChainLink*)data;
+	if (link.progress->load() != link.position)
+		*link.ordered = false;
+	link.progress->store(link.position + 1);
+}
+
+// nested parallelFor sums and a chain of continuations come out right
+static bool checkJobs(JobSystem& jobs)
+{
+	const unsigned int outer = 64, inner = 1000;
+	std::vector<uint64_t> sums(outer, 0);
+	jobs.parallelFor(0, outer, 1, [&](unsigned int first, unsigned int last) {
+		for (unsigned int o = first; o < last; o++)
+		{
+			std::atomic<uint64_t> sum(0);
+			jobs.parallelFor(0, inner, 16, [&](unsigned int a, unsigned int b) {
+				uint64_t local = 0;
+				for (unsigned int i = a; i < b; i++)
+					local += i * (uint64_t)(o + 1);
+				sum += local;
+			});
+			sums[o] = sum;
+		}
+	});
+	for (unsigned int o = 0; o < outer; o++)
+		if (sums[o] != (uint64_t)inner * (inner - 1) / 2 * (o + 1))
+			return false;
+
+	// link i runs after counter i, which link i - 1 counts
+	const unsigned int length = 200;
+	std::atomic<unsigned int> progress(0);
+	bool ordered = true;
+	std::vector<ChainLink> links(length);
+	std::vector<JobCounter> counters(length + 1);
+	for (unsigned int i = 0; i < length; i++)
+	{
+		links[i] = ChainLink{ &progress, i, &ordered };
+		jobs.runAfter(counters[i], chainJob, &links[i], &counters[i + 1]);
+	}
+	// nothing was counted by counters[0], so link 0 started at once
+	jobs.wait(counters[length]);
+	return ordered && progress.load() == length;
+}
+
+DANK5_BENCH(job_scaling, false)
+{
+	const unsigned int objects = ctx.quick ? 250000 : 1000000;
+	const unsigned int emptyJobs = ctx.quick ? 100000 : 1000000;
+	const unsigned int repeats = ctx.quick ? 3 : 5;
+
+	std::vector<glm::vec3> positions(objects);
+	for (unsigned int i = 0; i < objects; i++)
+		positions[i] = glm::vec3((float)(i % 100), (float)(i / 100 % 100), (float)(i / 10000));
+	std::vector<glm::mat4> reference(objects), models(objects);
+	buildModels(positions, reference, 0, objects);
+
+	unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> counts;
+	for (unsigned int threads = 1; threads < hardware; threads *= 2)
+		counts.push_back(threads);
+	counts.push_back(hardware);
+	std::cout << "  hardware threads: " << hardware << std::endl;
+
+	double single = 0.0;
+	for (unsigned int threads : counts)
+	{
+		JobSystem jobs(threads);
+		std::string suffix = "_threads_" + std::to_string(threads);
+
+		double best = 1e30;
+		for (unsigned int r = 0; r < repeats; r++)
+		{
+			std::fill(models.begin(), models.end(), glm::mat4(0.0f));
+			double start = benchNow();
+			jobs.parallelFor(0, objects, 4096, [&](unsigned int first, unsigned int last) {
+				buildModels(positions, models, first, last);
+			});
+			best = std::min(best, benchNow() - start);
+			if (models != reference)
+				benchFail("parallelFor missed or repeated objects");
+		}
+		if (threads == 1)
+			single = best;
+		benchReport(("models" + suffix).c_str(), objects / best / 1000.0, "Mmatrices/s");
+		benchReport(("models_speedup" + suffix).c_str(), single / best, "x");
+
+		best = 1e30;
+		for (unsigned int r = 0; r < repeats; r++)
+		{
+			uint64_t before = jobs.executed();
+			double start = benchNow();
+			JobCounter counter;
+			for (unsigned int i = 0; i < emptyJobs; i++)
+				jobs.run(emptyJob, nullptr, &counter);
+			jobs.wait(counter);
+			best = std::min(best, benchNow() - start);
+			if (jobs.executed() - before != emptyJobs)
+				benchFail("empty jobs went missing");
+		}
+		benchReport(("empty_jobs" + suffix).c_str(), emptyJobs / best / 1000.0, "Mjobs/s");
+		benchReport(("stolen" + suffix).c_str(), (double)jobs.stolen(), "jobs");
+	}
+
+	// more threads than cores too, where preemption shakes out races
+	for (unsigned int threads : { 1u, 2u, 4u, std::max(8u, hardware * 2) })
+	{
+		JobSystem jobs(threads);
+		for (unsigned int r = 0; r < 20; r++)
+			if (!checkJobs(jobs))
+			{
+				benchFail(("nested parallelFor or continuations wrong with " + std::to_string(threads) + " threads").c_str());
+				break;
+			}
+	}
+}
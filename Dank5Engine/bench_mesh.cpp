@@ -0,0 +1,252 @@
+#include "bench.h"
+#include "headless.h"
+#include "shader.h"
+#include "mesh.h"
+#include "cube.h"
+#include "instancing.h"
+#include "frameconstants.h"
+#include "glstate.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// mesh preprocessing: vertex cache statistics and cost of the stage, then the vertex
+// shader work it saves when drawing a dense mesh
+
+// a UV sphere of radius 0.5 (x, y, z, s, t and with normals nx, ny, nz), rows of quads
+static MeshData sphereMesh(unsigned int rings, unsigned int segments, bool normals)
+{
+	MeshData mesh;
+	mesh.stride = normals ? 8 : 5;
+	for (unsigned int r = 0; r <= rings; r++)
+	{
+		for (unsigned int s = 0; s <= segments; s++)
+		{
+			float theta = glm::pi<float>() * r / rings, phi = 2.0f * glm::pi<float>() * s / segments;
+			glm::vec3 n(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+			mesh.vertices.push_back(0.5f * n.x);
+			mesh.vertices.push_back(0.5f * n.y);
+			mesh.vertices.push_back(0.5f * n.z);
+			mesh.vertices.push_back((float)s / segments);
+			mesh.vertices.push_back((float)r / rings);
+			if (normals)
+			{
+				mesh.vertices.push_back(n.x);
+				mesh.vertices.push_back(n.y);
+				mesh.vertices.push_back(n.z);
+			}
+		}
+	}
+	for (unsigned int r = 0; r < rings; r++)
+	{
+		for (unsigned int s = 0; s < segments; s++)
+		{
+			unsigned int a = r * (segments + 1) + s, b = a + segments + 1;
+			unsigned int quad[] = { a, b, a + 1, a + 1, b, b + 1 };
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	}
+	return mesh;
+}
+
+// the sphere as a triangle soup (x, y, z, s, t), triangles shuffled the way an
+// exporter that doesn't care about ordering might leave them
+static std::vector<float> sphereSoup(unsigned int rings, unsigned int segments)
+{
+	MeshData sphere = sphereMesh(rings, segments, false);
+	std::vector<unsigned int>& triangles = sphere.indices;
+	srand(5);
+	unsigned int triangleCount = (unsigned int)triangles.size() / 3;
+	for (unsigned int t = triangleCount - 1; t > 0; t--)
+	{
+		unsigned int other = rand() % (t + 1);
+		for (unsigned int k = 0; k < 3; k++)
+			std::swap(triangles[t * 3 + k], triangles[other * 3 + k]);
+	}
+	std::vector<float> soup;
+	soup.reserve(triangles.size() * 5);
+	for (size_t i = 0; i < triangles.size(); i++)
+		soup.insert(soup.end(), &sphere.vertices[triangles[i] * 5], &sphere.vertices[triangles[i] * 5] + 5);
+	return soup;
+}
+
+static void reportStats(const char* prefix, const MeshOptimizeReport& report)
+{
+	std::string name(prefix);
+	benchReport((name + "_vertices_in").c_str(), report.inputVertices, "vertices");
+	benchReport((name + "_vertices_unique").c_str(), report.uniqueVertices, "vertices");
+	benchReport((name + "_acmr_before").c_str(), report.before.acmr, "");
+	benchReport((name + "_acmr_after").c_str(), report.after.acmr, "");
+	benchReport((name + "_atvr_before").c_str(), report.before.atvr, "");
+	benchReport((name + "_atvr_after").c_str(), report.after.atvr, "");
+}
+
+DANK5_BENCH(mesh_optimize, false)
+{
+	MeshData cube;
+	MeshOptimizeReport report = optimizeMesh(cubeVertices, sizeof(cubeVertices) / (5 * sizeof(float)), 5, cube);
+	reportStats("cube", report);
+
+	unsigned int rings = ctx.quick ? 128 : 512;
+	std::vector<float> soup = sphereSoup(rings, rings * 2);
+	unsigned int soupVertices = (unsigned int)soup.size() / 5;
+
+	double start = benchNow();
+	MeshData sphere = indexMesh(soup.data(), soupVertices, 5);
+	double indexTime = benchNow() - start;
+	start = benchNow();
+	report = optimizeMesh(sphere);
+	double optimizeTime = benchNow() - start;
+	// before is the shuffled order as indexed, the soup itself shades every vertex
+	report.inputVertices = soupVertices;
+	reportStats("sphere", report);
+	benchReport("sphere_index", indexTime, "ms");
+	benchReport("sphere_optimize", optimizeTime, "ms");
+	benchReport("sphere_triangles_per_ms", (soupVertices / 3) / (indexTime + optimizeTime), "triangles/ms");
+	if (report.after.acmr >= report.before.acmr || report.uniqueVertices >= soupVertices)
+		benchFail("optimisation did not improve the vertex cache statistics");
+}
+
+// draw a grid of dense spheres with a given index order; the spheres are small on
+// screen, so the frame time is dominated by vertex work rather than fill
+// (the last frame is read back into pixels if given)
+static double renderSpheres(BenchContext& ctx, const MeshData& data, const VertexFormat& format, unsigned int frames, std::vector<unsigned char>* pixels = nullptr)
+{
+	Mesh mesh(data, format);
+	Shader shader("testVertInstanced.vs", "testFrag.fs");
+	const unsigned int side = 8;
+	std::vector<glm::mat4> models;
+	for (unsigned int y = 0; y < side; y++)
+		for (unsigned int x = 0; x < side; x++)
+			models.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(x - side / 2.0f, y - side / 2.0f, -20.0f)) * mesh.dequantize());
+	InstanceBuffer instances((unsigned int)models.size());
+	instances.attach(mesh.VAO);
+	instances.upload(models.data(), (unsigned int)models.size());
+
+	FrameUniformBuffer frameUBO(3);
+	FrameConstants constants;
+	constants.projection = glm::perspective(glm::radians(45.0f), (float)ctx.gl->Width / (float)ctx.gl->Height, 0.1f, 100.0f);
+	constants.view = glm::mat4(1.0f);
+	constants.viewProjection = constants.projection;
+	constants.cameraPosition = glm::vec4(0.0f);
+	glState().setDepthTest(true);
+	shader.use();
+	shader.setInt("texture1", 0);
+	ctx.gl->finish();
+
+	double start = benchNow();
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		frameUBO.update(constants);
+		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		shader.use();
+		glState().bindVertexArray(mesh.VAO);
+		instances.drawElements(GL_TRIANGLES, mesh.IndexCount, mesh.IndexType, 0);
+	}
+	ctx.gl->finish();
+	double elapsed = (benchNow() - start) / frames;
+	if (pixels)
+	{
+		pixels->resize(ctx.gl->Width * ctx.gl->Height * 4);
+		glReadPixels(0, 0, ctx.gl->Width, ctx.gl->Height, GL_RGBA, GL_UNSIGNED_BYTE, pixels->data());
+	}
+
+	glState().deleteBuffers(1, &instances.VBO);
+	glState().deleteProgram(shader.ID);
+	frameUBO.destroy();
+	mesh.destroy();
+	return elapsed;
+}
+
+DANK5_BENCH(mesh_render, true)
+{
+	std::vector<float> soup = sphereSoup(64, 128);
+	MeshData shuffled = indexMesh(soup.data(), (unsigned int)soup.size() / 5, 5);
+	MeshData optimized = shuffled;
+	optimizeMesh(optimized);
+
+	unsigned int frames = ctx.frames / 10 + 1;
+	const unsigned int attributes[] = { 3, 2 };
+	VertexFormat floats = VertexFormat::floatFormat(attributes, 2);
+	benchReport("triangles_per_frame", shuffled.indices.size() / 3 * 64.0, "triangles");
+	benchReport("frame_shuffled", renderSpheres(ctx, shuffled, floats, frames), "ms");
+	benchReport("frame_optimized", renderSpheres(ctx, optimized, floats, frames), "ms");
+}
+
+// largest error a packed format introduces, decoded the way the vertex fetch does
+static void reportPackingError(const char* prefix, const MeshData& sphere, const VertexFormat& format)
+{
+	EncodedVertices encoded = encodeVertices(sphere.vertices.data(), sphere.vertexCount(), format);
+	const unsigned int stride = format.stride();
+	float positionError = 0.0f, uvError = 0.0f, normalError = 0.0f;
+	for (unsigned int v = 0; v < sphere.vertexCount(); v++)
+	{
+		const float* in = &sphere.vertices[v * sphere.stride];
+		const unsigned char* out = &encoded.bytes[(size_t)v * stride];
+		glm::uint64 position;
+		glm::uint32 uv, normal;
+		memcpy(&position, out, 8);
+		memcpy(&uv, out + 8, 4);
+		memcpy(&normal, out + 12, 4);
+		glm::vec3 p = encoded.center + encoded.extent * glm::vec3(glm::unpackSnorm4x16(position));
+		glm::vec2 t(glm::unpackHalf1x16((glm::uint16)(uv & 0xffff)), glm::unpackHalf1x16((glm::uint16)(uv >> 16)));
+		glm::vec3 n = format.attributes[2].encoding == VERTEX_NORMAL_OCT16 ?
+			octDecode(glm::unpackSnorm2x16(normal)) : glm::normalize(glm::vec3(glm::unpackSnorm3x10_1x2(normal)));
+		positionError = glm::max(positionError, glm::length(p - glm::vec3(in[0], in[1], in[2])));
+		uvError = glm::max(uvError, glm::length(t - glm::vec2(in[3], in[4])));
+		float cosine = glm::clamp(glm::dot(n, glm::vec3(in[5], in[6], in[7])), -1.0f, 1.0f);
+		normalError = glm::max(normalError, glm::degrees(acosf(cosine)));
+	}
+	std::string name(prefix);
+	benchReport((name + "_position_error").c_str(), positionError, "units");
+	benchReport((name + "_uv_error").c_str(), uvError, "");
+	benchReport((name + "_normal_error").c_str(), normalError, "degrees");
+}
+
+DANK5_BENCH(vertex_formats, true)
+{
+	MeshData sphere = sphereMesh(256, 512, true);
+	VertexFormat floats, octahedral, packed1010102;
+	floats.add(0, 3, VERTEX_FLOAT).add(1, 2, VERTEX_FLOAT).add(6, 3, VERTEX_FLOAT);
+	octahedral.add(0, 3, VERTEX_POSITION_SNORM16).add(1, 2, VERTEX_HALF).add(6, 3, VERTEX_NORMAL_OCT16);
+	packed1010102.add(0, 3, VERTEX_POSITION_SNORM16).add(1, 2, VERTEX_HALF).add(6, 3, VERTEX_NORMAL_10_10_10_2);
+
+	benchReport("float_stride", floats.stride(), "bytes");
+	benchReport("packed_stride", octahedral.stride(), "bytes");
+	benchReport("vbo_saving", 100.0 * (1.0 - (double)octahedral.stride() / floats.stride()), "%");
+	double start = benchNow();
+	EncodedVertices encoded = encodeVertices(sphere.vertices.data(), sphere.vertexCount(), octahedral);
+	benchKeep(encoded);
+	benchReport("encode", sphere.vertexCount() / (benchNow() - start), "vertices/ms");
+	reportPackingError("oct16", sphere, octahedral);
+	reportPackingError("10_10_10_2", sphere, packed1010102);
+
+	// a smaller sphere drawn both ways; the shader ignores the normals but they are still fetched
+	sphere = sphereMesh(64, 128, true);
+	optimizeMesh(sphere);
+	unsigned int frames = ctx.frames / 10 + 1;
+	std::vector<unsigned char> floatPixels, packedPixels;
+	benchReport("frame_float", renderSpheres(ctx, sphere, floats, frames, &floatPixels), "ms");
+	benchReport("frame_packed", renderSpheres(ctx, sphere, octahedral, frames, &packedPixels), "ms");
+	// quantisation may move a silhouette pixel, not more
+	unsigned int covered = 0, differing = 0;
+	for (size_t i = 0; i < floatPixels.size(); i += 4)
+	{
+		covered += floatPixels[i] != 26;
+		differing += memcmp(&floatPixels[i], &packedPixels[i], 4) != 0;
+	}
+	benchReport("pixels_differing", 100.0 * differing / (floatPixels.size() / 4), "%");
+	if (covered == 0 || differing * 100 > covered)
+		benchFail("packed vertices do not render like the float ones");
+}
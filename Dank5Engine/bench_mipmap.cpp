@@ -0,0 +1,124 @@
+#include "bench.h"
+#include "headless.h"
+#include "glstate.h"
+#include "mipmap.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// mip chain generation: glGenerateMipmap against buildMipChain per filter and colour
+// space, then box/sRGB over 1..N threads. Rates are level 0 texels per second.
+
+// container.jpg tiled out to size x size
+static bool tiledSource(int size, std::vector<unsigned char>& out)
+{
+	int width, height, channels;
+	unsigned char* data = stbi_load("container.jpg", &width, &height, &channels, 4);
+	if (!data)
+		return false;
+	out.resize((size_t)size * size * 4);
+	for (int y = 0; y < size; y++)
+		for (int x = 0; x < size; x++)
+			memcpy(&out[((size_t)y * size + x) * 4], data + ((size_t)(y % height) * width + x % width) * 4, 4);
+	stbi_image_free(data);
+	return true;
+}
+
+// black and white texels in a checkerboard must average to half the light: 188 in sRGB
+static bool checkGamma()
+{
+	const int size = 8;
+	std::vector<size_t> offsets;
+	std::vector<unsigned char> chain(mipChainOffsets(size, size, offsets));
+	for (int i = 0; i < size * size; i++)
+	{
+		unsigned char v = ((i % size) + (i / size)) % 2 ? 255 : 0;
+		chain[i * 4 + 0] = chain[i * 4 + 1] = chain[i * 4 + 2] = v;
+		chain[i * 4 + 3] = 255;
+	}
+	buildMipChain(chain.data(), size, size, offsets, MIP_BOX, true, 1);
+	const unsigned char* level1 = chain.data() + offsets[1];
+	return level1[0] == 188 && level1[1] == 188 && level1[2] == 188 && level1[3] == 255;
+}
+
+DANK5_BENCH(mip_chain, true)
+{
+	const int size = ctx.quick ? 1024 : 2048;
+	const unsigned int repeats = ctx.quick ? 2 : 5;
+	const double texels = (double)size * size;
+
+	std::vector<unsigned char> source;
+	if (!tiledSource(size, source))
+	{
+		benchFail("failed to load container.jpg (run dank5_bench from the build directory)");
+		return;
+	}
+	std::cout << "  path: " << mipmapPath() << std::endl;
+	if (!checkGamma())
+		benchFail("sRGB box filter doesn't average in linear light");
+
+	// the driver, level 0 already uploaded
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glState().bindTexture(0, GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, source.data());
+	ctx.gl->finish();
+	double best = 1e30;
+	for (unsigned int r = 0; r < repeats; r++)
+	{
+		double start = benchNow();
+		glGenerateMipmap(GL_TEXTURE_2D);
+		ctx.gl->finish();
+		best = std::min(best, benchNow() - start);
+	}
+	glState().deleteTextures(1, &texture);
+	benchReport("gl_generate", texels / best / 1000.0, "Mtexels/s");
+
+	std::vector<size_t> offsets;
+	std::vector<unsigned char> chain(mipChainOffsets(size, size, offsets));
+	static const MipFilter filters[] = { MIP_BOX, MIP_KAISER };
+	static const char* filterNames[] = { "box", "kaiser" };
+	for (int f = 0; f < 2; f++)
+		for (int srgb = 1; srgb >= 0; srgb--)
+		{
+			best = 1e30;
+			for (unsigned int r = 0; r < repeats; r++)
+			{
+				memcpy(chain.data(), source.data(), source.size());
+				double start = benchNow();
+				buildMipChain(chain.data(), size, size, offsets, filters[f], srgb != 0, 1);
+				best = std::min(best, benchNow() - start);
+			}
+			std::string name = std::string(filterNames[f]) + (srgb ? "_srgb" : "_linear");
+			benchReport(name.c_str(), texels / best / 1000.0, "Mtexels/s");
+		}
+
+	// thread scaling, against the single threaded chain
+	memcpy(chain.data(), source.data(), source.size());
+	buildMipChain(chain.data(), size, size, offsets, MIP_BOX, true, 1);
+	std::vector<unsigned char> reference = chain;
+	unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> counts;
+	for (unsigned int threads = 1; threads < hardware; threads *= 2)
+		counts.push_back(threads);
+	counts.push_back(hardware);
+	for (unsigned int threads : counts)
+	{
+		best = 1e30;
+		for (unsigned int r = 0; r < repeats; r++)
+		{
+			std::fill(chain.begin() + offsets[1], chain.end(), 0);
+			double start = benchNow();
+			buildMipChain(chain.data(), size, size, offsets, MIP_BOX, true, threads);
+			best = std::min(best, benchNow() - start);
+			if (chain != reference)
+				benchFail("threaded mip chain differs from single threaded");
+		}
+		benchReport(("box_srgb_threads_" + std::to_string(threads)).c_str(), texels / best / 1000.0, "Mtexels/s");
+	}
+}
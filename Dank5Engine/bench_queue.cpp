@@ -0,0 +1,210 @@
+#include "bench.h"
+#include "headless.h"
+#include "shader.h"
+#include "glstate.h"
+#include "renderqueue.h"
+#include "instancing.h"
+#include "frameconstants.h"
+#include "camera.h"
+#include "cube.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+// random packets: 8 programs, 4 VAOs, 64 textures, depth 0.1-100, 10% transparent
+static void randomPackets(std::vector<DrawPacket>& packets, std::vector<float>& depths, unsigned int count)
+{
+	packets.resize(count);
+	depths.resize(count);
+	srand(6);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		DrawPacket& p = packets[i];
+		p.program = 1 + rand() % 8;
+		p.vao = 1 + rand() % 4;
+		p.texture = 1 + rand() % 64;
+		p.transform = i;
+		p.mode = GL_TRIANGLES;
+		p.first = 0;
+		p.count = 36;
+		p.indexType = 0;
+		p.transparent = rand() % 10 == 0;
+		depths[i] = 0.1f + 99.9f * rand() / RAND_MAX;
+	}
+}
+
+static void sortBench(BenchContext& ctx, unsigned int count)
+{
+	std::vector<DrawPacket> packets;
+	std::vector<float> depths;
+	randomPackets(packets, depths, count);
+	const unsigned int frames = ctx.quick ? 3 : 10;
+
+	RenderQueue queue(count);
+	double start = benchNow();
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		queue.clear();
+		for (unsigned int i = 0; i < count; i++)
+			queue.submit(packets[i], depths[i]);
+		queue.sort();
+	}
+	double radix = (benchNow() - start) / frames;
+
+	for (unsigned int i = 1; i < queue.size(); i++)
+		if (queue.key(i - 1) > queue.key(i))
+		{
+			benchFail("queue is not sorted");
+			break;
+		}
+	// opaque before transparent, front-to-back / back-to-front inside each
+	unsigned int firstTransparent = 0;
+	while (firstTransparent < queue.size() && !queue.packet(firstTransparent).transparent)
+		firstTransparent++;
+	for (unsigned int i = firstTransparent; i < queue.size(); i++)
+		if (!queue.packet(i).transparent)
+		{
+			benchFail("opaque packet after a transparent one");
+			break;
+		}
+	if (queue.growths() != 0)
+		benchFail("queue allocated during the frame");
+
+	// reference: std::sort of (key, index) pairs
+	std::vector<std::pair<unsigned long long, unsigned int>> pairs(count);
+	start = benchNow();
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		for (unsigned int i = 0; i < count; i++)
+			pairs[i] = std::make_pair(RenderQueue::makeKey(packets[i], depths[i]), i);
+		std::sort(pairs.begin(), pairs.end());
+	}
+	double stdSort = (benchNow() - start) / frames;
+
+	benchReport("submit_and_radix_sort", radix, "ms/frame");
+	benchReport("radix_throughput", count / radix / 1000.0, "Mpackets/s");
+	benchReport("std_sort", stdSort, "ms/frame");
+}
+
+DANK5_BENCH(queue_sort_100k, false)
+{
+	sortBench(ctx, ctx.quick ? 10000 : 100000);
+}
+
+DANK5_BENCH(queue_sort_1m, false)
+{
+	sortBench(ctx, ctx.quick ? 100000 : 1000000);
+}
+
+// 10k cubes spread over 2 programs and 4 textures, submitted in random order:
+// executed as submitted against executed after sorting
+DANK5_BENCH(render_queue_10k, true)
+{
+	const unsigned int count = ctx.quick ? 1000 : 10000;
+	const unsigned int frames = ctx.frames / 10 + 1;
+
+	Shader shaders[2] = { Shader("testVertInstanced.vs", "testFrag.fs"), Shader("testVertInstanced.vs", "testFrag.fs") };
+	for (Shader& shader : shaders)
+	{
+		shader.use();
+		shader.setInt("texture1", 0);
+	}
+
+	unsigned int vao, vbo, textures[4];
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glState().bindVertexArray(vao);
+	glState().bindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+
+	glGenTextures(4, textures);
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		unsigned char texel[4] = { (unsigned char)(64 * i + 60), 128, (unsigned char)(255 - 64 * i), 255 };
+		glState().bindTexture(0, GL_TEXTURE_2D, textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	}
+
+	// static transforms, one per cube, in a cube-shaped block in front of the camera
+	unsigned int side = 1;
+	while (side * side * side < count)
+		side++;
+	std::vector<glm::mat4> models(count);
+	std::vector<glm::vec3> positions(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		positions[i] = glm::vec3(2.0f * (i % side) - side, 2.0f * ((i / side) % side) - side, -2.0f * (i / (side * side)) - 5.0f);
+		models[i] = glm::translate(glm::mat4(1.0f), positions[i]);
+	}
+	InstanceBuffer instances(count);
+	instances.attach(vao);
+	instances.upload(models.data(), count);
+
+	srand(7);
+	std::vector<DrawPacket> packets(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		DrawPacket p = { shaders[rand() % 2].ID, vao, textures[rand() % 4], i, GL_TRIANGLES, 0, 36, 0, false };
+		packets[i] = p;
+	}
+
+	Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+	FrameUniformBuffer frameUBO(3);
+	FrameConstants constants;
+	constants.projection = glm::perspective(glm::radians(45.0f), (float)ctx.gl->Width / (float)ctx.gl->Height, 0.1f, 100.0f);
+	glState().setDepthTest(true);
+	RenderQueue queue(count);
+
+	for (int sorted = 0; sorted < 2; sorted++)
+	{
+		ctx.gl->finish();
+		glState().endFrame();
+		unsigned int draws = 0;
+		double start = benchNow();
+		for (unsigned int frame = 0; frame < frames; frame++)
+		{
+			constants.view = camera.GetViewMatrix();
+			constants.viewProjection = constants.projection * constants.view;
+			frameUBO.update(constants);
+			glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			queue.clear();
+			for (unsigned int i = 0; i < count; i++)
+				queue.submit(packets[i], -(constants.view * glm::vec4(positions[i], 1.0f)).z);
+			if (sorted)
+				queue.sort();
+			draws += queue.execute();
+		}
+		ctx.gl->finish();
+		double elapsed = benchNow() - start;
+		GLStateCache::Stats stats = glState().endFrame();
+
+		const char* prefix = sorted ? "sorted" : "unsorted";
+		std::string name = std::string(prefix) + "_frame";
+		benchReport(name.c_str(), elapsed / frames, "ms");
+		name = std::string(prefix) + "_draws";
+		benchReport(name.c_str(), (double)draws / frames, "calls/frame");
+		name = std::string(prefix) + "_state_issued";
+		benchReport(name.c_str(), (double)stats.totalIssued() / frames, "calls/frame");
+	}
+
+	frameUBO.destroy();
+	glState().deleteBuffers(1, &instances.VBO);
+	glState().deleteTextures(4, textures);
+	glState().deleteVertexArrays(1, &vao);
+	glState().deleteBuffers(1, &vbo);
+	for (Shader& shader : shaders)
+		glState().deleteProgram(shader.ID);
+}
@@ -0,0 +1,282 @@
+#include "bench.h"
+#include "headless.h"
+#include "shader.h"
+#include "camera.h"
+#include "cube.h"
+#include "stb_image.h"
+#include "instancing.h"
+#include "frameconstants.h"
+#include "glstate.h"
+#include "culling.h"
+#include "mesh.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+
+// the ten cubes test.cpp draws
+static const glm::vec3 cubePositions[] = {
+	glm::vec3(0.0f,  0.0f,  0.0f),
+	glm::vec3(2.0f,  5.0f, -15.0f),
+	glm::vec3(-1.5f, -2.2f, -2.5f),
+	glm::vec3(-3.8f, -2.0f, -12.3f),
+	glm::vec3(2.4f, -0.4f, -3.5f),
+	glm::vec3(-1.7f,  3.0f, -7.5f),
+	glm::vec3(1.3f, -2.0f, -2.5f),
+	glm::vec3(1.5f,  2.0f, -2.5f),
+	glm::vec3(1.5f,  0.2f, -1.5f),
+	glm::vec3(-1.3f,  1.0f, -1.5f)
+};
+
+// GL objects of the test.cpp scene
+struct CubeScene {
+	Mesh cube;
+	unsigned int VAO;
+	unsigned int texture;
+};
+
+static CubeScene createCubeScene()
+{
+	MeshData cubeData;
+	optimizeMesh(cubeVertices, sizeof(cubeVertices) / (5 * sizeof(float)), 5, cubeData);
+	VertexFormat cubeFormat;
+	cubeFormat.add(0, 3, VERTEX_POSITION_SNORM16).add(1, 2, VERTEX_HALF);
+	CubeScene scene = { Mesh(cubeData, cubeFormat), 0, 0 };
+	scene.VAO = scene.cube.VAO;
+
+	glGenTextures(1, &scene.texture);
+	glState().bindTexture(0, GL_TEXTURE_2D, scene.texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	int width, height, nrChannels;
+	unsigned char *data = stbi_load("container.jpg", &width, &height, &nrChannels, 0);
+	if (data)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	else
+	{
+		benchFail("failed to load container.jpg (run dank5_bench from the build directory)");
+	}
+	stbi_image_free(data);
+	return scene;
+}
+
+static void destroyCubeScene(CubeScene& scene)
+{
+	scene.cube.destroy();
+	glState().deleteTextures(1, &scene.texture);
+}
+
+// a count cubes big block in front of the camera, 2 units apart
+static std::vector<glm::vec3> cubeGrid(unsigned int count)
+{
+	unsigned int side = 1;
+	while (side * side * side < count)
+		side++;
+	std::vector<glm::vec3> positions;
+	positions.reserve(count);
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int x = i % side, y = (i / side) % side, z = i / (side * side);
+		positions.push_back(glm::vec3(2.0f * x - side, 2.0f * y - side, -2.0f * z - 5.0f));
+	}
+	return positions;
+}
+
+// fraction of the framebuffer covered by something other than the clear colour,
+// catches a render path that silently stopped drawing
+static float coverage(BenchContext& ctx)
+{
+	std::vector<unsigned char> pixels(ctx.gl->Width * ctx.gl->Height * 4);
+	glReadPixels(0, 0, ctx.gl->Width, ctx.gl->Height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	unsigned int covered = 0;
+	// glClearColor(0.1, 0.1, 0.1) reads back as 26
+	for (size_t i = 0; i < pixels.size(); i += 4)
+		if (pixels[i] != 26 || pixels[i + 1] != 26 || pixels[i + 2] != 26)
+			covered++;
+	return (float)covered / (ctx.gl->Width * ctx.gl->Height);
+}
+
+static void reportCoverage(BenchContext& ctx)
+{
+	float covered = coverage(ctx);
+	benchReport("coverage", covered * 100.0f, "%");
+	if (covered == 0.0f)
+		benchFail("nothing was drawn");
+}
+
+// GL state calls per frame that went through the cache and that it skipped
+static void reportStateCalls(const GLStateCache::Stats& stats, unsigned int frames)
+{
+	benchReport("state_issued", (double)stats.totalIssued() / frames, "calls/frame");
+	benchReport("state_skipped", (double)stats.totalSkipped() / frames, "calls/frame");
+}
+
+// what test.cpp does at the top of each frame
+static void updateFrameConstants(FrameUniformBuffer& frameUBO, FrameConstants& constants, Camera& camera, unsigned int frame)
+{
+	constants.view = camera.GetViewMatrix();
+	constants.viewProjection = constants.projection * constants.view;
+	constants.cameraPosition = glm::vec4(camera.Position, frame / 60.0f);
+	frameUBO.update(constants);
+}
+
+// the test.cpp render loop before the render queue: one model matrix upload and one draw per cube
+static void renderPerObject(BenchContext& ctx, const glm::vec3* positions, unsigned int count, unsigned int frames)
+{
+	CubeScene scene = createCubeScene();
+	glm::mat4 dequantize = scene.cube.dequantize();
+	Shader shader("testVert.vs", "testFrag.fs");
+	Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+
+	shader.use();
+	shader.setInt("texture1", 0);
+	FrameUniformBuffer frameUBO(3);
+	FrameConstants constants;
+	constants.projection = glm::perspective(glm::radians(45.0f), (float)ctx.gl->Width / (float)ctx.gl->Height, 0.1f, 100.0f);
+	glState().setDepthTest(true);
+	ctx.gl->finish();
+	glState().endFrame();
+
+	double start = benchNow();
+	for (unsigned int frame = 0; frame < frames; frame++) {
+		// keep the view changing like a player looking around
+		camera.ProcessMouseMovement(1.0f, 0.0f);
+
+		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glState().bindTexture(0, GL_TEXTURE_2D, scene.texture);
+		shader.use();
+		updateFrameConstants(frameUBO, constants, camera, frame);
+		glState().bindVertexArray(scene.VAO);
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			glm::mat4 model = glm::mat4(1.0f);
+			model = glm::translate(model, positions[i]);
+			float angle = 20.0f * i;
+			model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+			shader.setMat4("model", model * dequantize);
+			glDrawElements(GL_TRIANGLES, scene.cube.IndexCount, scene.cube.IndexType, 0);
+		}
+	}
+	ctx.gl->finish();
+	double elapsed = benchNow() - start;
+	GLStateCache::Stats stateCalls = glState().endFrame();
+
+	benchReport("frame", elapsed / frames, "ms");
+	benchReport("draws_per_frame", count, "calls");
+	reportCoverage(ctx);
+	reportStateCalls(stateCalls, frames);
+	glState().deleteProgram(shader.ID);
+	frameUBO.destroy();
+	destroyCubeScene(scene);
+}
+
+DANK5_BENCH(render_cubes, true)
+{
+	renderPerObject(ctx, cubePositions, 10, ctx.frames);
+}
+
+DANK5_BENCH(render_cubes_10k, true)
+{
+	unsigned int count = ctx.quick ? 1000 : 10000;
+	std::vector<glm::vec3> positions = cubeGrid(count);
+	renderPerObject(ctx, positions.data(), count, ctx.frames / 10 + 1);
+}
+
+// instanced path: model matrices rebuilt each frame (as if every cube moved), uploaded
+// into an InstanceBuffer and drawn with a handful of glDrawElementsInstancedBaseInstance calls.
+// With cull, only cubes whose bounding sphere touches the view frustum get a matrix.
+static void renderInstanced(BenchContext& ctx, const glm::vec3* positions, unsigned int count, unsigned int frames, bool cull = false)
+{
+	CubeScene scene = createCubeScene();
+	glm::mat4 dequantize = scene.cube.dequantize();
+	Shader shader("testVertInstanced.vs", "testFrag.fs");
+	Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+	InstanceBuffer instances(count);
+	instances.attach(scene.VAO);
+	std::vector<glm::mat4> models(count);
+	std::vector<unsigned int> visible(count);
+	// a unit cube fits in a sphere of radius sqrt(3)/2 whatever its rotation
+	BoundingSpheres bounds;
+	bounds.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+		bounds.set(i, positions[i], 0.8660254f);
+	unsigned int drawn = 0;
+
+	shader.use();
+	shader.setInt("texture1", 0);
+	FrameUniformBuffer frameUBO(3);
+	FrameConstants constants;
+	constants.projection = glm::perspective(glm::radians(45.0f), (float)ctx.gl->Width / (float)ctx.gl->Height, 0.1f, 100.0f);
+	glState().setDepthTest(true);
+	ctx.gl->finish();
+	glState().endFrame();
+
+	double start = benchNow();
+	for (unsigned int frame = 0; frame < frames; frame++) {
+		camera.ProcessMouseMovement(1.0f, 0.0f);
+		updateFrameConstants(frameUBO, constants, camera, frame);
+
+		unsigned int visibleCount = count;
+		if (cull)
+			visibleCount = cullSpheres(extractFrustum(constants.viewProjection), bounds, visible.data());
+		for (unsigned int v = 0; v < visibleCount; v++)
+		{
+			unsigned int i = cull ? visible[v] : v;
+			glm::mat4 model = glm::mat4(1.0f);
+			model = glm::translate(model, positions[i]);
+			float angle = 20.0f * i;
+			models[v] = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f)) * dequantize;
+		}
+		instances.upload(models.data(), visibleCount);
+		drawn += visibleCount;
+
+		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glState().bindTexture(0, GL_TEXTURE_2D, scene.texture);
+		shader.use();
+		glState().bindVertexArray(scene.VAO);
+		instances.drawElements(GL_TRIANGLES, scene.cube.IndexCount, scene.cube.IndexType, 0);
+	}
+	ctx.gl->finish();
+	double elapsed = benchNow() - start;
+	GLStateCache::Stats stateCalls = glState().endFrame();
+
+	benchReport("frame", elapsed / frames, "ms");
+	benchReport("draws_per_frame", instances.drawCalls(), "calls");
+	reportCoverage(ctx);
+	reportStateCalls(stateCalls, frames);
+	benchReport("drawn_per_frame", (double)drawn / frames, "cubes");
+	benchReport("upload_per_frame", (double)drawn / frames * sizeof(glm::mat4) / (1024.0 * 1024.0), "MB");
+	glState().deleteBuffers(1, &instances.VBO);
+	glState().deleteProgram(shader.ID);
+	frameUBO.destroy();
+	destroyCubeScene(scene);
+}
+
+DANK5_BENCH(render_instanced_10k, true)
+{
+	unsigned int count = ctx.quick ? 1000 : 10000;
+	std::vector<glm::vec3> positions = cubeGrid(count);
+	renderInstanced(ctx, positions.data(), count, ctx.frames / 10 + 1);
+}
+
+DANK5_BENCH(render_instanced_100k, true)
+{
+	unsigned int count = ctx.quick ? 10000 : 100000;
+	std::vector<glm::vec3> positions = cubeGrid(count);
+	renderInstanced(ctx, positions.data(), count, ctx.frames / 50 + 1);
+}
+
+DANK5_BENCH(render_culled_100k, true)
+{
+	unsigned int count = ctx.quick ? 10000 : 100000;
+	std::vector<glm::vec3> positions = cubeGrid(count);
+	renderInstanced(ctx, positions.data(), count, ctx.frames / 50 + 1, true);
+}
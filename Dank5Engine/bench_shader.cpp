@@ -0,0 +1,388 @@
+#include "bench.h"
+#include "headless.h"
+#include "glstate.h"
+#include "programcache.h"
+#include "shader.h"
+#include "shaderpermutations.h"
+#include "shaderreload.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// shader startup: distinct programs built from source, then the same programs restored
+// from the program binary cache, then one damaged entry rebuilt; and programs compiled
+// one after the other against submitted all at once while assets load; and the feature
+// permutations of a template compiled up front against on demand for a set of materials;
+// and the frame times while a saved template reloads
+
+static std::string readSource(const char* path)
+{
+	std::ifstream file(path);
+	std::stringstream stream;
+	stream << file.rdbuf();
+	return stream.str();
+}
+
+// testFrag.fs with a comment that makes every variant's sources (and key) distinct; a
+// tag that changes per run also keeps the driver's own shader cache from answering
+static std::vector<std::string> writeVariants(const std::string& fragment, unsigned int count, const std::string& tag = "")
+{
+	std::vector<std::string> paths;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		std::string path = "bench_variant_" + std::to_string(i) + ".fs";
+		std::ofstream file(path.c_str(), std::ios::trunc);
+		file << fragment << "\n// variant " << i << " " << tag << "\n";
+		paths.push_back(path);
+	}
+	return paths;
+}
+
+// milliseconds to build every variant; the programs are deleted again
+static double buildAll(const std::vector<std::string>& paths, GLint& modelLocation)
+{
+	double start = benchNow();
+	std::vector<unsigned int> programs;
+	for (const std::string& path : paths)
+	{
+		Shader shader("testVert.vs", path.c_str());
+		modelLocation = shader.uniform("model");
+		programs.push_back(shader.ID);
+	}
+	glFinish();
+	double elapsed = benchNow() - start;
+	for (unsigned int program : programs)
+		glState().deleteProgram(program);
+	return elapsed;
+}
+
+DANK5_BENCH(program_cache, true)
+{
+	const unsigned int count = ctx.quick ? 10 : 50;
+	ProgramCache& cache = programCache();
+	if (!cache.setDirectory("program_cache") || !cache.enabled())
+	{
+		benchReport("unsupported", 1, "");
+		cache.setDirectory("");
+		return;
+	}
+	std::string vertex = readSource("testVert.vs"), fragment = readSource("testFrag.fs");
+	std::vector<std::string> paths = writeVariants(fragment, count);
+	std::vector<uint64_t> keys;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		keys.push_back(cache.key(vertex, readSource(paths[i].c_str())));
+		// start cold, whatever an earlier run left
+		std::remove(cache.path(keys[i]).c_str());
+	}
+
+	GLint coldLocation = -1, warmLocation = -1;
+	double cold = buildAll(paths, coldLocation);
+	unsigned int misses = cache.Misses;
+	double warm = buildAll(paths, warmLocation);
+	unsigned int hits = cache.Hits;
+	benchReport("cold", cold / count, "ms/program");
+	benchReport("warm", warm / count, "ms/program");
+	benchReport("speedup", cold / warm, "x");
+	if (misses != count || hits != count)
+		benchFail("expected every program to miss once, then hit");
+	if (coldLocation < 0 || warmLocation != coldLocation)
+		benchFail("restored program has different uniforms");
+
+	// a damaged entry is dropped, rebuilt from source and stored again
+	{
+		std::fstream entry(cache.path(keys[0]).c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		entry.seekp(40);
+		entry.write("garbage!", 8);
+	}
+	std::vector<std::string> first(paths.begin(), paths.begin() + 1);
+	buildAll(first, warmLocation);
+	unsigned int rejected = cache.Rejected;
+	buildAll(first, warmLocation);
+	benchReport("rejected", rejected, "entries");
+	if (rejected != 1 || cache.Hits != hits + 1)
+		benchFail("damaged entry wasn't rebuilt");
+
+	for (const std::string& path : paths)
+		std::remove(path.c_str());
+	cache.setDirectory("");
+}
+
+// what startup does besides shaders: decode an image
+static void loadAsset()
+{
+	int width, height, channels;
+	stbi_image_free(stbi_load("container.jpg", &width, &height, &channels, 4));
+}
+
+DANK5_BENCH(shader_async, true)
+{
+	const unsigned int count = ctx.quick ? 40 : 200;
+	const unsigned int assets = ctx.quick ? 10 : 50;
+	std::string fragment = readSource("testFrag.fs");
+	std::string tag = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+	benchReport("parallel_compile", Shader::parallelCompile() ? 1 : 0, "");
+
+	// assets alone
+	double start = benchNow();
+	for (unsigned int i = 0; i < assets; i++)
+		loadAsset();
+	double assetTime = benchNow() - start;
+	benchReport("assets", assetTime, "ms");
+
+	// one after the other: every constructor waits for its program
+	std::vector<std::string> paths = writeVariants(fragment, count, tag + "sync");
+	std::vector<Shader> shaders;
+	start = benchNow();
+	for (const std::string& path : paths)
+		shaders.push_back(Shader("testVertInstanced.vs", path.c_str()));
+	double syncTime = benchNow() - start;
+	for (Shader& shader : shaders)
+		glState().deleteProgram(shader.ID);
+	shaders.clear();
+	benchReport("sync_compile", syncTime, "ms");
+	benchReport("sync_then_assets", syncTime + assetTime, "ms");
+
+	// submitted up front, then assets load while the driver compiles; each "frame" draws
+	// with whatever is ready and counts the placeholders
+	paths = writeVariants(fragment, count, tag + "async");
+	start = benchNow();
+	for (const std::string& path : paths)
+		shaders.push_back(Shader("testVertInstanced.vs", path.c_str(), true));
+	benchReport("async_submit", benchNow() - start, "ms");
+	unsigned int placeholderDraws = 0;
+	for (unsigned int i = 0; i < assets; i++)
+	{
+		loadAsset();
+		for (Shader& shader : shaders)
+			if (shader.program() != shader.ID)
+				placeholderDraws++;
+	}
+	double loaded = benchNow() - start;
+	for (Shader& shader : shaders)
+		shader.use();
+	double total = benchNow() - start;
+	benchReport("async_assets_loaded", loaded, "ms");
+	benchReport("async_all_ready", total, "ms");
+	benchReport("async_wait_after_assets", total - loaded, "ms");
+	benchReport("placeholder_draws", placeholderDraws, "draws");
+
+	for (Shader& shader : shaders)
+	{
+		GLint linked = GL_FALSE;
+		glGetProgramiv(shader.ID, GL_LINK_STATUS, &linked);
+		if (!linked || shader.uniform("texture1") < 0)
+			benchFail("async program didn't link or lost its uniforms");
+		glState().deleteProgram(shader.ID);
+	}
+	Shader::destroyPlaceholders();
+	for (const std::string& path : paths)
+		std::remove(path.c_str());
+}
+
+// a copy of a template with a per run comment, so the driver's shader cache can't answer
+static std::string writeTagged(const char* path, const std::string& tag)
+{
+	std::string copy = std::string("bench_") + path;
+	std::ofstream file(copy.c_str(), std::ios::trunc);
+	file << readSource(path) << "\n// " << tag << "\n";
+	return copy;
+}
+
+DANK5_BENCH(shader_permutations, true)
+{
+	const unsigned int materials = ctx.quick ? 64 : 256;
+	const unsigned int allFeatures = SHADER_INSTANCING | SHADER_SKINNING | SHADER_FOG | SHADER_ALPHA_TEST;
+	std::string tag = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+
+	// every permutation, each program compiling both of its stages
+	std::string vertexPath = writeTagged("testUber.vs", tag + "all");
+	std::string fragmentPath = writeTagged("testUber.fs", tag + "all");
+	std::string vertex = readSource(vertexPath.c_str()), fragment = readSource(fragmentPath.c_str());
+	double start = benchNow();
+	std::vector<Shader> everything;
+	for (unsigned int features = 0; features <= allFeatures; features++)
+		everything.push_back(Shader(ShaderPermutations::resolve(vertex, features),
+			ShaderPermutations::resolve(fragment, features), nullptr));
+	double allTime = benchNow() - start;
+	for (Shader& shader : everything)
+	{
+		GLint linked = GL_FALSE;
+		glGetProgramiv(shader.ID, GL_LINK_STATUS, &linked);
+		if (!linked)
+			benchFail("a permutation of testUber didn't link");
+		glState().deleteProgram(shader.ID);
+	}
+	benchReport("all_programs", (double)everything.size(), "programs");
+	benchReport("all_time", allTime, "ms");
+
+	// what the materials ask for: mostly instanced, some fogged or alpha tested, a few
+	// skinned (and never instanced)
+	std::vector<unsigned int> requests;
+	for (unsigned int i = 0; i < materials; i++)
+	{
+		unsigned int h = (i * 2654435761u) >> 16;
+		unsigned int features = 0;
+		if ((h & 7) == 0)
+			features |= SHADER_SKINNING;
+		else if (h & 0x18)
+			features |= SHADER_INSTANCING;
+		if ((h & 0x60) == 0)
+			features |= SHADER_FOG;
+		if ((h & 0x180) == 0)
+			features |= SHADER_ALPHA_TEST;
+		requests.push_back(features);
+	}
+	vertexPath = writeTagged("testUber.vs", tag + "demand");
+	fragmentPath = writeTagged("testUber.fs", tag + "demand");
+	ShaderPermutations uber(vertexPath.c_str(), fragmentPath.c_str());
+	start = benchNow();
+	for (unsigned int features : requests)
+		uber.get(features).use();
+	double demandTime = benchNow() - start;
+	PermutationReport report = uber.report();
+	report.print("testUber");
+	benchReport("demand_materials", materials, "materials");
+	benchReport("demand_programs", report.programs, "programs");
+	benchReport("demand_stages", report.stagesCompiled, "stages");
+	benchReport("demand_time", demandTime, "ms");
+	benchReport("speedup", allTime / demandTime, "x");
+	if (report.stagesCompiled + report.stagesShared != report.programs * 2)
+		benchFail("stage counts don't add up");
+	Shader& fogged = uber.get(SHADER_INSTANCING | SHADER_FOG);
+	Shader& plain = uber.get(SHADER_INSTANCING);
+	fogged.use();
+	plain.use();
+	if (fogged.uniform("fogDensity") < 0 || plain.uniform("fogDensity") >= 0 || plain.uniform("model") >= 0)
+		benchFail("features didn't reach the programs");
+	uber.destroy();
+
+	// a template without feature code: every set resolves to the same program
+	ShaderPermutations fixed("testVertInstanced.vs", "testFrag.fs");
+	for (unsigned int features = 0; features <= allFeatures; features++)
+		fixed.get(features);
+	report = fixed.report();
+	report.print("testVertInstanced");
+	if (report.programs != 1)
+		benchFail("equal sources weren't deduplicated");
+	fixed.destroy();
+
+	std::remove("bench_testUber.vs");
+	std::remove("bench_testUber.fs");
+}
+
+// one frame drawing a triangle with every program (attributes left unset read as zero)
+static double reloadFrame(BenchContext& ctx, ShaderReloader& reloader, std::vector<Shader*>& shaders, unsigned int vao)
+{
+	double start = benchNow();
+	reloader.update();
+	ctx.gl->bind();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glState().bindVertexArray(vao);
+	for (Shader* shader : shaders)
+	{
+		glState().useProgram(shader->ID);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+	ctx.gl->finish();
+	return benchNow() - start;
+}
+
+// saves the fragment template (with a distinct comment, or broken) and renders frames until
+// the reloader has swapped everything in or given up; the slowest frame meanwhile
+static double saveAndWait(BenchContext& ctx, ShaderReloader& reloader, std::vector<Shader*>& shaders, unsigned int vao,
+	const std::string& fragment, const std::string& edit, unsigned int& frames)
+{
+	{
+		std::ofstream file("bench_testUber.fs", std::ios::trunc);
+		file << fragment << "\n" << edit << "\n";
+	}
+	unsigned int reloaded = reloader.Reloaded, failed = reloader.Failed;
+	double slowest = 0.0, start = benchNow();
+	for (frames = 0; reloader.Reloaded + reloader.Failed < reloaded + failed + shaders.size() && benchNow() - start < 10000.0; frames++)
+		slowest = std::max(slowest, reloadFrame(ctx, reloader, shaders, vao));
+	return slowest;
+}
+
+DANK5_BENCH(shader_reload, true)
+{
+	std::string tag = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+	writeTagged("testUber.vs", tag);
+	writeTagged("testUber.fs", tag);
+	std::string fragment = readSource("bench_testUber.fs");
+	ShaderPermutations uber("bench_testUber.vs", "bench_testUber.fs");
+	std::vector<Shader*> shaders;
+	for (unsigned int features = 0; features < 16; features++)
+		shaders.push_back(&uber.get(features));
+	unsigned int vao;
+	glGenVertexArrays(1, &vao);
+
+	// steady frames before anything changes
+	ShaderReloader reloader;
+	reloader.watch(uber);
+	bool background = reloader.start([&] { return ctx.gl->makeSharedCurrent(); }, [&] { ctx.gl->releaseCurrent(); });
+	benchReport("loader_context", background ? 1 : 0, "");
+	std::vector<double> frameTimes;
+	for (unsigned int i = 0; i < 30; i++)
+		frameTimes.push_back(reloadFrame(ctx, reloader, shaders, vao));
+	std::sort(frameTimes.begin(), frameTimes.end());
+	double median = frameTimes[frameTimes.size() / 2];
+	benchReport("frame_median", median, "ms");
+
+	// a good save: every program is rebuilt in the background and swapped in together
+	std::vector<unsigned int> before;
+	for (Shader* shader : shaders)
+		before.push_back(shader->ID);
+	unsigned int frames = 0;
+	double slowest = saveAndWait(ctx, reloader, shaders, vao, fragment, "// edit " + tag, frames);
+	benchReport("background_frames", frames, "frames");
+	benchReport("background_slowest_frame", slowest, "ms");
+	benchReport("background_hitch", slowest - median, "ms");
+	for (unsigned int i = 0; i < shaders.size(); i++)
+		if (shaders[i]->ID == before[i] || shaders[i]->uniform("texture1") < 0)
+			benchFail("a program wasn't reloaded");
+
+	// a broken save: the programs stay as they are
+	before.clear();
+	for (Shader* shader : shaders)
+		before.push_back(shader->ID);
+	std::cout << "  (compile errors expected)" << std::endl;
+	saveAndWait(ctx, reloader, shaders, vao, fragment, "broken(", frames);
+	benchReport("failed", reloader.Failed, "programs");
+	for (unsigned int i = 0; i < shaders.size(); i++)
+		if (shaders[i]->ID != before[i])
+			benchFail("a broken save replaced a program");
+	if (reloader.Failed != shaders.size())
+		benchFail("a broken save didn't fail every program");
+
+	// a save that breaks only the fog permutations: the others don't swap either
+	std::cout << "  (compile errors expected)" << std::endl;
+	saveAndWait(ctx, reloader, shaders, vao, fragment, "#ifdef FOG\nbroken(\n#endif", frames);
+	for (unsigned int i = 0; i < shaders.size(); i++)
+		if (shaders[i]->ID != before[i])
+			benchFail("a partly broken save replaced a program");
+	if (reloader.Failed != 2 * shaders.size())
+		benchFail("a partly broken save wasn't rejected as a whole");
+	reloader.stop();
+
+	// the same save rebuilt inside update(), on the render thread
+	ShaderReloader renderThread;
+	renderThread.watch(uber);
+	slowest = saveAndWait(ctx, renderThread, shaders, vao, fragment, "// inline " + tag, frames);
+	benchReport("inline_frames", frames, "frames");
+	benchReport("inline_slowest_frame", slowest, "ms");
+	benchReport("inline_hitch", slowest - median, "ms");
+	if (renderThread.Reloaded != shaders.size())
+		benchFail("inline reload didn't swap every program");
+
+	glState().deleteVertexArrays(1, &vao);
+	uber.destroy();
+	std::remove("bench_testUber.vs");
+	std::remove("bench_testUber.fs");
+}
@@ -0,0 +1,126 @@
+#include "bench.h"
+#include "headless.h"
+#include "shader.h"
+#include "glstate.h"
+#include "frameconstants.h"
+#include "cube.h"
+
+#include <vector>
+#include <cstdlib>
+
+// state changes per draw, direct GL calls against the same calls through the state cache
+
+// what a draw needs bound
+struct StatePacket {
+	unsigned int program;
+	unsigned int vao;
+	unsigned int texture;
+};
+
+// submits every packet the way test.cpp does: set all state, then draw
+static double submitDirect(const std::vector<StatePacket>& packets, unsigned int frames)
+{
+	double start = benchNow();
+	for (unsigned int frame = 0; frame < frames; frame++)
+		for (const StatePacket& p : packets)
+		{
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, p.texture);
+			glUseProgram(p.program);
+			glBindVertexArray(p.vao);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+	glFinish();
+	return benchNow() - start;
+}
+
+static double submitCached(const std::vector<StatePacket>& packets, unsigned int frames)
+{
+	double start = benchNow();
+	for (unsigned int frame = 0; frame < frames; frame++)
+		for (const StatePacket& p : packets)
+		{
+			glState().bindTexture(0, GL_TEXTURE_2D, p.texture);
+			glState().useProgram(p.program);
+			glState().bindVertexArray(p.vao);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+	glFinish();
+	return benchNow() - start;
+}
+
+static void runStateBench(BenchContext& ctx, bool coherent)
+{
+	const unsigned int programs = 4, vaos = 4, textures = 8;
+	const unsigned int count = ctx.quick ? 2000 : 20000;
+	const unsigned int frames = ctx.quick ? 5 : 20;
+
+	std::vector<Shader> shaders;
+	for (unsigned int i = 0; i < programs; i++)
+		shaders.push_back(Shader("testVert.vs", "testFrag.fs"));
+
+	unsigned int vbo;
+	std::vector<unsigned int> vao(vaos), texture(textures);
+	glGenBuffers(1, &vbo);
+	glState().bindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
+	glGenVertexArrays(vaos, vao.data());
+	for (unsigned int i = 0; i < vaos; i++)
+	{
+		glState().bindVertexArray(vao[i]);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
+	}
+	glGenTextures(textures, texture.data());
+	const unsigned char texel[4] = { 255, 255, 255, 255 };
+	for (unsigned int i = 0; i < textures; i++)
+	{
+		glState().bindTexture(0, GL_TEXTURE_2D, texture[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+	}
+
+	// all-zero constants collapse every triangle, the draws cost validation but no fill
+	FrameUniformBuffer frameUBO(2);
+	FrameConstants constants = {};
+	frameUBO.update(constants);
+
+	// coherent: long runs of identical state like test.cpp's per-cube loop; otherwise random
+	std::vector<StatePacket> packets(count);
+	srand(5);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int run = coherent ? i / 500 : (unsigned int)rand();
+		packets[i].program = shaders[run % programs].ID;
+		packets[i].vao = vao[(run / programs) % vaos];
+		packets[i].texture = texture[(coherent ? run : (unsigned int)rand()) % textures];
+	}
+
+	double direct = submitDirect(packets, frames);
+	glState().invalidate();
+	glState().endFrame();
+	double cached = submitCached(packets, frames);
+	GLStateCache::Stats stats = glState().endFrame();
+
+	benchReport("direct", direct * 1000.0 / frames, "us/frame");
+	benchReport("cached", cached * 1000.0 / frames, "us/frame");
+	benchReport("direct_calls", count * 5.0, "calls/frame");
+	benchReport("cached_issued", (double)stats.totalIssued() / frames + count, "calls/frame");
+	benchReport("cached_skipped", (double)stats.totalSkipped() / frames, "calls/frame");
+
+	frameUBO.destroy();
+	glState().deleteTextures(textures, texture.data());
+	glState().deleteVertexArrays(vaos, vao.data());
+	glState().deleteBuffers(1, &vbo);
+	for (Shader& shader : shaders)
+		glState().deleteProgram(shader.ID);
+}
+
+DANK5_BENCH(state_cache_coherent, true)
+{
+	runStateBench(ctx, true);
+}
+
+DANK5_BENCH(state_cache_random, true)
+{
+	runStateBench(ctx, false);
+}
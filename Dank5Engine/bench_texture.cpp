@@ -0,0 +1,96 @@
+#include "bench.h"
+#include "headless.h"
+#include "glstate.h"
+#include "stb_image.h"
+#include "texturestream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// a level load of textures: the test.cpp way (stbi_load, glTexImage2D, glGenerateMipmap
+// on the render thread) against the TextureStreamer with a per-frame upload budget
+
+static unsigned int loadSync(const char* path)
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glState().bindTexture(0, GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	int width, height, nrChannels;
+	unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 4);
+	if (!data)
+	{
+		benchFail("failed to load container.jpg (run dank5_bench from the build directory)");
+		return texture;
+	}
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	stbi_image_free(data);
+	return texture;
+}
+
+static std::vector<unsigned char> readLevel(unsigned int texture, int level)
+{
+	GLint width, height;
+	glState().bindTexture(0, GL_TEXTURE_2D, texture);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+	std::vector<unsigned char> texels((size_t)width * height * 4);
+	glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+	return texels;
+}
+
+DANK5_BENCH(texture_stream, true)
+{
+	const unsigned int count = ctx.quick ? 8 : 32;
+	const size_t budget = 1 << 20;
+
+	// synchronous: everything blocks before the first frame
+	std::vector<unsigned int> sync(count);
+	double start = benchNow();
+	for (unsigned int i = 0; i < count; i++)
+		sync[i] = loadSync("container.jpg");
+	ctx.gl->finish();
+	benchReport("sync_startup", benchNow() - start, "ms");
+
+	// streamed: load() returns at once, frames carry on while the textures arrive
+	std::vector<unsigned int> streamed(count);
+	TextureStreamer streamer(2, budget);
+	start = benchNow();
+	for (unsigned int i = 0; i < count; i++)
+		streamed[i] = streamer.load("container.jpg");
+	benchReport("stream_startup", benchNow() - start, "ms");
+
+	unsigned int frames = 0;
+	double worstFrame = 0.0, totalFrames = 0.0;
+	size_t uploaded = 0;
+	double streamStart = benchNow();
+	while (streamer.pending())
+	{
+		double frameStart = benchNow();
+		uploaded += streamer.update(budget);
+		ctx.gl->bind();
+		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		ctx.gl->finish();
+		double frame = benchNow() - frameStart;
+		worstFrame = std::max(worstFrame, frame);
+		totalFrames += frame;
+		frames++;
+	}
+	benchReport("stream_resident_after", benchNow() - streamStart, "ms");
+	benchReport("stream_frames", frames, "frames");
+	benchReport("stream_frame_mean", totalFrames / frames, "ms");
+	benchReport("stream_frame_worst", worstFrame, "ms");
+	benchReport("stream_uploaded", uploaded / (1024.0 * 1024.0), "MB");
+	benchReport("stream_stalls", streamer.stalls(), "waits");
+
+	// both paths give the same top level; only the mips are filtered differently
+	if (readLevel(sync[0], 0) != readLevel(streamed[count - 1], 0))
+		benchFail("streamed texture differs from the synchronously loaded one");
+
+	streamer.destroy();
+	glState().deleteTextures(count, sync.data());
+	glState().deleteTextures(count, streamed.data());
+}
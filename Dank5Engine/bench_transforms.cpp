@@ -0,0 +1,141 @@
+#include "bench.h"
+#include "jobsystem.h"
+#include "transforms.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// transform hierarchy: a 100k node scene of small trees with 1% of the nodes turning every
+// frame, updated on this thread and over the job system, against rebuilding every world
+// matrix from scratch with glm the way test.cpp builds its models
+
+static const unsigned int TREE_SIZE = 100;
+
+// local transform of node as a matrix, the slow way
+static glm::mat4 localMatrix(const TransformHierarchy& scene, unsigned int node)
+{
+	glm::mat4 model = glm::translate(glm::mat4(1.0f), scene.position(node));
+	model = model * glm::mat4_cast(scene.rotation(node));
+	return glm::scale(model, scene.scale(node));
+}
+
+// world matrix of node by walking up to its root
+static glm::mat4 worldMatrix(const TransformHierarchy& scene, unsigned int node)
+{
+	glm::mat4 world = localMatrix(scene, node);
+	for (unsigned int p = scene.parent(node); p != TRANSFORM_NONE; p = scene.parent(p))
+		world = localMatrix(scene, p) * world;
+	return world;
+}
+
+static float largestDifference(const glm::mat4& a, const glm::mat4& b)
+{
+	float largest = 0.0f;
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 4; r++)
+			largest = std::max(largest, std::fabs(a[c][r] - b[c][r]));
+	return largest;
+}
+
+static glm::quat randomRotation()
+{
+	glm::vec3 axis(rand() % 200 - 100.0f, rand() % 200 - 100.0f, rand() % 200 - 99.5f);
+	return glm::angleAxis(glm::radians((float)(rand() % 360)), glm::normalize(axis));
+}
+
+// trees of TREE_SIZE nodes whose parents are random earlier nodes of the same tree, so the
+// nodes are created out of depth order
+static void buildScene(TransformHierarchy& scene, unsigned int count)
+{
+	scene.reserve(count);
+	std::vector<unsigned int> tree;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (i % TREE_SIZE == 0)
+			tree.clear();
+		unsigned int parent = tree.empty() ? TRANSFORM_NONE : tree[rand() % tree.size()];
+		glm::vec3 position = tree.empty() ?
+			glm::vec3(rand() % 1000 - 500.0f, rand() % 1000 - 500.0f, rand() % 1000 - 500.0f) :
+			glm::vec3(rand() % 5 - 2.0f, rand() % 5 - 2.0f, rand() % 5 - 2.0f);
+		tree.push_back(scene.create(parent, position, randomRotation(), glm::vec3(0.9f + rand() % 3 * 0.05f)));
+	}
+}
+
+// frames of 1% of the nodes turning; average milliseconds per update and nodes recomputed
+static double runFrames(TransformHierarchy& scene, JobSystem* jobs, unsigned int frames, unsigned int& recomputed)
+{
+	const unsigned int count = scene.size(), moving = count / 100;
+	double total = 0.0;
+	recomputed = 0;
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		for (unsigned int m = 0; m < moving; m++)
+		{
+			unsigned int node = (unsigned int)(((uint64_t)rand() * RAND_MAX + rand()) % count);
+			scene.setRotation(node, randomRotation());
+		}
+		double start = benchNow();
+		recomputed += scene.update(jobs);
+		total += benchNow() - start;
+	}
+	recomputed /= frames;
+	return total / frames;
+}
+
+DANK5_BENCH(transform_hierarchy, false)
+{
+	const unsigned int count = 100000;
+	const unsigned int frames = ctx.quick ? 30 : 300;
+	srand(11);
+
+	TransformHierarchy scene;
+	buildScene(scene, count);
+	double start = benchNow();
+	unsigned int first = scene.update();
+	benchReport("first_update", (benchNow() - start) * 1000.0, "us");
+	std::cout << "  nodes: " << scene.size() << ", levels: " << scene.levels() << std::endl;
+	if (first != count)
+		benchFail("the first update didn't compute every node");
+
+	unsigned int recomputed = 0;
+	double serial = runFrames(scene, nullptr, frames, recomputed);
+	benchReport("update_1pct_moving", serial * 1000.0, "us");
+	benchReport("recomputed_per_frame", recomputed, "nodes");
+	double parallel = runFrames(scene, &jobSystem(), frames, recomputed);
+	benchReport("update_1pct_moving_jobs", parallel * 1000.0, "us");
+	benchReport("job_threads", jobSystem().threads(), "threads");
+	// levels split over jobs even with a single core, for the check below
+	JobSystem oversubscribed(4);
+	runFrames(scene, &oversubscribed, 5, recomputed);
+	if (scene.update() != 0)
+		benchFail("a clean scene recomputed nodes");
+
+	// what rebuilding every model matrix each frame costs
+	std::vector<glm::mat4> models(count);
+	start = benchNow();
+	for (unsigned int node = 0; node < count; node++)
+	{
+		unsigned int p = scene.parent(node);
+		models[node] = p == TRANSFORM_NONE ? localMatrix(scene, node) : models[p] * localMatrix(scene, node);
+	}
+	benchReport("rebuild_all_glm", (benchNow() - start) * 1000.0, "us");
+	benchKeep(models);
+
+	// every world matrix against the chain of local matrices up to its root
+	float largest = 0.0f;
+	for (unsigned int node = 0; node < count; node++)
+	{
+		glm::mat4 expected = worldMatrix(scene, node);
+		float tolerance = 1e-5f * (1.0f + std::fabs(expected[3][0]) + std::fabs(expected[3][1]) + std::fabs(expected[3][2]));
+		largest = std::max(largest, largestDifference(scene.world(node), expected) / tolerance);
+	}
+	if (largest > 1.0f)
+		benchFail("world matrices differ from the local chain");
+}
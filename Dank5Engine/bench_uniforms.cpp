@@ -0,0 +1,146 @@
+#include "bench.h"
+#include "headless.h"
+#include "shader.h"
+#include "frameconstants.h"
+#include "glstate.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <string>
+#include <vector>
+
+// per call cost of a model matrix upload through the three ways of naming a uniform
+
+// what Shader::setMat4 did before the uniform table: std::string from the literal + glGetUniformLocation
+static void setMat4Query(const Shader& shader, const std::string &name, const glm::mat4 &mat)
+{
+	glUniformMatrix4fv(glGetUniformLocation(shader.ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+}
+
+DANK5_BENCH(uniform_set, true)
+{
+	Shader shader("testVert.vs", "testFrag.fs");
+	shader.use();
+	const unsigned int calls = ctx.quick ? 100000 : 1000000;
+	glm::mat4 model(1.0f);
+
+	if (shader.uniform("model") != glGetUniformLocation(shader.ID, "model"))
+		benchFail("cached location of \"model\" differs from glGetUniformLocation");
+
+	double start = benchNow();
+	for (unsigned int i = 0; i < calls; i++) {
+		model[3][0] = (float)i;
+		setMat4Query(shader, "model", model);
+	}
+	double query = benchNow() - start;
+
+	start = benchNow();
+	for (unsigned int i = 0; i < calls; i++) {
+		model[3][0] = (float)i;
+		shader.setMat4("model", model);
+	}
+	double hashed = benchNow() - start;
+
+	constexpr UniformName uModel("model");
+	GLint location = shader.uniform(uModel);
+	start = benchNow();
+	for (unsigned int i = 0; i < calls; i++) {
+		model[3][0] = (float)i;
+		shader.setMat4(location, model);
+	}
+	double resolved = benchNow() - start;
+
+	// the GL call alone, the floor all three share
+	start = benchNow();
+	for (unsigned int i = 0; i < calls; i++) {
+		model[3][0] = (float)i;
+		glUniformMatrix4fv(location, 1, GL_FALSE, &model[0][0]);
+	}
+	double raw = benchNow() - start;
+
+	benchReport("string_query", query * 1e6 / calls, "ns/call");
+	benchReport("hashed_name", hashed * 1e6 / calls, "ns/call");
+	benchReport("location", resolved * 1e6 / calls, "ns/call");
+	benchReport("gl_only", raw * 1e6 / calls, "ns/call");
+	benchReport("removed_overhead", (query - hashed) * 1e6 / calls, "ns/call");
+	glState().deleteProgram(shader.ID);
+}
+
+// lookup alone, no GL: the cost a hashed name adds over a resolved location
+DANK5_BENCH(uniform_lookup, true)
+{
+	Shader shader("testVert.vs", "testFrag.fs");
+	const unsigned int calls = ctx.quick ? 1000000 : 10000000;
+	const char* names[] = { "model", "view", "projection", "texture1" };
+
+	GLint sum = 0;
+	double start = benchNow();
+	for (unsigned int i = 0; i < calls; i++)
+		sum += shader.uniform(names[i & 3]);
+	double elapsed = benchNow() - start;
+	benchKeep(sum);
+
+	benchReport("runtime_hash", elapsed * 1e6 / calls, "ns/lookup");
+	glState().deleteProgram(shader.ID);
+
+	// an array's elements each take a slot; the table must still have room to end a
+	// probe for a name the program doesn't have
+	Shader arrays("#version 330 core\nlayout (location = 0) in vec3 aPos;\nuniform vec4 offsets[24];\n"
+		"void main() { vec4 sum = vec4(0.0); for (int i = 0; i < 24; i++) sum += offsets[i]; gl_Position = vec4(aPos, 1.0) + sum; }\n",
+		"#version 330 core\nout vec4 FragColor;\nuniform vec4 tints[12];\n"
+		"void main() { vec4 sum = vec4(0.0); for (int i = 0; i < 12; i++) sum += tints[i]; FragColor = sum; }\n", nullptr);
+	arrays.finish();
+	if (arrays.uniform("offsets[23]") < 0 || arrays.uniform("tints[11]") < 0)
+		benchFail("array elements missing from the uniform table");
+	if (arrays.uniform("missing") != -1 || arrays.uniform("offsets[24]") != -1)
+		benchFail("lookup of an unknown uniform didn't return -1");
+	glState().deleteProgram(arrays.ID);
+}
+
+// view + projection for many programs: two setMat4 per program per frame (the old
+// testVert.vs uniforms, stood in for by "model") against one FrameConstants update per frame
+DANK5_BENCH(frame_constants, true)
+{
+	const unsigned int programs = 32;
+	const unsigned int frames = ctx.quick ? 200 : 2000;
+	std::vector<Shader> shaders;
+	for (unsigned int i = 0; i < programs; i++)
+		shaders.push_back(Shader("testVert.vs", "testFrag.fs"));
+
+	FrameConstants constants;
+	constants.projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+	constants.view = glm::mat4(1.0f);
+	ctx.gl->finish();
+
+	double start = benchNow();
+	for (unsigned int frame = 0; frame < frames; frame++) {
+		constants.view[3][0] = (float)frame;
+		for (Shader& shader : shaders) {
+			shader.use();
+			shader.setMat4("model", constants.view);
+			shader.setMat4("model", constants.projection);
+		}
+	}
+	ctx.gl->finish();
+	double perProgram = benchNow() - start;
+
+	FrameUniformBuffer frameUBO(3);
+	start = benchNow();
+	for (unsigned int frame = 0; frame < frames; frame++) {
+		constants.view[3][0] = (float)frame;
+		constants.viewProjection = constants.projection * constants.view;
+		frameUBO.update(constants);
+		for (Shader& shader : shaders)
+			shader.use();
+	}
+	ctx.gl->finish();
+	double shared = benchNow() - start;
+
+	benchReport("per_program_uniforms", perProgram * 1000.0 / frames, "us/frame");
+	benchReport("shared_ubo", shared * 1000.0 / frames, "us/frame");
+	benchReport("ubo_stalls", frameUBO.stalls(), "waits");
+	frameUBO.destroy();
+	for (Shader& shader : shaders)
+		glState().deleteProgram(shader.ID);
+}
@@ -0,0 +1,339 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cfloat>
+
+// bins per axis for the SAH split search
+static const unsigned int BINS = 16;
+// cost of visiting an inner node relative to testing one object box
+static const float TRAVERSAL_COST = 1.0f;
+// traversal stack on the stack; deeper trees (skewed object layouts can make SAH build
+// chains) traverse with one sized from their depth
+static const unsigned int STACK_SIZE = 64;
+
+static float surfaceArea(const glm::vec3& min, const glm::vec3& max)
+{
+	glm::vec3 e = max - min;
+	return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+BVH::BVH() : nodes(nullptr), usedNodes(0), treeDepth(0)
+{
+}
+
+BVH::~BVH()
+{
+}
+
+void BVH::reserveNodes(unsigned int count)
+{
+	// plain std::vector storage, aligned by hand: C++14 allocators don't honour 32-byte alignment
+	nodeStorage.resize(count * sizeof(BVHNode) + 32);
+	uintptr_t address = (uintptr_t)nodeStorage.data();
+	nodes = (BVHNode*)((address + 31) & ~(uintptr_t)31);
+}
+
+void BVH::updateBounds(BVHNode& n) const
+{
+	glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+	for (unsigned int i = 0; i < n.count; i++)
+	{
+		const AABB& box = boxes[objectIndex[n.leftFirst + i]];
+		min = glm::min(min, box.min);
+		max = glm::max(max, box.max);
+	}
+	n.min = min;
+	n.max = max;
+}
+
+void BVH::build(const AABB* source, unsigned int count, unsigned int maxLeafSize)
+{
+	boxes.assign(source, source + count);
+	centroids.resize(count);
+	objectIndex.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		centroids[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+		objectIndex[i] = i;
+	}
+
+	// a binary tree with one object per leaf at worst has 2n - 1 nodes
+	reserveNodes(count > 0 ? 2 * count - 1 : 1);
+	usedNodes = 1;
+	treeDepth = 0;
+	BVHNode& root = nodes[0];
+	root.leftFirst = 0;
+	root.count = count;
+	if (count == 0)
+	{
+		root.min = root.max = glm::vec3(0.0f);
+		return;
+	}
+	updateBounds(root);
+	subdivide(0, maxLeafSize < 1 ? 1 : maxLeafSize);
+}
+
+void BVH::subdivide(unsigned int root, unsigned int maxLeafSize)
+{
+	struct Bin {
+		glm::vec3 min, max;
+		unsigned int count;
+	};
+
+	// nodes to split and their depth
+	std::vector<std::pair<unsigned int, unsigned int>> stack;
+	stack.push_back(std::make_pair(root, 0u));
+	while (!stack.empty())
+	{
+		unsigned int index = stack.back().first, depth = stack.back().second;
+		stack.pop_back();
+		BVHNode& n = nodes[index];
+		if (n.count <= 1)
+			continue;
+
+		// split candidates are bin boundaries along each axis of the centroid bounds
+		glm::vec3 cmin(FLT_MAX), cmax(-FLT_MAX);
+		for (unsigned int i = 0; i < n.count; i++)
+		{
+			const glm::vec3& c = centroids[objectIndex[n.leftFirst + i]];
+			cmin = glm::min(cmin, c);
+			cmax = glm::max(cmax, c);
+		}
+
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		unsigned int bestSplit = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (cmax[axis] <= cmin[axis])
+				continue;
+			Bin bins[BINS];
+			for (unsigned int b = 0; b < BINS; b++)
+			{
+				bins[b].min = glm::vec3(FLT_MAX);
+				bins[b].max = glm::vec3(-FLT_MAX);
+				bins[b].count = 0;
+			}
+			float scale = BINS / (cmax[axis] - cmin[axis]);
+			for (unsigned int i = 0; i < n.count; i++)
+			{
+				unsigned int object = objectIndex[n.leftFirst + i];
+				unsigned int b = std::min(BINS - 1, (unsigned int)((centroids[object][axis] - cmin[axis]) * scale));
+				bins[b].count++;
+				bins[b].min = glm::min(bins[b].min, boxes[object].min);
+				bins[b].max = glm::max(bins[b].max, boxes[object].max);
+			}
+			// sweep from both sides: area * count left and right of every boundary
+			float leftCost[BINS - 1], rightCost[BINS - 1];
+			glm::vec3 lmin(FLT_MAX), lmax(-FLT_MAX), rmin(FLT_MAX), rmax(-FLT_MAX);
+			unsigned int leftCount = 0, rightCount = 0;
+			for (unsigned int b = 0; b < BINS - 1; b++)
+			{
+				leftCount += bins[b].count;
+				lmin = glm::min(lmin, bins[b].min);
+				lmax = glm::max(lmax, bins[b].max);
+				leftCost[b] = leftCount ? leftCount * surfaceArea(lmin, lmax) : 0.0f;
+				rightCount += bins[BINS - 1 - b].count;
+				rmin = glm::min(rmin, bins[BINS - 1 - b].min);
+				rmax = glm::max(rmax, bins[BINS - 1 - b].max);
+				rightCost[BINS - 2 - b] = rightCount ? rightCount * surfaceArea(rmin, rmax) : 0.0f;
+			}
+			for (unsigned int b = 0; b < BINS - 1; b++)
+			{
+				float cost = leftCost[b] + rightCost[b];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b + 1;
+				}
+			}
+		}
+
+		// all centroids in one point: nothing to split on
+		if (bestAxis < 0)
+			continue;
+		// splitting has to beat intersecting every object of the node, unless the leaf is too big
+		float area = surfaceArea(n.min, n.max);
+		if (TRAVERSAL_COST * area + bestCost >= n.count * area && n.count <= maxLeafSize)
+			continue;
+
+		// partition the node's objects around the chosen boundary
+		float scale = BINS / (cmax[bestAxis] - cmin[bestAxis]);
+		unsigned int* first = &objectIndex[n.leftFirst];
+		unsigned int* middle = std::partition(first, first + n.count, [&](unsigned int object) {
+			return std::min(BINS - 1, (unsigned int)((centroids[object][bestAxis] - cmin[bestAxis]) * scale)) < bestSplit;
+		});
+		unsigned int leftCount = (unsigned int)(middle - first);
+		if (leftCount == 0 || leftCount == n.count)
+			continue;
+
+		unsigned int left = usedNodes;
+		usedNodes += 2;
+		nodes[left].leftFirst = n.leftFirst;
+		nodes[left].count = leftCount;
+		nodes[left + 1].leftFirst = n.leftFirst + leftCount;
+		nodes[left + 1].count = n.count - leftCount;
+		updateBounds(nodes[left]);
+		updateBounds(nodes[left + 1]);
+		n.leftFirst = left;
+		n.count = 0;
+		stack.push_back(std::make_pair(left + 1, depth + 1));
+		stack.push_back(std::make_pair(left, depth + 1));
+		treeDepth = std::max(treeDepth, depth + 1);
+	}
+}
+
+void BVH::update(unsigned int object, const AABB& box)
+{
+	boxes[object] = box;
+	centroids[object] = (box.min + box.max) * 0.5f;
+}
+
+void BVH::refit()
+{
+	// children are always stored after their parent, so a reverse sweep is bottom-up
+	for (unsigned int i = usedNodes; i-- > 0; )
+	{
+		BVHNode& n = nodes[i];
+		if (n.count)
+		{
+			updateBounds(n);
+			continue;
+		}
+		const BVHNode& l = nodes[n.leftFirst];
+		const BVHNode& r = nodes[n.leftFirst + 1];
+		n.min = glm::min(l.min, r.min);
+		n.max = glm::max(l.max, r.max);
+	}
+}
+
+unsigned int* BVH::traversalStack(unsigned int* local, std::vector<unsigned int>& deep) const
+{
+	// depth-first, a node at depth d is popped with at most d siblings waiting and pushes
+	// two children; inner nodes are above treeDepth, so treeDepth + 1 entries always do
+	if (treeDepth + 1 <= STACK_SIZE)
+		return local;
+	deep.resize(treeDepth + 1);
+	return deep.data();
+}
+
+// 0 outside, 1 intersecting, 2 fully inside
+static int classify(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max)
+{
+	int result = 2;
+	for (unsigned int p = 0; p < 6; p++)
+	{
+		const glm::vec4& plane = frustum.planes[p];
+		// corners furthest along and against the plane normal
+		glm::vec3 positive(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y, plane.z >= 0.0f ? max.z : min.z);
+		glm::vec3 negative(plane.x >= 0.0f ? min.x : max.x, plane.y >= 0.0f ? min.y : max.y, plane.z >= 0.0f ? min.z : max.z);
+		if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+			return 0;
+		if (glm::dot(glm::vec3(plane), negative) + plane.w < 0.0f)
+			result = 1;
+	}
+	return result;
+}
+
+unsigned int BVH::queryFrustum(const Frustum& frustum, unsigned int* visible) const
+{
+	if (boxes.empty())
+		return 0;
+	// the top bit of a stack entry marks a subtree already known to be fully inside
+	const unsigned int INSIDE = 0x80000000u;
+	unsigned int local[STACK_SIZE];
+	std::vector<unsigned int> deep;
+	unsigned int* stack = traversalStack(local, deep);
+	unsigned int top = 0, n = 0;
+	stack[top++] = 0;
+	while (top)
+	{
+		unsigned int entry = stack[--top];
+		const BVHNode& node = nodes[entry & ~INSIDE];
+		int state = (entry & INSIDE) ? 2 : classify(frustum, node.min, node.max);
+		if (state == 0)
+			continue;
+		if (node.count)
+		{
+			for (unsigned int i = 0; i < node.count; i++)
+			{
+				unsigned int object = objectIndex[node.leftFirst + i];
+				if (state == 2 || node.count == 1 || classify(frustum, boxes[object].min, boxes[object].max))
+					visible[n++] = object;
+			}
+			continue;
+		}
+		unsigned int flag = state == 2 ? INSIDE : 0;
+		stack[top++] = (node.leftFirst + 1) | flag;
+		stack[top++] = node.leftFirst | flag;
+	}
+	return n;
+}
+
+float intersectAABB(const glm::vec3& origin, const glm::vec3& invDirection, const glm::vec3& min, const glm::vec3& max, float maxDistance)
+{
+	glm::vec3 t1 = (min - origin) * invDirection;
+	glm::vec3 t2 = (max - origin) * invDirection;
+	glm::vec3 tNear = glm::min(t1, t2);
+	glm::vec3 tFar = glm::max(t1, t2);
+	float enter = std::max(std::max(tNear.x, tNear.y), tNear.z);
+	float exit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+	if (exit < enter || exit < 0.0f || enter > maxDistance)
+		return -1.0f;
+	return enter > 0.0f ? enter : 0.0f;
+}
+
+int BVH::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* distance) const
+{
+	if (boxes.empty())
+		return -1;
+	glm::vec3 inv = 1.0f / direction;
+	float closest = maxDistance;
+	int hit = -1;
+	unsigned int local[STACK_SIZE];
+	std::vector<unsigned int> deep;
+	unsigned int* stack = traversalStack(local, deep);
+	unsigned int top = 0;
+	stack[top++] = 0;
+	while (top)
+	{
+		const BVHNode& node = nodes[stack[--top]];
+		float t = intersectAABB(origin, inv, node.min, node.max, closest);
+		if (t < 0.0f)
+			continue;
+		if (node.count)
+		{
+			for (unsigned int i = 0; i < node.count; i++)
+			{
+				unsigned int object = objectIndex[node.leftFirst + i];
+				float to = intersectAABB(origin, inv, boxes[object].min, boxes[object].max, closest);
+				if (to >= 0.0f && (hit < 0 || to < closest))
+				{
+					closest = to;
+					hit = (int)object;
+				}
+			}
+			continue;
+		}
+		// visit the nearer child first so far subtrees get rejected by the closer hit
+		const BVHNode& l = nodes[node.leftFirst];
+		const BVHNode& r = nodes[node.leftFirst + 1];
+		float tl = intersectAABB(origin, inv, l.min, l.max, closest);
+		float tr = intersectAABB(origin, inv, r.min, r.max, closest);
+		if (tl >= 0.0f && tr >= 0.0f)
+		{
+			bool leftFirst = tl <= tr;
+			stack[top++] = leftFirst ? node.leftFirst + 1 : node.leftFirst;
+			stack[top++] = leftFirst ? node.leftFirst : node.leftFirst + 1;
+		}
+		else if (tl >= 0.0f)
+			stack[top++] = node.leftFirst;
+		else if (tr >= 0.0f)
+			stack[top++] = node.leftFirst + 1;
+	}
+	if (hit >= 0 && distance)
+		*distance = closest;
+	return hit;
+}
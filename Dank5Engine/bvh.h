@@ -0,0 +1,81 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "culling.h"
+
+struct AABB {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+// One node of the flattened tree, 32 bytes so two share a cache line. Inner nodes have
+// count == 0 and their children at leftFirst and leftFirst + 1; leaves reference
+// count object indices starting at leftFirst in BVH::objectIndex.
+struct BVHNode {
+	glm::vec3 min;
+	unsigned int leftFirst;
+	glm::vec3 max;
+	unsigned int count;
+};
+
+// Bounding volume hierarchy over object AABBs for static (and slowly moving) scene
+// geometry. Built top-down with a binned surface area heuristic; nodes live in one
+// 32-byte aligned array in depth-first order, children after their parent.
+class BVH {
+
+public:
+	BVH();
+	~BVH();
+
+	// build over count boxes; leaves hold up to maxLeafSize objects
+	void build(const AABB* boxes, unsigned int count, unsigned int maxLeafSize = 4);
+
+	// change the box of one object (it keeps its leaf), then call refit() once per frame
+	void update(unsigned int object, const AABB& box);
+	// recompute node bounds bottom-up after update(); the topology stays, so quality
+	// slowly degrades if objects move far, rebuild then
+	void refit();
+
+	// indices of the objects whose box intersects the frustum, returns how many
+	// (visible needs room for objectCount())
+	unsigned int queryFrustum(const Frustum& frustum, unsigned int* visible) const;
+	// closest object whose box the ray hits within maxDistance; -1 if none.
+	// direction need not be normalised, distance is measured in units of direction
+	int raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* distance = nullptr) const;
+
+	unsigned int nodeCount() const { return usedNodes; }
+	// edges from the root to the deepest leaf
+	unsigned int depth() const { return treeDepth; }
+	unsigned int objectCount() const { return (unsigned int)boxes.size(); }
+	const BVHNode& node(unsigned int i) const { return nodes[i]; }
+
+	// object index per leaf slot
+	std::vector<unsigned int> objectIndex;
+
+private:
+	BVH(const BVH&);
+	BVH& operator=(const BVH&);
+
+	void reserveNodes(unsigned int count);
+	void updateBounds(BVHNode& n) const;
+	void subdivide(unsigned int root, unsigned int maxLeafSize);
+	// local when the tree fits its fixed size, otherwise deep sized for the tree's depth
+	unsigned int* traversalStack(unsigned int* local, std::vector<unsigned int>& deep) const;
+
+	std::vector<AABB> boxes;
+	std::vector<glm::vec3> centroids;
+	// 32-byte aligned view into nodeStorage
+	BVHNode* nodes;
+	std::vector<unsigned char> nodeStorage;
+	unsigned int usedNodes;
+	unsigned int treeDepth;
+};
+
+// ray/box slab test with a precomputed 1/direction; entry distance or a negative value on a miss
+float intersectAABB(const glm::vec3& origin, const glm::vec3& invDirection, const glm::vec3& min, const glm::vec3& max, float maxDistance);
+
+#endif
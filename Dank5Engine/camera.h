@@ -46,8 +46,8 @@ public:
 	{
 		Position = position;
 		WorldUp = up;
-		yaw = yaw;
-		pitch = pitch;
+		this->yaw = yaw;
+		this->pitch = pitch;
 		updateCameraVectors();
 	}
 	// Constructor with scalar values
@@ -55,8 +55,8 @@ public:
 	{
 		Position = glm::vec3(posX, posY, posZ);
 		WorldUp = glm::vec3(upX, upY, upZ);
-		yaw = yaw;
-		pitch = pitch;
+		this->yaw = yaw;
+		this->pitch = pitch;
 		updateCameraVectors();
 	}
 
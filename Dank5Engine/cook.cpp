@@ -0,0 +1,51 @@
+#include "bakedtexture.h"
+
+#include <cstring>
+#include <iostream>
+
+// dank5_cook: bakes an image into a texture file for loadBakedTexture()
+//	dank5_cook [--rgba8 | --bc1 | --bc3 | --bc4 | --bc5 | --bc7] [--fast | --best] input output
+
+static const char* USAGE = "usage: dank5_cook [--rgba8 | --bc1 | --bc3 | --bc4 | --bc5 | --bc7] [--fast | --best] input output";
+
+int main(int argc, char** argv)
+{
+	static const char* formats[BAKED_FORMAT_COUNT] = { "--rgba8", "--bc1", "--bc3", "--bc7", "--bc4", "--bc5" };
+	BakedFormat format = BAKED_BC7;
+	CompressionQuality quality = COMPRESS_NORMAL;
+	int first = 1;
+	for (; first < argc && strncmp(argv[first], "--", 2) == 0; first++)
+	{
+		if (strcmp(argv[first], "--fast") == 0)
+		{
+			quality = COMPRESS_FAST;
+			continue;
+		}
+		if (strcmp(argv[first], "--best") == 0)
+		{
+			quality = COMPRESS_BEST;
+			continue;
+		}
+		int i = 0;
+		while (i < BAKED_FORMAT_COUNT && strcmp(argv[first], formats[i]) != 0)
+			i++;
+		if (i == BAKED_FORMAT_COUNT)
+		{
+			std::cout << "unknown option " << argv[first] << std::endl;
+			std::cout << USAGE << std::endl;
+			return 1;
+		}
+		format = (BakedFormat)i;
+	}
+	if (argc - first != 2)
+	{
+		std::cout << USAGE << std::endl;
+		return 1;
+	}
+	CompressionReport report;
+	if (!cookTexture(argv[first], argv[first + 1], format, quality, &report))
+		return 1;
+	if (format != BAKED_RGBA8)
+		report.print(argv[first + 1]);
+	return 0;
+}
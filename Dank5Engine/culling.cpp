@@ -0,0 +1,311 @@
+#include "culling.h"
+
+#include <cmath>
+
+// the SIMD paths are picked at compile time from glm's GLM_ARCH (glm/simd/platform.h,
+// pulled in through glm.hpp), so -march decides which ones exist
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#	define DANK5_CULL_SSE 1
+#endif
+#if GLM_ARCH & GLM_ARCH_AVX_BIT
+#	define DANK5_CULL_AVX 1
+#endif
+
+#if defined(_MSC_VER) && (DANK5_CULL_SSE || DANK5_CULL_AVX)
+#	include <intrin.h>
+#endif
+
+// index of the lowest set bit of a non-zero mask
+static inline unsigned int lowestBit(unsigned int mask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (unsigned int)index;
+#else
+	return (unsigned int)__builtin_ctz(mask);
+#endif
+}
+
+// append base + i for every set bit i of mask
+static inline unsigned int appendVisible(unsigned int mask, unsigned int base, unsigned int* visible, unsigned int n)
+{
+	while (mask)
+	{
+		visible[n++] = base + lowestBit(mask);
+		mask &= mask - 1;
+	}
+	return n;
+}
+
+Frustum extractFrustum(const glm::mat4& m)
+{
+	// rows of the column-major glm matrix
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	Frustum frustum;
+	frustum.planes[0] = row3 + row0; // left
+	frustum.planes[1] = row3 - row0; // right
+	frustum.planes[2] = row3 + row1; // bottom
+	frustum.planes[3] = row3 - row1; // top
+	frustum.planes[4] = row3 + row2; // near
+	frustum.planes[5] = row3 - row2; // far
+	// normalise so plane distances are in world units, which the sphere radius test needs
+	for (unsigned int i = 0; i < 6; i++)
+		frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+	return frustum;
+}
+
+void BoundingSpheres::resize(unsigned int count)
+{
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+	radius.resize(count);
+}
+
+void BoundingSpheres::set(unsigned int i, const glm::vec3& center, float r)
+{
+	x[i] = center.x;
+	y[i] = center.y;
+	z[i] = center.z;
+	radius[i] = r;
+}
+
+void BoundingBoxes::resize(unsigned int count)
+{
+	cx.resize(count);
+	cy.resize(count);
+	cz.resize(count);
+	ex.resize(count);
+	ey.resize(count);
+	ez.resize(count);
+}
+
+void BoundingBoxes::set(unsigned int i, const glm::vec3& min, const glm::vec3& max)
+{
+	glm::vec3 center = (min + max) * 0.5f;
+	glm::vec3 extent = (max - min) * 0.5f;
+	cx[i] = center.x;
+	cy[i] = center.y;
+	cz[i] = center.z;
+	ex[i] = extent.x;
+	ey[i] = extent.y;
+	ez[i] = extent.z;
+}
+
+// ------------------------------------------------------------------------
+unsigned int cullSpheresScalar(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int first, unsigned int* visible)
+{
+	unsigned int n = 0;
+	for (unsigned int i = first; i < spheres.size(); i++)
+	{
+		bool inside = true;
+		for (unsigned int p = 0; p < 6 && inside; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			float d = plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w;
+			inside = d >= -spheres.radius[i];
+		}
+		if (inside)
+			visible[n++] = i;
+	}
+	return n;
+}
+
+unsigned int cullBoxesScalar(const Frustum& frustum, const BoundingBoxes& boxes, unsigned int first, unsigned int* visible)
+{
+	unsigned int n = 0;
+	for (unsigned int i = first; i < boxes.size(); i++)
+	{
+		bool inside = true;
+		for (unsigned int p = 0; p < 6 && inside; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			float d = plane.x * boxes.cx[i] + plane.y * boxes.cy[i] + plane.z * boxes.cz[i] + plane.w;
+			// projected half size of the box onto the plane normal
+			float r = std::fabs(plane.x) * boxes.ex[i] + std::fabs(plane.y) * boxes.ey[i] + std::fabs(plane.z) * boxes.ez[i];
+			inside = d + r >= 0.0f;
+		}
+		if (inside)
+			visible[n++] = i;
+	}
+	return n;
+}
+
+// ------------------------------------------------------------------------
+unsigned int cullSpheresSSE(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible)
+{
+#if DANK5_CULL_SSE
+	__m128 px[6], py[6], pz[6], pw[6];
+	for (unsigned int p = 0; p < 6; p++)
+	{
+		px[p] = _mm_set1_ps(frustum.planes[p].x);
+		py[p] = _mm_set1_ps(frustum.planes[p].y);
+		pz[p] = _mm_set1_ps(frustum.planes[p].z);
+		pw[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+	const unsigned int count = spheres.size();
+	const __m128 zero = _mm_setzero_ps();
+	unsigned int n = 0, i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&spheres.x[i]);
+		__m128 y = _mm_loadu_ps(&spheres.y[i]);
+		__m128 z = _mm_loadu_ps(&spheres.z[i]);
+		__m128 negR = _mm_sub_ps(zero, _mm_loadu_ps(&spheres.radius[i]));
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (unsigned int p = 0; p < 6; p++)
+		{
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)), _mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+		}
+		n = appendVisible((unsigned int)_mm_movemask_ps(inside), i, visible, n);
+	}
+	return n + cullSpheresScalar(frustum, spheres, i, visible + n);
+#else
+	return cullSpheresScalar(frustum, spheres, 0, visible);
+#endif
+}
+
+unsigned int cullBoxesSSE(const Frustum& frustum, const BoundingBoxes& boxes, unsigned int* visible)
+{
+#if DANK5_CULL_SSE
+	__m128 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+	for (unsigned int p = 0; p < 6; p++)
+	{
+		const glm::vec4& plane = frustum.planes[p];
+		px[p] = _mm_set1_ps(plane.x);
+		py[p] = _mm_set1_ps(plane.y);
+		pz[p] = _mm_set1_ps(plane.z);
+		pw[p] = _mm_set1_ps(plane.w);
+		ax[p] = _mm_set1_ps(std::fabs(plane.x));
+		ay[p] = _mm_set1_ps(std::fabs(plane.y));
+		az[p] = _mm_set1_ps(std::fabs(plane.z));
+	}
+	const unsigned int count = boxes.size();
+	const __m128 zero = _mm_setzero_ps();
+	unsigned int n = 0, i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&boxes.cx[i]);
+		__m128 cy = _mm_loadu_ps(&boxes.cy[i]);
+		__m128 cz = _mm_loadu_ps(&boxes.cz[i]);
+		__m128 ex = _mm_loadu_ps(&boxes.ex[i]);
+		__m128 ey = _mm_loadu_ps(&boxes.ey[i]);
+		__m128 ez = _mm_loadu_ps(&boxes.ez[i]);
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (unsigned int p = 0; p < 6; p++)
+		{
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], cx), _mm_mul_ps(py[p], cy)), _mm_add_ps(_mm_mul_ps(pz[p], cz), pw[p]));
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+		}
+		n = appendVisible((unsigned int)_mm_movemask_ps(inside), i, visible, n);
+	}
+	return n + cullBoxesScalar(frustum, boxes, i, visible + n);
+#else
+	return cullBoxesScalar(frustum, boxes, 0, visible);
+#endif
+}
+
+// ------------------------------------------------------------------------
+unsigned int cullSpheresAVX(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible)
+{
+#if DANK5_CULL_AVX
+	__m256 px[6], py[6], pz[6], pw[6];
+	for (unsigned int p = 0; p < 6; p++)
+	{
+		px[p] = _mm256_set1_ps(frustum.planes[p].x);
+		py[p] = _mm256_set1_ps(frustum.planes[p].y);
+		pz[p] = _mm256_set1_ps(frustum.planes[p].z);
+		pw[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+	const unsigned int count = spheres.size();
+	const __m256 zero = _mm256_setzero_ps();
+	unsigned int n = 0, i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(&spheres.x[i]);
+		__m256 y = _mm256_loadu_ps(&spheres.y[i]);
+		__m256 z = _mm256_loadu_ps(&spheres.z[i]);
+		__m256 negR = _mm256_sub_ps(zero, _mm256_loadu_ps(&spheres.radius[i]));
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (unsigned int p = 0; p < 6; p++)
+		{
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], x), _mm256_mul_ps(py[p], y)), _mm256_add_ps(_mm256_mul_ps(pz[p], z), pw[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+		}
+		n = appendVisible((unsigned int)_mm256_movemask_ps(inside), i, visible, n);
+	}
+	return n + cullSpheresScalar(frustum, spheres, i, visible + n);
+#else
+	return cullSpheresSSE(frustum, spheres, visible);
+#endif
+}
+
+unsigned int cullBoxesAVX(const Frustum& frustum, const BoundingBoxes& boxes, unsigned int* visible)
+{
+#if DANK5_CULL_AVX
+	__m256 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+	for (unsigned int p = 0; p < 6; p++)
+	{
+		const glm::vec4& plane = frustum.planes[p];
+		px[p] = _mm256_set1_ps(plane.x);
+		py[p] = _mm256_set1_ps(plane.y);
+		pz[p] = _mm256_set1_ps(plane.z);
+		pw[p] = _mm256_set1_ps(plane.w);
+		ax[p] = _mm256_set1_ps(std::fabs(plane.x));
+		ay[p] = _mm256_set1_ps(std::fabs(plane.y));
+		az[p] = _mm256_set1_ps(std::fabs(plane.z));
+	}
+	const unsigned int count = boxes.size();
+	const __m256 zero = _mm256_setzero_ps();
+	unsigned int n = 0, i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(&boxes.cx[i]);
+		__m256 cy = _mm256_loadu_ps(&boxes.cy[i]);
+		__m256 cz = _mm256_loadu_ps(&boxes.cz[i]);
+		__m256 ex = _mm256_loadu_ps(&boxes.ex[i]);
+		__m256 ey = _mm256_loadu_ps(&boxes.ey[i]);
+		__m256 ez = _mm256_loadu_ps(&boxes.ez[i]);
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (unsigned int p = 0; p < 6; p++)
+		{
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], cx), _mm256_mul_ps(py[p], cy)), _mm256_add_ps(_mm256_mul_ps(pz[p], cz), pw[p]));
+			__m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)), _mm256_mul_ps(az[p], ez));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_GE_OQ));
+		}
+		n = appendVisible((unsigned int)_mm256_movemask_ps(inside), i, visible, n);
+	}
+	return n + cullBoxesScalar(frustum, boxes, i, visible + n);
+#else
+	return cullBoxesSSE(frustum, boxes, visible);
+#endif
+}
+
+// ------------------------------------------------------------------------
+unsigned int cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible)
+{
+	return cullSpheresAVX(frustum, spheres, visible);
+}
+
+unsigned int cullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, unsigned int* visible)
+{
+	return cullBoxesAVX(frustum, boxes, visible);
+}
+
+const char* cullingPath()
+{
+#if DANK5_CULL_AVX
+	return "avx";
+#elif DANK5_CULL_SSE
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,54 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// View frustum as six normalised planes (left, right, bottom, top, near, far). A point p
+// is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+struct Frustum {
+	glm::vec4 planes[6];
+};
+
+// Frustum of a projection * view matrix (Gribb/Hartmann plane extraction), e.g.
+// extractFrustum(projection * camera.GetViewMatrix())
+Frustum extractFrustum(const glm::mat4& viewProjection);
+
+// Bounding spheres in SoA layout, so the culling kernels load 4 or 8 of each component at once
+struct BoundingSpheres {
+	std::vector<float> x, y, z, radius;
+
+	unsigned int size() const { return (unsigned int)x.size(); }
+	void resize(unsigned int count);
+	void set(unsigned int i, const glm::vec3& center, float r);
+};
+
+// Axis aligned bounding boxes in SoA layout, stored as centre and half extents
+struct BoundingBoxes {
+	std::vector<float> cx, cy, cz, ex, ey, ez;
+
+	unsigned int size() const { return (unsigned int)cx.size(); }
+	void resize(unsigned int count);
+	void set(unsigned int i, const glm::vec3& min, const glm::vec3& max);
+};
+
+// Write the indices of the spheres/boxes that intersect the frustum to visible (room for
+// size() entries) and return how many there are. Uses the widest SIMD path glm's GLM_ARCH
+// detection enabled for this build (see cullingPath()), with a scalar tail.
+unsigned int cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible);
+unsigned int cullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, unsigned int* visible);
+
+// the individual paths, for benchmarking and checking against each other; the SIMD ones
+// fall back to the next narrower path when the build doesn't have their instruction set
+unsigned int cullSpheresScalar(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int first, unsigned int* visible);
+unsigned int cullSpheresSSE(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible);
+unsigned int cullSpheresAVX(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible);
+unsigned int cullBoxesScalar(const Frustum& frustum, const BoundingBoxes& boxes, unsigned int first, unsigned int* visible);
+unsigned int cullBoxesSSE(const Frustum& frustum, const BoundingBoxes& boxes, unsigned int* visible);
+unsigned int cullBoxesAVX(const Frustum& frustum, const BoundingBoxes& boxes, unsigned int* visible);
+
+// "avx", "sse2" or "scalar": the path cullSpheres/cullBoxes use
+const char* cullingPath();
+
+#endif
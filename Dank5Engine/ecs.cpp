@@ -0,0 +1,359 @@
+#include "ecs.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+// column starts, a cache line apart
+static const unsigned int COLUMN_ALIGNMENT = 64;
+
+static ComponentInfo componentInfos[MAX_COMPONENT_TYPES];
+static unsigned int componentCount = 0;
+static std::mutex componentLock;
+
+unsigned int registerComponentType(unsigned int size, unsigned int alignment)
+{
+	std::lock_guard<std::mutex> guard(componentLock);
+	if (componentCount == MAX_COMPONENT_TYPES)
+	{
+		std::cout << "ERROR::ECS::TOO_MANY_COMPONENT_TYPES more than " << MAX_COMPONENT_TYPES << std::endl;
+		std::abort();
+	}
+	componentInfos[componentCount].size = size;
+	componentInfos[componentCount].alignment = alignment;
+	return componentCount++;
+}
+
+const ComponentInfo& componentInfo(unsigned int type)
+{
+	return componentInfos[type];
+}
+
+static unsigned int alignColumn(unsigned int offset)
+{
+	return (offset + COLUMN_ALIGNMENT - 1) & ~(COLUMN_ALIGNMENT - 1);
+}
+
+EntityWorld::EntityWorld() : live(0)
+{
+}
+
+EntityWorld::~EntityWorld()
+{
+}
+
+Archetype* EntityWorld::archetypeFor(ComponentMask mask)
+{
+	auto found = archetypeByMask.find(mask);
+	if (found != archetypeByMask.end())
+		return found->second.get();
+
+	std::unique_ptr<Archetype> archetype(new Archetype());
+	archetype->mask = mask;
+	std::fill(archetype->offsets, archetype->offsets + MAX_COMPONENT_TYPES, 0u);
+	std::fill(archetype->addEdges, archetype->addEdges + MAX_COMPONENT_TYPES, nullptr);
+	std::fill(archetype->removeEdges, archetype->removeEdges + MAX_COMPONENT_TYPES, nullptr);
+	unsigned int rowBytes = sizeof(Entity);
+	for (unsigned int type = 0; type < MAX_COMPONENT_TYPES; type++)
+		if (mask & (ComponentMask(1) << type))
+		{
+			archetype->types.push_back(type);
+			rowBytes += componentInfos[type].size;
+		}
+	// rows that fit with every column start padded to a cache line
+	unsigned int columns = 1 + (unsigned int)archetype->types.size();
+	archetype->capacity = (ENTITY_CHUNK_SIZE - columns * (COLUMN_ALIGNMENT - 1)) / rowBytes;
+	if (archetype->capacity == 0)
+	{
+		std::cout << "ERROR::ECS::ARCHETYPE_TOO_LARGE " << rowBytes << " bytes per entity" << std::endl;
+		std::abort();
+	}
+	unsigned int offset = archetype->capacity * (unsigned int)sizeof(Entity);
+	for (unsigned int type : archetype->types)
+	{
+		offset = alignColumn(offset);
+		archetype->offsets[type] = offset;
+		offset += archetype->capacity * componentInfos[type].size;
+	}
+
+	Archetype* result = archetype.get();
+	archetypeByMask[mask] = std::move(archetype);
+	archetypeList.push_back(result);
+	return result;
+}
+
+void EntityWorld::place(Entity entity, Archetype* archetype)
+{
+	if (archetype->chunks.empty() || archetype->chunks.back().count == archetype->capacity)
+	{
+		if (!spareChunks.empty())
+		{
+			archetype->chunks.push_back(std::move(spareChunks.back()));
+			spareChunks.pop_back();
+		}
+		else
+		{
+			EntityChunk chunk;
+			chunk.memory.reset(new unsigned char[ENTITY_CHUNK_SIZE + COLUMN_ALIGNMENT]);
+			uintptr_t address = (uintptr_t)chunk.memory.get();
+			chunk.data = (unsigned char*)((address + COLUMN_ALIGNMENT - 1) & ~(uintptr_t)(COLUMN_ALIGNMENT - 1));
+			chunk.count = 0;
+			archetype->chunks.push_back(std::move(chunk));
+		}
+	}
+	EntityChunk& chunk = archetype->chunks.back();
+	EntityRecord& record = records[entity.index];
+	record.archetype = archetype;
+	record.chunk = (unsigned int)archetype->chunks.size() - 1;
+	record.row = chunk.count++;
+	archetype->entities(chunk)[record.row] = entity;
+}
+
+void EntityWorld::unplace(const EntityRecord& record)
+{
+	Archetype& archetype = *record.archetype;
+	EntityChunk& last = archetype.chunks.back();
+	unsigned int lastRow = last.count - 1;
+	if (record.chunk != archetype.chunks.size() - 1 || record.row != lastRow)
+	{
+		EntityChunk& chunk = archetype.chunks[record.chunk];
+		Entity moved = archetype.entities(last)[lastRow];
+		archetype.entities(chunk)[record.row] = moved;
+		for (unsigned int type : archetype.types)
+		{
+			unsigned int size = componentInfos[type].size;
+			memcpy(chunk.data + archetype.offsets[type] + record.row * size,
+				last.data + archetype.offsets[type] + lastRow * size, size);
+		}
+		records[moved.index].chunk = record.chunk;
+		records[moved.index].row = record.row;
+	}
+	if (--last.count == 0)
+	{
+		spareChunks.push_back(std::move(last));
+		archetype.chunks.pop_back();
+	}
+}
+
+void EntityWorld::move(Entity entity, Archetype* target)
+{
+	EntityRecord from = records[entity.index];
+	place(entity, target);
+	const EntityRecord& to = records[entity.index];
+	const EntityChunk& source = from.archetype->chunks[from.chunk];
+	const EntityChunk& destination = target->chunks[to.chunk];
+	for (unsigned int type : target->types)
+	{
+		if (!(from.archetype->mask & (ComponentMask(1) << type)))
+			continue;
+		unsigned int size = componentInfos[type].size;
+		memcpy(destination.data + target->offsets[type] + to.row * size,
+			source.data + from.archetype->offsets[type] + from.row * size, size);
+	}
+	unplace(from);
+}
+
+Entity EntityWorld::createZeroed(ComponentMask mask)
+{
+	Entity entity;
+	if (!freeIndices.empty())
+	{
+		entity.index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	else
+	{
+		entity.index = (unsigned int)records.size();
+		records.push_back(EntityRecord{ nullptr, 0, 0, 0 });
+	}
+	entity.generation = records[entity.index].generation;
+	Archetype* archetype = archetypeFor(mask);
+	place(entity, archetype);
+	const EntityRecord& record = records[entity.index];
+	EntityChunk& chunk = archetype->chunks[record.chunk];
+	for (unsigned int type : archetype->types)
+	{
+		unsigned int size = componentInfos[type].size;
+		memset(chunk.data + archetype->offsets[type] + record.row * size, 0, size);
+	}
+	live++;
+	return entity;
+}
+
+bool EntityWorld::alive(Entity entity) const
+{
+	return entity.index < records.size() && records[entity.index].archetype &&
+		records[entity.index].generation == entity.generation;
+}
+
+void EntityWorld::destroy(Entity entity)
+{
+	if (!alive(entity))
+		return;
+	EntityRecord& record = records[entity.index];
+	unplace(record);
+	record.archetype = nullptr;
+	record.generation++;
+	freeIndices.push_back(entity.index);
+	live--;
+}
+
+void* EntityWorld::component(Entity entity, unsigned int type) const
+{
+	if (!alive(entity))
+		return nullptr;
+	const EntityRecord& record = records[entity.index];
+	if (!(record.archetype->mask & (ComponentMask(1) << type)))
+		return nullptr;
+	return record.archetype->chunks[record.chunk].data + record.archetype->offsets[type] + record.row * componentInfos[type].size;
+}
+
+void* EntityWorld::addComponent(Entity entity, unsigned int type)
+{
+	void* existing = component(entity, type);
+	if (existing || !alive(entity))
+		return existing;
+	Archetype* source = records[entity.index].archetype;
+	Archetype* target = source->addEdges[type];
+	if (!target)
+	{
+		target = archetypeFor(source->mask | (ComponentMask(1) << type));
+		source->addEdges[type] = target;
+		target->removeEdges[type] = source;
+	}
+	move(entity, target);
+	return component(entity, type);
+}
+
+void EntityWorld::removeComponent(Entity entity, unsigned int type)
+{
+	if (!component(entity, type))
+		return;
+	Archetype* source = records[entity.index].archetype;
+	Archetype* target = source->removeEdges[type];
+	if (!target)
+	{
+		target = archetypeFor(source->mask & ~(ComponentMask(1) << type));
+		source->removeEdges[type] = target;
+		target->addEdges[type] = source;
+	}
+	move(entity, target);
+}
+
+void EntityCommands::append(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+void EntityCommands::destroy(Entity entity)
+{
+	CommandHeader header = { COMMAND_DESTROY, 0, 0, 0, entity, 0 };
+	std::lock_guard<std::mutex> guard(lock);
+	append(&header, sizeof(header));
+}
+
+unsigned int EntityCommands::playback(EntityWorld& world)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	unsigned int applied = 0;
+	size_t at = 0;
+	while (at < buffer.size())
+	{
+		CommandHeader header;
+		memcpy(&header, &buffer[at], sizeof(header));
+		at += sizeof(header);
+		const unsigned char* payload = buffer.data() + at;
+		switch (header.operation)
+		{
+		case COMMAND_CREATE:
+		{
+			Entity entity = world.createZeroed(header.mask);
+			for (uint32_t i = 0; i < header.count; i++)
+			{
+				ComponentHeader component;
+				memcpy(&component, payload, sizeof(component));
+				payload += sizeof(component);
+				memcpy(world.component(entity, component.type), payload, component.size);
+				payload += component.size;
+			}
+			applied++;
+			break;
+		}
+		case COMMAND_DESTROY:
+			if (world.alive(header.entity))
+			{
+				world.destroy(header.entity);
+				applied++;
+			}
+			break;
+		case COMMAND_ADD:
+		{
+			void* slot = world.addComponent(header.entity, header.type);
+			if (slot)
+			{
+				memcpy(slot, payload, header.size);
+				applied++;
+			}
+			break;
+		}
+		case COMMAND_REMOVE:
+			if (world.alive(header.entity))
+			{
+				world.removeComponent(header.entity, header.type);
+				applied++;
+			}
+			break;
+		}
+		at += header.size;
+	}
+	// keeps the capacity, so recording the next frame's commands doesn't allocate
+	buffer.clear();
+	return applied;
+}
+
+SystemSchedule::SystemSchedule() : phaseCount(0), world(nullptr), jobs(nullptr)
+{
+}
+
+void SystemSchedule::add(const char* name, ComponentMask reads, ComponentMask writes, SystemFunction function)
+{
+	// after the last earlier system it conflicts with, so conflicting systems keep the
+	// order they were added in
+	unsigned int phase = 0;
+	for (const System& earlier : systems)
+	{
+		bool conflict = (writes & (earlier.reads | earlier.writes)) || (reads & earlier.writes);
+		if (conflict)
+			phase = std::max(phase, earlier.phase + 1);
+	}
+	systems.push_back(System{ name, reads, writes, function, phase });
+	phaseCount = std::max(phaseCount, phase + 1);
+}
+
+void SystemSchedule::runSystem(void* schedule, unsigned int index, unsigned int)
+{
+	SystemSchedule& self = *(SystemSchedule*)schedule;
+	self.systems[index].function(*self.world, *self.jobs, self.commands);
+}
+
+void SystemSchedule::run(EntityWorld& world, JobSystem& jobs)
+{
+	this->world = &world;
+	this->jobs = &jobs;
+	for (unsigned int phase = 0; phase < phaseCount; phase++)
+	{
+		JobCounter counter;
+		for (unsigned int i = 0; i < systems.size(); i++)
+			if (systems[i].phase == phase)
+				jobs.run(runSystem, this, &counter, i, i + 1);
+		jobs.wait(counter);
+	}
+	commands.playback(world);
+}
+
+void SystemSchedule::print() const
+{
+	for (const System& system : systems)
+		std::cout << "ECS::system " << system.name << " phase " << system.phase << " of " << phaseCount << std::endl;
+}
@@ -0,0 +1,421 @@
+#ifndef ECS_H
+#define ECS_H
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "jobsystem.h"
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#	include <xmmintrin.h>
+#endif
+
+// Entity-component-system with archetype storage. Every distinct set of component types
+// is an archetype, whose entities live in 16KB chunks: within a chunk each component type
+// is one array (SoA) and the entity handles another, so a query walks the chunks of the
+// matching archetypes and hands out plain arrays, with no per-entity lookups. Rows stay
+// packed: removing an entity moves the last one of its archetype into the hole.
+// Components are plain data (trivially copyable), moved between chunks with memcpy.
+// Structural changes (create, destroy, add, remove) happen on one thread, outside of
+// queries; systems running on the job system record them in EntityCommands instead.
+
+// bytes of component and entity storage per chunk
+const unsigned int ENTITY_CHUNK_SIZE = 16384;
+// component types a program can use, one bit of a ComponentMask each
+const unsigned int MAX_COMPONENT_TYPES = 64;
+
+typedef uint64_t ComponentMask;
+
+// index into the world's entity table, and how many entities used that index before;
+// a handle of a destroyed entity stays invalid when the index is reused
+struct Entity {
+	uint32_t index, generation;
+
+	bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+// size and alignment of a component type
+struct ComponentInfo {
+	unsigned int size, alignment;
+};
+
+// the next free component type id; use componentType<T>() instead
+unsigned int registerComponentType(unsigned int size, unsigned int alignment);
+const ComponentInfo& componentInfo(unsigned int type);
+
+// the id of component type T, registered on first use
+template<typename T>
+unsigned int registeredComponentType()
+{
+	static_assert(std::is_trivially_copyable<T>::value, "components are moved between chunks with memcpy");
+	static_assert(alignof(T) <= 64, "chunk columns are 64-byte aligned");
+	static const unsigned int type = registerComponentType(sizeof(T), alignof(T));
+	return type;
+}
+
+// the id of component type T; const T is the same type
+template<typename T>
+unsigned int componentType()
+{
+	return registeredComponentType<typename std::remove_const<T>::type>();
+}
+
+template<typename... Ts>
+ComponentMask componentMask()
+{
+	ComponentMask bits[] = { 0, (ComponentMask(1) << componentType<Ts>())... };
+	ComponentMask mask = 0;
+	for (ComponentMask bit : bits)
+		mask |= bit;
+	return mask;
+}
+
+// ENTITY_CHUNK_SIZE bytes of an archetype: the entity column first, then one column per
+// component type, each 64-byte aligned
+struct EntityChunk {
+	unsigned char* data;
+	unsigned int count;
+	std::unique_ptr<unsigned char[]> memory;
+};
+
+// the storage of one set of component types
+struct Archetype {
+	ComponentMask mask;
+	// entities per chunk
+	unsigned int capacity;
+	// all full except the last
+	std::vector<EntityChunk> chunks;
+	// byte offset of every component type's column in a chunk, 0 when it has none (the
+	// entity column is at 0)
+	unsigned int offsets[MAX_COMPONENT_TYPES];
+	// the component types, in id order
+	std::vector<unsigned int> types;
+	// archetypes one component type more and less, filled in as entities move
+	Archetype* addEdges[MAX_COMPONENT_TYPES];
+	Archetype* removeEdges[MAX_COMPONENT_TYPES];
+
+	Entity* entities(const EntityChunk& chunk) const { return (Entity*)chunk.data; }
+	template<typename T>
+	T* column(const EntityChunk& chunk) const { return (T*)(chunk.data + offsets[componentType<T>()]); }
+};
+
+class EntityWorld {
+
+public:
+	EntityWorld();
+	~EntityWorld();
+
+	// an entity with the given components
+	template<typename... Ts>
+	Entity create(const Ts&... components);
+	// an entity with the component types of mask, zero filled
+	Entity createZeroed(ComponentMask mask);
+	void destroy(Entity entity);
+	bool alive(Entity entity) const;
+
+	// adds component T to entity, or overwrites it if it has one
+	template<typename T>
+	void add(Entity entity, const T& component);
+	template<typename T>
+	void remove(Entity entity);
+	// component T of entity, nullptr if it has none; valid until the next structural change
+	template<typename T>
+	T* get(Entity entity) const { return (T*)component(entity, componentType<T>()); }
+	template<typename T>
+	bool has(Entity entity) const { return component(entity, componentType<T>()) != nullptr; }
+
+	// live entities, and archetypes made so far
+	unsigned int size() const { return live; }
+	unsigned int archetypes() const { return (unsigned int)archetypeList.size(); }
+
+	// f(count, entities, Ts* columns...) for every chunk holding all of Ts; declaring a type
+	// const documents that f only reads it
+	template<typename... Ts, typename F>
+	void eachChunk(F f) const;
+	// f(Ts&... components) for every entity holding all of Ts
+	template<typename... Ts, typename F>
+	void each(F f) const;
+	// eachChunk with the chunks split over jobs, grain chunks at a time
+	template<typename... Ts, typename F>
+	void parallelEachChunk(JobSystem& jobs, F f, unsigned int grain = 4) const;
+	template<typename... Ts, typename F>
+	void parallelEach(JobSystem& jobs, F f, unsigned int grain = 4) const;
+
+	// the untyped forms of add/remove/get: add returns the (uninitialised) component
+	void* addComponent(Entity entity, unsigned int type);
+	void removeComponent(Entity entity, unsigned int type);
+	void* component(Entity entity, unsigned int type) const;
+
+private:
+	EntityWorld(const EntityWorld&);
+	EntityWorld& operator=(const EntityWorld&);
+
+	// where an entity's components are
+	struct EntityRecord {
+		Archetype* archetype;
+		unsigned int chunk, row;
+		uint32_t generation;
+	};
+	std::vector<EntityRecord> records;
+	std::vector<uint32_t> freeIndices;
+	unsigned int live;
+
+	std::unordered_map<ComponentMask, std::unique_ptr<Archetype>> archetypeByMask;
+	std::vector<Archetype*> archetypeList;
+	// chunks of emptied archetypes, handed out again before allocating
+	std::vector<EntityChunk> spareChunks;
+
+	Archetype* archetypeFor(ComponentMask mask);
+	// appends entity to archetype, its components uninitialised; its record points there
+	void place(Entity entity, Archetype* archetype);
+	// takes the row of record out of its archetype, filling the hole with the last row
+	void unplace(const EntityRecord& record);
+	// moves entity's components shared with the target archetype over
+	void move(Entity entity, Archetype* target);
+
+	template<typename... Ts>
+	static void prefetchChunk(const Archetype& archetype, const EntityChunk& chunk);
+	template<typename... Ts, typename F>
+	static void callChunk(const Archetype& archetype, const EntityChunk& chunk, F& f);
+};
+
+// Structural changes recorded by systems (from any thread) and applied later by
+// playback() on the thread owning the world, in the order they were recorded. Changes
+// to entities that are gone by then are skipped.
+class EntityCommands {
+
+public:
+	template<typename... Ts>
+	void create(const Ts&... components);
+	void destroy(Entity entity);
+	template<typename T>
+	void add(Entity entity, const T& component);
+	template<typename T>
+	void remove(Entity entity);
+
+	bool empty() const { return buffer.empty(); }
+	// commands applied
+	unsigned int playback(EntityWorld& world);
+
+private:
+	enum Operation { COMMAND_CREATE, COMMAND_DESTROY, COMMAND_ADD, COMMAND_REMOVE };
+	// followed by size bytes of component data (for create: count components, each a
+	// ComponentHeader and its data)
+	struct CommandHeader {
+		uint32_t operation, type, size, count;
+		Entity entity;
+		ComponentMask mask;
+	};
+	struct ComponentHeader {
+		uint32_t type, size;
+	};
+
+	std::mutex lock;
+	std::vector<unsigned char> buffer;
+
+	// under lock
+	void append(const void* data, size_t size);
+	template<typename T>
+	void appendComponent(const T& component);
+};
+
+// Systems run once per run() call, in the order they were added, except that systems
+// whose component access doesn't conflict (neither writes what the other reads or writes)
+// share a phase and run at the same time on the job system. Every system gets the
+// schedule's EntityCommands, played back after the last phase.
+class SystemSchedule {
+
+public:
+	typedef std::function<void(EntityWorld& world, JobSystem& jobs, EntityCommands& commands)> SystemFunction;
+
+	SystemSchedule();
+
+	// reads and writes: the component types the system accesses, from componentMask
+	void add(const char* name, ComponentMask reads, ComponentMask writes, SystemFunction function);
+	void run(EntityWorld& world, JobSystem& jobs);
+
+	unsigned int phases() const { return phaseCount; }
+	// phase of every system
+	void print() const;
+
+private:
+	struct System {
+		const char* name;
+		ComponentMask reads, writes;
+		SystemFunction function;
+		unsigned int phase;
+	};
+	std::vector<System> systems;
+	unsigned int phaseCount;
+	EntityCommands commands;
+
+	// what the running systems get
+	EntityWorld* world;
+	JobSystem* jobs;
+	static void runSystem(void* schedule, unsigned int index, unsigned int);
+};
+
+template<typename... Ts>
+Entity EntityWorld::create(const Ts&... components)
+{
+	Entity entity = createZeroed(componentMask<Ts...>());
+	int unused[] = { 0, (memcpy(component(entity, componentType<Ts>()), &components, sizeof(Ts)), 0)... };
+	(void)unused;
+	return entity;
+}
+
+template<typename T>
+void EntityWorld::add(Entity entity, const T& component)
+{
+	void* slot = addComponent(entity, componentType<T>());
+	if (slot)
+		memcpy(slot, &component, sizeof(T));
+}
+
+template<typename T>
+void EntityWorld::remove(Entity entity)
+{
+	removeComponent(entity, componentType<T>());
+}
+
+template<typename... Ts, typename F>
+void EntityWorld::callChunk(const Archetype& archetype, const EntityChunk& chunk, F& f)
+{
+	f(chunk.count, (const Entity*)archetype.entities(chunk), archetype.column<Ts>(chunk)...);
+}
+
+// starts loading the first two cache lines of address: the hardware prefetcher only follows
+// a stream after a few misses, and every chunk starts new ones
+inline void prefetchColumn(const void* address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_prefetch(address);
+	__builtin_prefetch((const char*)address + 64);
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	_mm_prefetch((const char*)address, _MM_HINT_T0);
+	_mm_prefetch((const char*)address + 64, _MM_HINT_T0);
+#endif
+}
+
+template<typename... Ts>
+void EntityWorld::prefetchChunk(const Archetype& archetype, const EntityChunk& chunk)
+{
+	int unused[] = { 0, (prefetchColumn(archetype.column<Ts>(chunk)), 0)... };
+	(void)unused;
+}
+
+template<typename... Ts, typename F>
+void EntityWorld::eachChunk(F f) const
+{
+	static_assert(sizeof...(Ts) > 0, "a query needs a component type");
+	ComponentMask mask = componentMask<Ts...>();
+	for (Archetype* archetype : archetypeList)
+	{
+		if ((archetype->mask & mask) != mask)
+			continue;
+		const std::vector<EntityChunk>& chunks = archetype->chunks;
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			if (i + 1 < chunks.size())
+				prefetchChunk<Ts...>(*archetype, chunks[i + 1]);
+			callChunk<Ts...>(*archetype, chunks[i], f);
+		}
+	}
+}
+
+template<typename... Ts, typename F>
+void EntityWorld::each(F f) const
+{
+	eachChunk<Ts...>([&f](unsigned int count, const Entity*, Ts*... columns) {
+		for (unsigned int i = 0; i < count; i++)
+			f(columns[i]...);
+	});
+}
+
+template<typename... Ts, typename F>
+void EntityWorld::parallelEachChunk(JobSystem& jobs, F f, unsigned int grain) const
+{
+	static_assert(sizeof...(Ts) > 0, "a query needs a component type");
+	ComponentMask mask = componentMask<Ts...>();
+	// the chunks of all matching archetypes numbered in a row; a range finds its first
+	// chunk by walking the (few) archetypes
+	unsigned int total = 0;
+	for (Archetype* archetype : archetypeList)
+		if ((archetype->mask & mask) == mask)
+			total += (unsigned int)archetype->chunks.size();
+	jobs.parallelFor(0, total, grain, [&](unsigned int first, unsigned int last) {
+		unsigned int base = 0;
+		for (Archetype* archetype : archetypeList)
+		{
+			if ((archetype->mask & mask) != mask)
+				continue;
+			unsigned int chunks = (unsigned int)archetype->chunks.size();
+			for (unsigned int i = first > base ? first - base : 0; i < chunks && base + i < last; i++)
+			{
+				if (i + 1 < chunks && base + i + 1 < last)
+					prefetchChunk<Ts...>(*archetype, archetype->chunks[i + 1]);
+				callChunk<Ts...>(*archetype, archetype->chunks[i], f);
+			}
+			base += chunks;
+			if (base >= last)
+				break;
+		}
+	});
+}
+
+template<typename... Ts, typename F>
+void EntityWorld::parallelEach(JobSystem& jobs, F f, unsigned int grain) const
+{
+	parallelEachChunk<Ts...>(jobs, [&f](unsigned int count, const Entity*, Ts*... columns) {
+		for (unsigned int i = 0; i < count; i++)
+			f(columns[i]...);
+	}, grain);
+}
+
+template<typename T>
+void EntityCommands::appendComponent(const T& component)
+{
+	ComponentHeader header = { componentType<T>(), (uint32_t)sizeof(T) };
+	append(&header, sizeof(header));
+	append(&component, sizeof(T));
+}
+
+template<typename... Ts>
+void EntityCommands::create(const Ts&... components)
+{
+	size_t sizes[] = { 0, (sizeof(ComponentHeader) + sizeof(Ts))... };
+	size_t size = 0;
+	for (size_t s : sizes)
+		size += s;
+	CommandHeader header = { COMMAND_CREATE, 0, (uint32_t)size, (uint32_t)sizeof...(Ts), Entity(), componentMask<Ts...>() };
+	std::lock_guard<std::mutex> guard(lock);
+	append(&header, sizeof(header));
+	int unused[] = { 0, (appendComponent(components), 0)... };
+	(void)unused;
+}
+
+template<typename T>
+void EntityCommands::add(Entity entity, const T& component)
+{
+	CommandHeader header = { COMMAND_ADD, componentType<T>(), (uint32_t)sizeof(T), 0, entity, 0 };
+	std::lock_guard<std::mutex> guard(lock);
+	append(&header, sizeof(header));
+	append(&component, sizeof(T));
+}
+
+template<typename T>
+void EntityCommands::remove(Entity entity)
+{
+	CommandHeader header = { COMMAND_REMOVE, componentType<T>(), 0, 0, entity, 0 };
+	std::lock_guard<std::mutex> guard(lock);
+	append(&header, sizeof(header));
+}
+
+#endif
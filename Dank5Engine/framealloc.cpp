@@ -0,0 +1,146 @@
+#include "framealloc.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+// alignment of the arena's block
+static const size_t ARENA_ALIGNMENT = 64;
+
+#if DANK5_ARENA_CHECKS
+static const size_t GUARD_BYTES = 16;
+static const unsigned char GUARD_PATTERN = 0xFD;
+static const unsigned char FREED_PATTERN = 0xCD;
+
+// in front of every allocation in checked builds, so rewind() can walk them
+struct AllocationHeader {
+	size_t size;
+	size_t data;
+};
+#endif
+
+static uintptr_t alignUp(uintptr_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(uintptr_t)(alignment - 1);
+}
+
+LinearArena::LinearArena(size_t capacity)
+	: memory(new unsigned char[capacity + ARENA_ALIGNMENT]), size(capacity), top(0), highWaterMark(0), overflowCount(0), overflowBlocks(nullptr)
+{
+	base = (unsigned char*)alignUp((uintptr_t)memory.get(), ARENA_ALIGNMENT);
+}
+
+LinearArena::~LinearArena()
+{
+	reset();
+}
+
+void* LinearArena::allocate(size_t bytes, size_t alignment)
+{
+	uintptr_t start = (uintptr_t)base;
+#if DANK5_ARENA_CHECKS
+	uintptr_t header = alignUp(start + top, alignof(AllocationHeader));
+	uintptr_t data = alignUp(header + sizeof(AllocationHeader), alignment);
+	uintptr_t end = data + bytes + GUARD_BYTES;
+#else
+	uintptr_t data = alignUp(start + top, alignment);
+	uintptr_t end = data + bytes;
+#endif
+	if (end > start + size)
+		return overflow(bytes, alignment);
+#if DANK5_ARENA_CHECKS
+	AllocationHeader h = { bytes, data - start };
+	memcpy((void*)header, &h, sizeof(h));
+	memset((void*)(data + bytes), GUARD_PATTERN, GUARD_BYTES);
+#endif
+	top = end - start;
+	return (void*)data;
+}
+
+void* LinearArena::overflow(size_t bytes, size_t alignment)
+{
+#if DANK5_ARENA_CHECKS
+	if (overflowCount == 0)
+		std::cout << "ERROR::ARENA::OVERFLOW " << bytes << " bytes with " << top << " of " << size << " in use, falling back to the heap" << std::endl;
+#endif
+	overflowCount++;
+	// the link to the next block, then the allocation
+	size_t link = alignUp(sizeof(void*), alignment);
+	unsigned char* block = new unsigned char[link + bytes + alignment];
+	*(void**)block = overflowBlocks;
+	overflowBlocks = block;
+	return (void*)alignUp((uintptr_t)block + link, alignment);
+}
+
+#if DANK5_ARENA_CHECKS
+void LinearArena::check(size_t from) const
+{
+	uintptr_t start = (uintptr_t)base;
+	uintptr_t header = alignUp(start + from, alignof(AllocationHeader));
+	while (header < start + top)
+	{
+		AllocationHeader h;
+		memcpy(&h, (const void*)header, sizeof(h));
+		const unsigned char* guard = base + h.data + h.size;
+		for (size_t i = 0; i < GUARD_BYTES; i++)
+			if (guard[i] != GUARD_PATTERN)
+			{
+				std::cout << "ERROR::ARENA::WRITE_PAST_END of the " << h.size << " byte allocation at offset " << h.data << std::endl;
+				break;
+			}
+		header = alignUp((uintptr_t)guard + GUARD_BYTES, alignof(AllocationHeader));
+	}
+}
+#endif
+
+void LinearArena::rewind(const ArenaMark& mark)
+{
+	if (top > highWaterMark)
+		highWaterMark = top;
+#if DANK5_ARENA_CHECKS
+	check(mark.top);
+	memset(base + mark.top, FREED_PATTERN, top - mark.top);
+#endif
+	top = mark.top;
+	while (overflowBlocks != mark.overflow)
+	{
+		unsigned char* block = (unsigned char*)overflowBlocks;
+		overflowBlocks = *(void**)block;
+		delete[] block;
+	}
+}
+
+void LinearArena::print(const char* name) const
+{
+	std::cout << "ARENA::" << name << " " << used() << " bytes in use, high water " << highWater()
+		<< " of " << capacity() << ", " << overflows() << " overflows" << std::endl;
+}
+
+FrameAllocator::FrameAllocator(size_t capacity) : arenas{ { capacity }, { capacity } }, index(0), frameCount(0)
+{
+}
+
+void FrameAllocator::beginFrame()
+{
+	index ^= 1;
+	arenas[index].reset();
+	frameCount++;
+}
+
+void FrameAllocator::print() const
+{
+	arenas[0].print("frame0");
+	arenas[1].print("frame1");
+}
+
+FrameAllocator& frameAllocator()
+{
+	static FrameAllocator allocator;
+	return allocator;
+}
+
+LinearArena& threadScratch()
+{
+	static thread_local LinearArena scratch(SCRATCH_ARENA_SIZE);
+	return scratch;
+}
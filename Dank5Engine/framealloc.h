@@ -0,0 +1,164 @@
+#ifndef FRAMEALLOC_H
+#define FRAMEALLOC_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Linear allocators for memory that lives for a frame or less, so steady-state frames
+// don't touch the general heap:
+//  - FrameAllocator: two arenas swapped by beginFrame(), so a frame's allocations stay
+//    valid through the next frame (for work that reads the previous frame's results)
+//    and are dropped all at once after that
+//  - threadScratch(): a per-thread stack for temporaries inside a function or a job,
+//    rewound by ScratchScope; JobSystem workers allocate theirs when they start
+//  - ArenaAllocator/ArenaVector: std containers backed by an arena
+// Freeing single allocations is a no-op; memory comes back when the arena is reset or
+// rewound. An allocation that doesn't fit falls back to the heap until then (counted in
+// overflows(), and reported in checked builds).
+
+// checked builds put guard bytes after every allocation, verify them when the arena
+// rewinds and fill the freed memory with 0xCD; on by default in debug builds
+#ifndef DANK5_ARENA_CHECKS
+#	ifdef NDEBUG
+#		define DANK5_ARENA_CHECKS 0
+#	else
+#		define DANK5_ARENA_CHECKS 1
+#	endif
+#endif
+
+// each of the two frame arenas
+const size_t FRAME_ARENA_SIZE = 4 * 1024 * 1024;
+// each thread's scratch stack
+const size_t SCRATCH_ARENA_SIZE = 256 * 1024;
+
+// a position to rewind an arena to
+struct ArenaMark {
+	size_t top;
+	void* overflow;
+};
+
+// Bump allocator over one fixed block. Not thread safe: one thread allocates from an
+// arena at a time.
+class LinearArena {
+
+public:
+	LinearArena(size_t capacity);
+	~LinearArena();
+
+	// alignment is a power of two
+	void* allocate(size_t size, size_t alignment = 16);
+	// uninitialized storage for count Ts
+	template<typename T>
+	T* allocate(size_t count) { return (T*)allocate(count * sizeof(T), alignof(T)); }
+
+	ArenaMark mark() const { return ArenaMark{ top, overflowBlocks }; }
+	// frees everything allocated since the mark
+	void rewind(const ArenaMark& mark);
+	// frees everything
+	void reset() { rewind(ArenaMark{ 0, nullptr }); }
+
+	size_t used() const { return top; }
+	size_t capacity() const { return size; }
+	// most bytes in use at once since construction
+	size_t highWater() const { return top > highWaterMark ? top : highWaterMark; }
+	// allocations that didn't fit and went to the heap
+	unsigned int overflows() const { return overflowCount; }
+	void print(const char* name) const;
+
+private:
+	LinearArena(const LinearArena&);
+	LinearArena& operator=(const LinearArena&);
+
+	void* overflow(size_t bytes, size_t alignment);
+#if DANK5_ARENA_CHECKS
+	void check(size_t from) const;
+#endif
+
+	std::unique_ptr<unsigned char[]> memory;
+	unsigned char* base;
+	size_t size;
+	size_t top;
+	size_t highWaterMark;
+	unsigned int overflowCount;
+	// heap blocks of allocations that didn't fit, newest first
+	void* overflowBlocks;
+};
+
+// The frame's arena and the previous frame's. Call beginFrame() once at the top of every
+// frame from the thread that runs the frame; allocate from that thread, or before handing
+// the memory to jobs.
+class FrameAllocator {
+
+public:
+	FrameAllocator(size_t capacity = FRAME_ARENA_SIZE);
+
+	// makes the arena of two frames ago current and resets it
+	void beginFrame();
+
+	void* allocate(size_t size, size_t alignment = 16) { return arenas[index].allocate(size, alignment); }
+	template<typename T>
+	T* allocate(size_t count) { return arenas[index].allocate<T>(count); }
+
+	LinearArena& current() { return arenas[index]; }
+	LinearArena& previous() { return arenas[index ^ 1]; }
+	unsigned long long frame() const { return frameCount; }
+	void print() const;
+
+private:
+	FrameAllocator(const FrameAllocator&);
+	FrameAllocator& operator=(const FrameAllocator&);
+
+	LinearArena arenas[2];
+	unsigned int index;
+	unsigned long long frameCount;
+};
+
+// the engine's frame allocator
+FrameAllocator& frameAllocator();
+// the calling thread's scratch stack, allocated on first use
+LinearArena& threadScratch();
+
+// rewinds an arena (the thread's scratch by default) to where it was on construction
+class ScratchScope {
+
+public:
+	ScratchScope(LinearArena& arena = threadScratch()) : arena(arena), start(arena.mark()) {}
+	~ScratchScope() { arena.rewind(start); }
+
+	LinearArena& arena;
+
+private:
+	ScratchScope(const ScratchScope&);
+	ScratchScope& operator=(const ScratchScope&);
+
+	ArenaMark start;
+};
+
+// std allocator over an arena; deallocate is a no-op, so reserve() containers that grow
+// to keep their old storage from piling up until the reset
+template<typename T>
+class ArenaAllocator {
+
+public:
+	typedef T value_type;
+
+	ArenaAllocator(LinearArena& arena) : arena(&arena) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t count) { return arena->allocate<T>(count); }
+	void deallocate(T*, size_t) {}
+
+	LinearArena* arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena == b.arena; }
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena != b.arena; }
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif
@@ -0,0 +1,90 @@
+#include "frameconstants.h"
+#include "glstate.h"
+
+#include <cstring>
+
+FrameUniformBuffer::FrameUniformBuffer(unsigned int frames) : UBO(0), Frames(frames), current(0), mapped(nullptr), stallCount(0)
+{
+	if (Frames < 1)
+		Frames = 1;
+	if (Frames > MAX_FRAMES)
+		Frames = MAX_FRAMES;
+	for (unsigned int i = 0; i < MAX_FRAMES; i++)
+		fences[i] = 0;
+
+	// every range has to start on the driver's uniform buffer offset alignment
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	stride = ((GLsizeiptr)sizeof(FrameConstants) + alignment - 1) / alignment * alignment;
+
+	glGenBuffers(1, &UBO);
+	glState().bindBuffer(GL_UNIFORM_BUFFER, UBO);
+	if (GLAD_GL_VERSION_4_4)
+	{
+		// immutable storage mapped once for the lifetime of the buffer
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_UNIFORM_BUFFER, stride * Frames, NULL, flags);
+		mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, stride * Frames, flags);
+	}
+	else
+	{
+		glBufferData(GL_UNIFORM_BUFFER, stride * Frames, NULL, GL_DYNAMIC_DRAW);
+	}
+	// start on the last range so the first update() lands on range 0
+	current = Frames - 1;
+}
+
+void FrameUniformBuffer::update(const FrameConstants& constants)
+{
+	// everything submitted since the last update read the current range
+	if (fences[current])
+		glDeleteSync(fences[current]);
+	fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	current = (current + 1) % Frames;
+	GLintptr offset = stride * current;
+
+	// wait until the GPU is done with the frame that last used this range
+	if (fences[current])
+	{
+		GLenum status = glClientWaitSync(fences[current], 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+		{
+			stallCount++;
+			while (glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+				;
+		}
+		glDeleteSync(fences[current]);
+		fences[current] = 0;
+	}
+
+	if (mapped)
+	{
+		std::memcpy(mapped + offset, &constants, sizeof(FrameConstants));
+	}
+	else
+	{
+		glState().bindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(FrameConstants), &constants);
+	}
+	glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, UBO, offset, sizeof(FrameConstants));
+	glState().boundBufferRange(GL_UNIFORM_BUFFER, UBO);
+}
+
+void FrameUniformBuffer::destroy()
+{
+	for (unsigned int i = 0; i < MAX_FRAMES; i++)
+	{
+		if (fences[i])
+			glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+	if (mapped)
+	{
+		glState().bindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+		mapped = nullptr;
+	}
+	glState().deleteBuffers(1, &UBO);
+	UBO = 0;
+}
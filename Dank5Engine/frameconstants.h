@@ -0,0 +1,52 @@
+#ifndef FRAMECONSTANTS_H
+#define FRAMECONSTANTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// uniform buffer binding point of the FrameConstants block; Shader binds the block
+// of every program it links to this point
+const unsigned int FRAME_CONSTANTS_BINDING = 0;
+
+// Per-frame constants shared by all programs. Matches the std140 block
+//	layout (std140) uniform FrameConstants { mat4 view; mat4 projection; mat4 viewProjection; vec4 cameraPosition; };
+// (only mat4/vec4 members, so the C++ layout is the std140 layout)
+struct FrameConstants {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	// xyz camera position, w time in seconds
+	glm::vec4 cameraPosition;
+};
+
+// Ring of FrameConstants ranges in one uniform buffer. Each frame writes the next range
+// and binds it at FRAME_CONSTANTS_BINDING; a fence per range keeps the CPU from
+// overwriting constants the GPU is still reading, so with 2-3 ranges it never stalls.
+class FrameUniformBuffer {
+
+public:
+	unsigned int UBO;
+	// number of ranges in the ring (2 = double, 3 = triple buffered)
+	unsigned int Frames;
+
+	FrameUniformBuffer(unsigned int frames = 3);
+
+	// write this frame's constants and bind them; call once per frame before drawing
+	void update(const FrameConstants& constants);
+	// how often update() had to wait for the GPU to release a range
+	unsigned int stalls() const { return stallCount; }
+	// delete the buffer and fences
+	void destroy();
+
+private:
+	static const unsigned int MAX_FRAMES = 4;
+
+	GLsizeiptr stride;
+	unsigned int current;
+	// persistently mapped storage, null when falling back to glBufferSubData
+	unsigned char* mapped;
+	GLsync fences[MAX_FRAMES];
+	unsigned int stallCount;
+};
+
+#endif
@@ -0,0 +1,331 @@
+#include "glstate.h"
+
+#include <cstring>
+#include <iostream>
+
+unsigned int GLStateCache::Stats::totalIssued() const
+{
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < KIND_COUNT; i++)
+		total += issued[i];
+	return total;
+}
+
+unsigned int GLStateCache::Stats::totalSkipped() const
+{
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < KIND_COUNT; i++)
+		total += skipped[i];
+	return total;
+}
+
+GLStateCache::GLStateCache()
+{
+	std::memset(&stats, 0, sizeof(stats));
+	invalidate();
+}
+
+void GLStateCache::invalidate()
+{
+	currentProgram = UNKNOWN;
+	currentVAO = UNKNOWN;
+	for (unsigned int i = 0; i < BUFFER_SLOT_COUNT; i++)
+		buffers[i] = UNKNOWN;
+	activeUnit = UNKNOWN;
+	for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		textureTargets[i] = 0;
+		textures[i] = UNKNOWN;
+	}
+	framebuffer = UNKNOWN;
+	viewport[0] = viewport[1] = viewport[2] = viewport[3] = -1;
+	depthTest = depthWrite = blend = cullFace = UNKNOWN_FLAG;
+	depthFunc = blendSrc = blendDst = 0;
+}
+
+bool GLStateCache::skip(Kind kind, bool same)
+{
+	if (same)
+		stats.skipped[kind]++;
+	else
+		stats.issued[kind]++;
+	return same;
+}
+
+int GLStateCache::bufferSlot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: return ARRAY_BUFFER;
+	case GL_UNIFORM_BUFFER: return UNIFORM_BUFFER;
+	case GL_SHADER_STORAGE_BUFFER: return SHADER_STORAGE_BUFFER;
+	case GL_DRAW_INDIRECT_BUFFER: return DRAW_INDIRECT_BUFFER;
+	case GL_PIXEL_UNPACK_BUFFER: return PIXEL_UNPACK_BUFFER;
+	case GL_COPY_READ_BUFFER: return COPY_READ_BUFFER;
+	case GL_COPY_WRITE_BUFFER: return COPY_WRITE_BUFFER;
+	default: return -1;
+	}
+}
+
+void GLStateCache::useProgram(unsigned int program)
+{
+	if (skip(PROGRAM, currentProgram == program))
+		return;
+	glUseProgram(program);
+	currentProgram = program;
+}
+
+void GLStateCache::bindVertexArray(unsigned int vao)
+{
+	if (skip(VERTEX_ARRAY, currentVAO == vao))
+		return;
+	glBindVertexArray(vao);
+	currentVAO = vao;
+}
+
+void GLStateCache::bindBuffer(GLenum target, unsigned int buffer)
+{
+	int slot = bufferSlot(target);
+	if (skip(BUFFER, slot >= 0 && buffers[slot] == buffer))
+		return;
+	glBindBuffer(target, buffer);
+	if (slot >= 0)
+		buffers[slot] = buffer;
+}
+
+void GLStateCache::boundBufferRange(GLenum target, unsigned int buffer)
+{
+	int slot = bufferSlot(target);
+	if (slot >= 0)
+		buffers[slot] = buffer;
+}
+
+void GLStateCache::bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+{
+	if (unit >= MAX_TEXTURE_UNITS)
+	{
+		// not tracked, pass straight through
+		stats.issued[TEXTURE] += 2;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		activeUnit = unit;
+		return;
+	}
+	if (skip(TEXTURE, textures[unit] == texture && textureTargets[unit] == target))
+		return;
+	if (!skip(TEXTURE, activeUnit == unit))
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+	}
+	glBindTexture(target, texture);
+	textureTargets[unit] = target;
+	textures[unit] = texture;
+}
+
+void GLStateCache::bindFramebuffer(unsigned int fbo)
+{
+	if (skip(FRAMEBUFFER, framebuffer == fbo))
+		return;
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	framebuffer = fbo;
+}
+
+void GLStateCache::setViewport(int x, int y, int width, int height)
+{
+	if (skip(RASTER, viewport[0] == x && viewport[1] == y && viewport[2] == width && viewport[3] == height))
+		return;
+	glViewport(x, y, width, height);
+	viewport[0] = x;
+	viewport[1] = y;
+	viewport[2] = width;
+	viewport[3] = height;
+}
+
+void GLStateCache::setDepthTest(bool enabled)
+{
+	if (skip(RASTER, depthTest == (signed char)enabled))
+		return;
+	if (enabled)
+		glEnable(GL_DEPTH_TEST);
+	else
+		glDisable(GL_DEPTH_TEST);
+	depthTest = enabled;
+}
+
+void GLStateCache::setDepthWrite(bool enabled)
+{
+	if (skip(RASTER, depthWrite == (signed char)enabled))
+		return;
+	glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+	depthWrite = enabled;
+}
+
+void GLStateCache::setDepthFunc(GLenum func)
+{
+	if (skip(RASTER, depthFunc == func))
+		return;
+	glDepthFunc(func);
+	depthFunc = func;
+}
+
+void GLStateCache::setBlend(bool enabled)
+{
+	if (skip(RASTER, blend == (signed char)enabled))
+		return;
+	if (enabled)
+		glEnable(GL_BLEND);
+	else
+		glDisable(GL_BLEND);
+	blend = enabled;
+}
+
+void GLStateCache::setBlendFunc(GLenum src, GLenum dst)
+{
+	if (skip(RASTER, blendSrc == src && blendDst == dst))
+		return;
+	glBlendFunc(src, dst);
+	blendSrc = src;
+	blendDst = dst;
+}
+
+void GLStateCache::setCullFace(bool enabled)
+{
+	if (skip(RASTER, cullFace == (signed char)enabled))
+		return;
+	if (enabled)
+		glEnable(GL_CULL_FACE);
+	else
+		glDisable(GL_CULL_FACE);
+	cullFace = enabled;
+}
+
+// GL unbinds a deleted object from the current context, the cache must follow
+void GLStateCache::deleteProgram(unsigned int program)
+{
+	// a program in use stays current until another one is used, so only the name goes
+	if (currentProgram == program)
+		currentProgram = UNKNOWN;
+	glDeleteProgram(program);
+}
+
+void GLStateCache::deleteVertexArrays(int count, const unsigned int* vaos)
+{
+	for (int i = 0; i < count; i++)
+		if (currentVAO == vaos[i])
+			currentVAO = 0;
+	glDeleteVertexArrays(count, vaos);
+}
+
+void GLStateCache::deleteBuffers(int count, const unsigned int* ids)
+{
+	for (int i = 0; i < count; i++)
+		for (unsigned int slot = 0; slot < BUFFER_SLOT_COUNT; slot++)
+			if (buffers[slot] == ids[i])
+				buffers[slot] = 0;
+	glDeleteBuffers(count, ids);
+}
+
+void GLStateCache::deleteTextures(int count, const unsigned int* ids)
+{
+	for (int i = 0; i < count; i++)
+		for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+			if (textures[unit] == ids[i])
+				textures[unit] = 0;
+	glDeleteTextures(count, ids);
+}
+
+GLStateCache::Stats GLStateCache::endFrame()
+{
+	Stats frame = stats;
+	std::memset(&stats, 0, sizeof(stats));
+	return frame;
+}
+
+unsigned int GLStateCache::validate() const
+{
+	unsigned int mismatches = 0;
+	GLint value;
+	// unknown entries can't be wrong
+	if (currentProgram != UNKNOWN)
+	{
+		glGetIntegerv(GL_CURRENT_PROGRAM, &value);
+		if ((unsigned int)value != currentProgram)
+		{
+			std::cout << "ERROR::GLSTATE::PROGRAM cached " << currentProgram << " actual " << value << std::endl;
+			mismatches++;
+		}
+	}
+	if (currentVAO != UNKNOWN)
+	{
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &value);
+		if ((unsigned int)value != currentVAO)
+		{
+			std::cout << "ERROR::GLSTATE::VERTEX_ARRAY cached " << currentVAO << " actual " << value << std::endl;
+			mismatches++;
+		}
+	}
+	const GLenum bufferQueries[BUFFER_SLOT_COUNT] = {
+		GL_ARRAY_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING, GL_SHADER_STORAGE_BUFFER_BINDING,
+		GL_DRAW_INDIRECT_BUFFER_BINDING, GL_PIXEL_UNPACK_BUFFER_BINDING,
+		GL_COPY_READ_BUFFER_BINDING, GL_COPY_WRITE_BUFFER_BINDING
+	};
+	for (unsigned int slot = 0; slot < BUFFER_SLOT_COUNT; slot++)
+	{
+		if (buffers[slot] == UNKNOWN)
+			continue;
+		glGetIntegerv(bufferQueries[slot], &value);
+		if ((unsigned int)value != buffers[slot])
+		{
+			std::cout << "ERROR::GLSTATE::BUFFER slot " << slot << " cached " << buffers[slot] << " actual " << value << std::endl;
+			mismatches++;
+		}
+	}
+	if (framebuffer != UNKNOWN)
+	{
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &value);
+		if ((unsigned int)value != framebuffer)
+		{
+			std::cout << "ERROR::GLSTATE::FRAMEBUFFER cached " << framebuffer << " actual " << value << std::endl;
+			mismatches++;
+		}
+	}
+	if (depthTest != UNKNOWN_FLAG && (glIsEnabled(GL_DEPTH_TEST) == GL_TRUE) != (depthTest == 1))
+	{
+		std::cout << "ERROR::GLSTATE::DEPTH_TEST" << std::endl;
+		mismatches++;
+	}
+	if (blend != UNKNOWN_FLAG && (glIsEnabled(GL_BLEND) == GL_TRUE) != (blend == 1))
+	{
+		std::cout << "ERROR::GLSTATE::BLEND" << std::endl;
+		mismatches++;
+	}
+	// texture units: query each tracked unit, then restore the active unit
+	GLint active;
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+	if (activeUnit != UNKNOWN && (unsigned int)active != GL_TEXTURE0 + activeUnit)
+	{
+		std::cout << "ERROR::GLSTATE::ACTIVE_TEXTURE cached " << activeUnit << " actual " << active - GL_TEXTURE0 << std::endl;
+		mismatches++;
+	}
+	for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+	{
+		if (textures[unit] == UNKNOWN || textureTargets[unit] != GL_TEXTURE_2D)
+			continue;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &value);
+		if ((unsigned int)value != textures[unit])
+		{
+			std::cout << "ERROR::GLSTATE::TEXTURE unit " << unit << " cached " << textures[unit] << " actual " << value << std::endl;
+			mismatches++;
+		}
+	}
+	glActiveTexture(active);
+	return mismatches;
+}
+
+GLStateCache& glState()
+{
+	static GLStateCache cache;
+	return cache;
+}
@@ -0,0 +1,114 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h>
+
+// Shadow copy of the GL state the engine touches every frame. Each setter compares
+// against the cached value and only calls into GL when the value actually changes.
+// There is one cache for the (single) context, see glState(). Code that changes state
+// behind its back, or deletes objects without the delete* wrappers, must invalidate().
+class GLStateCache {
+
+public:
+	// what a call was for, for the per-frame counters
+	enum Kind {
+		PROGRAM,
+		VERTEX_ARRAY,
+		BUFFER,
+		TEXTURE,
+		FRAMEBUFFER,
+		RASTER,
+		KIND_COUNT
+	};
+
+	// calls issued to GL and calls skipped because the value was already set
+	struct Stats {
+		unsigned int issued[KIND_COUNT];
+		unsigned int skipped[KIND_COUNT];
+
+		unsigned int totalIssued() const;
+		unsigned int totalSkipped() const;
+	};
+
+	static const unsigned int MAX_TEXTURE_UNITS = 16;
+
+	GLStateCache();
+
+	// forget everything, the next call of every setter reaches GL
+	void invalidate();
+
+	void useProgram(unsigned int program);
+	void bindVertexArray(unsigned int vao);
+	// GL_ELEMENT_ARRAY_BUFFER is VAO state and always passed through
+	void bindBuffer(GLenum target, unsigned int buffer);
+	// record a glBindBufferRange/glBindBufferBase, which also binds the generic target
+	void boundBufferRange(GLenum target, unsigned int buffer);
+	void bindTexture(unsigned int unit, GLenum target, unsigned int texture);
+	void bindFramebuffer(unsigned int fbo);
+	void setViewport(int x, int y, int width, int height);
+	void setDepthTest(bool enabled);
+	void setDepthWrite(bool enabled);
+	void setDepthFunc(GLenum func);
+	void setBlend(bool enabled);
+	void setBlendFunc(GLenum src, GLenum dst);
+	void setCullFace(bool enabled);
+
+	// delete objects and drop them from the cache, so a recycled name is bound again
+	void deleteProgram(unsigned int program);
+	void deleteVertexArrays(int count, const unsigned int* vaos);
+	void deleteBuffers(int count, const unsigned int* buffers);
+	void deleteTextures(int count, const unsigned int* textures);
+
+	unsigned int program() const { return currentProgram; }
+	unsigned int vertexArray() const { return currentVAO; }
+
+	// counters of the frame in progress
+	const Stats& frameStats() const { return stats; }
+	// close the frame: returns its counters and starts counting from zero
+	Stats endFrame();
+	// compare the cache with glGet* (slow, for debugging); returns the number of mismatches
+	unsigned int validate() const;
+
+private:
+	// buffer targets with their binding tracked
+	enum BufferSlot {
+		ARRAY_BUFFER,
+		UNIFORM_BUFFER,
+		SHADER_STORAGE_BUFFER,
+		DRAW_INDIRECT_BUFFER,
+		PIXEL_UNPACK_BUFFER,
+		COPY_READ_BUFFER,
+		COPY_WRITE_BUFFER,
+		BUFFER_SLOT_COUNT
+	};
+	static int bufferSlot(GLenum target);
+
+	// values that can never be set mark "unknown"
+	static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+	static const signed char UNKNOWN_FLAG = -1;
+
+	bool skip(Kind kind, bool same);
+
+	unsigned int currentProgram;
+	unsigned int currentVAO;
+	unsigned int buffers[BUFFER_SLOT_COUNT];
+	unsigned int activeUnit;
+	GLenum textureTargets[MAX_TEXTURE_UNITS];
+	unsigned int textures[MAX_TEXTURE_UNITS];
+	unsigned int framebuffer;
+	int viewport[4];
+	signed char depthTest;
+	signed char depthWrite;
+	GLenum depthFunc;
+	signed char blend;
+	GLenum blendSrc;
+	GLenum blendDst;
+	signed char cullFace;
+
+	Stats stats;
+};
+
+// the state cache of the current context
+GLStateCache& glState();
+
+#endif
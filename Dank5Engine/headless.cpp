@@ -0,0 +1,138 @@
+#include "headless.h"
+#include "glstate.h"
+
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <iostream>
+
+// same context version/profile test.cpp asks GLFW for
+static const EGLint CONTEXT_ATTRIBS[] = {
+	EGL_CONTEXT_MAJOR_VERSION, 4,
+	EGL_CONTEXT_MINOR_VERSION, 4,
+	EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+	EGL_NONE
+};
+
+HeadlessContext::HeadlessContext(unsigned int width, unsigned int height) : Width(width), Height(height), FBO(0), display(nullptr), context(nullptr), config(nullptr), sharedContext(nullptr), colorRBO(0), depthRBO(0)
+{
+	// prefer the surfaceless platform, it needs neither X11 nor a DRM device
+	EGLDisplay dpy = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (dpy == EGL_NO_DISPLAY)
+		dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, &major, &minor)) {
+		std::cout << "ERROR::HEADLESS::EGL_INITIALIZE_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+		return;
+	}
+	display = dpy;
+
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig eglConfig = nullptr;
+	EGLint numConfigs = 0;
+	eglChooseConfig(dpy, configAttribs, &eglConfig, 1, &numConfigs);
+	config = numConfigs > 0 ? eglConfig : nullptr;
+
+	eglBindAPI(EGL_OPENGL_API);
+	EGLContext ctx = eglCreateContext(dpy, (EGLConfig)config, EGL_NO_CONTEXT, CONTEXT_ATTRIBS);
+	if (ctx == EGL_NO_CONTEXT || !eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+		std::cout << "ERROR::HEADLESS::EGL_CONTEXT_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+		if (ctx != EGL_NO_CONTEXT)
+			eglDestroyContext(dpy, ctx);
+		return;
+	}
+
+	// initilise GLAD through EGL instead of glfwGetProcAddress
+	if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+		std::cout << "Failed to initilise GLAD" << std::endl;
+		eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(dpy, ctx);
+		return;
+	}
+	context = ctx;
+
+	// there is no default framebuffer without a surface, so render into our own
+	glGenRenderbuffers(1, &colorRBO);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, Width, Height);
+	glGenRenderbuffers(1, &depthRBO);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, Width, Height);
+
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	bind();
+}
+
+HeadlessContext::~HeadlessContext()
+{
+	if (context) {
+		glDeleteFramebuffers(1, &FBO);
+		glDeleteRenderbuffers(1, &colorRBO);
+		glDeleteRenderbuffers(1, &depthRBO);
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (sharedContext)
+			eglDestroyContext(display, sharedContext);
+		eglDestroyContext(display, context);
+	}
+	if (display)
+		eglTerminate(display);
+}
+
+void HeadlessContext::bind()
+{
+	glState().bindFramebuffer(FBO);
+	glState().setViewport(0, 0, Width, Height);
+}
+
+void HeadlessContext::finish()
+{
+	glFinish();
+}
+
+bool HeadlessContext::makeSharedCurrent()
+{
+	if (!context)
+		return false;
+	// the API is per thread, and GL isn't EGL's default
+	eglBindAPI(EGL_OPENGL_API);
+	if (!sharedContext) {
+		EGLContext ctx = eglCreateContext(display, (EGLConfig)config, context, CONTEXT_ATTRIBS);
+		if (ctx == EGL_NO_CONTEXT) {
+			std::cout << "ERROR::HEADLESS::EGL_SHARED_CONTEXT_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+			return false;
+		}
+		sharedContext = ctx;
+	}
+	// GLAD's function pointers work for every context of the display
+	return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, sharedContext) == EGL_TRUE;
+}
+
+void HeadlessContext::releaseCurrent()
+{
+	if (display)
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+const char* HeadlessContext::renderer() const
+{
+	return valid() ? (const char*)glGetString(GL_RENDERER) : "none";
+}
+
+const char* HeadlessContext::version() const
+{
+	return valid() ? (const char*)glGetString(GL_VERSION) : "none";
+}
@@ -0,0 +1,43 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <glad/glad.h>
+
+// Offscreen OpenGL context for the benchmarks. Creates a surfaceless EGL context
+// (so Mesa llvmpipe works with no GPU and no display) and renders into a framebuffer object.
+class HeadlessContext {
+
+public:
+	unsigned int Width;
+	unsigned int Height;
+	// framebuffer every frame is rendered into
+	unsigned int FBO;
+
+	HeadlessContext(unsigned int width, unsigned int height);
+	~HeadlessContext();
+
+	// true if a context was created and GLAD loaded
+	bool valid() const { return context != nullptr; }
+	// bind the offscreen framebuffer and set the viewport to cover it
+	void bind();
+	// wait for the GPU, so frame timings include the actual rendering
+	void finish();
+	// makes a second context, sharing objects (programs, buffers, textures) with this one,
+	// current on the calling thread, e.g. a loader thread; created on the first call
+	bool makeSharedCurrent();
+	// leaves the calling thread without a current context
+	void releaseCurrent();
+	// GL_RENDERER / GL_VERSION strings
+	const char* renderer() const;
+	const char* version() const;
+
+private:
+	void* display;
+	void* context;
+	void* config;
+	void* sharedContext;
+	unsigned int colorRBO;
+	unsigned int depthRBO;
+};
+
+#endif
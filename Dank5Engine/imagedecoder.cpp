@@ -0,0 +1,140 @@
+#include "imagedecoder.h"
+#include "mappedfile.h"
+#include "stb_image.h"
+
+ImageDecoder::ImageDecoder(unsigned int threadCount) : pending(0), stopping(false)
+{
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+	for (unsigned int i = 0; i < threadCount; i++)
+		threads.push_back(std::thread(&ImageDecoder::work, this));
+}
+
+ImageDecoder::~ImageDecoder()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobReady.notify_all();
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+	for (size_t i = 0; i < completed.size(); i++)
+		stbi_image_free(completed[i].pixels);
+}
+
+void ImageDecoder::push(const Job& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(job);
+		pending++;
+	}
+	jobReady.notify_one();
+}
+
+void ImageDecoder::decodeFile(const std::string& path, unsigned int tag, int desiredChannels)
+{
+	Job job = { tag, path, nullptr, 0, desiredChannels };
+	push(job);
+}
+
+void ImageDecoder::decodeMemory(const unsigned char* data, size_t size, unsigned int tag, int desiredChannels)
+{
+	Job job = { tag, std::string(), data, size, desiredChannels };
+	push(job);
+}
+
+void ImageDecoder::decodeFiles(const std::vector<std::string>& paths, int desiredChannels)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (unsigned int i = 0; i < paths.size(); i++)
+		{
+			Job job = { i, paths[i], nullptr, 0, desiredChannels };
+			jobs.push_back(job);
+		}
+		pending += (unsigned int)paths.size();
+	}
+	jobReady.notify_all();
+}
+
+DecodedImage ImageDecoder::decode(const Job& job)
+{
+	DecodedImage image = { job.tag, 0, 0, 0, nullptr, nullptr };
+	MappedFile mapped;
+	const unsigned char* data = job.data;
+	size_t size = job.size;
+	if (!data)
+	{
+		image.failure = mapFile(job.path, mapped);
+		if (image.failure)
+			return image;
+		data = mapped.data;
+		size = mapped.size;
+	}
+	if (size > 0x7fffffff)
+		image.failure = "file too large";
+	else
+		image.pixels = stbi_load_from_memory(data, (int)size, &image.width, &image.height, &image.channels, job.desiredChannels);
+	// stb_image keeps its failure reason per thread, and the reasons are string literals
+	if (!image.pixels && !image.failure)
+		image.failure = stbi_failure_reason();
+	if (!job.data)
+		unmapFile(mapped);
+	return image;
+}
+
+void ImageDecoder::work()
+{
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			// finish what is queued before stopping
+			jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (jobs.empty())
+				return;
+			job = jobs.front();
+			jobs.pop_front();
+		}
+		DecodedImage image = decode(job);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			completed.push_back(image);
+		}
+		imageReady.notify_one();
+	}
+}
+
+bool ImageDecoder::poll(DecodedImage& image)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (completed.empty())
+		return false;
+	image = completed.front();
+	completed.pop_front();
+	pending--;
+	return true;
+}
+
+bool ImageDecoder::wait(DecodedImage& image)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	imageReady.wait(lock, [this] { return pending == 0 || !completed.empty(); });
+	if (completed.empty())
+		return false;
+	image = completed.front();
+	completed.pop_front();
+	pending--;
+	return true;
+}
+
+unsigned int ImageDecoder::outstanding()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pending;
+}
@@ -0,0 +1,82 @@
+#ifndef IMAGEDECODER_H
+#define IMAGEDECODER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// one finished decode, handed out by ImageDecoder::poll()/wait()
+struct DecodedImage {
+	// the tag the image was queued with (its index for decodeFiles())
+	unsigned int tag;
+	int width, height;
+	// channels in the file; the pixels have desiredChannels if that was given
+	int channels;
+	// stbi_load_from_memory() result, free with stbi_image_free(); null on failure
+	unsigned char* pixels;
+	// stbi_failure_reason() of the decoding thread when pixels is null
+	const char* failure;
+};
+
+// Decodes images on a pool of threads. Files are memory mapped and decoded with
+// stbi_load_from_memory, so nothing is copied through a FILE*; blobs already in memory
+// are decoded in place (and must stay alive until their image completes).
+// Finished images go to a completion queue in the order they finish.
+//	ImageDecoder decoder;
+//	decoder.decodeFiles(paths);
+//	DecodedImage image;
+//	while (decoder.wait(image)) { ... stbi_image_free(image.pixels); }
+class ImageDecoder {
+
+public:
+	// threads = 0 uses one per hardware thread
+	ImageDecoder(unsigned int threads = 0);
+	// waits for the queued images; pixels of images never taken from the queue are freed
+	~ImageDecoder();
+
+	void decodeFile(const std::string& path, unsigned int tag, int desiredChannels = 0);
+	void decodeMemory(const unsigned char* data, size_t size, unsigned int tag, int desiredChannels = 0);
+	// queue a batch, tagged with their index in paths
+	void decodeFiles(const std::vector<std::string>& paths, int desiredChannels = 0);
+
+	// take a finished image if there is one
+	bool poll(DecodedImage& image);
+	// take the next finished image, blocking; false once nothing is queued or decoding
+	bool wait(DecodedImage& image);
+
+	// images queued and not taken from the completion queue yet
+	unsigned int outstanding();
+	unsigned int threadCount() const { return (unsigned int)threads.size(); }
+
+private:
+	struct Job {
+		unsigned int tag;
+		std::string path;
+		const unsigned char* data;
+		size_t size;
+		int desiredChannels;
+	};
+
+	ImageDecoder(const ImageDecoder&);
+	ImageDecoder& operator=(const ImageDecoder&);
+
+	void work();
+	void push(const Job& job);
+	static DecodedImage decode(const Job& job);
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	// wakes workers when jobs arrive, and waiters when images complete
+	std::condition_variable jobReady;
+	std::condition_variable imageReady;
+	std::deque<Job> jobs;
+	std::deque<DecodedImage> completed;
+	unsigned int pending;
+	bool stopping;
+};
+
+#endif
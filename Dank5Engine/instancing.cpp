@@ -0,0 +1,68 @@
+#include "instancing.h"
+#include "glstate.h"
+
+#include <algorithm>
+
+// at least 1 of each: upload() grows the capacity by doubling and the draws step by the
+// batch size, neither of which gets anywhere from 0
+InstanceBuffer::InstanceBuffer(unsigned int capacity, unsigned int batchSize)
+	: VBO(0), Capacity(std::max(capacity, 1u)), Count(0), BatchSize(std::max(batchSize, 1u))
+{
+	glGenBuffers(1, &VBO);
+	glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, Capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+}
+
+void InstanceBuffer::attach(unsigned int vao, unsigned int location)
+{
+	glState().bindVertexArray(vao);
+	glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+	// a mat4 attribute takes four consecutive vec4 locations, one per column
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		glEnableVertexAttribArray(location + i);
+		glVertexAttribPointer(location + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(i * sizeof(glm::vec4)));
+		// advance once per instance instead of once per vertex
+		glVertexAttribDivisor(location + i, 1);
+	}
+}
+
+void InstanceBuffer::upload(const glm::mat4* models, unsigned int count)
+{
+	glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+	if (count > Capacity)
+	{
+		while (Capacity < count)
+			Capacity *= 2;
+		glBufferData(GL_ARRAY_BUFFER, Capacity * sizeof(glm::mat4), models, GL_STREAM_DRAW);
+	}
+	else
+	{
+		glBufferData(GL_ARRAY_BUFFER, Capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), models);
+	}
+	Count = count;
+}
+
+void InstanceBuffer::drawArrays(GLenum mode, GLint first, GLsizei vertexCount) const
+{
+	for (unsigned int base = 0; base < Count; base += BatchSize)
+	{
+		unsigned int n = Count - base < BatchSize ? Count - base : BatchSize;
+		glDrawArraysInstancedBaseInstance(mode, first, vertexCount, n, base);
+	}
+}
+
+void InstanceBuffer::drawElements(GLenum mode, GLsizei indexCount, GLenum type, const void* indices) const
+{
+	for (unsigned int base = 0; base < Count; base += BatchSize)
+	{
+		unsigned int n = Count - base < BatchSize ? Count - base : BatchSize;
+		glDrawElementsInstancedBaseInstance(mode, indexCount, type, indices, n, base);
+	}
+}
+
+unsigned int InstanceBuffer::drawCalls() const
+{
+	return (Count + BatchSize - 1) / BatchSize;
+}
@@ -0,0 +1,39 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Per-instance model matrices in a vertex buffer, read by the vertex shader as a mat4
+// attribute with divisor 1 (see testVertInstanced.vs). Replaces a setMat4("model") +
+// glDrawArrays per object with one instanced draw per batch.
+// Like the other GL objects, VBO is deleted by its owner with glDeleteBuffers.
+class InstanceBuffer {
+
+public:
+	// the instance vertex buffer
+	unsigned int VBO;
+	// instances the buffer can hold before it has to grow
+	unsigned int Capacity;
+	// instances uploaded by the last upload()
+	unsigned int Count;
+	// instances per draw call, larger sets are split with a base instance
+	unsigned int BatchSize;
+
+	InstanceBuffer(unsigned int capacity = 1024, unsigned int batchSize = 65536);
+
+	// point attribute locations [location, location + 3] of vao at the instance matrices
+	void attach(unsigned int vao, unsigned int location = 2);
+	// replace the instance matrices; grows the buffer if needed, otherwise orphans it
+	// so the driver never waits for draws still reading the previous contents
+	void upload(const glm::mat4* models, unsigned int count);
+
+	// draw Count instances of a non-indexed mesh (the VAO must be bound)
+	void drawArrays(GLenum mode, GLint first, GLsizei vertexCount) const;
+	// draw Count instances of an indexed mesh (the VAO must be bound)
+	void drawElements(GLenum mode, GLsizei indexCount, GLenum type, const void* indices) const;
+	// draw calls issued by the last drawArrays/drawElements
+	unsigned int drawCalls() const;
+};
+
+#endif
@@ -0,0 +1,360 @@
+#include "jobsystem.h"
+#include "framealloc.h"
+
+#include <algorithm>
+#include <climits>
+#include <iostream>
+
+// slots in every thread's deque and job pool; a thread with more jobs in flight than
+// that runs the next ones itself
+static const unsigned int QUEUE_CAPACITY = 4096;
+static const unsigned int POOL_SIZE = 4096;
+// pool slots looked at past the next one before giving up; jobs mostly return in the
+// order they were started, so a busy slot means the pool is close to full
+static const unsigned int POOL_PROBES = 16;
+// idle rounds a worker spins through before it sleeps
+static const unsigned int SPINS_BEFORE_SLEEP = 64;
+// JobCounter::pending while the last job hands out the continuations
+static const int COUNTER_FINISHING = INT_MIN;
+
+// the system the calling thread belongs to and its index there
+static thread_local const JobSystem* threadSystem = nullptr;
+static thread_local unsigned int threadSlot = 0;
+
+// Chase-Lev deque with a fixed ring ("Correct and Efficient Work-Stealing for Weak Memory
+// Models", Le et al. 2013): the owner pushes and pops at bottom, thieves take from top
+class JobQueue {
+
+public:
+	JobQueue() : top(0), bottom(0)
+	{
+		for (unsigned int i = 0; i < QUEUE_CAPACITY; i++)
+			ring[i].store(nullptr, std::memory_order_relaxed);
+	}
+
+	// owner only; false when full
+	bool push(Job* job)
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed);
+		int64_t t = top.load(std::memory_order_acquire);
+		if (b - t >= (int64_t)QUEUE_CAPACITY)
+			return false;
+		ring[b & (QUEUE_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+		// publishes the job (and what it points to) to thieves reading bottom
+		bottom.store(b + 1, std::memory_order_release);
+		return true;
+	}
+
+	// owner only: the newest job
+	Job* pop()
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+		if (t > b)
+		{
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		Job* job = ring[b & (QUEUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// the last job: a thief may be taking it at the same time
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = nullptr;
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	// any thread: the oldest job, or nullptr when empty or another thread got it first
+	Job* steal()
+	{
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = bottom.load(std::memory_order_acquire);
+		if (t >= b)
+			return nullptr;
+		Job* job = ring[t & (QUEUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return job;
+	}
+
+private:
+	// a cache line apart: thieves hammer top, the owner bottom (padding rather than
+	// alignas, which operator new doesn't honour before C++17)
+	std::atomic<int64_t> top;
+	char topPadding[64];
+	std::atomic<int64_t> bottom;
+	char bottomPadding[64];
+	std::atomic<Job*> ring[QUEUE_CAPACITY];
+};
+
+struct JobSystem::ThreadData {
+	JobQueue queue;
+	// jobs this thread started; a slot is reused once its job returned
+	std::unique_ptr<Job[]> pool;
+	unsigned int poolNext;
+	// xorshift state for picking victims
+	uint32_t random;
+	std::atomic<uint64_t> executed, stolen;
+
+	ThreadData(unsigned int index) : pool(new Job[POOL_SIZE]), poolNext(0), random(index * 2654435761u + 1), executed(0), stolen(0) {}
+};
+
+JobCounter::JobCounter() : pending(0), continuations(nullptr)
+{
+	lock.clear();
+}
+
+JobSystem::JobSystem(unsigned int threads) : queued(0), sleeping(0), stopping(false)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned int i = 0; i < threads; i++)
+		perThread.emplace_back(new ThreadData(i));
+	threadSystem = this;
+	threadSlot = 0;
+	for (unsigned int i = 1; i < threads; i++)
+		workers.emplace_back(&JobSystem::workerMain, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepLock);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+	if (threadSystem == this)
+		threadSystem = nullptr;
+}
+
+unsigned int JobSystem::threadIndex() const
+{
+	return threadSystem == this ? threadSlot : 0;
+}
+
+Job* JobSystem::allocate(JobFunction function, void* data, JobCounter* counter, unsigned int begin, unsigned int end)
+{
+	ThreadData& thread = *perThread[threadIndex()];
+	for (unsigned int i = 0; i < POOL_PROBES; i++)
+	{
+		Job& job = thread.pool[(thread.poolNext + i) & (POOL_SIZE - 1)];
+		if (!job.free.load(std::memory_order_acquire))
+			continue;
+		thread.poolNext = (thread.poolNext + i + 1) & (POOL_SIZE - 1);
+		job.free.store(false, std::memory_order_relaxed);
+		job.function = function;
+		job.data = data;
+		job.begin = begin;
+		job.end = end;
+		job.counter = counter;
+		job.next = nullptr;
+		if (counter)
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+		return &job;
+	}
+	return nullptr;
+}
+
+void JobSystem::run(JobFunction function, void* data, JobCounter* counter, unsigned int begin, unsigned int end)
+{
+	Job* job = allocate(function, data, counter, begin, end);
+	if (!job)
+	{
+		// every slot is in flight: run it here instead of queueing it
+		function(data, begin, end);
+		perThread[threadIndex()]->executed.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	submit(job);
+}
+
+void JobSystem::runAfter(JobCounter& dependency, JobFunction function, void* data, JobCounter* counter, unsigned int begin, unsigned int end)
+{
+	Job* job = allocate(function, data, counter, begin, end);
+	if (!job)
+	{
+		wait(dependency);
+		function(data, begin, end);
+		perThread[threadIndex()]->executed.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	for (;;)
+	{
+		while (dependency.lock.test_and_set(std::memory_order_acquire))
+			std::this_thread::yield();
+		int pending = dependency.pending.load(std::memory_order_acquire);
+		if (pending == COUNTER_FINISHING)
+		{
+			// its last job is handing out continuations right now; it's zero in a moment
+			dependency.lock.clear(std::memory_order_release);
+			std::this_thread::yield();
+			continue;
+		}
+		if (pending != 0)
+		{
+			job->next = dependency.continuations;
+			dependency.continuations = job;
+			dependency.lock.clear(std::memory_order_release);
+			return;
+		}
+		dependency.lock.clear(std::memory_order_release);
+		submit(job);
+		return;
+	}
+}
+
+void JobSystem::submit(Job* job)
+{
+	unsigned int index = threadIndex();
+	if (!perThread[index]->queue.push(job))
+	{
+		execute(job, index);
+		return;
+	}
+	queued.fetch_add(1);
+	// sleeping is raised under sleepLock before a worker checks queued, so either it sees
+	// this job or this sees it asleep
+	if (sleeping.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(sleepLock);
+		wakeUp.notify_one();
+	}
+}
+
+Job* JobSystem::next(unsigned int index)
+{
+	ThreadData& thread = *perThread[index];
+	Job* job = thread.queue.pop();
+	if (!job)
+	{
+		unsigned int count = threads();
+		if (count < 2 || queued.load(std::memory_order_relaxed) <= 0)
+			return nullptr;
+		thread.random ^= thread.random << 13;
+		thread.random ^= thread.random >> 17;
+		thread.random ^= thread.random << 5;
+		unsigned int start = thread.random % count;
+		for (unsigned int i = 0; i < count && !job; i++)
+		{
+			unsigned int victim = (start + i) % count;
+			if (victim != index)
+				job = perThread[victim]->queue.steal();
+		}
+		if (!job)
+			return nullptr;
+		thread.stolen.fetch_add(1, std::memory_order_relaxed);
+	}
+	queued.fetch_sub(1, std::memory_order_relaxed);
+	return job;
+}
+
+void JobSystem::execute(Job* job, unsigned int index)
+{
+	job->function(job->data, job->begin, job->end);
+	JobCounter* counter = job->counter;
+	perThread[index]->executed.fetch_add(1, std::memory_order_relaxed);
+	job->free.store(true, std::memory_order_release);
+	if (counter)
+		finish(counter);
+}
+
+void JobSystem::finish(JobCounter* counter)
+{
+	int pending = counter->pending.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		if (pending == 1)
+		{
+			if (counter->pending.compare_exchange_weak(pending, COUNTER_FINISHING, std::memory_order_acq_rel, std::memory_order_relaxed))
+				break;
+		}
+		else if (counter->pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+			return;
+	}
+	// the last job: take the continuations, then let wait() return; the counter may be gone
+	// right after the store, so it is the last thing touched
+	while (counter->lock.test_and_set(std::memory_order_acquire))
+		std::this_thread::yield();
+	Job* continuation = counter->continuations;
+	counter->continuations = nullptr;
+	counter->lock.clear(std::memory_order_release);
+	counter->pending.store(0, std::memory_order_release);
+	while (continuation)
+	{
+		Job* following = continuation->next;
+		submit(continuation);
+		continuation = following;
+	}
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	unsigned int index = threadIndex();
+	while (!counter.done())
+	{
+		Job* job = next(index);
+		if (job)
+			execute(job, index);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::workerMain(unsigned int index)
+{
+	threadSystem = this;
+	threadSlot = index;
+	// the scratch stack jobs rewind through ScratchScope, allocated now rather than
+	// by the first job that needs it
+	threadScratch();
+	unsigned int idle = 0;
+	while (!stopping.load(std::memory_order_relaxed))
+	{
+		Job* job = next(index);
+		if (job)
+		{
+			execute(job, index);
+			idle = 0;
+			continue;
+		}
+		if (++idle < SPINS_BEFORE_SLEEP)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepLock);
+		sleeping.fetch_add(1);
+		wakeUp.wait(lock, [this] { return stopping.load() || queued.load() > 0; });
+		sleeping.fetch_sub(1);
+		idle = 0;
+	}
+}
+
+uint64_t JobSystem::executed() const
+{
+	uint64_t total = 0;
+	for (auto& thread : perThread)
+		total += thread->executed.load(std::memory_order_relaxed);
+	return total;
+}
+
+uint64_t JobSystem::stolen() const
+{
+	uint64_t total = 0;
+	for (auto& thread : perThread)
+		total += thread->stolen.load(std::memory_order_relaxed);
+	return total;
+}
+
+JobSystem& jobSystem()
+{
+	static JobSystem system;
+	return system;
+}
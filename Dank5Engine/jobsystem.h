@@ -0,0 +1,146 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing job scheduler. Every thread owns a Chase-Lev deque: it pushes and pops
+// its own jobs at the bottom (newest first, while their data is still in cache) and idle
+// threads steal the oldest from the top of another deque, so a job that splits itself
+// (parallelFor) spreads over the threads by itself. The thread that creates the system is
+// thread 0 and runs jobs while it waits; threads - 1 workers run the rest and sleep when
+// there is nothing to steal. Nothing blocks a thread that could run jobs: wait() runs
+// other jobs until its counter reaches zero, and runAfter() turns a job into a
+// continuation of a counter instead of waiting at all.
+// Jobs are started from thread 0 or from inside jobs, not from threads the system doesn't
+// own (the texture streamer's workers, say).
+
+typedef void (*JobFunction)(void* data, unsigned int begin, unsigned int end);
+
+struct Job;
+
+// Counts the unfinished jobs started with it; zero once all have returned. Keep it alive
+// until wait() on it returns, and don't start more jobs with it while it may reach zero
+// from another thread.
+struct JobCounter {
+	JobCounter();
+	bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+	std::atomic<int> pending;
+	// continuations waiting for zero, chained through Job::next; guarded by lock
+	std::atomic_flag lock;
+	Job* continuations;
+};
+
+// one job in the pool of the thread that started it
+struct Job {
+	JobFunction function;
+	void* data;
+	unsigned int begin, end;
+	JobCounter* counter;
+	// the next continuation of the same counter
+	Job* next;
+	// returned, so the slot can be handed out again
+	std::atomic<bool> free;
+
+	Job() : free(true) {}
+};
+
+class JobSystem {
+
+public:
+	// threads including the calling one; 0 = one per hardware thread
+	explicit JobSystem(unsigned int threads = 0);
+	// jobs still queued are dropped: wait for them first
+	~JobSystem();
+
+	unsigned int threads() const { return (unsigned int)perThread.size(); }
+	// 0 on the thread that created the system (and any thread it doesn't own), 1.. on workers
+	unsigned int threadIndex() const;
+
+	// function(data, begin, end) on some thread; counter, if any, counts it until it returns
+	void run(JobFunction function, void* data, JobCounter* counter = nullptr, unsigned int begin = 0, unsigned int end = 0);
+	// the same, started once dependency reaches zero (at once if it is zero); counter counts
+	// it from now
+	void runAfter(JobCounter& dependency, JobFunction function, void* data, JobCounter* counter = nullptr,
+		unsigned int begin = 0, unsigned int end = 0);
+	// runs jobs until counter reaches zero
+	void wait(JobCounter& counter);
+
+	// body(first, last) over [begin, end) in ranges of at most grain items, returning when
+	// all ran; ranges are split in halves on demand, so thieves take big pieces first
+	template <typename Body>
+	void parallelFor(unsigned int begin, unsigned int end, unsigned int grain, const Body& body);
+
+	// jobs run, and of those the ones stolen from another thread, since construction
+	uint64_t executed() const;
+	uint64_t stolen() const;
+
+private:
+	// a thread's deque and job pool, see jobsystem.cpp
+	struct ThreadData;
+	std::vector<std::unique_ptr<ThreadData>> perThread;
+	std::vector<std::thread> workers;
+
+	// jobs in the deques, and workers asleep waiting for one
+	std::atomic<int> queued;
+	std::atomic<int> sleeping;
+	std::atomic<bool> stopping;
+	std::mutex sleepLock;
+	std::condition_variable wakeUp;
+
+	template <typename Body>
+	struct ForRange {
+		JobSystem* system;
+		const Body* body;
+		JobCounter* counter;
+		unsigned int grain;
+	};
+	template <typename Body>
+	static void forRange(void* data, unsigned int begin, unsigned int end);
+
+	Job* allocate(JobFunction function, void* data, JobCounter* counter, unsigned int begin, unsigned int end);
+	void submit(Job* job);
+	Job* next(unsigned int index);
+	void execute(Job* job, unsigned int index);
+	void finish(JobCounter* counter);
+	void workerMain(unsigned int index);
+};
+
+template <typename Body>
+void JobSystem::parallelFor(unsigned int begin, unsigned int end, unsigned int grain, const Body& body)
+{
+	if (begin >= end)
+		return;
+	JobCounter counter;
+	ForRange<Body> range = { this, &body, &counter, grain ? grain : 1 };
+	run(&forRange<Body>, &range, &counter, begin, end);
+	wait(counter);
+}
+
+template <typename Body>
+void JobSystem::forRange(void* data, unsigned int begin, unsigned int end)
+{
+	ForRange<Body>& range = *(ForRange<Body>*)data;
+	// hand the upper half to thieves until one grain is left for this thread
+	while (end - begin > range.grain)
+	{
+		unsigned int middle = begin + (end - begin) / 2;
+		range.system->run(&forRange<Body>, data, range.counter, middle, end);
+		end = middle;
+	}
+	(*range.body)(begin, end);
+}
+
+// the engine's job system, one thread per hardware thread; the first call creates it and
+// makes the calling thread its thread 0
+JobSystem& jobSystem();
+
+#endif
@@ -0,0 +1,76 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char* mapFile(const std::string& path, MappedFile& mapped)
+{
+	mapped.data = nullptr;
+	mapped.size = 0;
+#ifdef _WIN32
+	mapped.file = NULL;
+	mapped.mapping = NULL;
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return "can't fopen";
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return "empty file";
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping)
+		mapped.data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!mapped.data)
+	{
+		if (mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return "can't map file";
+	}
+	mapped.file = file;
+	mapped.mapping = mapping;
+	mapped.size = (size_t)size.QuadPart;
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return "can't fopen";
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		close(fd);
+		return "empty file";
+	}
+	void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps the file referenced
+	close(fd);
+	if (data == MAP_FAILED)
+		return "can't map file";
+	// read front to back once
+	madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+	mapped.data = (const unsigned char*)data;
+	mapped.size = (size_t)info.st_size;
+#endif
+	return nullptr;
+}
+
+void unmapFile(MappedFile& mapped)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(mapped.data);
+	CloseHandle((HANDLE)mapped.mapping);
+	CloseHandle((HANDLE)mapped.file);
+#else
+	munmap((void*)mapped.data, mapped.size);
+#endif
+	mapped.data = nullptr;
+}
@@ -0,0 +1,22 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// a read-only mapping of a whole file
+struct MappedFile {
+	const unsigned char* data;
+	size_t size;
+#ifdef _WIN32
+	// file and mapping HANDLEs, kept as void* so windows.h stays out of the header
+	void* file;
+	void* mapping;
+#endif
+};
+
+// maps the file for reading front to back; returns null, or why it failed (a string literal)
+const char* mapFile(const std::string& path, MappedFile& mapped);
+void unmapFile(MappedFile& mapped);
+
+#endif
@@ -0,0 +1,339 @@
+#include "mesh.h"
+#include "glstate.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+static unsigned int hashVertex(const float* vertex, unsigned int stride)
+{
+	// FNV-1a over the vertex a float at a time, with a final mix so the low bits
+	// used for the table slot depend on every input bit
+	unsigned int hash = 2166136261u;
+	for (unsigned int i = 0; i < stride; i++)
+	{
+		unsigned int word;
+		memcpy(&word, &vertex[i], sizeof(word));
+		hash = (hash ^ word) * 16777619u;
+	}
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	return hash;
+}
+
+MeshData indexMesh(const float* vertices, unsigned int vertexCount, unsigned int stride)
+{
+	MeshData mesh;
+	mesh.stride = stride;
+	mesh.indices.resize(vertexCount);
+	mesh.vertices.reserve(vertexCount * stride);
+
+	// open addressing table of unique vertex ids, at most half full
+	unsigned int tableSize = 16;
+	while (tableSize < vertexCount * 2)
+		tableSize *= 2;
+	const unsigned int EMPTY = ~0u;
+	std::vector<unsigned int> table(tableSize, EMPTY);
+
+	const size_t bytes = stride * sizeof(float);
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const float* vertex = vertices + (size_t)i * stride;
+		unsigned int slot = hashVertex(vertex, stride) & (tableSize - 1);
+		while (table[slot] != EMPTY && memcmp(&mesh.vertices[(size_t)table[slot] * stride], vertex, bytes) != 0)
+			slot = (slot + 1) & (tableSize - 1);
+		if (table[slot] == EMPTY)
+		{
+			table[slot] = mesh.vertexCount();
+			mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + stride);
+		}
+		mesh.indices[i] = table[slot];
+	}
+	return mesh;
+}
+
+// Forsyth, "Linear-Speed Vertex Cache Optimisation": greedily emit the triangle whose
+// vertices score highest, a vertex scoring for its position in a simulated LRU cache
+// and for how few triangles still use it (so stragglers get finished off)
+static const unsigned int FORSYTH_CACHE_SIZE = 32;
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+// scores are looked up rather than computed: the valence boost only matters for
+// vertices with few triangles left, beyond that it is clamped
+static const unsigned int MAX_VALENCE = 32;
+
+struct ScoreTables {
+	float cache[FORSYTH_CACHE_SIZE];
+	float valence[MAX_VALENCE];
+
+	ScoreTables()
+	{
+		for (unsigned int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+		{
+			// the vertices of the last triangle all get the same score, so the next one
+			// isn't biased towards any of its edges
+			if (i < 3)
+				cache[i] = LAST_TRIANGLE_SCORE;
+			else
+				cache[i] = powf(1.0f - (i - 3) / (float)(FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+		}
+		valence[0] = 0.0f;
+		for (unsigned int i = 1; i < MAX_VALENCE; i++)
+			valence[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+	}
+};
+
+static float vertexScore(const ScoreTables& tables, int cachePosition, unsigned int remaining)
+{
+	// no triangles left to draw with it
+	if (remaining == 0)
+		return -1.0f;
+	float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+	return score + tables.valence[remaining < MAX_VALENCE ? remaining : MAX_VALENCE - 1];
+}
+
+void optimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount)
+{
+	const unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// triangles using each vertex: offsets[v] .. offsets[v] + remaining[v] are still to be drawn
+	std::vector<unsigned int> remaining(vertexCount, 0), offsets(vertexCount + 1, 0);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+		remaining[indices[i]]++;
+	for (unsigned int v = 0; v < vertexCount; v++)
+		offsets[v + 1] = offsets[v] + remaining[v];
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (unsigned int t = 0; t < triangleCount; t++)
+		for (unsigned int k = 0; k < 3; k++)
+			adjacency[fill[indices[t * 3 + k]]++] = t;
+
+	static const ScoreTables tables;
+	std::vector<float> scores(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		scores[v] = vertexScore(tables, -1, remaining[v]);
+	std::vector<bool> emitted(triangleCount, false);
+	int best = 0;
+	float bestScore = -1.0f;
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		const unsigned int* tri = &indices[t * 3];
+		float score = scores[tri[0]] + scores[tri[1]] + scores[tri[2]];
+		if (score > bestScore)
+		{
+			bestScore = score;
+			best = t;
+		}
+	}
+
+	std::vector<unsigned int> output(triangleCount * 3);
+	// room for the cache plus the three vertices pushed in front of it
+	unsigned int cache[FORSYTH_CACHE_SIZE + 3], newCache[FORSYTH_CACHE_SIZE + 3];
+	unsigned int cacheCount = 0;
+	unsigned int cursor = 0;
+	for (unsigned int out = 0; out < triangleCount; out++)
+	{
+		if (best < 0)
+		{
+			// nothing in the cache has triangles left: continue with the next undrawn one
+			while (emitted[cursor])
+				cursor++;
+			best = cursor;
+		}
+		const unsigned int* tri = &indices[best * 3];
+		output[out * 3 + 0] = tri[0];
+		output[out * 3 + 1] = tri[1];
+		output[out * 3 + 2] = tri[2];
+		emitted[best] = true;
+
+		// the triangle's vertices go to the front of the cache, the rest move back
+		unsigned int newCount = 0;
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			unsigned int v = tri[k];
+			// remove the triangle from the vertex's list
+			unsigned int* list = &adjacency[offsets[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++)
+			{
+				if (list[j] == (unsigned int)best)
+				{
+					list[j] = list[remaining[v] - 1];
+					break;
+				}
+			}
+			remaining[v]--;
+			// a degenerate triangle names a vertex twice, it takes one cache slot
+			if ((k < 1 || v != tri[0]) && (k < 2 || v != tri[1]))
+				newCache[newCount++] = v;
+		}
+		for (unsigned int c = 0; c < cacheCount; c++)
+		{
+			unsigned int v = cache[c];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCount++] = v;
+		}
+		// vertices falling off the end leave the cache, their scores drop too
+		for (unsigned int c = FORSYTH_CACHE_SIZE; c < newCount; c++)
+			scores[newCache[c]] = vertexScore(tables, -1, remaining[newCache[c]]);
+		cacheCount = newCount < FORSYTH_CACHE_SIZE ? newCount : FORSYTH_CACHE_SIZE;
+		for (unsigned int c = 0; c < cacheCount; c++)
+		{
+			unsigned int v = newCache[c];
+			cache[c] = v;
+			scores[v] = vertexScore(tables, c, remaining[v]);
+		}
+
+		// rescore the triangles touching the cache and pick the best of them
+		best = -1;
+		bestScore = -1.0f;
+		for (unsigned int c = 0; c < newCount; c++)
+		{
+			unsigned int v = newCache[c];
+			const unsigned int* list = &adjacency[offsets[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++)
+			{
+				unsigned int t = list[j];
+				const unsigned int* other = &indices[t * 3];
+				float score = scores[other[0]] + scores[other[1]] + scores[other[2]];
+				if (score > bestScore)
+				{
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+	}
+	memcpy(indices, output.data(), output.size() * sizeof(unsigned int));
+}
+
+void optimizeVertexFetch(MeshData& mesh)
+{
+	const unsigned int NONE = ~0u;
+	std::vector<unsigned int> remap(mesh.vertexCount(), NONE);
+	std::vector<float> vertices;
+	vertices.reserve(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		unsigned int v = mesh.indices[i];
+		if (remap[v] == NONE)
+		{
+			remap[v] = (unsigned int)(vertices.size() / mesh.stride);
+			vertices.insert(vertices.end(), &mesh.vertices[(size_t)v * mesh.stride], &mesh.vertices[(size_t)v * mesh.stride] + mesh.stride);
+		}
+		mesh.indices[i] = remap[v];
+	}
+	mesh.vertices.swap(vertices);
+}
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize)
+{
+	// a vertex is in the FIFO while fewer than cacheSize misses happened since it was loaded
+	std::vector<unsigned int> loadedAt(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	unsigned int misses = 0, unique = 0;
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		unsigned int v = indices[i];
+		if (!used[v])
+		{
+			used[v] = true;
+			unique++;
+		}
+		if (loadedAt[v] == 0 || misses - loadedAt[v] >= cacheSize)
+		{
+			misses++;
+			loadedAt[v] = misses;
+		}
+	}
+	VertexCacheStats stats;
+	stats.acmr = indexCount >= 3 ? misses / (float)(indexCount / 3) : 0.0f;
+	stats.atvr = unique ? misses / (float)unique : 0.0f;
+	return stats;
+}
+
+void MeshOptimizeReport::print(const char* name) const
+{
+	std::cout << "MESH::" << name << " vertices " << inputVertices << " -> " << uniqueVertices
+		<< ", ACMR " << before.acmr << " -> " << after.acmr
+		<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+}
+
+MeshOptimizeReport optimizeMesh(MeshData& mesh)
+{
+	MeshOptimizeReport report;
+	report.inputVertices = mesh.vertexCount();
+	report.before = analyzeVertexCache(mesh.indices.data(), (unsigned int)mesh.indices.size(), mesh.vertexCount());
+	optimizeVertexCache(mesh.indices.data(), (unsigned int)mesh.indices.size(), mesh.vertexCount());
+	optimizeVertexFetch(mesh);
+	report.uniqueVertices = mesh.vertexCount();
+	report.after = analyzeVertexCache(mesh.indices.data(), (unsigned int)mesh.indices.size(), mesh.vertexCount());
+	return report;
+}
+
+MeshOptimizeReport optimizeMesh(const float* vertices, unsigned int vertexCount, unsigned int stride, MeshData& mesh)
+{
+	mesh = indexMesh(vertices, vertexCount, stride);
+	MeshOptimizeReport report = optimizeMesh(mesh);
+	// as drawn before indexing, every vertex of the soup is shaded
+	report.inputVertices = vertexCount;
+	report.before.acmr = 3.0f;
+	report.before.atvr = mesh.vertexCount() ? vertexCount / (float)mesh.vertexCount() : 0.0f;
+	return report;
+}
+
+Mesh::Mesh(const MeshData& data, const unsigned int* attributeSizes, unsigned int attributeCount)
+	: Mesh(data, VertexFormat::floatFormat(attributeSizes, attributeCount))
+{
+}
+
+Mesh::Mesh(const MeshData& data, const VertexFormat& format)
+{
+	IndexCount = (unsigned int)data.indices.size();
+	IndexType = data.vertexCount() <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	if (format.floats() != data.stride)
+		std::cout << "ERROR::MESH::FORMAT_DOES_NOT_MATCH_STRIDE" << std::endl;
+
+	EncodedVertices encoded = encodeVertices(data.vertices.data(), data.vertexCount(), format);
+	PositionCenter = encoded.center;
+	PositionExtent = encoded.extent;
+	VertexBytes = (unsigned int)encoded.bytes.size();
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+	glState().bindVertexArray(VAO);
+	glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, encoded.bytes.size(), encoded.bytes.data(), GL_STATIC_DRAW);
+	// the element buffer binding is part of the VAO
+	glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	if (IndexType == GL_UNSIGNED_SHORT)
+	{
+		std::vector<unsigned short> shortIndices(data.indices.begin(), data.indices.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+	}
+	else
+	{
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indices.size() * sizeof(unsigned int), data.indices.data(), GL_STATIC_DRAW);
+	}
+	setVertexAttributes(format);
+}
+
+glm::mat4 Mesh::dequantize() const
+{
+	return glm::scale(glm::translate(glm::mat4(1.0f), PositionCenter), PositionExtent);
+}
+
+void Mesh::destroy()
+{
+	glState().deleteVertexArrays(1, &VAO);
+	glState().deleteBuffers(1, &VBO);
+	glState().deleteBuffers(1, &EBO);
+}
@@ -0,0 +1,88 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "vertexformat.h"
+
+// Indexed triangle list with interleaved float vertices, as it goes through the
+// preprocessing stage below before being uploaded into a Mesh.
+struct MeshData {
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+	// floats per vertex
+	unsigned int stride;
+
+	unsigned int vertexCount() const { return stride ? (unsigned int)(vertices.size() / stride) : 0; }
+};
+
+// post-transform vertex cache size assumed by the statistics (a FIFO, like most GPUs)
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+// How often the vertex shader runs for an index order:
+// ACMR = shaded vertices per triangle (0.5 at best for a regular grid, 3 with no reuse),
+// ATVR = shaded vertices per unique vertex (1 is ideal).
+struct VertexCacheStats {
+	float acmr;
+	float atvr;
+};
+
+// what optimizeMesh() did to a mesh
+struct MeshOptimizeReport {
+	// vertices before and after deduplication (equal for an already indexed mesh)
+	unsigned int inputVertices;
+	unsigned int uniqueVertices;
+	VertexCacheStats before;
+	VertexCacheStats after;
+
+	// one line on std::cout: "MESH::<name> vertices a -> b, ACMR x -> y, ATVR x -> y"
+	void print(const char* name) const;
+};
+
+// index an unindexed triangle soup, merging bit-identical vertices
+MeshData indexMesh(const float* vertices, unsigned int vertexCount, unsigned int stride);
+// reorder triangles for the post-transform cache (Forsyth's linear-speed algorithm)
+void optimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount);
+// reorder vertices by first use so the vertex fetch walks memory linearly; drops unused vertices
+void optimizeVertexFetch(MeshData& mesh);
+// simulate a FIFO cache of cacheSize entries over the index order
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// the whole stage on an indexed mesh: cache order, then fetch order
+MeshOptimizeReport optimizeMesh(MeshData& mesh);
+// the whole stage on a triangle soup (e.g. cubeVertices): index, then optimizeMesh()
+MeshOptimizeReport optimizeMesh(const float* vertices, unsigned int vertexCount, unsigned int stride, MeshData& mesh);
+
+// An indexed mesh on the GPU: vertex and element buffer in one VAO, the vertices packed
+// as described by a VertexFormat. 16-bit indices are used when the vertices allow it.
+// Like the other GL objects there is no destructor, call destroy() while the context lives.
+class Mesh {
+
+public:
+	unsigned int VAO, VBO, EBO;
+	unsigned int IndexCount;
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, for glDrawElements and DrawPacket::indexType
+	GLenum IndexType;
+
+	// bounds of a VERTEX_POSITION_SNORM16 position (see dequantize())
+	glm::vec3 PositionCenter, PositionExtent;
+	// size of the vertex buffer
+	unsigned int VertexBytes;
+
+	// attributeSizes[i] floats of each vertex go to attribute location i, unpacked
+	Mesh(const MeshData& data, const unsigned int* attributeSizes, unsigned int attributeCount);
+	// data.stride must be format.floats()
+	Mesh(const MeshData& data, const VertexFormat& format);
+
+	// maps quantised positions back to mesh space; fold it into the model matrix
+	// (model * dequantize()), it is the identity for float positions
+	glm::mat4 dequantize() const;
+
+	// delete the VAO and buffers
+	void destroy();
+};
+
+#endif
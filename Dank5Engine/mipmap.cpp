@@ -0,0 +1,345 @@
+#include "mipmap.h"
+
+#include <glm/simd/platform.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+// SIMD paths as in culling.cpp
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#	define DANK5_MIP_SSE 1
+#endif
+#if GLM_ARCH & GLM_ARCH_AVX_BIT
+#	define DANK5_MIP_AVX 1
+#endif
+
+#if defined(_MSC_VER) && (DANK5_MIP_SSE || DANK5_MIP_AVX)
+#	include <intrin.h>
+#endif
+
+// below this many texels a thread costs more to start than it saves
+static const size_t MIN_TEXELS_PER_THREAD = 16384;
+// destination rows a thread filters at once
+static const int BAND_ROWS = 8;
+
+// sRGB to linear for every byte, and back from linear in 1/65535 steps, fine enough
+// that every byte survives the round trip (the sRGB curve is steepest near black)
+struct SrgbTables {
+	float toLinear[256];
+	unsigned char fromLinear[65536];
+
+	SrgbTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			double s = i / 255.0;
+			toLinear[i] = (float)(s <= 0.04045 ? s / 12.92 : std::pow((s + 0.055) / 1.055, 2.4));
+		}
+		for (int i = 0; i < 65536; i++)
+		{
+			double l = i / 65535.0;
+			double s = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+			fromLinear[i] = (unsigned char)std::min(255.0, std::floor(s * 255.0 + 0.5));
+		}
+	}
+};
+
+static const SrgbTables& srgbTables()
+{
+	static const SrgbTables tables;
+	return tables;
+}
+
+// the taps of a 2:1 reduction in one direction: destination texel x reads source texels
+// 2x + first .. 2x + first + taps - 1
+struct MipKernel {
+	int first;
+	int taps;
+	float weights[6];
+};
+
+// zeroth order modified Bessel function of the first kind, for the Kaiser window
+static double besselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 32; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static MipKernel mipKernel(MipFilter filter)
+{
+	MipKernel kernel;
+	if (filter == MIP_BOX)
+	{
+		kernel.first = 0;
+		kernel.taps = 2;
+		kernel.weights[0] = kernel.weights[1] = 0.5f;
+		return kernel;
+	}
+	// sinc at the new Nyquist rate under a Kaiser window (alpha 4) three texels wide,
+	// sampled at the six source texel centres around the destination texel's centre
+	const double pi = 3.14159265358979323846, alpha = 4.0, radius = 3.0;
+	kernel.first = -2;
+	kernel.taps = 6;
+	double weights[6], sum = 0.0;
+	for (int t = 0; t < 6; t++)
+	{
+		double d = kernel.first + t - 0.5;
+		double sinc = std::sin(pi * d / 2.0) / (pi * d / 2.0);
+		double window = besselI0(alpha * std::sqrt(1.0 - (d / radius) * (d / radius))) / besselI0(alpha);
+		weights[t] = sinc * window;
+		sum += weights[t];
+	}
+	for (int t = 0; t < 6; t++)
+		kernel.weights[t] = (float)(weights[t] / sum);
+	return kernel;
+}
+
+// body(i) for i in 0..count-1, split over threads when there are enough texels for it
+template<typename Body>
+static void parallelFor(int count, size_t texels, unsigned int threads, Body body)
+{
+	threads = (unsigned int)std::min<size_t>(threads, std::max<size_t>(1, texels / MIN_TEXELS_PER_THREAD));
+	threads = std::min(threads, (unsigned int)std::max(count, 1));
+	std::atomic<int> next(0);
+	auto work = [&]()
+	{
+		for (int i = next++; i < count; i = next++)
+			body(i);
+	};
+	std::vector<std::thread> workers;
+	for (unsigned int i = 1; i < threads; i++)
+		workers.emplace_back(work);
+	work();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+static void decodeRow(const unsigned char* src, float* dst, int width, bool srgb)
+{
+	const float* toLinear = srgbTables().toLinear;
+	const float scale = 1.0f / 255.0f;
+	if (srgb)
+	{
+		for (int x = 0; x < width; x++, src += 4, dst += 4)
+		{
+			dst[0] = toLinear[src[0]];
+			dst[1] = toLinear[src[1]];
+			dst[2] = toLinear[src[2]];
+			dst[3] = src[3] * scale;
+		}
+		return;
+	}
+	for (int i = 0; i < width * 4; i++)
+		dst[i] = src[i] * scale;
+}
+
+static void encodeRow(const float* src, unsigned char* dst, int width, bool srgb)
+{
+	const unsigned char* fromLinear = srgbTables().fromLinear;
+#if DANK5_MIP_SSE
+	__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	__m128 scale = srgb ? _mm_setr_ps(65535.0f, 65535.0f, 65535.0f, 255.0f) : _mm_set1_ps(255.0f);
+	for (int x = 0; x < width; x++, src += 4, dst += 4)
+	{
+		__m128i value = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), zero), one), scale));
+		if (srgb)
+		{
+			int values[4];
+			_mm_storeu_si128((__m128i*)values, value);
+			dst[0] = fromLinear[values[0]];
+			dst[1] = fromLinear[values[1]];
+			dst[2] = fromLinear[values[2]];
+			dst[3] = (unsigned char)values[3];
+		}
+		else
+		{
+			int packed = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(value, value), value));
+			memcpy(dst, &packed, 4);
+		}
+	}
+#else
+	for (int x = 0; x < width; x++, src += 4, dst += 4)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			float v = std::min(1.0f, std::max(0.0f, src[c]));
+			bool curve = srgb && c < 3;
+			long value = std::lrint(v * (curve ? 65535.0f : 255.0f));
+			dst[c] = curve ? fromLinear[value] : (unsigned char)value;
+		}
+	}
+#endif
+}
+
+// one row of source texels filtered across into dw texels
+static void filterAcross(const float* src, float* dst, int width, int dw, const MipKernel& kernel)
+{
+	// texels whose taps all fall inside the row need no clamping
+	int span = width - kernel.first - kernel.taps;
+	int inside = span < 0 ? 0 : std::min(dw, span / 2 + 1);
+	int first = std::min(inside, std::max(0, (1 - kernel.first) / 2));
+#if DANK5_MIP_SSE
+	__m128 weights[6];
+	for (int t = 0; t < kernel.taps; t++)
+		weights[t] = _mm_set1_ps(kernel.weights[t]);
+	for (int x = 0; x < dw; x++)
+	{
+		__m128 sum = _mm_setzero_ps();
+		if (x >= first && x < inside)
+		{
+			const float* texel = src + (2 * x + kernel.first) * 4;
+			for (int t = 0; t < kernel.taps; t++)
+				sum = _mm_add_ps(sum, _mm_mul_ps(weights[t], _mm_loadu_ps(texel + t * 4)));
+		}
+		else
+			for (int t = 0; t < kernel.taps; t++)
+			{
+				int s = std::min(std::max(2 * x + kernel.first + t, 0), width - 1);
+				sum = _mm_add_ps(sum, _mm_mul_ps(weights[t], _mm_loadu_ps(src + s * 4)));
+			}
+		_mm_storeu_ps(dst + x * 4, sum);
+	}
+#else
+	(void)inside;
+	(void)first;
+	for (int x = 0; x < dw; x++, dst += 4)
+	{
+		float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int t = 0; t < kernel.taps; t++)
+		{
+			const float* texel = src + std::min(std::max(2 * x + kernel.first + t, 0), width - 1) * 4;
+			for (int c = 0; c < 4; c++)
+				sum[c] += kernel.weights[t] * texel[c];
+		}
+		for (int c = 0; c < 4; c++)
+			dst[c] = sum[c];
+	}
+#endif
+}
+
+// the weighted sum of kernel.taps rows of count floats
+static void filterDown(const float* const* rows, float* dst, int count, const MipKernel& kernel)
+{
+	int i = 0;
+#if DANK5_MIP_AVX
+	__m256 wide[6];
+	for (int t = 0; t < kernel.taps; t++)
+		wide[t] = _mm256_set1_ps(kernel.weights[t]);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 sum = _mm256_setzero_ps();
+		for (int t = 0; t < kernel.taps; t++)
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(wide[t], _mm256_loadu_ps(rows[t] + i)));
+		_mm256_storeu_ps(dst + i, sum);
+	}
+#endif
+#if DANK5_MIP_SSE
+	__m128 weights[6];
+	for (int t = 0; t < kernel.taps; t++)
+		weights[t] = _mm_set1_ps(kernel.weights[t]);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (int t = 0; t < kernel.taps; t++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(weights[t], _mm_loadu_ps(rows[t] + i)));
+		_mm_storeu_ps(dst + i, sum);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		float sum = 0.0f;
+		for (int t = 0; t < kernel.taps; t++)
+			sum += kernel.weights[t] * rows[t][i];
+		dst[i] = sum;
+	}
+}
+
+size_t mipChainOffsets(int width, int height, std::vector<size_t>& offsets)
+{
+	offsets.clear();
+	int w = width, h = height;
+	size_t size = 0;
+	for (;;)
+	{
+		offsets.push_back(size);
+		size += (size_t)w * h * 4;
+		if (w == 1 && h == 1)
+			break;
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+	}
+	return size;
+}
+
+void buildMipChain(unsigned char* texels, int width, int height, const std::vector<size_t>& offsets,
+	MipFilter filter, bool srgb, unsigned int threads)
+{
+	if (offsets.size() < 2)
+		return;
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	MipKernel kernel = mipKernel(filter);
+
+	// Every level is filtered across into rows of half the width, then down into half the
+	// rows, a band of destination rows at a time so the rows filtered across stay in
+	// cache. Level 0 is decoded to linear float a row at a time as it is read; the levels
+	// after it are kept whole in float for the next one.
+	int w = width, h = height;
+	std::vector<float> level, next;
+	for (size_t l = 1; l < offsets.size(); l++)
+	{
+		int dw = std::max(1, w / 2), dh = std::max(1, h / 2);
+		next.resize((size_t)dw * dh * 4);
+		unsigned char* dst = texels + offsets[l];
+		int bands = (dh + BAND_ROWS - 1) / BAND_ROWS;
+		parallelFor(bands, (size_t)w * h, threads, [&](int band)
+		{
+			int y0 = band * BAND_ROWS, y1 = std::min(dh, y0 + BAND_ROWS);
+			// the source rows the band reads, before clamping to the image
+			int s0 = 2 * y0 + kernel.first, s1 = 2 * (y1 - 1) + kernel.first + kernel.taps;
+			std::vector<float> across((size_t)(s1 - s0) * dw * 4), decoded(l == 1 ? (size_t)w * 4 : 0);
+			for (int s = s0; s < s1; s++)
+			{
+				size_t row = (size_t)std::min(std::max(s, 0), h - 1);
+				const float* src = level.data() + row * w * 4;
+				if (l == 1)
+				{
+					decodeRow(texels + row * w * 4, decoded.data(), w, srgb);
+					src = decoded.data();
+				}
+				filterAcross(src, across.data() + (size_t)(s - s0) * dw * 4, w, dw, kernel);
+			}
+			for (int y = y0; y < y1; y++)
+			{
+				const float* rows[6];
+				for (int t = 0; t < kernel.taps; t++)
+					rows[t] = across.data() + (size_t)(2 * y + kernel.first + t - s0) * dw * 4;
+				float* row = next.data() + (size_t)y * dw * 4;
+				filterDown(rows, row, dw * 4, kernel);
+				encodeRow(row, dst + (size_t)y * dw * 4, dw, srgb);
+			}
+		});
+		level.swap(next);
+		w = dw;
+		h = dh;
+	}
+}
+
+const char* mipmapPath()
+{
+#if DANK5_MIP_AVX
+	return "avx";
+#elif DANK5_MIP_SSE
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,33 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <cstddef>
+#include <vector>
+
+// RGBA8 mip chains down to 1x1, all levels back to back in one buffer from level 0.
+// Built on the CPU so the texture streamer and the texture cooker share the filter
+// instead of leaving it to glGenerateMipmap.
+
+enum MipFilter {
+	// 2x2 average
+	MIP_BOX,
+	// 6x6 windowed sinc (Kaiser window): keeps detail the box blurs and aliases less
+	MIP_KAISER
+};
+
+// the byte offset of every level; returns the size of the whole chain
+size_t mipChainOffsets(int width, int height, std::vector<size_t>& offsets);
+// Fills levels 1.. from level 0, edge texels repeated where the filter runs off the
+// image. With srgb the colour channels are decoded to linear light before filtering and
+// encoded again after (alpha is always linear); without, every channel is filtered as
+// stored, which is right for data such as normals. Each level is filtered from the one
+// above kept in float, so rounding doesn't build up down the chain. The rows of every
+// level are split over threads (0 = one per hardware thread); the output doesn't depend
+// on it.
+void buildMipChain(unsigned char* texels, int width, int height, const std::vector<size_t>& offsets,
+	MipFilter filter = MIP_BOX, bool srgb = true, unsigned int threads = 0);
+
+// "avx", "sse2" or "scalar": the path the filters use in this build
+const char* mipmapPath();
+
+#endif
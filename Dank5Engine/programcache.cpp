@@ -0,0 +1,191 @@
+#include "programcache.h"
+
+#include <glad/glad.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// "D5PB"
+static const uint32_t PROGRAM_CACHE_MAGIC = 0x42503544;
+// bump when the entry layout changes; older entries are then rejected and rebuilt
+static const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+// what precedes the driver's binary in an entry
+struct ProgramCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint64_t driver;
+	// the binary format glGetProgramBinary reported
+	uint32_t format;
+	uint32_t length;
+};
+
+// 64-bit FNV-1a, continued from h
+static uint64_t hash64(const char* data, size_t size, uint64_t h)
+{
+	for (size_t i = 0; i < size; i++)
+		h = (h ^ (unsigned char)data[i]) * 1099511628211ull;
+	return h;
+}
+
+static uint64_t hash64(const std::string& s, uint64_t h)
+{
+	// the length goes in too, so "ab" + "c" and "a" + "bc" differ
+	uint64_t size = s.size();
+	return hash64(s.data(), s.size(), hash64((const char*)&size, sizeof(size), h));
+}
+
+ProgramCache::ProgramCache() : Hits(0), Misses(0), Rejected(0), driver(0), formats(-1)
+{
+}
+
+bool ProgramCache::setDirectory(const std::string& directory)
+{
+	Directory.clear();
+	Hits = Misses = Rejected = 0;
+	if (directory.empty())
+		return true;
+#ifdef _WIN32
+	int result = _mkdir(directory.c_str());
+#else
+	int result = mkdir(directory.c_str(), 0755);
+#endif
+	if (result != 0 && errno != EEXIST)
+	{
+		std::cout << "ERROR::PROGRAMCACHE::FAILED_TO_CREATE " << directory << " (" << strerror(errno) << ")" << std::endl;
+		return false;
+	}
+	Directory = directory;
+	return true;
+}
+
+bool ProgramCache::enabled()
+{
+	if (Directory.empty())
+		return false;
+	if (formats < 0)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+		formats = count;
+	}
+	return formats > 0;
+}
+
+uint64_t ProgramCache::key(const std::string& vertexSource, const std::string& fragmentSource, const std::string& defines)
+{
+	if (driver == 0)
+	{
+		// a binary is only good for the driver build that produced it
+		const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+		driver = 14695981039346656037ull;
+		for (GLenum name : names)
+		{
+			const char* value = (const char*)glGetString(name);
+			driver = hash64(value ? value : "", driver);
+		}
+	}
+	uint64_t h = hash64(vertexSource, driver);
+	h = hash64(fragmentSource, h);
+	return hash64(defines, h);
+}
+
+std::string ProgramCache::path(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return Directory + "/" + name;
+}
+
+bool ProgramCache::load(uint64_t key, unsigned int program)
+{
+	std::string file = path(key);
+	std::ifstream stream(file.c_str(), std::ios::binary | std::ios::ate);
+	if (!stream)
+	{
+		Misses++;
+		return false;
+	}
+	std::vector<char> data((size_t)stream.tellg());
+	stream.seekg(0);
+	stream.read(data.data(), (std::streamsize)data.size());
+	stream.close();
+
+	ProgramCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	if (data.size() >= sizeof(header))
+		memcpy(&header, data.data(), sizeof(header));
+	// anything but an intact entry for this key and driver, or a binary the driver won't
+	// take back after all (a driver update that kept its version string), is rebuilt
+	bool valid = header.magic == PROGRAM_CACHE_MAGIC && header.version == PROGRAM_CACHE_VERSION && header.key == key
+		&& header.driver == driver && header.length == data.size() - sizeof(header);
+	if (valid)
+	{
+		glProgramBinary(program, header.format, data.data() + sizeof(header), (GLsizei)header.length);
+		GLint linked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		valid = linked == GL_TRUE;
+	}
+	if (!valid)
+	{
+		Rejected++;
+		std::remove(file.c_str());
+		return false;
+	}
+	Hits++;
+	return true;
+}
+
+void ProgramCache::store(uint64_t key, unsigned int program)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+	std::vector<char> data(sizeof(ProgramCacheHeader) + length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &format, data.data() + sizeof(ProgramCacheHeader));
+	if (written <= 0)
+		return;
+	ProgramCacheHeader header = { PROGRAM_CACHE_MAGIC, PROGRAM_CACHE_VERSION, key, driver, format, (uint32_t)written };
+	memcpy(data.data(), &header, sizeof(header));
+
+	// written beside the entry and renamed over it, so a crash never leaves half an entry
+	std::string file = path(key), temporary = file + ".tmp";
+	std::ofstream stream(temporary.c_str(), std::ios::binary | std::ios::trunc);
+	stream.write(data.data(), (std::streamsize)(sizeof(header) + written));
+	stream.close();
+	if (!stream)
+	{
+		std::cout << "ERROR::PROGRAMCACHE::FAILED_TO_WRITE " << temporary << std::endl;
+		std::remove(temporary.c_str());
+		return;
+	}
+#ifdef _WIN32
+	// rename() doesn't replace an existing file there
+	std::remove(file.c_str());
+#endif
+	if (std::rename(temporary.c_str(), file.c_str()) != 0)
+	{
+		std::cout << "ERROR::PROGRAMCACHE::FAILED_TO_WRITE " << file << std::endl;
+		std::remove(temporary.c_str());
+	}
+}
+
+ProgramCache& programCache()
+{
+	static ProgramCache cache;
+	return cache;
+}
@@ -0,0 +1,48 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <cstdint>
+#include <string>
+
+// Linked programs saved with glGetProgramBinary and restored with glProgramBinary, so a
+// program built on an earlier run skips compiling and linking. Each entry is one file
+// named after a 64-bit key hashed from the sources, the defines and the driver (vendor,
+// renderer, version): editing a shader or updating the driver makes a new key, and an
+// entry the driver rejects anyway is deleted so the program is rebuilt from source and
+// stored again. The cache is off until setDirectory().
+class ProgramCache {
+
+public:
+	// where entries live; empty while the cache is off
+	std::string Directory;
+	// lookups that restored a program, found no entry, or found one that didn't load
+	unsigned int Hits, Misses, Rejected;
+
+	ProgramCache();
+
+	// creates the directory if needed; false (with an ERROR:: line) if it can't
+	bool setDirectory(const std::string& directory);
+	// a directory is set and the driver has a binary format; needs a current context
+	bool enabled();
+	// the key of a program built from these sources and defines on this driver
+	uint64_t key(const std::string& vertexSource, const std::string& fragmentSource, const std::string& defines = "");
+	// the file an entry lives in
+	std::string path(uint64_t key) const;
+
+	// restores the entry into program, a name from glCreateProgram with nothing attached;
+	// false on a miss or a rejected entry, which is removed
+	bool load(uint64_t key, unsigned int program);
+	// saves a program linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	void store(uint64_t key, unsigned int program);
+
+private:
+	// hash of the driver strings, 0 until the first key()
+	uint64_t driver;
+	// GL_NUM_PROGRAM_BINARY_FORMATS, -1 until asked
+	int formats;
+};
+
+// the program cache of the current context
+ProgramCache& programCache();
+
+#endif
@@ -0,0 +1,155 @@
+#include "renderqueue.h"
+#include "glstate.h"
+
+#include <cstring>
+#include <utility>
+
+RenderQueue::RenderQueue(unsigned int capacity) : count(0), growCount(0)
+{
+	if (capacity < 16)
+		capacity = 16;
+	packets.resize(capacity);
+	keys.resize(capacity);
+	order.resize(capacity);
+	keysTemp.resize(capacity);
+	orderTemp.resize(capacity);
+}
+
+void RenderQueue::clear()
+{
+	count = 0;
+}
+
+void RenderQueue::grow()
+{
+	size_t capacity = packets.size() * 2;
+	packets.resize(capacity);
+	keys.resize(capacity);
+	order.resize(capacity);
+	keysTemp.resize(capacity);
+	orderTemp.resize(capacity);
+	growCount++;
+}
+
+// 24 bits of depth: the bit pattern of a positive float grows with its value, so
+// dropping the sign and the low mantissa bits keeps the order
+static unsigned long long depthBits(float viewDepth)
+{
+	if (!(viewDepth > 0.0f))
+		viewDepth = 0.0f;
+	unsigned int bits;
+	std::memcpy(&bits, &viewDepth, sizeof(bits));
+	return (bits >> 7) & 0xFFFFFF;
+}
+
+// key layout, most significant first:
+//	opaque:       0 | program:12 | vao:12 | texture:12 | depth:24 | 0:3
+//	transparent:  1 | ~depth:24 | program:12 | vao:12 | texture:12 | 0:3
+// GL names are folded to 12 bits; a collision only costs sort quality, the packet keeps the real name
+unsigned long long RenderQueue::makeKey(const DrawPacket& packet, float viewDepth)
+{
+	unsigned long long program = packet.program & 0xFFF;
+	unsigned long long vao = packet.vao & 0xFFF;
+	unsigned long long texture = packet.texture & 0xFFF;
+	unsigned long long depth = depthBits(viewDepth);
+	if (!packet.transparent)
+		return (program << 51) | (vao << 39) | (texture << 27) | (depth << 3);
+	return (1ull << 63) | ((~depth & 0xFFFFFF) << 39) | (program << 27) | (vao << 15) | (texture << 3);
+}
+
+void RenderQueue::submit(const DrawPacket& packet, float viewDepth)
+{
+	if (count == packets.size())
+		grow();
+	packets[count] = packet;
+	keys[count] = makeKey(packet, viewDepth);
+	order[count] = count;
+	count++;
+}
+
+void RenderQueue::sort()
+{
+	// one pass over the keys builds all eight byte histograms
+	unsigned int histograms[8][256];
+	std::memset(histograms, 0, sizeof(histograms));
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned long long k = keys[i];
+		for (unsigned int pass = 0; pass < 8; pass++)
+			histograms[pass][(k >> (pass * 8)) & 0xFF]++;
+	}
+
+	unsigned long long* srcKeys = keys.data();
+	unsigned int* srcOrder = order.data();
+	unsigned long long* dstKeys = keysTemp.data();
+	unsigned int* dstOrder = orderTemp.data();
+	for (unsigned int pass = 0; pass < 8; pass++)
+	{
+		unsigned int* histogram = histograms[pass];
+		unsigned int shift = pass * 8;
+		// every key has the same byte here (spare bits, unused high program bits...), nothing to do
+		if (count == 0 || histogram[(srcKeys[0] >> shift) & 0xFF] == count)
+			continue;
+		unsigned int offset = 0;
+		for (unsigned int b = 0; b < 256; b++)
+		{
+			unsigned int n = histogram[b];
+			histogram[b] = offset;
+			offset += n;
+		}
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int slot = histogram[(srcKeys[i] >> shift) & 0xFF]++;
+			dstKeys[slot] = srcKeys[i];
+			dstOrder[slot] = srcOrder[i];
+		}
+		std::swap(srcKeys, dstKeys);
+		std::swap(srcOrder, dstOrder);
+	}
+	// odd number of executed passes leaves the result in the temp buffers
+	if (srcKeys != keys.data())
+	{
+		keys.swap(keysTemp);
+		order.swap(orderTemp);
+	}
+}
+
+static bool sameState(const DrawPacket& a, const DrawPacket& b)
+{
+	return a.program == b.program && a.vao == b.vao && a.texture == b.texture && a.mode == b.mode &&
+		a.first == b.first && a.count == b.count && a.indexType == b.indexType && a.transparent == b.transparent;
+}
+
+unsigned int RenderQueue::execute() const
+{
+	GLStateCache& state = glState();
+	unsigned int draws = 0;
+	for (unsigned int i = 0; i < count; )
+	{
+		const DrawPacket& p = packet(i);
+		// same mesh and state with the next transforms in line: one instanced draw
+		unsigned int run = 1;
+		while (i + run < count && packet(i + run).transform == p.transform + run && sameState(packet(i + run), p))
+			run++;
+
+		state.useProgram(p.program);
+		state.bindVertexArray(p.vao);
+		if (p.texture)
+			state.bindTexture(0, GL_TEXTURE_2D, p.texture);
+		state.setBlend(p.transparent);
+		state.setDepthWrite(!p.transparent);
+		if (p.transparent)
+			state.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		if (p.indexType)
+			glDrawElementsInstancedBaseInstance(p.mode, p.count, p.indexType, (const void*)(size_t)p.first, run, p.transform);
+		else
+			glDrawArraysInstancedBaseInstance(p.mode, p.first, p.count, run, p.transform);
+		draws++;
+		i += run;
+	}
+	// leave the opaque defaults for whoever draws next
+	state.setBlend(false);
+	state.setDepthWrite(true);
+	return draws;
+}
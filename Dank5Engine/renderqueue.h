@@ -0,0 +1,70 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <glad/glad.h>
+
+#include <vector>
+
+// Everything needed to issue one draw. The model matrix is not part of the packet: the
+// queue draws with base instance = transform, so the vertex shader reads its matrix from
+// the instance buffer bound to the VAO (see InstanceBuffer, testVertInstanced.vs).
+struct DrawPacket {
+	unsigned int program;
+	unsigned int vao;
+	// texture bound to unit 0 as GL_TEXTURE_2D (0 for none)
+	unsigned int texture;
+	// index of the object's matrix in the instance buffer
+	unsigned int transform;
+	GLenum mode;
+	// first vertex (glDrawArrays) or byte offset into the element buffer (glDrawElements)
+	GLint first;
+	GLsizei count;
+	// GL_UNSIGNED_SHORT/GL_UNSIGNED_INT for indexed meshes, 0 for glDrawArrays
+	GLenum indexType;
+	bool transparent;
+};
+
+// Per-frame draw list. Systems submit packets with their view-space depth, sort()
+// orders them by a 64-bit key with an LSD radix sort, and execute() issues them through
+// the GL state cache. Opaque packets come first, grouped by program/VAO/texture and
+// front-to-back inside a group; transparent packets follow back-to-front.
+// Storage is preallocated, so a frame that fits in the capacity does not touch the heap.
+class RenderQueue {
+
+public:
+	RenderQueue(unsigned int capacity = 4096);
+
+	// start a new frame (keeps the storage)
+	void clear();
+	// queue a packet; viewDepth is the distance along the view direction (positive in front)
+	void submit(const DrawPacket& packet, float viewDepth);
+	// order the packets by key
+	void sort();
+	// draw all packets in order; consecutive packets with the same state and
+	// consecutive transforms are merged into one instanced draw. Returns the draw calls issued
+	unsigned int execute() const;
+
+	unsigned int size() const { return count; }
+	// i-th packet in sorted order (submission order before sort())
+	const DrawPacket& packet(unsigned int i) const { return packets[order[i]]; }
+	unsigned long long key(unsigned int i) const { return keys[i]; }
+	// times submit() had to grow the storage; stays 0 in steady state
+	unsigned int growths() const { return growCount; }
+
+	// the sort key of a packet
+	static unsigned long long makeKey(const DrawPacket& packet, float viewDepth);
+
+private:
+	void grow();
+
+	std::vector<DrawPacket> packets;
+	std::vector<unsigned long long> keys;
+	std::vector<unsigned int> order;
+	// ping-pong buffers for the radix passes
+	std::vector<unsigned long long> keysTemp;
+	std::vector<unsigned int> orderTemp;
+	unsigned int count;
+	unsigned int growCount;
+};
+
+#endif
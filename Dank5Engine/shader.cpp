@@ -1,6 +1,18 @@
 #include "shader.h"
+#include "frameconstants.h"
+#include "glstate.h"
+#include "programcache.h"
+#include "shaderpermutations.h"
 
-Shader::Shader(const GLchar * vertexPath, const GLchar * fragmentPath)
+#include <cstring>
+#include <unordered_map>
+
+// KHR_parallel_shader_compile is an extension, so glad's core profile header leaves it out
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+Shader::Shader(const GLchar * vertexPath, const GLchar * fragmentPath, bool async)
 {
 	// retrieve the vertex/fragment source code from filePath
 	std::string vertexCode;
@@ -26,93 +38,417 @@ Shader::Shader(const GLchar * vertexPath, const GLchar * fragmentPath)
 		vertexCode = vShaderStream.str();
 		fragmentCode = fShaderStream.str();
 	}
-	catch (std::ifstream::failure e)
+	catch (std::ifstream::failure &e)
 	{
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 	}
-	const char* vShaderCode = vertexCode.c_str();
-	const char * fShaderCode = fragmentCode.c_str();
-	// 2. compile shaders
-	unsigned int vertex, fragment;
-	// vertex shader
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
+	build(vertexCode, fragmentCode, nullptr, async);
+}
+
+Shader::Shader(const std::string& vertexCode, const std::string& fragmentCode, ShaderStages* stages, bool async)
+{
+	build(vertexCode, fragmentCode, stages, async);
+}
+
+void Shader::build(const std::string& vertexCode, const std::string& fragmentCode, ShaderStages* stages, bool async)
+{
+	// a program linked on an earlier run comes back from the binary cache without compiling
+	ProgramCache& cache = programCache();
+	bool cached = cache.enabled();
+	cacheKey = cached ? cache.key(vertexCode, fragmentCode) : 0;
+	ID = glCreateProgram();
+	// an empty uniform table until finish(): lookups find nothing
+	uniforms.assign(1, UniformSlot{ 0, -1 });
+	uniformMask = 0;
+	uniformCount = 0;
+	finished = false;
+	compiled = !cached || !cache.load(cacheKey, ID);
+	storeBinary = compiled && cached;
+	placeholder = 0;
+	if (compiled)
+	{
+		// 2. compile shaders (finish() checks them: asking for the status here would wait
+		// for the driver)
+		unsigned int vertex, fragment;
+		if (stages)
+		{
+			vertex = stages->get(GL_VERTEX_SHADER, vertexCode);
+			fragment = stages->get(GL_FRAGMENT_SHADER, fragmentCode);
+		}
+		else
+		{
+			vertex = ShaderStages::compile(GL_VERTEX_SHADER, vertexCode);
+			fragment = ShaderStages::compile(GL_FRAGMENT_SHADER, fragmentCode);
+		}
+		// shader Program
+		glAttachShader(ID, vertex);
+		glAttachShader(ID, fragment);
+		if (storeBinary)
+			glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(ID);
+		// delete the shaders as they're linked into our program now and no longer necessary
+		// (GL keeps them until the program goes, so finish() can still read their logs);
+		// shared stages are deleted by their set
+		if (!stages)
+		{
+			glDeleteShader(vertex);
+			glDeleteShader(fragment);
+		}
+		if (async && parallelCompile())
+		{
+			placeholder = placeholderFor(vertexCode);
+			return;
+		}
+	}
+	finish();
+}
+
+bool Shader::parallelCompile()
+{
+	// per context, like the rest of the engine's GL caches: there is one context
+	static int supported = -1;
+	if (supported < 0)
+	{
+		supported = 0;
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (name && (strcmp(name, "GL_KHR_parallel_shader_compile") == 0 || strcmp(name, "GL_ARB_parallel_shader_compile") == 0))
+				supported = 1;
+		}
+	}
+	return supported == 1;
+}
+
+bool Shader::ready()
+{
+	if (finished)
+		return true;
+	GLint done = GL_TRUE;
+	if (parallelCompile())
+		glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+	if (!done)
+		return false;
+	finish();
+	return true;
+}
+
+void Shader::finish()
+{
+	if (finished)
+		return;
+	finished = true;
+	if (compiled)
+	{
+		GLint linked = GL_FALSE;
+		glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+		if (linked && storeBinary)
+			programCache().store(cacheKey, ID);
+		if (!linked)
+		{
+			// the compile logs say more than the link log about a shader that didn't compile
+			GLuint shaders[2];
+			GLsizei count = 0;
+			glGetAttachedShaders(ID, 2, &count, shaders);
+			for (GLsizei i = 0; i < count; i++)
+			{
+				GLint type = 0;
+				glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+				checkCompileErrors(shaders[i], type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT");
+			}
+			checkCompileErrors(ID, "PROGRAM");
+		}
+	}
+	// look every uniform location up once, the setters only hit the table afterwards
+	cacheUniforms();
+	// programs using the per-frame constants all read them from the same binding point
+	bindFrameConstants(ID);
+}
+
+unsigned int Shader::program()
+{
+	return ready() ? ID : placeholder;
+}
+
+void Shader::use()
+{
+	finish();
+	glState().useProgram(ID);
+}
+
+void Shader::replaceProgram(unsigned int program)
+{
+	// whatever was still linking is dropped with the program
+	finish();
+	glState().deleteProgram(ID);
+	ID = program;
+	compiled = false;
+	storeBinary = false;
+	cacheUniforms();
+	bindFrameConstants(ID);
+}
+
+// shared by every program built from the same vertex shader, by its source
+static std::unordered_map<std::string, unsigned int>& placeholders()
+{
+	static std::unordered_map<std::string, unsigned int> programs;
+	return programs;
+}
+
+void Shader::bindFrameConstants(unsigned int program)
+{
+	GLuint frameBlock = glGetUniformBlockIndex(program, "FrameConstants");
+	if (frameBlock != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, frameBlock, FRAME_CONSTANTS_BINDING);
+}
+
+unsigned int Shader::placeholderFor(const std::string& vertexCode)
+{
+	unsigned int& program = placeholders()[vertexCode];
+	if (program)
+		return program;
+	// built synchronously, but only once per vertex shader and with a trivial fragment shader
+	static const char* flatFragment =
+		"#version 330 core\n"
+		"out vec4 FragColor;\n"
+		"void main()\n"
+		"{\n"
+		"    FragColor = vec4(0.5, 0.5, 0.5, 1.0);\n"
+		"}\n";
+	unsigned int vertex = ShaderStages::compile(GL_VERTEX_SHADER, vertexCode);
 	checkCompileErrors(vertex, "VERTEX");
-	// fragment Shader
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
-	glCompileShader(fragment);
+	unsigned int fragment = ShaderStages::compile(GL_FRAGMENT_SHADER, flatFragment);
 	checkCompileErrors(fragment, "FRAGMENT");
-	// shader Program
-	ID = glCreateProgram();
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
-	glLinkProgram(ID);
-	checkCompileErrors(ID, "PROGRAM");
-	// delete the shaders as they're linked into our program now and no longer necessary
+	program = glCreateProgram();
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+	glLinkProgram(program);
+	checkCompileErrors(program, "PROGRAM");
 	glDeleteShader(vertex);
 	glDeleteShader(fragment);
+	bindFrameConstants(program);
+	return program;
 }
 
-void Shader::use()
+void Shader::destroyPlaceholders()
 {
-	glUseProgram(ID);
+	for (auto& entry : placeholders())
+		glState().deleteProgram(entry.second);
+	placeholders().clear();
 }
 
-void Shader::setBool(const std::string & name, bool value) const
+void Shader::cacheUniforms()
+{
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	// entries: one per uniform, plus "name" and every "name[i]" of arrays
+	std::vector<char> buffer(maxLength + 1);
+	std::vector<std::string> names(count);
+	std::vector<GLint> sizes(count);
+	unsigned int entries = 0;
+	for (GLint i = 0; i < count; i++)
+	{
+		GLenum type;
+		glGetActiveUniform(ID, (GLuint)i, maxLength + 1, NULL, &sizes[i], &type, buffer.data());
+		names[i] = buffer.data();
+		entries += names[i].find('[') != std::string::npos ? 1 + sizes[i] : 1;
+	}
+
+	// power of two with at most 50% load so probe chains stay short
+	unsigned int slots = 8;
+	while (slots < entries * 2)
+		slots *= 2;
+	uniforms.assign(slots, UniformSlot{ 0, -1 });
+	uniformMask = slots - 1;
+	uniformCount = 0;
+
+	for (GLint i = 0; i < count; i++)
+	{
+		const std::string& name = names[i];
+		GLint size = sizes[i];
+		GLint location = glGetUniformLocation(ID, name.c_str());
+		// uniforms inside blocks have no location
+		if (location < 0)
+			continue;
+		insertUniform(name, location);
+		// arrays are reported as "name[0]", also accept "name" and every "name[i]"
+		std::string::size_type bracket = name.find('[');
+		if (bracket != std::string::npos)
+		{
+			std::string base = name.substr(0, bracket);
+			insertUniform(base, location);
+			for (GLint element = 1; element < size; element++)
+			{
+				std::string elementName = base + "[" + std::to_string(element) + "]";
+				insertUniform(elementName, glGetUniformLocation(ID, elementName.c_str()));
+			}
+		}
+	}
+}
+
+void Shader::insertUniform(const std::string &name, GLint location)
+{
+	if (location < 0)
+		return;
+	unsigned int hash = UniformName(name).hash;
+	// at 50% load double the table first, so lookups always reach an empty slot
+	if ((uniformCount + 1) * 2 > uniforms.size())
+		growUniforms();
+	for (unsigned int i = hash & uniformMask; ; i = (i + 1) & uniformMask)
+	{
+		if (uniforms[i].location < 0)
+		{
+			uniforms[i].hash = hash;
+			uniforms[i].location = location;
+			uniformCount++;
+			return;
+		}
+		if (uniforms[i].hash == hash)
+		{
+			if (uniforms[i].location != location)
+				std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION " << name << std::endl;
+			return;
+		}
+	}
+}
+
+void Shader::growUniforms()
+{
+	std::vector<UniformSlot> old;
+	old.swap(uniforms);
+	uniforms.assign(old.size() * 2, UniformSlot{ 0, -1 });
+	uniformMask = (unsigned int)uniforms.size() - 1;
+	for (const UniformSlot& slot : old)
+	{
+		if (slot.location < 0)
+			continue;
+		unsigned int j = slot.hash & uniformMask;
+		while (uniforms[j].location >= 0)
+			j = (j + 1) & uniformMask;
+		uniforms[j] = slot;
+	}
+}
+
+GLint Shader::uniform(UniformName name) const
+{
+	// bounded by the table size, should it ever fill up
+	for (unsigned int i = name.hash & uniformMask, probes = 0; probes <= uniformMask; i = (i + 1) & uniformMask, probes++)
+	{
+		const UniformSlot& slot = uniforms[i];
+		if (slot.hash == name.hash && slot.location >= 0)
+			return slot.location;
+		if (slot.location < 0)
+			return -1;
+	}
+	return -1;
+}
+
+void Shader::setBool(UniformName name, bool value) const
+{
+	setBool(uniform(name), value);
+}
+void Shader::setInt(UniformName name, int value) const
+{
+	setInt(uniform(name), value);
+}
+void Shader::setFloat(UniformName name, float value) const
+{
+	setFloat(uniform(name), value);
+}
+void Shader::setVec2(UniformName name, const glm::vec2 &value) const
+{
+	setVec2(uniform(name), value);
+}
+void Shader::setVec2(UniformName name, float x, float y) const
+{
+	setVec2(uniform(name), x, y);
+}
+void Shader::setVec3(UniformName name, const glm::vec3 &value) const
+{
+	setVec3(uniform(name), value);
+}
+void Shader::setVec3(UniformName name, float x, float y, float z) const
+{
+	setVec3(uniform(name), x, y, z);
+}
+void Shader::setVec4(UniformName name, const glm::vec4 &value) const
+{
+	setVec4(uniform(name), value);
+}
+void Shader::setVec4(UniformName name, float x, float y, float z, float w) const
+{
+	setVec4(uniform(name), x, y, z, w);
+}
+void Shader::setMat2(UniformName name, const glm::mat2 &mat) const
+{
+	setMat2(uniform(name), mat);
+}
+void Shader::setMat3(UniformName name, const glm::mat3 &mat) const
+{
+	setMat3(uniform(name), mat);
+}
+void Shader::setMat4(UniformName name, const glm::mat4 &mat) const
+{
+	setMat4(uniform(name), mat);
+}
+// ------------------------------------------------------------------------
+void Shader::setBool(GLint location, bool value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	glUniform1i(location, (int)value);
 }
 
-void Shader::setInt(const std::string & name, int value) const
+void Shader::setInt(GLint location, int value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform1i(location, value);
 }
 
-void Shader::setFloat(const std::string & name, float value) const
+void Shader::setFloat(GLint location, float value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform1f(location, value);
 }
 
-void Shader::setVec2(const std::string &name, const glm::vec2 &value) const
+void Shader::setVec2(GLint location, const glm::vec2 &value) const
 {
-	glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	glUniform2fv(location, 1, &value[0]);
 }
-void Shader::setVec2(const std::string &name, float x, float y) const
+void Shader::setVec2(GLint location, float x, float y) const
 {
-	glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+	glUniform2f(location, x, y);
 }
 // ------------------------------------------------------------------------
-void Shader::setVec3(const std::string &name, const glm::vec3 &value) const
+void Shader::setVec3(GLint location, const glm::vec3 &value) const
 {
-	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	glUniform3fv(location, 1, &value[0]);
 }
-void Shader::setVec3(const std::string &name, float x, float y, float z) const
+void Shader::setVec3(GLint location, float x, float y, float z) const
 {
-	glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+	glUniform3f(location, x, y, z);
 }
 // ------------------------------------------------------------------------
-void Shader::setVec4(const std::string &name, const glm::vec4 &value) const
+void Shader::setVec4(GLint location, const glm::vec4 &value) const
 {
-	glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	glUniform4fv(location, 1, &value[0]);
 }
-void Shader::setVec4(const std::string &name, float x, float y, float z, float w) const
+void Shader::setVec4(GLint location, float x, float y, float z, float w) const
 {
-	glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+	glUniform4f(location, x, y, z, w);
 }
 // ------------------------------------------------------------------------
-void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const
+void Shader::setMat2(GLint location, const glm::mat2 &mat) const
 {
-	glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
 }
 // ------------------------------------------------------------------------
-void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const
+void Shader::setMat3(GLint location, const glm::mat3 &mat) const
 {
-	glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
 }
 // ------------------------------------------------------------------------
-void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const
+void Shader::setMat4(GLint location, const glm::mat4 &mat) const
 {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
 }
@@ -4,11 +4,30 @@
 #include <glad/glad.h> // include glad to get all the required OpenGL headers
 #include <glm/glm.hpp> // include glm for maths
 
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// A uniform name reduced to its FNV-1a hash. Built implicitly from a literal or a
+// std::string, so setters never allocate; declare one constexpr to hash at compile time:
+//	constexpr UniformName uModel("model");
+struct UniformName
+{
+	unsigned int hash;
+
+	constexpr UniformName(const char* name) : hash(fnv1a(name, 2166136261u)) {}
+	UniformName(const std::string& name) : hash(fnv1a(name.c_str(), 2166136261u)) {}
+
+	static constexpr unsigned int fnv1a(const char* s, unsigned int h)
+	{
+		return *s ? fnv1a(s + 1, (h ^ (unsigned char)*s) * 16777619u) : h;
+	}
+};
+
+class ShaderStages;
 
 class Shader
 {
@@ -16,26 +35,92 @@ public:
 	// the program ID
 	unsigned int ID;
 
-	// constructor reads and builds the shader
-	Shader(const GLchar* vertexPath, const GLchar* fragmentPath);
-	// use/activate the shader
+	// constructor reads and builds the shader, or restores it from programCache() when
+	// the same sources were linked before. With async the compile and link are only
+	// submitted: the driver works on them in the background (KHR_parallel_shader_compile)
+	// while the caller goes on, e.g. submitting more programs or loading assets. Without
+	// the extension async changes nothing.
+	Shader(const GLchar* vertexPath, const GLchar* fragmentPath, bool async = false);
+	// the same from sources already in memory; with stages, the vertex and fragment
+	// shaders come from (and stay in) that set, so programs sharing a stage compile it once
+	Shader(const std::string& vertexCode, const std::string& fragmentCode, ShaderStages* stages, bool async = false);
+	// the program is linked, never waits for the driver; true once finish() ran
+	bool ready();
+	// waits for the link if it is still running, reports errors and fills the uniform
+	// table; use() calls it, so a program blocks at the latest when first used
+	void finish();
+	// the program to draw with without waiting: ID once ready(), until then a flat grey
+	// placeholder linked from the same vertex shader (uniforms set by the setters only
+	// reach ID, so the placeholder suits vertex shaders fed by attributes and blocks)
+	unsigned int program();
+	// use/activate the shader, waiting for it to link
 	void use();
-	// utility uniform functions
-	void setBool(const std::string &name, bool value) const;
-	void setInt(const std::string &name, int value) const;
-	void setFloat(const std::string &name, float value) const;
-	void setVec2(const std::string & name, const glm::vec2 & value) const;
-	void setVec2(const std::string & name, float x, float y) const;
-	void setVec3(const std::string & name, const glm::vec3 & value) const;
-	void setVec3(const std::string & name, float x, float y, float z) const;
-	void setVec4(const std::string & name, const glm::vec4 & value) const;
-	void setVec4(const std::string & name, float x, float y, float z, float w) const;
-	void setMat2(const std::string & name, const glm::mat2 & mat) const;
-	void setMat3(const std::string & name, const glm::mat3 & mat) const;
-	void setMat4(const std::string & name, const glm::mat4 & mat) const;
+	// swaps in a program linked from newer sources elsewhere (see ShaderReloader): the old
+	// program is deleted and the uniform table rebuilt, so values set once (samplers,
+	// constants) have to be set again
+	void replaceProgram(unsigned int program);
+	// whether the driver compiles in the background; needs a current context
+	static bool parallelCompile();
+	// delete the placeholder programs (while the context lives)
+	static void destroyPlaceholders();
+	// location of an active uniform (-1 if the program has no such uniform), resolve
+	// once and pass the location to the setters to skip even the table lookup
+	GLint uniform(UniformName name) const;
+	// utility uniform functions, by name (hashed table lookup, no GL query)
+	void setBool(UniformName name, bool value) const;
+	void setInt(UniformName name, int value) const;
+	void setFloat(UniformName name, float value) const;
+	void setVec2(UniformName name, const glm::vec2 & value) const;
+	void setVec2(UniformName name, float x, float y) const;
+	void setVec3(UniformName name, const glm::vec3 & value) const;
+	void setVec3(UniformName name, float x, float y, float z) const;
+	void setVec4(UniformName name, const glm::vec4 & value) const;
+	void setVec4(UniformName name, float x, float y, float z, float w) const;
+	void setMat2(UniformName name, const glm::mat2 & mat) const;
+	void setMat3(UniformName name, const glm::mat3 & mat) const;
+	void setMat4(UniformName name, const glm::mat4 & mat) const;
+	// utility uniform functions, by location from uniform()
+	void setBool(GLint location, bool value) const;
+	void setInt(GLint location, int value) const;
+	void setFloat(GLint location, float value) const;
+	void setVec2(GLint location, const glm::vec2 & value) const;
+	void setVec2(GLint location, float x, float y) const;
+	void setVec3(GLint location, const glm::vec3 & value) const;
+	void setVec3(GLint location, float x, float y, float z) const;
+	void setVec4(GLint location, const glm::vec4 & value) const;
+	void setVec4(GLint location, float x, float y, float z, float w) const;
+	void setMat2(GLint location, const glm::mat2 & mat) const;
+	void setMat3(GLint location, const glm::mat3 & mat) const;
+	void setMat4(GLint location, const glm::mat4 & mat) const;
 
 private:
-	void checkCompileErrors(unsigned int shader, std::string type)
+	// open addressing table of the program's active uniforms, filled after linking
+	struct UniformSlot
+	{
+		unsigned int hash;
+		GLint location; // -1 marks an empty slot
+	};
+	std::vector<UniformSlot> uniforms;
+	unsigned int uniformMask;
+	// occupied slots, kept at most half of the table
+	unsigned int uniformCount;
+	// finish() ran; compiled from source (not restored), so the link status is unknown
+	bool finished, compiled;
+	// a linked program from source goes into programCache() under this key
+	bool storeBinary;
+	uint64_t cacheKey;
+	unsigned int placeholder;
+
+	void build(const std::string& vertexCode, const std::string& fragmentCode, ShaderStages* stages, bool async);
+	static unsigned int placeholderFor(const std::string& vertexCode);
+	static void bindFrameConstants(unsigned int program);
+
+	void cacheUniforms();
+	void insertUniform(const std::string &name, GLint location);
+	void growUniforms();
+
+	// true if the shader compiled or the program linked
+	static bool checkCompileErrors(unsigned int shader, std::string type)
 	{
 		int success;
 		char infoLog[1024];
@@ -57,6 +142,7 @@ private:
 				std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
 			}
 		}
+		return success != 0;
 	}
 };
 
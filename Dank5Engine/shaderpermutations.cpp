@@ -0,0 +1,299 @@
+#include "shaderpermutations.h"
+#include "glstate.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+static const struct {
+	unsigned int bit;
+	const char* name;
+} SHADER_FEATURES[] = {
+	{ SHADER_INSTANCING, "INSTANCING" },
+	{ SHADER_SKINNING, "SKINNING" },
+	{ SHADER_FOG, "FOG" },
+	{ SHADER_ALPHA_TEST, "ALPHA_TEST" }
+};
+
+static bool isIdentifier(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// "ifdef" and "NAME" out of "  #  ifdef NAME // comment"; empty unless the line is a directive
+static void parseDirective(const std::string& line, std::string& directive, std::string& expression)
+{
+	directive.clear();
+	expression.clear();
+	size_t i = line.find_first_not_of(" \t");
+	if (i == std::string::npos || line[i] != '#')
+		return;
+	i = line.find_first_not_of(" \t", i + 1);
+	if (i == std::string::npos)
+		return;
+	size_t end = i;
+	while (end < line.size() && isIdentifier(line[end]))
+		end++;
+	directive = line.substr(i, end - i);
+	// whitespace dropped, so "defined ( FOG )" reads "defined(FOG)"
+	size_t comment = line.find("//", end);
+	for (size_t j = end; j < line.size() && j < comment; j++)
+		if (line[j] != ' ' && line[j] != '\t' && line[j] != '\r' && line[j] != '\n')
+			expression += line[j];
+}
+
+// whether a conditional tests a single feature, and if so its outcome for features:
+// "NAME" after #ifdef/#ifndef; "defined(NAME)", "defined NAME" or their negation after #if/#elif
+static bool featureTest(const std::string& directive, std::string expression, unsigned int features, bool& result)
+{
+	bool negate = directive == "ifndef";
+	if (directive == "if" || directive == "elif")
+	{
+		if (!expression.empty() && expression[0] == '!')
+		{
+			negate = true;
+			expression.erase(0, 1);
+		}
+		if (expression.compare(0, 7, "defined") != 0)
+			return false;
+		expression.erase(0, 7);
+		if (!expression.empty() && expression[0] == '(')
+		{
+			if (expression.back() != ')')
+				return false;
+			expression = expression.substr(1, expression.size() - 2);
+		}
+	}
+	for (const auto& feature : SHADER_FEATURES)
+		if (expression == feature.name)
+		{
+			result = ((features & feature.bit) != 0) != negate;
+			return true;
+		}
+	return false;
+}
+
+// name appears in source as a whole identifier
+static bool mentions(const std::string& source, const char* name)
+{
+	size_t length = strlen(name);
+	for (size_t at = source.find(name); at != std::string::npos; at = source.find(name, at + 1))
+		if ((at == 0 || !isIdentifier(source[at - 1])) && (at + length == source.size() || !isIdentifier(source[at + length])))
+			return true;
+	return false;
+}
+
+std::string ShaderPermutations::resolve(const std::string& source, unsigned int features)
+{
+	// one per open #if; feature conditionals are dropped from the output, the others are
+	// left to the compiler
+	struct Branch {
+		bool feature;
+		// lines around the conditional are kept; one of its branches was taken
+		bool outerActive, taken;
+	};
+	std::vector<Branch> branches;
+	bool active = true;
+	std::string out, directive, expression;
+	out.reserve(source.size());
+	for (size_t pos = 0; pos < source.size(); )
+	{
+		size_t end = source.find('\n', pos);
+		end = end == std::string::npos ? source.size() : end + 1;
+		std::string line = source.substr(pos, end - pos);
+		pos = end;
+
+		parseDirective(line, directive, expression);
+		bool keep = active, test = false;
+		if (directive == "ifdef" || directive == "ifndef" || directive == "if")
+		{
+			bool feature = featureTest(directive, expression, features, test);
+			branches.push_back(Branch{ feature, active, feature && test });
+			if (feature)
+			{
+				active = active && test;
+				keep = false;
+			}
+		}
+		else if ((directive == "elif" || directive == "else") && !branches.empty() && branches.back().feature)
+		{
+			Branch& branch = branches.back();
+			if (directive == "else")
+				test = true;
+			else if (!featureTest(directive, expression, features, test))
+				std::cout << "ERROR::SHADERPERMUTATIONS::MIXED_CONDITIONAL #elif " << expression << " follows a feature test" << std::endl;
+			active = branch.outerActive && !branch.taken && test;
+			branch.taken = branch.taken || test;
+			keep = false;
+		}
+		else if (directive == "endif" && !branches.empty())
+		{
+			if (branches.back().feature)
+			{
+				active = branches.back().outerActive;
+				keep = false;
+			}
+			branches.pop_back();
+		}
+		// dropped lines stay as empty ones, so compile errors point at the template's lines
+		if (keep)
+			out += line;
+		else if (line.back() == '\n')
+			out += '\n';
+	}
+	if (!branches.empty())
+		std::cout << "ERROR::SHADERPERMUTATIONS::UNTERMINATED_CONDITIONAL" << std::endl;
+
+	// features still named (e.g. in an expression the resolver leaves alone) get defined,
+	// the rest don't, so they can't make otherwise equal sources differ
+	std::string defines;
+	for (const auto& feature : SHADER_FEATURES)
+		if ((features & feature.bit) && mentions(out, feature.name))
+			defines += std::string("#define ") + feature.name + "\n";
+	if (!defines.empty())
+	{
+		// right after #version, which has to come first
+		size_t at = 0, version = out.find("#version");
+		if (version != std::string::npos)
+		{
+			at = out.find('\n', version);
+			if (at == std::string::npos)
+			{
+				out += '\n';
+				at = out.size() - 1;
+			}
+			at++;
+		}
+		out.insert(at, defines);
+	}
+	return out;
+}
+
+ShaderStages::ShaderStages() : Compiled(0), Shared(0)
+{
+}
+
+unsigned int ShaderStages::compile(GLenum type, const std::string& code)
+{
+	const char* source = code.c_str();
+	unsigned int shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	return shader;
+}
+
+unsigned int ShaderStages::get(GLenum type, const std::string& code)
+{
+	unsigned int& stage = stages[type == GL_VERTEX_SHADER ? 0 : 1][code];
+	if (stage)
+	{
+		Shared++;
+		return stage;
+	}
+	stage = compile(type, code);
+	Compiled++;
+	return stage;
+}
+
+void ShaderStages::destroy()
+{
+	for (auto& byType : stages)
+	{
+		for (auto& entry : byType)
+			glDeleteShader(entry.second);
+		byType.clear();
+	}
+}
+
+static std::string readTemplate(const GLchar* path)
+{
+	std::ifstream file;
+	file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	try
+	{
+		file.open(path);
+		std::stringstream stream;
+		stream << file.rdbuf();
+		return stream.str();
+	}
+	catch (std::ifstream::failure &e)
+	{
+		std::cout << "ERROR::SHADERPERMUTATIONS::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		return "";
+	}
+}
+
+ShaderPermutations::ShaderPermutations(const GLchar* vertexPath, const GLchar* fragmentPath, bool async)
+	: vertexPath(vertexPath), fragmentPath(fragmentPath), vertexTemplate(readTemplate(vertexPath)),
+	fragmentTemplate(readTemplate(fragmentPath)), async(async), milliseconds(0.0)
+{
+}
+
+void ShaderPermutations::setTemplates(const std::string& vertexCode, const std::string& fragmentCode)
+{
+	vertexTemplate = vertexCode;
+	fragmentTemplate = fragmentCode;
+	// the programs now run the new sources, so those are what a later get() matches
+	bySource.clear();
+	for (auto& entry : byFeatures)
+	{
+		std::string key = resolve(vertexTemplate, entry.first);
+		key += '\0';
+		key += resolve(fragmentTemplate, entry.first);
+		bySource.insert(std::make_pair(key, entry.second));
+	}
+}
+
+Shader& ShaderPermutations::get(unsigned int features)
+{
+	auto found = byFeatures.find(features);
+	if (found != byFeatures.end())
+		return *found->second;
+
+	auto start = std::chrono::steady_clock::now();
+	std::string vertexCode = resolve(vertexTemplate, features);
+	std::string fragmentCode = resolve(fragmentTemplate, features);
+	std::string key = vertexCode;
+	key += '\0';
+	key += fragmentCode;
+	Shader*& shader = bySource[key];
+	if (!shader)
+	{
+		programs.emplace_back(vertexCode, fragmentCode, &stages, async);
+		shader = &programs.back();
+	}
+	byFeatures[features] = shader;
+	milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return *shader;
+}
+
+PermutationReport ShaderPermutations::report() const
+{
+	PermutationReport report;
+	report.featureSets = (unsigned int)byFeatures.size();
+	report.programs = (unsigned int)programs.size();
+	report.stagesCompiled = stages.Compiled;
+	report.stagesShared = stages.Shared;
+	report.milliseconds = milliseconds;
+	return report;
+}
+
+void ShaderPermutations::destroy()
+{
+	for (Shader& shader : programs)
+		glState().deleteProgram(shader.ID);
+	programs.clear();
+	byFeatures.clear();
+	bySource.clear();
+	stages.destroy();
+}
+
+void PermutationReport::print(const char* name) const
+{
+	std::cout << "SHADER::" << name << " feature sets " << featureSets << " -> programs " << programs
+		<< ", stages compiled " << stagesCompiled << " (shared " << stagesShared << ") in "
+		<< milliseconds << " ms" << std::endl;
+}
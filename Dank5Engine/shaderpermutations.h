@@ -0,0 +1,98 @@
+#ifndef SHADERPERMUTATIONS_H
+#define SHADERPERMUTATIONS_H
+
+#include "shader.h"
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+// Variants of one vertex/fragment template, switched by features. A template marks
+// feature code with #ifdef NAME / #ifndef NAME / #if defined(NAME) / #if !defined(NAME)
+// (with #elif and #else) on the names below; those conditionals are resolved before
+// compiling, and a feature the template still names outside them is #defined after the
+// #version line. Feature sets whose resolved sources are equal share one program, and
+// programs whose vertex (or fragment) sources are equal share that compiled stage, so a
+// feature one stage ignores doesn't compile it again. Only requested sets are built.
+
+enum ShaderFeature {
+	// "INSTANCING": the model matrix comes per instance (locations 2-5), see InstanceBuffer
+	SHADER_INSTANCING = 1 << 0,
+	// "SKINNING": joint indices and weights at locations 6 and 7, uniform mat4 joints[]
+	SHADER_SKINNING = 1 << 1,
+	// "FOG": exponential fog by view depth, uniforms fogColor and fogDensity
+	SHADER_FOG = 1 << 2,
+	// "ALPHA_TEST": discard texels below uniform alphaCutoff
+	SHADER_ALPHA_TEST = 1 << 3
+};
+
+// Compiled shader stages by source, deleted together by destroy()
+class ShaderStages {
+
+public:
+	// stages compiled, and requests answered with an already compiled one
+	unsigned int Compiled, Shared;
+
+	ShaderStages();
+
+	// the stage built from this source, compiled on the first request; errors show when a
+	// program linked from it is finished
+	unsigned int get(GLenum type, const std::string& code);
+	void destroy();
+
+	// a new shader object with the compile submitted (the status isn't asked for)
+	static unsigned int compile(GLenum type, const std::string& code);
+
+private:
+	// vertex, fragment
+	std::unordered_map<std::string, unsigned int> stages[2];
+};
+
+struct PermutationReport {
+	// distinct feature sets asked for, and the programs they needed
+	unsigned int featureSets;
+	unsigned int programs;
+	// stages compiled, and shared between programs instead
+	unsigned int stagesCompiled;
+	unsigned int stagesShared;
+	// spent resolving, compiling and linking (with async, submitting)
+	double milliseconds;
+
+	// one line on std::cout: "SHADER::<name> feature sets n -> programs m, stages ..."
+	void print(const char* name) const;
+};
+
+class ShaderPermutations {
+
+public:
+	// reads the templates; nothing is compiled until get()
+	ShaderPermutations(const GLchar* vertexPath, const GLchar* fragmentPath, bool async = false);
+
+	// the program for a set of ShaderFeature bits, built on the first request for a set
+	// with these resolved sources (with async, only submitted: see Shader)
+	Shader& get(unsigned int features);
+	PermutationReport report() const;
+	// deletes the programs and stages (while the context lives)
+	void destroy();
+
+	// source with the feature conditionals resolved for features
+	static std::string resolve(const std::string& source, unsigned int features);
+
+private:
+	friend class ShaderReloader;
+	std::string vertexPath, fragmentPath;
+	std::string vertexTemplate, fragmentTemplate;
+	bool async;
+	ShaderStages stages;
+	// a deque so the references get() hands out stay put
+	std::deque<Shader> programs;
+	std::unordered_map<unsigned int, Shader*> byFeatures;
+	// by resolved vertex and fragment source
+	std::unordered_map<std::string, Shader*> bySource;
+	double milliseconds;
+
+	// new template text (a reload): later get() calls resolve it
+	void setTemplates(const std::string& vertexCode, const std::string& fragmentCode);
+};
+
+#endif
@@ -0,0 +1,444 @@
+#include "shaderreload.h"
+#include "glstate.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// how often file times are compared without inotify
+static const double POLL_INTERVAL_MS = 500.0;
+
+static double nowMs()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// "directory/name", "./name" for a bare name, so watched paths and inotify events compare equal
+static std::string normalPath(const std::string& path)
+{
+	std::string::size_type slash = path.find_last_of("/\\");
+	if (slash == std::string::npos)
+		return "./" + path;
+	return path.substr(0, slash) + "/" + path.substr(slash + 1);
+}
+
+// modification time, -1 if the file can't be found
+static long long modified(const std::string& path)
+{
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return -1;
+	return (long long)info.st_mtime;
+}
+
+static bool readFile(const std::string& path, std::string& text)
+{
+	std::ifstream file(path.c_str());
+	if (!file)
+	{
+		std::cout << "ERROR::SHADERRELOAD::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		return false;
+	}
+	std::stringstream stream;
+	stream << file.rdbuf();
+	text = stream.str();
+	return true;
+}
+
+// true if the stage compiled (or the program linked), else prints its log
+static bool succeeded(unsigned int object, bool program, const std::string& what)
+{
+	GLint success = GL_FALSE;
+	if (program)
+		glGetProgramiv(object, GL_LINK_STATUS, &success);
+	else
+		glGetShaderiv(object, GL_COMPILE_STATUS, &success);
+	if (success)
+		return true;
+	char infoLog[1024];
+	if (program)
+		glGetProgramInfoLog(object, sizeof(infoLog), NULL, infoLog);
+	else
+		glGetShaderInfoLog(object, sizeof(infoLog), NULL, infoLog);
+	std::cout << "ERROR::SHADERRELOAD::" << (program ? "LINK " : "COMPILE ") << what << " (the old program stays)\n"
+		<< infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+	return false;
+}
+
+ShaderReloader::ShaderReloader() : Reloaded(0), Failed(0), lastPoll(0.0), notify(-1), warmVAO(0), running(false), stopping(false)
+{
+#ifdef __linux__
+	notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (notify < 0)
+		std::cout << "ERROR::SHADERRELOAD::INOTIFY_FAILED, polling file times instead" << std::endl;
+#endif
+}
+
+ShaderReloader::~ShaderReloader()
+{
+	if (loader.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		loader.join();
+	}
+#ifdef __linux__
+	if (notify >= 0)
+		close(notify);
+#endif
+}
+
+bool ShaderReloader::start(std::function<bool()> makeCurrent, std::function<void()> release)
+{
+	if (running)
+		return true;
+	// -1 until the loader knows whether it got its context
+	int started = -1;
+	stopping = false;
+	loader = std::thread(&ShaderReloader::loaderMain, this, makeCurrent, release, std::ref(started));
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		wake.wait(lock, [&] { return started >= 0; });
+	}
+	if (!started)
+	{
+		loader.join();
+		std::cout << "ERROR::SHADERRELOAD::NO_LOADER_CONTEXT, rebuilding on the render thread" << std::endl;
+		return false;
+	}
+	running = true;
+	return true;
+}
+
+void ShaderReloader::stop()
+{
+	if (loader.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		loader.join();
+	}
+	running = false;
+	queue.clear();
+	for (Batch& batch : batches)
+		for (auto& job : batch)
+		{
+			if (job->program)
+				glState().deleteProgram(job->program);
+			if (job->fence)
+				glDeleteSync(job->fence);
+		}
+	batches.clear();
+	if (warmVAO)
+		glState().deleteVertexArrays(1, &warmVAO);
+	warmVAO = 0;
+}
+
+void ShaderReloader::loaderMain(std::function<bool()> makeCurrent, std::function<void()> release, int& started)
+{
+	bool current = makeCurrent();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		started = current ? 1 : 0;
+	}
+	wake.notify_all();
+	if (!current)
+		return;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		wake.wait(lock, [this] { return stopping || !queue.empty(); });
+		if (stopping)
+			break;
+		Job* job = queue.front();
+		queue.pop_front();
+		lock.unlock();
+		build(*job);
+		lock.lock();
+	}
+	lock.unlock();
+	release();
+}
+
+void ShaderReloader::build(Job& job)
+{
+	// runs on the loader context, which has no state cache: plain GL calls only
+	job.program = 0;
+	job.linked = false;
+	job.fence = 0;
+	if (readFile(job.vertexPath, job.vertexTemplate) && readFile(job.fragmentPath, job.fragmentTemplate))
+	{
+		std::string vertexCode = job.vertexTemplate, fragmentCode = job.fragmentTemplate;
+		if (job.permutations)
+		{
+			vertexCode = ShaderPermutations::resolve(vertexCode, job.features);
+			fragmentCode = ShaderPermutations::resolve(fragmentCode, job.features);
+		}
+		unsigned int vertex = ShaderStages::compile(GL_VERTEX_SHADER, vertexCode);
+		unsigned int fragment = ShaderStages::compile(GL_FRAGMENT_SHADER, fragmentCode);
+		// both, so every error of a save shows at once
+		bool compiled = succeeded(vertex, false, job.vertexPath);
+		compiled = succeeded(fragment, false, job.fragmentPath) && compiled;
+		unsigned int program = glCreateProgram();
+		if (compiled)
+		{
+			glAttachShader(program, vertex);
+			glAttachShader(program, fragment);
+			glLinkProgram(program);
+			job.linked = succeeded(program, true, job.vertexPath + " + " + job.fragmentPath);
+		}
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		if (job.linked)
+		{
+			// the render context may only use the program once this has passed
+			job.program = program;
+			job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			glFlush();
+		}
+		else
+			glDeleteProgram(program);
+	}
+	job.done.store(true, std::memory_order_release);
+}
+
+void ShaderReloader::warm(unsigned int program)
+{
+	// an empty VAO: every vertex reads the same constant attributes, so the triangle has no
+	// area and nothing is drawn, whatever the program does with them
+	if (!warmVAO)
+		glGenVertexArrays(1, &warmVAO);
+	// through the state cache, so the frame's own binds aren't skipped afterwards
+	glState().bindVertexArray(warmVAO);
+	glState().useProgram(program);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void ShaderReloader::watch(Shader& shader, const std::string& vertexPath, const std::string& fragmentPath)
+{
+	sources.push_back(Source{ &shader, nullptr, vertexPath, fragmentPath });
+	watchFile(vertexPath);
+	watchFile(fragmentPath);
+}
+
+void ShaderReloader::watch(ShaderPermutations& permutations)
+{
+	sources.push_back(Source{ nullptr, &permutations, permutations.vertexPath, permutations.fragmentPath });
+	watchFile(permutations.vertexPath);
+	watchFile(permutations.fragmentPath);
+}
+
+void ShaderReloader::watchFile(const std::string& file)
+{
+	std::string path = normalPath(file);
+	if (files.count(path))
+		return;
+	files[path] = modified(path);
+#ifdef __linux__
+	if (notify < 0)
+		return;
+	// the directory rather than the file: editors that save by renaming a new file over the
+	// old one would end a watch on the file itself
+	std::string directory = path.substr(0, path.rfind('/'));
+	for (auto& entry : directories)
+		if (entry.second == directory)
+			return;
+	int descriptor = inotify_add_watch(notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (descriptor < 0)
+	{
+		std::cout << "ERROR::SHADERRELOAD::CANT_WATCH " << directory << ", polling file times instead" << std::endl;
+		close(notify);
+		notify = -1;
+		directories.clear();
+		return;
+	}
+	directories[descriptor] = directory;
+#endif
+}
+
+std::vector<std::string> ShaderReloader::changedFiles()
+{
+	std::vector<std::string> changed;
+#ifdef __linux__
+	if (notify >= 0)
+	{
+		// non-blocking: nothing to read is the common case and costs one syscall
+		alignas(struct inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(notify, buffer, sizeof(buffer))) > 0)
+			for (char* at = buffer; at < buffer + length; )
+			{
+				const struct inotify_event* event = (const struct inotify_event*)at;
+				at += sizeof(struct inotify_event) + event->len;
+				auto directory = directories.find(event->wd);
+				if (event->len == 0 || directory == directories.end())
+					continue;
+				std::string path = directory->second + "/" + event->name;
+				if (files.count(path) && std::find(changed.begin(), changed.end(), path) == changed.end())
+					changed.push_back(path);
+			}
+		return changed;
+	}
+#endif
+	double now = nowMs();
+	if (now - lastPoll < POLL_INTERVAL_MS)
+		return changed;
+	lastPoll = now;
+	for (auto& file : files)
+	{
+		long long time = modified(file.first);
+		if (time == file.second)
+			continue;
+		file.second = time;
+		// a file that's gone may be mid-save; it counts once it's back
+		if (time >= 0)
+			changed.push_back(file.first);
+	}
+	return changed;
+}
+
+unsigned int ShaderReloader::update()
+{
+	std::vector<std::string> changed = changedFiles();
+	if (!changed.empty())
+	{
+		auto affected = [&](const std::string& path) {
+			return std::find(changed.begin(), changed.end(), normalPath(path)) != changed.end();
+		};
+		Batch batch;
+		auto add = [&](Shader* shader, ShaderPermutations* permutations, unsigned int features, const Source& source) {
+			std::unique_ptr<Job> job(new Job());
+			job->shader = shader;
+			job->permutations = permutations;
+			job->features = features;
+			job->vertexPath = source.vertexPath;
+			job->fragmentPath = source.fragmentPath;
+			job->warmed = false;
+			job->done = false;
+			batch.push_back(std::move(job));
+		};
+		for (const Source& source : sources)
+		{
+			if (!affected(source.vertexPath) && !affected(source.fragmentPath))
+				continue;
+			if (source.shader)
+			{
+				add(source.shader, nullptr, 0, source);
+				continue;
+			}
+			// every program of the permutations, resolved for the lowest feature set using it
+			for (Shader& shader : source.permutations->programs)
+			{
+				unsigned int features = ~0u;
+				for (auto& entry : source.permutations->byFeatures)
+					if (entry.second == &shader)
+						features = std::min(features, entry.first);
+				add(&shader, source.permutations, features, source);
+			}
+		}
+		if (!batch.empty())
+		{
+			if (running)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					for (auto& job : batch)
+						queue.push_back(job.get());
+				}
+				wake.notify_all();
+			}
+			batches.push_back(std::move(batch));
+		}
+	}
+
+	// oldest change first, and all of a change or none of it, so a frame never mixes
+	// programs from before and after one save
+	unsigned int swapped = 0;
+	while (!batches.empty())
+	{
+		Batch& batch = batches.front();
+		bool ready = true;
+		for (auto& job : batch)
+		{
+			if (!running && !job->done)
+				build(*job);
+			if (!job->done.load(std::memory_order_acquire))
+			{
+				ready = false;
+				break;
+			}
+			if (job->fence)
+			{
+				if (glClientWaitSync(job->fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+				{
+					ready = false;
+					break;
+				}
+				glDeleteSync(job->fence);
+				job->fence = 0;
+			}
+		}
+		if (!ready)
+			break;
+		// one program that didn't build rejects the whole change: the new programs are
+		// dropped and the permutations keep the old templates (the errors were printed
+		// by build())
+		unsigned int broken = (unsigned int)std::count_if(batch.begin(), batch.end(), [](const std::unique_ptr<Job>& job) { return !job->linked; });
+		if (broken)
+		{
+			std::cout << "ERROR::SHADERRELOAD::CHANGE_REJECTED " << broken << " of " << batch.size()
+				<< " programs failed, every old program stays" << std::endl;
+			for (auto& job : batch)
+				if (job->program)
+				{
+					glState().deleteProgram(job->program);
+					job->program = 0;
+				}
+			Failed += (unsigned int)batch.size();
+			batches.pop_front();
+			continue;
+		}
+		// drivers finish compiling at the first draw (llvmpipe translates to machine code
+		// there, per context), which would make the swap frame as slow as compiling
+		// everything; a draw without fragments in the frame's state does that, one new
+		// program per frame
+		auto cold = std::find_if(batch.begin(), batch.end(), [](const std::unique_ptr<Job>& job) { return job->linked && !job->warmed; });
+		if (cold != batch.end())
+		{
+			warm((*cold)->program);
+			(*cold)->warmed = true;
+			break;
+		}
+		std::vector<Job*> templates;
+		for (auto& job : batch)
+		{
+			job->shader->replaceProgram(job->program);
+			job->program = 0;
+			// one job per permutations passes the new templates on
+			if (job->permutations && std::none_of(templates.begin(), templates.end(),
+				[&](Job* other) { return other->permutations == job->permutations; }))
+				templates.push_back(job.get());
+			Reloaded++;
+			swapped++;
+		}
+		for (Job* job : templates)
+			job->permutations->setTemplates(job->vertexTemplate, job->fragmentTemplate);
+		batches.pop_front();
+	}
+	return swapped;
+}
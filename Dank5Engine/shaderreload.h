@@ -0,0 +1,102 @@
+#ifndef SHADERRELOAD_H
+#define SHADERRELOAD_H
+
+#include "shader.h"
+#include "shaderpermutations.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Shader hot reload. The source files of watched programs are watched (inotify on Linux,
+// modification times polled twice a second elsewhere), and only the programs built from a
+// changed file are rebuilt, on a loader thread with its own context that shares objects
+// with the render context, so compiling doesn't stall frames. update() at a frame
+// boundary swaps in all the programs of one change together once every one has linked.
+// When any program of a change doesn't compile or link, its errors are printed and the
+// whole change is dropped: every program keeps running its old version. Without a loader
+// context (start() not called or failed) the rebuild happens inside update(), stalling
+// that frame.
+class ShaderReloader {
+
+public:
+	// programs swapped in, and programs of rejected changes (their old programs stayed)
+	unsigned int Reloaded, Failed;
+
+	ShaderReloader();
+	// joins the loader thread; call stop() first while the context lives
+	~ShaderReloader();
+
+	// starts the loader thread: makeCurrent makes a context sharing objects with the render
+	// context current on it (false if it can't), release leaves it before the thread ends
+	bool start(std::function<bool()> makeCurrent, std::function<void()> release);
+	// joins the loader thread and drops rebuilds that weren't swapped in yet
+	void stop();
+
+	// rebuild shader when either file changes; watched programs have to outlive the reloader
+	void watch(Shader& shader, const std::string& vertexPath, const std::string& fragmentPath);
+	// rebuild every program permutations has built (by then) when a template changes
+	void watch(ShaderPermutations& permutations);
+
+	// once per frame on the render thread, between frames: queues the programs of changed
+	// files and swaps in finished ones; the number swapped in. Before the swap every new
+	// program is drawn with once (no fragments, one program per call), because drivers
+	// finish compiling at the first draw; that leaves a program and a VAO bound.
+	unsigned int update();
+
+private:
+	// a watched program (shader) or set of them (permutations)
+	struct Source {
+		Shader* shader;
+		ShaderPermutations* permutations;
+		std::string vertexPath, fragmentPath;
+	};
+	// one program to rebuild; the loader fills in the results, then sets done
+	struct Job {
+		Shader* shader;
+		ShaderPermutations* permutations;
+		unsigned int features;
+		std::string vertexPath, fragmentPath;
+		std::string vertexTemplate, fragmentTemplate;
+		unsigned int program;
+		// built without errors; drawn with once on the render context
+		bool linked, warmed;
+		GLsync fence;
+		std::atomic<bool> done;
+	};
+	// the jobs of one change, swapped in together
+	typedef std::vector<std::unique_ptr<Job>> Batch;
+
+	std::vector<Source> sources;
+	std::deque<Batch> batches;
+
+	// files by "directory/name", with the modification time polling compares against
+	std::unordered_map<std::string, long long> files;
+	double lastPoll;
+	// inotify descriptor (-1 when polling) and the directory of every watch descriptor
+	int notify;
+	std::unordered_map<int, std::string> directories;
+	// bound while warming programs up
+	unsigned int warmVAO;
+
+	std::thread loader;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<Job*> queue;
+	bool running, stopping;
+
+	void watchFile(const std::string& path);
+	std::vector<std::string> changedFiles();
+	void loaderMain(std::function<bool()> makeCurrent, std::function<void()> release, int& started);
+	static void build(Job& job);
+	void warm(unsigned int program);
+};
+
+#endif
@@ -466,6 +466,10 @@ extern "C" {
 	// flip the image vertically, so the first pixel in the output array is the bottom left
 	STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+	// use the AVX2 JPEG and PNG kernels when the CPU has them (the default). the output
+	// is identical either way; this is for comparing the paths, set it before decoding
+	STBIDEF void stbi_set_avx2_on_load(int flag_true_if_should_use);
+
 	// ZLIB client - used by PNG, available for other purposes
 
 	STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -551,6 +555,26 @@ extern "C" {
 #define STBI_EXTERN extern
 #endif
 
+// backported from stb_image 2.23: per-thread failure reasons, so decoding on several
+// threads at once reports the right error
+#ifndef STBI_THREAD_LOCAL
+#if defined(__cplusplus) &&  __cplusplus >= 201103L
+#define STBI_THREAD_LOCAL       thread_local
+#elif defined(__GNUC__) && __GNUC__ < 5
+#define STBI_THREAD_LOCAL       __thread
+#elif defined(_MSC_VER)
+#define STBI_THREAD_LOCAL       __declspec(thread)
+#elif defined (__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+#define STBI_THREAD_LOCAL       _Thread_local
+#endif
+
+#ifndef STBI_THREAD_LOCAL
+#if defined(__GNUC__)
+#define STBI_THREAD_LOCAL       __thread
+#endif
+#endif
+#endif
+
 
 #ifndef _MSC_VER
 #ifdef __cplusplus
@@ -699,6 +723,45 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2 kernels for the JPEG IDCT and colour conversion and the PNG filters. Unlike
+// SSE2 these are not assumed: they are compiled for AVX2 function by function and
+// only picked when the CPU reports it, so the rest of the file keeps the baseline
+// instruction set. Define STBI_NO_AVX2 to leave them out.
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && ((defined(_MSC_VER) && _MSC_VER >= 1800) || defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define STBI_AVX2
+#include <immintrin.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+// VC++ lets any function use the intrinsics of any instruction set
+#define STBI__AVX2_TARGET
+#include <intrin.h>
+// cpuid on every call, like stbi__sse2_available: once per image, and no shared state
+// for the decoding threads to race on
+static int stbi__avx2_available(void)
+{
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return 0;
+	// the OS has to save the ymm registers too (OSXSAVE, AVX, then XCR0)
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+		return 0;
+	if ((_xgetbv(0) & 6) != 6)
+		return 0;
+	__cpuidex(info, 7, 0);
+	return (info[1] >> 5) & 1;
+}
+#else
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+// a read of what libgcc's startup constructor filled in, safe from any thread
+static int stbi__avx2_available(void)
+{
+	return __builtin_cpu_supports("avx2") != 0;
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -872,8 +935,11 @@ static void    *stbi__pnm_load(stbi__context *s, int *x, int *y, int *comp, int
 static int      stbi__pnm_info(stbi__context *s, int *x, int *y, int *comp);
 #endif
 
+#ifndef STBI_THREAD_LOCAL
 // this is not threadsafe
-static const char *stbi__g_failure_reason;
+#define STBI_THREAD_LOCAL
+#endif
+static STBI_THREAD_LOCAL const char *stbi__g_failure_reason;
 
 STBIDEF const char *stbi_failure_reason(void)
 {
@@ -1001,6 +1067,13 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
 	stbi__vertically_flip_on_load = flag_true_if_should_flip;
 }
 
+static int stbi__avx2_on_load = 1;
+
+STBIDEF void stbi_set_avx2_on_load(int flag_true_if_should_use)
+{
+	stbi__avx2_on_load = flag_true_if_should_use;
+}
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
 	memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -2520,6 +2593,170 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// the SSE2 IDCT with its 32-bit stages in ymm registers: one register holds all
+// eight columns where SSE2 needs a lo/hi pair. the arithmetic is the same, so the
+// output is too; the transposes stay 128-bit.
+static STBI__AVX2_TARGET void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
+{
+	__m128i row0, row1, row2, row3, row4, row5, row6, row7;
+	__m128i tmp;
+
+	// dot product constant: even elems=x, odd elems=y
+#define dct_const(x,y)  _mm256_set1_epi32((int) (((unsigned int) (y) << 16) | ((unsigned int) (x) & 0xffff)))
+
+// out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+// out(1) = c1[even]*x + c1[odd]*y
+#define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##xy = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16((x),(y))), _mm_unpackhi_epi16((x),(y)), 1); \
+      __m256i out0 = _mm256_madd_epi16(c0##xy, c0); \
+      __m256i out1 = _mm256_madd_epi16(c0##xy, c1)
+
+   // out = in << 12  (in 16-bit, out 32-bit)
+#define dct_widen(out, in) \
+      __m256i out = _mm256_slli_epi32(_mm256_cvtepi16_epi32(in), 12)
+
+   // butterfly a/b, add bias, then shift by "s" and pack
+#define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased = _mm256_add_epi32(a, bias); \
+         __m256i sum = _mm256_srai_epi32(_mm256_add_epi32(abiased, b), s); \
+         __m256i dif = _mm256_srai_epi32(_mm256_sub_epi32(abiased, b), s); \
+         /* packs works within lanes: sum0-3 dif0-3 | sum4-7 dif4-7 */ \
+         __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(sum, dif), 0xd8); \
+         out0 = _mm256_castsi256_si128(packed); \
+         out1 = _mm256_extracti128_si256(packed, 1); \
+      }
+
+   // 8-bit interleave step (for transposes)
+#define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi8(a, b); \
+      b = _mm_unpackhi_epi8(tmp, b)
+
+   // 16-bit interleave step (for transposes)
+#define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi16(a, b); \
+      b = _mm_unpackhi_epi16(tmp, b)
+
+#define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m128i sum04 = _mm_add_epi16(row0, row4); \
+         __m128i dif04 = _mm_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         __m256i x0 = _mm256_add_epi32(t0e, t3e); \
+         __m256i x3 = _mm256_sub_epi32(t0e, t3e); \
+         __m256i x1 = _mm256_add_epi32(t1e, t2e); \
+         __m256i x2 = _mm256_sub_epi32(t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m128i sum17 = _mm_add_epi16(row1, row7); \
+         __m128i sum35 = _mm_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         __m256i x4 = _mm256_add_epi32(y0o, y4o); \
+         __m256i x5 = _mm256_add_epi32(y1o, y5o); \
+         __m256i x6 = _mm256_add_epi32(y2o, y5o); \
+         __m256i x7 = _mm256_add_epi32(y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+	__m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+	__m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f(0.765366865f), stbi__f2f(0.5411961f));
+	__m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+	__m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+	__m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f(0.298631336f), stbi__f2f(-1.961570560f));
+	__m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f(3.072711026f));
+	__m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f(2.053119869f), stbi__f2f(-0.390180644f));
+	__m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f(1.501321110f));
+
+	// rounding biases in column/row passes, see stbi__idct_block for explanation.
+	__m256i bias_0 = _mm256_set1_epi32(512);
+	__m256i bias_1 = _mm256_set1_epi32(65536 + (128 << 17));
+
+	// load
+	row0 = _mm_load_si128((const __m128i *) (data + 0 * 8));
+	row1 = _mm_load_si128((const __m128i *) (data + 1 * 8));
+	row2 = _mm_load_si128((const __m128i *) (data + 2 * 8));
+	row3 = _mm_load_si128((const __m128i *) (data + 3 * 8));
+	row4 = _mm_load_si128((const __m128i *) (data + 4 * 8));
+	row5 = _mm_load_si128((const __m128i *) (data + 5 * 8));
+	row6 = _mm_load_si128((const __m128i *) (data + 6 * 8));
+	row7 = _mm_load_si128((const __m128i *) (data + 7 * 8));
+
+	// column pass
+	dct_pass(bias_0, 10);
+
+	{
+		// 16bit 8x8 transpose pass 1
+		dct_interleave16(row0, row4);
+		dct_interleave16(row1, row5);
+		dct_interleave16(row2, row6);
+		dct_interleave16(row3, row7);
+
+		// transpose pass 2
+		dct_interleave16(row0, row2);
+		dct_interleave16(row1, row3);
+		dct_interleave16(row4, row6);
+		dct_interleave16(row5, row7);
+
+		// transpose pass 3
+		dct_interleave16(row0, row1);
+		dct_interleave16(row2, row3);
+		dct_interleave16(row4, row5);
+		dct_interleave16(row6, row7);
+	}
+
+	// row pass
+	dct_pass(bias_1, 17);
+
+	{
+		// pack
+		__m128i p0 = _mm_packus_epi16(row0, row1); // a0a1a2a3...a7b0b1b2b3...b7
+		__m128i p1 = _mm_packus_epi16(row2, row3);
+		__m128i p2 = _mm_packus_epi16(row4, row5);
+		__m128i p3 = _mm_packus_epi16(row6, row7);
+
+		// 8bit 8x8 transpose pass 1
+		dct_interleave8(p0, p2); // a0e0a1e1...
+		dct_interleave8(p1, p3); // c0g0c1g1...
+
+		// transpose pass 2
+		dct_interleave8(p0, p1); // a0c0e0g0...
+		dct_interleave8(p2, p3); // b0d0f0h0...
+
+		// transpose pass 3
+		dct_interleave8(p0, p2); // a0b0c0d0...
+		dct_interleave8(p1, p3); // a4b4c4d4...
+
+		// store
+		_mm_storel_epi64((__m128i *) out, p0); out += out_stride;
+		_mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p0, 0x4e)); out += out_stride;
+		_mm_storel_epi64((__m128i *) out, p2); out += out_stride;
+		_mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p2, 0x4e)); out += out_stride;
+		_mm_storel_epi64((__m128i *) out, p1); out += out_stride;
+		_mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p1, 0x4e)); out += out_stride;
+		_mm_storel_epi64((__m128i *) out, p3); out += out_stride;
+		_mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p3, 0x4e));
+	}
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+}
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -3613,6 +3850,72 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+// stbi__YCbCr_to_RGB_simd sixteen pixels at a time; the end of the row is left to it
+static STBI__AVX2_TARGET void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+	int i = 0;
+
+	if (step == 4) {
+		__m128i signflip = _mm_set1_epi8(-0x80);
+		__m256i cr_const0 = _mm256_set1_epi16((short)(1.40200f*4096.0f + 0.5f));
+		__m256i cr_const1 = _mm256_set1_epi16(-(short)(0.71414f*4096.0f + 0.5f));
+		__m256i cb_const0 = _mm256_set1_epi16(-(short)(0.34414f*4096.0f + 0.5f));
+		__m256i cb_const1 = _mm256_set1_epi16((short)(1.77200f*4096.0f + 0.5f));
+		__m256i y_bias = _mm256_set1_epi16(128);
+		__m256i xw = _mm256_set1_epi16(255); // alpha channel
+
+		for (; i + 15 < count; i += 16) {
+			// load
+			__m128i y_bytes = _mm_loadu_si128((const __m128i *) (y + i));
+			__m128i cr_bytes = _mm_loadu_si128((const __m128i *) (pcr + i));
+			__m128i cb_bytes = _mm_loadu_si128((const __m128i *) (pcb + i));
+			__m128i cr_biased = _mm_xor_si128(cr_bytes, signflip); // -128
+			__m128i cb_biased = _mm_xor_si128(cb_bytes, signflip); // -128
+
+			// widen to short the way the SSE2 unpacks do: y << 8 | 128, cr << 8, cb << 8
+			__m256i yw = _mm256_or_si256(_mm256_slli_epi16(_mm256_cvtepu8_epi16(y_bytes), 8), y_bias);
+			__m256i crw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(cr_biased), 8);
+			__m256i cbw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(cb_biased), 8);
+
+			// color transform
+			__m256i yws = _mm256_srli_epi16(yw, 4);
+			__m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+			__m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+			__m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+			__m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+			__m256i rws = _mm256_add_epi16(cr0, yws);
+			__m256i gwt = _mm256_add_epi16(cb0, yws);
+			__m256i bws = _mm256_add_epi16(yws, cb1);
+			__m256i gws = _mm256_add_epi16(gwt, cr1);
+
+			// descale
+			__m256i rw = _mm256_srai_epi16(rws, 4);
+			__m256i bw = _mm256_srai_epi16(bws, 4);
+			__m256i gw = _mm256_srai_epi16(gws, 4);
+
+			// back to byte, set up for transpose
+			__m256i brb = _mm256_packus_epi16(rw, bw);
+			__m256i gxb = _mm256_packus_epi16(gw, xw);
+
+			// transpose to interleave channels; all of these work within 128-bit lanes,
+			// so o0 ends up with pixels 0-3 and 8-11, o1 with 4-7 and 12-15
+			__m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+			__m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+			__m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+			__m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+			// store
+			_mm256_storeu_si256((__m256i *) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+			_mm256_storeu_si256((__m256i *) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+			out += 64;
+		}
+	}
+
+	stbi__YCbCr_to_RGB_simd(out, y + i, pcb + i, pcr + i, count - i, step);
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
@@ -3628,6 +3931,13 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
 	}
 #endif
 
+#ifdef STBI_AVX2
+	if (stbi__avx2_on_load && stbi__avx2_available()) {
+		j->idct_block_kernel = stbi__idct_avx2;
+		j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+	}
+#endif
+
 #ifdef STBI_NEON
 	j->idct_block_kernel = stbi__idct_simd;
 	j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -4430,6 +4740,123 @@ static int stbi__paeth(int a, int b, int c)
 	return c;
 }
 
+#ifdef STBI_AVX2
+// one pixel of 3 or 4 bytes, without touching the byte after a 3-byte pixel
+static stbi__uint32 stbi__png_load_px(const stbi_uc *p, int n)
+{
+	stbi__uint32 v;
+	if (n == 4) {
+		memcpy(&v, p, 4);
+		return v;
+	}
+	return p[0] | (p[1] << 8) | ((stbi__uint32)p[2] << 16);
+}
+
+static void stbi__png_store_px(stbi_uc *p, stbi__uint32 v, int n)
+{
+	if (n == 4) {
+		memcpy(p, &v, 4);
+		return;
+	}
+	p[0] = (stbi_uc)v;
+	p[1] = (stbi_uc)(v >> 8);
+	p[2] = (stbi_uc)(v >> 16);
+}
+
+// the filter loops of stbi__create_png_image_raw from the second pixel of a row on.
+// 'raw' steps by in_bytes, 'cur' and 'prior' by out_bytes; an extra output byte is
+// the 255 alpha. up runs 32 bytes at a time; sub, avg and paeth depend on the pixel
+// to their left, so they take a pixel (3 or 4 bytes) per step. returns 0 to leave
+// the row to the scalar loops.
+static STBI__AVX2_TARGET int stbi__png_filter_row_avx2(int filter, stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int pixels, int in_bytes, int out_bytes)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i one = _mm_set1_epi8(1);
+	__m128i a, b, c, x;
+	stbi__uint32 alpha = in_bytes < out_bytes ? 0xff000000u : 0;
+	int i, count, pass, load_bytes, store_bytes;
+
+	if (in_bytes == out_bytes && filter == STBI__F_none)
+		return 0; // the memcpy there is as good as it gets
+	if (in_bytes == out_bytes && filter == STBI__F_up) {
+		int k = 0, n = pixels * in_bytes;
+		for (; k + 32 <= n; k += 32) {
+			__m256i r = _mm256_loadu_si256((const __m256i *) (raw + k));
+			__m256i p = _mm256_loadu_si256((const __m256i *) (prior + k));
+			_mm256_storeu_si256((__m256i *) (cur + k), _mm256_add_epi8(r, p));
+		}
+		for (; k < n; ++k)
+			cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+		return 1;
+	}
+	if (in_bytes < 3 || in_bytes > 4 || out_bytes < in_bytes || out_bytes > 4)
+		return 0;
+
+#define STBI__PX_LOAD(p)   _mm_cvtsi32_si128((int) stbi__png_load_px((p), load_bytes))
+#define STBI__PX_STORE(v)  stbi__png_store_px(cur, (stbi__uint32) _mm_cvtsi128_si32(v) | alpha, store_bytes)
+#define STBI__PX_CASE(f) \
+             case f:     \
+                for (i=0; i < count; ++i, raw+=in_bytes, cur+=out_bytes, prior+=out_bytes)
+
+	// a = left, b = above, c = above left
+	load_bytes = in_bytes;
+	a = STBI__PX_LOAD(cur - out_bytes);
+	c = (filter == STBI__F_avg || filter == STBI__F_paeth) ? STBI__PX_LOAD(prior - out_bytes) : zero;
+
+	// all but the last pixel load and store whole words: the byte past a 3-byte pixel
+	// belongs to the next one, which rewrites it. the last one stays inside the row.
+	count = pixels - 1;
+	load_bytes = store_bytes = 4;
+	for (pass = 0; pass < 2; ++pass) {
+		switch (filter) {
+			STBI__PX_CASE(STBI__F_none) { a = STBI__PX_LOAD(raw); STBI__PX_STORE(a); } break;
+			STBI__PX_CASE(STBI__F_up) { a = _mm_add_epi8(STBI__PX_LOAD(raw), STBI__PX_LOAD(prior)); STBI__PX_STORE(a); } break;
+			// paeth(a, 0, 0) is always a
+			case STBI__F_paeth_first:
+			STBI__PX_CASE(STBI__F_sub) { a = _mm_add_epi8(STBI__PX_LOAD(raw), a); STBI__PX_STORE(a); } break;
+			// (a + b) >> 1 without the rounding of pavgb
+			STBI__PX_CASE(STBI__F_avg) {
+				b = STBI__PX_LOAD(prior);
+				x = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+				a = _mm_add_epi8(STBI__PX_LOAD(raw), x);
+				STBI__PX_STORE(a);
+			} break;
+			STBI__PX_CASE(STBI__F_avg_first) {
+				x = _mm_sub_epi8(_mm_avg_epu8(a, zero), _mm_and_si128(a, one));
+				a = _mm_add_epi8(STBI__PX_LOAD(raw), x);
+				STBI__PX_STORE(a);
+			} break;
+			// stbi__paeth in 16 bits: p - a = b - c, p - b = a - c, p - c = (b - c) + (a - c)
+			STBI__PX_CASE(STBI__F_paeth) {
+				__m128i a16, b16, c16, bc, ac, pa, pb, pc, not_a, pred;
+				b = STBI__PX_LOAD(prior);
+				a16 = _mm_unpacklo_epi8(a, zero);
+				b16 = _mm_unpacklo_epi8(b, zero);
+				c16 = _mm_unpacklo_epi8(c, zero);
+				bc = _mm_sub_epi16(b16, c16);
+				ac = _mm_sub_epi16(a16, c16);
+				pa = _mm_abs_epi16(bc);
+				pb = _mm_abs_epi16(ac);
+				pc = _mm_abs_epi16(_mm_add_epi16(bc, ac));
+				// a if pa <= pb and pa <= pc, else b if pb <= pc, else c
+				not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+				pred = _mm_blendv_epi8(a16, _mm_blendv_epi8(b16, c16, _mm_cmpgt_epi16(pb, pc)), not_a);
+				a = _mm_add_epi8(STBI__PX_LOAD(raw), _mm_packus_epi16(pred, pred));
+				c = b;
+				STBI__PX_STORE(a);
+			} break;
+		}
+		count = pixels > 0;
+		load_bytes = in_bytes;
+		store_bytes = out_bytes;
+	}
+#undef STBI__PX_CASE
+#undef STBI__PX_STORE
+#undef STBI__PX_LOAD
+	return 1;
+}
+#endif
+
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
 // create the png data from post-deflated data
@@ -4445,6 +4872,9 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
 	int output_bytes = out_n * bytes;
 	int filter_bytes = img_n * bytes;
 	int width = x;
+#ifdef STBI_AVX2
+	int avx2 = stbi__avx2_on_load && stbi__avx2_available();
+#endif
 
 	STBI_ASSERT(out_n == s->img_n || out_n == s->img_n + 1);
 	a->out = (stbi_uc *)stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
@@ -4516,6 +4946,12 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
 		// this is a little gross, so that we don't switch per-pixel or per-component
 		if (depth < 8 || img_n == out_n) {
 			int nk = (width - 1)*filter_bytes;
+#ifdef STBI_AVX2
+			if (avx2 && stbi__png_filter_row_avx2(filter, cur, prior, raw, width - 1, filter_bytes, filter_bytes)) {
+				raw += nk;
+				continue;
+			}
+#endif
 #define STBI__CASE(f) \
              case f:     \
                 for (k=0; k < nk; ++k)
@@ -4534,6 +4970,13 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
 		}
 		else {
 			STBI_ASSERT(img_n + 1 == out_n);
+#ifdef STBI_AVX2
+			// the 255 alpha of 16-bit pixels takes two bytes, leave those to the loops below
+			if (avx2 && depth == 8 && stbi__png_filter_row_avx2(filter, cur, prior, raw, x - 1, filter_bytes, output_bytes)) {
+				raw += (x - 1) * filter_bytes;
+				continue;
+			}
+#endif
 #define STBI__CASE(f) \
              case f:     \
                 for (i=x-1; i >= 1; --i, cur[filter_bytes]=255,raw+=filter_bytes,cur+=output_bytes,prior+=output_bytes) \
@@ -1,21 +1,38 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 
-#include "stb_image.h"
 #include "shader.h"
+#include "shaderpermutations.h"
+#include "shaderreload.h"
 #include "camera.h"
+#include "cube.h"
+#include "instancing.h"
+#include "frameconstants.h"
+#include "glstate.h"
+#include "renderqueue.h"
+#include "culling.h"
+#include "mesh.h"
+#include "texturestream.h"
+#include "bakedtexture.h"
+#include "programcache.h"
+#include "transforms.h"
+#include "framealloc.h"
 // consts used
 
 // settings
 
 const unsigned int _WIDTH = 800;
 const unsigned int _HEIGHT = 600;
+// texel bytes the texture streamer may upload per frame
+const size_t TEXTURE_UPLOAD_BUDGET = 1 << 20;
 
 // time between current frame and last frame
 float deltaTime = 0.0f;	
@@ -61,7 +78,7 @@ void processInput(GLFWwindow* w) {
 }
 // function to change rendering window size on GLFW window resize
 void framebuffer_size_callback(GLFWwindow* w, int width, int height) {
-	glViewport(0, 0, width, height);
+	glState().setViewport(0, 0, width, height);
 }
 
 int main() {
@@ -99,62 +116,23 @@ int main() {
 	}
 
 	// tell opengl size of rendering window (lower left, lower left, width, height)
-	glViewport(0, 0, 800, 600);
+	glState().setViewport(0, 0, 800, 600);
 
-	// configure global opengl state
+	// configure global opengl state (through the state cache, which skips redundant calls)
 	// -----------------------------
-	glEnable(GL_DEPTH_TEST);
+	glState().setDepthTest(true);
 
 	/* Shader code */
 
-	// create shader object
-	Shader shader("testVert.vs", "testFrag.fs");
-
-	// setup vertex data and buffer objects
-		//	x,		y,		z, , t.s, t.u
-	float vertices[] = {
-	-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-	 0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
-	 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-	 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-	-0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-	-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-
-	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-	 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-	 0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-	 0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-	-0.5f,  0.5f,  0.5f,  0.0f, 1.0f,
-	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-
-	-0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-	-0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-	-0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-	 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-	 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-	 0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-	 0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-	 0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-	 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-	 0.5f, -0.5f, -0.5f,  1.0f, 1.0f,
-	 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-	 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-
-	-0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-	 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-	 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-	 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-	-0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
-	-0.5f,  0.5f, -0.5f,  0.0f, 1.0f
-	};
+	// programs linked on an earlier run are restored from their binaries
+	programCache().setDirectory("shadercache");
+	// the instanced variant of the template: only submitted here, the driver compiles it
+	// while the geometry and texture load below, and shader.use() waits for whatever is left
+	ShaderPermutations shaders("testUber.vs", "testUber.fs", true);
+	Shader& shader = shaders.get(SHADER_INSTANCING);
+	shaders.report().print("testUber");
+
+	// setup vertex data and buffer objects (cubeVertices, see cube.h)
 
 	// add some world positions for other cubes
 
@@ -171,29 +149,38 @@ int main() {
 		glm::vec3(-1.3f,  1.0f, -1.5f)
 	};
 
-	unsigned int VBO, VAO; //EBO
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	//glGenBuffers(1, &EBO);
-	
-	//bind array object
-	glBindVertexArray(VAO);
-	//bind vertex buffer
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	//set vertex buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-	 /*
-	//bind element buffer
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-	*/
+	// index the cube (36 -> unique vertices), order it for the vertex cache and upload it
+	MeshData cubeData;
+	optimizeMesh(cubeVertices, sizeof(cubeVertices) / (5 * sizeof(float)), 5, cubeData).print("cube");
+	// position (xyz) at location 0 as 16-bit snorm, texture coordinates (st) at location 1 as
+	// half floats: 12 instead of 20 bytes a vertex
+	VertexFormat cubeFormat;
+	cubeFormat.add(0, 3, VERTEX_POSITION_SNORM16).add(1, 2, VERTEX_HALF);
+	Mesh cube(cubeData, cubeFormat);
+	unsigned int VAO = cube.VAO;
+
+	// the cubes are roots of the scene's transform hierarchy, which only recomputes the
+	// world matrices of nodes that moved
+	TransformHierarchy scene;
+	unsigned int cubeNodes[10];
+	for (unsigned int i = 0; i < 10; i++)
+	{
+		float angle = 20.0f * i;
+		glm::quat rotation = glm::angleAxis(glm::radians(angle), glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f)));
+		cubeNodes[i] = scene.create(TRANSFORM_NONE, cubePositions[i], rotation);
+	}
+	scene.update();
 
-	// position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	// texture data starts after each position so offset is every 3 * float (xyz)
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
+	// per-instance model matrices (attribute locations 2-5), uploaded again only when a cube moved
+	glm::mat4 models[10];
+	for (unsigned int i = 0; i < 10; i++)
+	{
+		// the quantised positions are decoded by the model matrix
+		models[i] = scene.world(cubeNodes[i]) * cube.dequantize();
+	}
+	InstanceBuffer instances(10);
+	instances.attach(VAO);
+	instances.upload(models, 10);
 
 	/*
 	
@@ -204,47 +191,58 @@ int main() {
 
 	*/
 
-	// generate opengl texture object
-	unsigned int texture;
-	glGenTextures(1, &texture);
-	// bind the texture
-	glBindTexture(GL_TEXTURE_2D, texture);
-	// set the texture wrapping/filtering options (on the currently bound texture object)
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	// load a texture using the stb_image program
-	int width, height, nrChannels;
-	unsigned char *data = stbi_load("container.jpg", &width, &height, &nrChannels, 0);
-	// if found the texture data
-	if (data)
-	{
-		// generate texture using the loaded texture
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else
+	// the texture baked by dank5_cook if the build made one: mapped and uploaded as is.
+	// otherwise stream the jpg in: decoded (with its mips) on a worker thread and
+	// uploaded over the first frames, a placeholder is drawn until then. The streamer (its
+	// decode threads and upload ring) only exists on that path
+	std::unique_ptr<TextureStreamer> textures;
+	unsigned int texture = 0;
+	if (std::ifstream("container.d5tex").good())
+		texture = loadBakedTexture("container.d5tex");
+	if (!texture)
 	{
-		std::cout << "Failed to load texture" << std::endl;
+		textures.reset(new TextureStreamer(2));
+		texture = textures->load("container.jpg");
 	}
-	// free the image memory
-	stbi_image_free(data);
-
 
 	shader.use();
 	shader.setInt("texture1", 0);
 
+	// saving the templates rebuilds the variants in use on a hidden window's context, which
+	// shares objects with ours, and swaps them in between frames
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* loaderWindow = glfwCreateWindow(1, 1, "dank5 loader", NULL, w);
+	ShaderReloader reloader;
+	reloader.watch(shaders);
+	if (loaderWindow)
+		reloader.start([loaderWindow] { glfwMakeContextCurrent(loaderWindow); return true; },
+			[] { glfwMakeContextCurrent(NULL); });
+
 	// tell GLFW to call framebuffer size callback on resize
 	glfwSetFramebufferSizeCallback(w, framebuffer_size_callback);
 
 	// create perspective
 	glm::mat4 projection = glm::mat4(1.0f);
 	projection = glm::perspective(glm::radians(45.0f), (float)_WIDTH / (float)_HEIGHT, 0.1f, 100.0f); // perspective
-	shader.setMat4("projection", projection);
+
+	// view/projection live in one triple buffered uniform block shared by all programs
+	FrameUniformBuffer frameUBO(3);
+	FrameConstants frame;
+	frame.projection = projection;
+
+	// per-frame draw list, sized once so the loop never allocates
+	RenderQueue queue(64);
+
+	// bounding spheres of the cubes for frustum culling (a unit cube fits in radius sqrt(3)/2)
+	BoundingSpheres cubeBounds;
+	cubeBounds.resize(10);
+	for (unsigned int i = 0; i < 10; i++)
+		cubeBounds.set(i, cubePositions[i], 0.8660254f);
 
 	// render loop
 	while (!glfwWindowShouldClose(w)) {
+		// drops what was allocated for the frame before last
+		frameAllocator().beginFrame();
 
 		// per-frame time logic
 		float currentFrame = glfwGetTime();
@@ -253,6 +251,24 @@ int main() {
 
 		// manage input
 		processInput(w);
+
+		// upload whatever the texture workers finished decoding, within the frame's budget
+		if (textures)
+			textures->update(TEXTURE_UPLOAD_BUDGET);
+		// world matrices of whatever moved since the last frame
+		if (scene.update())
+		{
+			for (unsigned int i = 0; i < 10; i++)
+				if (scene.changed(cubeNodes[i]))
+					models[i] = scene.world(cubeNodes[i]) * cube.dequantize();
+			instances.upload(models, 10);
+		}
+		// a reloaded program starts with default uniforms
+		if (reloader.update())
+		{
+			shader.use();
+			shader.setInt("texture1", 0);
+		}
 		
 		//render
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -267,47 +283,49 @@ int main() {
         glBindTexture(GL_TEXTURE_2D, texture2);
 		
 		*/
-		glActiveTexture(GL_TEXTURE0);
-		// bind texture on texture units
-		glBindTexture(GL_TEXTURE_2D, texture);
-
-		//2d rectangle made of two triangles
-		shader.use();
-
 		// perspective projection
 		// glm::ortho(0.0f, 800.0f, 0.0f, 600.0f, 0.1f, 100.0f); //orthographic
 
 		// camera/view transformation
-		glm::mat4 view = camera.GetViewMatrix();
-		shader.setMat4("view", view);
-
-		for (unsigned int i = 0; i < 10; i++)
+		frame.view = camera.GetViewMatrix();
+		frame.viewProjection = frame.projection * frame.view;
+		frame.cameraPosition = glm::vec4(camera.Position, currentFrame);
+		frameUBO.update(frame);
+
+		// submit every cube to the render queue, which sorts them and binds program,
+		// VAO and texture only when they change (the cube matrices come from instances)
+		// only the cubes inside the view frustum reach the queue
+		unsigned int* visible = frameAllocator().allocate<unsigned int>(cubeBounds.size());
+		unsigned int visibleCount = cullSpheres(extractFrustum(frame.viewProjection), cubeBounds, visible);
+		queue.clear();
+		for (unsigned int v = 0; v < visibleCount; v++)
 		{
-			// calculate the model matrix for each object and pass it to shader before drawing
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, cubePositions[i]);
-			float angle = 20.0f * i;
-			model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-			shader.setMat4("model", model);
-
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+			unsigned int i = visible[v];
+			DrawPacket packet = { shader.ID, VAO, texture, i, GL_TRIANGLES, 0, (GLsizei)cube.IndexCount, cube.IndexType, false };
+			queue.submit(packet, -(frame.view * glm::vec4(cubePositions[i], 1.0f)).z);
 		}
-
-		glBindVertexArray(VAO);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		// glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		queue.sort();
+		queue.execute();
 		// glBindVertexArray(0); // no need to unbind it every time 
 
 		// swap the buffers and poll for input using glfw
 		glfwSwapBuffers(w);
 		glfwPollEvents();
+		// close the state cache's frame so its issued/skipped counters stay per frame
+		glState().endFrame();
 	}
 
 	// optional: de-allocate all resources once they've outlived their purpose:
 	// ------------------------------------------------------------------------
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
-	//glDeleteBuffers(1, &EBO);
+	cube.destroy();
+	if (textures)
+		textures->destroy();
+	glState().deleteTextures(1, &texture);
+	glState().deleteBuffers(1, &instances.VBO);
+	frameUBO.destroy();
+	reloader.stop();
+	shaders.destroy();
+	Shader::destroyPlaceholders();
 
 	// terminate program
 	glfwTerminate();
@@ -0,0 +1,29 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+#ifdef FOG
+in float ViewDepth;
+
+uniform vec3 fogColor;
+uniform float fogDensity;
+#endif
+
+uniform sampler2D texture1;
+#ifdef ALPHA_TEST
+uniform float alphaCutoff;
+#endif
+
+void main()
+{
+    vec4 color = texture(texture1, TexCoord);
+#ifdef ALPHA_TEST
+    if (color.a < alphaCutoff)
+        discard;
+#endif
+#ifdef FOG
+    float fog = clamp(exp(-fogDensity * ViewDepth), 0.0, 1.0);
+    color.rgb = mix(fogColor, color.rgb, fog);
+#endif
+    FragColor = color;
+}
@@ -0,0 +1,48 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+#ifdef INSTANCING
+// per-instance model matrix, see InstanceBuffer (takes locations 2-5)
+layout (location = 2) in mat4 aModel;
+#else
+uniform mat4 model;
+#endif
+#ifdef SKINNING
+layout (location = 6) in uvec4 aJoints;
+layout (location = 7) in vec4 aWeights;
+uniform mat4 joints[64];
+#endif
+
+out vec2 TexCoord;
+#ifdef FOG
+out float ViewDepth;
+#endif
+
+// per-frame constants, written once per frame by FrameUniformBuffer
+layout (std140) uniform FrameConstants
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
+
+void main()
+{
+#ifdef INSTANCING
+    mat4 world = aModel;
+#else
+    mat4 world = model;
+#endif
+#ifdef SKINNING
+    world = world * (joints[aJoints.x] * aWeights.x + joints[aJoints.y] * aWeights.y
+        + joints[aJoints.z] * aWeights.z + joints[aJoints.w] * aWeights.w);
+#endif
+    vec4 worldPos = world * vec4(aPos, 1.0);
+    gl_Position = viewProjection * worldPos;
+    TexCoord = aTexCoord;
+#ifdef FOG
+    ViewDepth = -(view * worldPos).z;
+#endif
+}
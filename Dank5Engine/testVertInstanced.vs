@@ -0,0 +1,23 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+// per-instance model matrix, see InstanceBuffer (takes locations 2-5)
+layout (location = 2) in mat4 aModel;
+
+out vec2 TexCoord;
+
+// per-frame constants, written once per frame by FrameUniformBuffer
+layout (std140) uniform FrameConstants
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
+
+void main()
+{
+    gl_Position = viewProjection * (aModel * vec4(aPos, 1.0));
+    TexCoord = aTexCoord;
+}
\ No newline at end of file
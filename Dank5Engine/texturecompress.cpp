@@ -0,0 +1,842 @@
+#include "texturecompress.h"
+
+#include <glm/simd/platform.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// the index searches have an SSE2 path; it finds the same indices as the scalar loops
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#	define DANK5_BCN_SSE 1
+#endif
+
+#if defined(_MSC_VER) && DANK5_BCN_SSE
+#	include <intrin.h>
+#endif
+
+unsigned int blockBytes(BlockFormat format)
+{
+	return format == BLOCK_BC1 || format == BLOCK_BC4 ? 8 : 16;
+}
+
+size_t compressedSize(BlockFormat format, int width, int height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+const char* blockFormatName(BlockFormat format)
+{
+	switch (format)
+	{
+	case BLOCK_BC1: return "BC1";
+	case BLOCK_BC3: return "BC3";
+	case BLOCK_BC4: return "BC4";
+	case BLOCK_BC5: return "BC5";
+	default: return "BC7";
+	}
+}
+
+const char* compressionQualityName(CompressionQuality quality)
+{
+	return quality == COMPRESS_FAST ? "fast" : quality == COMPRESS_BEST ? "best" : "normal";
+}
+
+// channels the PSNR is taken over
+static int storedChannels(BlockFormat format)
+{
+	switch (format)
+	{
+	case BLOCK_BC1: return 3;
+	case BLOCK_BC4: return 1;
+	case BLOCK_BC5: return 2;
+	default: return 4;
+	}
+}
+
+// Endpoints on the corners of the block's bounding box, pulled in by 1/16 of the range
+// so the interpolated entries land on the texels rather than past them.
+static void boundingBox(const unsigned char* texels, int channels, float endpoint0[4], float endpoint1[4])
+{
+	for (int c = 0; c < channels; c++)
+	{
+		int lowest = 255, highest = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			lowest = std::min(lowest, (int)texels[i * 4 + c]);
+			highest = std::max(highest, (int)texels[i * 4 + c]);
+		}
+		float inset = (highest - lowest) / 16.0f;
+		endpoint0[c] = lowest + inset;
+		endpoint1[c] = highest - inset;
+	}
+}
+
+// Endpoints on the principal axis of the block: the line through the mean along the
+// direction of greatest variance, clipped to the texels' projections and pulled in by
+// inset times their range (1/16 like boundingBox() suits four entry palettes). Unlike the
+// corners of the bounding box this follows channels that fall while others rise.
+static void fitLine(const unsigned char* texels, int channels, float inset, float endpoint0[4], float endpoint1[4])
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < channels; c++)
+			mean[c] += texels[i * 4 + c];
+	for (int c = 0; c < channels; c++)
+		mean[c] /= 16.0f;
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++)
+		for (int a = 0; a < channels; a++)
+			for (int b = a; b < channels; b++)
+				covariance[a][b] += (texels[i * 4 + a] - mean[a]) * (texels[i * 4 + b] - mean[b]);
+	for (int a = 0; a < channels; a++)
+		for (int b = 0; b < a; b++)
+			covariance[a][b] = covariance[b][a];
+
+	// power iteration, starting from the column of the channel that varies most
+	int widest = 0;
+	for (int c = 1; c < channels; c++)
+		if (covariance[c][c] > covariance[widest][widest])
+			widest = c;
+	float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int c = 0; c < channels; c++)
+		axis[c] = covariance[c][widest];
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float length = 0.0f;
+		for (int a = 0; a < channels; a++)
+		{
+			for (int b = 0; b < channels; b++)
+				next[a] += covariance[a][b] * axis[b];
+			length = std::max(length, std::fabs(next[a]));
+		}
+		if (length < 1e-6f)
+			break;
+		for (int c = 0; c < channels; c++)
+			axis[c] = next[c] / length;
+	}
+	float length = 0.0f;
+	for (int c = 0; c < channels; c++)
+		length += axis[c] * axis[c];
+
+	float lowest = 0.0f, highest = 0.0f;
+	if (length > 1e-12f)
+	{
+		for (int c = 0; c < channels; c++)
+			axis[c] /= std::sqrt(length);
+		lowest = 1e30f;
+		highest = -1e30f;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < channels; c++)
+				t += (texels[i * 4 + c] - mean[c]) * axis[c];
+			lowest = std::min(lowest, t);
+			highest = std::max(highest, t);
+		}
+		float pull = (highest - lowest) * inset;
+		lowest += pull;
+		highest -= pull;
+	}
+	for (int c = 0; c < channels; c++)
+	{
+		endpoint0[c] = std::min(255.0f, std::max(0.0f, mean[c] + lowest * axis[c]));
+		endpoint1[c] = std::min(255.0f, std::max(0.0f, mean[c] + highest * axis[c]));
+	}
+}
+
+// The endpoints that minimise the squared error for the chosen indices, each texel
+// weighted towards endpoint1 by weights[index]: the 2x2 normal equations per channel.
+// False when every texel sits on the same weight and the system is singular.
+static bool refitEndpoints(const unsigned char* texels, int channels, const unsigned int indices[16], const float* weights,
+	float endpoint0[4], float endpoint1[4])
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		float b = weights[indices[i]], a = 1.0f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (int c = 0; c < channels; c++)
+		{
+			ax[c] += a * texels[i * 4 + c];
+			bx[c] += b * texels[i * 4 + c];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (std::fabs(determinant) < 1e-6f)
+		return false;
+	for (int c = 0; c < channels; c++)
+	{
+		endpoint0[c] = std::min(255.0f, std::max(0.0f, (ax[c] * bb - bx[c] * ab) / determinant));
+		endpoint1[c] = std::min(255.0f, std::max(0.0f, (bx[c] * aa - ax[c] * ab) / determinant));
+	}
+	return true;
+}
+
+// For every texel the index of the closest of count palette colours, by squared error
+// over the first channels (3 leaves alpha out, 4 takes it); returns the summed error.
+// Ties go to the lower index.
+static unsigned int findIndices(const unsigned char texels[64], const int (*palette)[4], unsigned int count, int channels,
+	unsigned int indices[16])
+{
+#if DANK5_BCN_SSE
+	// four texels a register, widened to 16 bits: two texels per half
+	__m128i zero = _mm_setzero_si128();
+	__m128i mask = _mm_set1_epi32(channels == 3 ? 0x00ffffff : -1);
+	__m128i wide[8];
+	for (int g = 0; g < 4; g++)
+	{
+		__m128i quad = _mm_and_si128(_mm_loadu_si128((const __m128i*)(texels + g * 16)), mask);
+		wide[2 * g] = _mm_unpacklo_epi8(quad, zero);
+		wide[2 * g + 1] = _mm_unpackhi_epi8(quad, zero);
+	}
+	__m128i best[4], index[4];
+	for (int g = 0; g < 4; g++)
+	{
+		best[g] = _mm_set1_epi32(0x7fffffff);
+		index[g] = zero;
+	}
+	for (unsigned int k = 0; k < count; k++)
+	{
+		const int* p = palette[k];
+		short alpha = (short)(channels == 3 ? 0 : p[3]);
+		__m128i colour = _mm_setr_epi16((short)p[0], (short)p[1], (short)p[2], alpha, (short)p[0], (short)p[1], (short)p[2], alpha);
+		__m128i candidate = _mm_set1_epi32((int)k);
+		for (int g = 0; g < 4; g++)
+		{
+			__m128i d0 = _mm_sub_epi16(wide[2 * g], colour);
+			__m128i d1 = _mm_sub_epi16(wide[2 * g + 1], colour);
+			// r*r + g*g and b*b + a*a per texel, then the two sums of each texel added
+			__m128 e0 = _mm_castsi128_ps(_mm_madd_epi16(d0, d0));
+			__m128 e1 = _mm_castsi128_ps(_mm_madd_epi16(d1, d1));
+			__m128i error = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(e0, e1, _MM_SHUFFLE(2, 0, 2, 0))),
+				_mm_castps_si128(_mm_shuffle_ps(e0, e1, _MM_SHUFFLE(3, 1, 3, 1))));
+			__m128i closer = _mm_cmplt_epi32(error, best[g]);
+			best[g] = _mm_or_si128(_mm_and_si128(closer, error), _mm_andnot_si128(closer, best[g]));
+			index[g] = _mm_or_si128(_mm_and_si128(closer, candidate), _mm_andnot_si128(closer, index[g]));
+		}
+	}
+	__m128i total = _mm_add_epi32(_mm_add_epi32(best[0], best[1]), _mm_add_epi32(best[2], best[3]));
+	for (int g = 0; g < 4; g++)
+		_mm_storeu_si128((__m128i*)(indices + g * 4), index[g]);
+	unsigned int sums[4];
+	_mm_storeu_si128((__m128i*)sums, total);
+	return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+	unsigned int total = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		const unsigned char* texel = texels + i * 4;
+		unsigned int bestError = 0xffffffffu;
+		for (unsigned int k = 0; k < count; k++)
+		{
+			unsigned int error = 0;
+			for (int c = 0; c < channels; c++)
+			{
+				int d = texel[c] - palette[k][c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[i] = k;
+			}
+		}
+		total += bestError;
+	}
+	return total;
+#endif
+}
+
+// findIndices() for one channel: 16 values against 8 palette entries
+static unsigned int findChannelIndices(const unsigned char values[16], const int palette[8], unsigned int indices[16])
+{
+#if DANK5_BCN_SSE
+	// all 16 values in one register; |a - b| on bytes is the OR of both saturated differences
+	__m128i value = _mm_loadu_si128((const __m128i*)values);
+	__m128i best = _mm_set1_epi8((char)0xff);
+	__m128i index = _mm_setzero_si128();
+	__m128i ones = _mm_set1_epi8((char)0xff);
+	for (int k = 0; k < 8; k++)
+	{
+		__m128i entry = _mm_set1_epi8((char)palette[k]);
+		__m128i distance = _mm_or_si128(_mm_subs_epu8(value, entry), _mm_subs_epu8(entry, value));
+		// min(distance, best) == best unless distance is strictly closer
+		__m128i closer = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_min_epu8(distance, best), best), ones);
+		best = _mm_min_epu8(distance, best);
+		index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi8((char)k)), _mm_andnot_si128(closer, index));
+	}
+	unsigned char chosen[16];
+	_mm_storeu_si128((__m128i*)chosen, index);
+	for (int i = 0; i < 16; i++)
+		indices[i] = chosen[i];
+	__m128i zero = _mm_setzero_si128();
+	__m128i low = _mm_unpacklo_epi8(best, zero), high = _mm_unpackhi_epi8(best, zero);
+	__m128i total = _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high));
+	unsigned int sums[4];
+	_mm_storeu_si128((__m128i*)sums, total);
+	return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+	unsigned int total = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int bestDistance = 256;
+		for (unsigned int k = 0; k < 8; k++)
+		{
+			int distance = std::abs(values[i] - palette[k]);
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				indices[i] = k;
+			}
+		}
+		total += bestDistance * bestDistance;
+	}
+	return total;
+#endif
+}
+
+static unsigned short to565(const float colour[3])
+{
+	int r = (int)(colour[0] * 31.0f / 255.0f + 0.5f);
+	int g = (int)(colour[1] * 63.0f / 255.0f + 0.5f);
+	int b = (int)(colour[2] * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void from565(unsigned short value, int colour[4])
+{
+	int r = value >> 11, g = (value >> 5) & 63, b = value & 31;
+	colour[0] = (r << 3) | (r >> 2);
+	colour[1] = (g << 2) | (g >> 4);
+	colour[2] = (b << 3) | (b >> 2);
+	colour[3] = 255;
+}
+
+// colour0 > colour1: 0 = colour0, 1 = colour1, 2 and 3 a third and two thirds of the way
+static const float BC1_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+// codes the colour half of a block from two endpoints; returns the squared error
+static unsigned int encodeBC1(const unsigned char texels[64], const float endpoint0[4], const float endpoint1[4],
+	unsigned char out[8], unsigned int indices[16])
+{
+	unsigned short colour0 = to565(endpoint0), colour1 = to565(endpoint1);
+	// colour0 > colour1 selects four colours (no transparent black)
+	if (colour0 < colour1)
+		std::swap(colour0, colour1);
+
+	int palette[4][4];
+	from565(colour0, palette[0]);
+	from565(colour1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+	}
+	// equal endpoints would select three colours, where index 3 is black: use only index 0
+	unsigned int error = findIndices(texels, palette, colour0 != colour1 ? 4 : 1, 3, indices);
+
+	unsigned int packed = 0;
+	for (int i = 0; i < 16; i++)
+		packed |= indices[i] << (2 * i);
+	out[0] = (unsigned char)colour0;
+	out[1] = (unsigned char)(colour0 >> 8);
+	out[2] = (unsigned char)colour1;
+	out[3] = (unsigned char)(colour1 >> 8);
+	for (int i = 0; i < 4; i++)
+		out[4 + i] = (unsigned char)(packed >> (8 * i));
+	return error;
+}
+
+void compressBC1Block(const unsigned char texels[64], unsigned char out[8], CompressionQuality quality)
+{
+	float low[4], high[4];
+	boundingBox(texels, 3, low, high);
+	unsigned int indices[16];
+	unsigned int error = encodeBC1(texels, high, low, out, indices);
+	if (quality == COMPRESS_FAST)
+		return;
+
+	// the principal axis wins on most blocks but not all, so it has to beat the box
+	fitLine(texels, 3, 1.0f / 16.0f, low, high);
+	unsigned char line[8];
+	unsigned int lineIndices[16];
+	unsigned int lineError = encodeBC1(texels, high, low, line, lineIndices);
+	if (lineError < error)
+	{
+		error = lineError;
+		memcpy(out, line, sizeof(line));
+		memcpy(indices, lineIndices, sizeof(indices));
+	}
+	if (quality != COMPRESS_BEST)
+		return;
+
+	// the indices are relative to the endpoints as stored, so the refit is too
+	for (int iteration = 0; iteration < 2 && error > 0; iteration++)
+	{
+		float endpoint0[4], endpoint1[4];
+		if (!refitEndpoints(texels, 3, indices, BC1_WEIGHTS, endpoint0, endpoint1))
+			break;
+		unsigned char candidate[8];
+		unsigned int candidateIndices[16];
+		unsigned int candidateError = encodeBC1(texels, endpoint0, endpoint1, candidate, candidateIndices);
+		if (candidateError >= error)
+			break;
+		error = candidateError;
+		memcpy(out, candidate, sizeof(candidate));
+		memcpy(indices, candidateIndices, sizeof(indices));
+	}
+}
+
+// value0 > value1: 0 = value0, 1 = value1, 2..7 from value0 towards value1
+static const float CHANNEL_WEIGHTS[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+
+// codes a BC4 style block (BC3 alpha, BC4, either half of BC5); value0 > value1 or equal
+static unsigned int encodeChannel(const unsigned char values[16], int value0, int value1, unsigned char out[8], unsigned int indices[16])
+{
+	out[0] = (unsigned char)value0;
+	out[1] = (unsigned char)value1;
+	unsigned int error = 0;
+	unsigned long long packed = 0;
+	if (value0 == value1)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			int d = values[i] - value0;
+			error += d * d;
+			indices[i] = 0;
+		}
+	}
+	else
+	{
+		int palette[8];
+		palette[0] = value0;
+		palette[1] = value1;
+		for (int k = 1; k < 7; k++)
+			palette[k + 1] = ((7 - k) * value0 + k * value1 + 3) / 7;
+		error = findChannelIndices(values, palette, indices);
+		for (int i = 0; i < 16; i++)
+			packed |= (unsigned long long)indices[i] << (3 * i);
+	}
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (unsigned char)(packed >> (8 * i));
+	return error;
+}
+
+// For a single channel the bounding box and the principal axis both come to its extremes.
+// Fast codes those; normal also tries them pulled in by half a palette step, which often
+// wins when a few outliers stretch the range; best refits the winner to its indices.
+static void compressChannelBlock(const unsigned char texels[64], int channel, unsigned char out[8], CompressionQuality quality)
+{
+	unsigned char values[16];
+	int lowest = 255, highest = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		values[i] = texels[i * 4 + channel];
+		lowest = std::min(lowest, (int)values[i]);
+		highest = std::max(highest, (int)values[i]);
+	}
+	unsigned int indices[16];
+	unsigned int error = encodeChannel(values, highest, lowest, out, indices);
+	if (quality == COMPRESS_FAST)
+		return;
+
+	int inset = (highest - lowest + 7) / 14;
+	if (inset > 0 && error > 0)
+	{
+		unsigned char candidate[8];
+		unsigned int candidateIndices[16];
+		unsigned int candidateError = encodeChannel(values, highest - inset, lowest + inset, candidate, candidateIndices);
+		if (candidateError < error)
+		{
+			error = candidateError;
+			memcpy(out, candidate, sizeof(candidate));
+			memcpy(indices, candidateIndices, sizeof(indices));
+		}
+	}
+	if (quality != COMPRESS_BEST)
+		return;
+
+	for (int iteration = 0; iteration < 2 && error > 0; iteration++)
+	{
+		unsigned char column[64] = {};
+		for (int i = 0; i < 16; i++)
+			column[i * 4] = values[i];
+		float endpoint0[4], endpoint1[4];
+		if (!refitEndpoints(column, 1, indices, CHANNEL_WEIGHTS, endpoint0, endpoint1))
+			break;
+		int value0 = (int)(endpoint0[0] + 0.5f), value1 = (int)(endpoint1[0] + 0.5f);
+		// swapped endpoints would select the six value mode; the search below redoes the indices
+		if (value0 < value1)
+			std::swap(value0, value1);
+		unsigned char candidate[8];
+		unsigned int candidateIndices[16];
+		unsigned int candidateError = encodeChannel(values, value0, value1, candidate, candidateIndices);
+		if (candidateError >= error)
+			break;
+		error = candidateError;
+		memcpy(out, candidate, sizeof(candidate));
+		memcpy(indices, candidateIndices, sizeof(indices));
+	}
+}
+
+void compressBC3Block(const unsigned char texels[64], unsigned char out[16], CompressionQuality quality)
+{
+	compressChannelBlock(texels, 3, out, quality);
+	compressBC1Block(texels, out + 8, quality);
+}
+
+void compressBC4Block(const unsigned char texels[64], unsigned char out[8], CompressionQuality quality)
+{
+	compressChannelBlock(texels, 0, out, quality);
+}
+
+void compressBC5Block(const unsigned char texels[64], unsigned char out[16], CompressionQuality quality)
+{
+	compressChannelBlock(texels, 0, out, quality);
+	compressChannelBlock(texels, 1, out + 8, quality);
+}
+
+// writes fields into a block from the lowest bit up
+struct BlockBits {
+	unsigned char* out;
+	unsigned int bit;
+
+	void write(unsigned int value, unsigned int bits)
+	{
+		for (unsigned int i = 0; i < bits; i++, bit++)
+			if ((value >> i) & 1)
+				out[bit >> 3] |= (unsigned char)(1 << (bit & 7));
+	}
+};
+
+// and reads them back
+struct BlockBitsReader {
+	const unsigned char* in;
+	unsigned int bit;
+
+	unsigned int read(unsigned int bits)
+	{
+		unsigned int value = 0;
+		for (unsigned int i = 0; i < bits; i++, bit++)
+			value |= (unsigned int)((in[bit >> 3] >> (bit & 7)) & 1) << i;
+		return value;
+	}
+};
+
+static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// codes a mode 6 block from two endpoints; returns the squared error
+static unsigned int encodeBC7(const unsigned char texels[64], const float endpoint0[4], const float endpoint1[4],
+	unsigned char out[16], unsigned int indices[16])
+{
+	const float* endpoints[2] = { endpoint0, endpoint1 };
+	// 7 bits per channel plus a shared low bit per endpoint, whichever of the two fits better
+	int quantized[2][4], pbit[2];
+	for (int e = 0; e < 2; e++)
+	{
+		float bestError = 1e30f;
+		for (int p = 0; p < 2; p++)
+		{
+			int candidate[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++)
+			{
+				candidate[c] = std::min(127, std::max(0, (int)std::floor((endpoints[e][c] - p) / 2.0f + 0.5f)));
+				float d = (float)(candidate[c] * 2 + p) - endpoints[e][c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				pbit[e] = p;
+				memcpy(quantized[e], candidate, sizeof(candidate));
+			}
+		}
+	}
+
+	int palette[16][4];
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 4; c++)
+		{
+			int e0 = quantized[0][c] * 2 + pbit[0], e1 = quantized[1][c] * 2 + pbit[1];
+			palette[i][c] = ((64 - BC7_WEIGHTS[i]) * e0 + BC7_WEIGHTS[i] * e1 + 32) >> 6;
+		}
+	unsigned int error = findIndices(texels, palette, 16, 4, indices);
+	// the first index is stored without its top bit, so it has to be below 8
+	if (indices[0] >= 8)
+	{
+		for (int c = 0; c < 4; c++)
+			std::swap(quantized[0][c], quantized[1][c]);
+		std::swap(pbit[0], pbit[1]);
+		for (int i = 0; i < 16; i++)
+			indices[i] = 15 - indices[i];
+	}
+
+	memset(out, 0, 16);
+	BlockBits bits = { out, 0 };
+	bits.write(1 << 6, 7);
+	for (int c = 0; c < 4; c++)
+	{
+		bits.write(quantized[0][c], 7);
+		bits.write(quantized[1][c], 7);
+	}
+	bits.write(pbit[0], 1);
+	bits.write(pbit[1], 1);
+	bits.write(indices[0], 3);
+	for (int i = 1; i < 16; i++)
+		bits.write(indices[i], 4);
+	return error;
+}
+
+void compressBC7Block(const unsigned char texels[64], unsigned char out[16], CompressionQuality quality)
+{
+	float endpoint0[4], endpoint1[4];
+	if (quality == COMPRESS_FAST)
+		boundingBox(texels, 4, endpoint0, endpoint1);
+	else
+		fitLine(texels, 4, 0.0f, endpoint0, endpoint1);
+	unsigned int indices[16];
+	unsigned int error = encodeBC7(texels, endpoint0, endpoint1, out, indices);
+	if (quality != COMPRESS_BEST)
+		return;
+
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = BC7_WEIGHTS[i] / 64.0f;
+	for (int iteration = 0; iteration < 2 && error > 0; iteration++)
+	{
+		if (!refitEndpoints(texels, 4, indices, weights, endpoint0, endpoint1))
+			break;
+		unsigned char candidate[16];
+		unsigned int candidateIndices[16];
+		unsigned int candidateError = encodeBC7(texels, endpoint0, endpoint1, candidate, candidateIndices);
+		if (candidateError >= error)
+			break;
+		error = candidateError;
+		memcpy(out, candidate, sizeof(candidate));
+		memcpy(indices, candidateIndices, sizeof(indices));
+	}
+}
+
+// compresses the row of blocks starting at texel row by
+static void compressBlockRow(BlockFormat format, const unsigned char* rgba, int width, int height, int by, unsigned char* out,
+	CompressionQuality quality)
+{
+	unsigned char texels[64];
+	for (int bx = 0; bx < width; bx += 4)
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			const unsigned char* row = rgba + (size_t)std::min(by + y, height - 1) * width * 4;
+			for (int x = 0; x < 4; x++)
+				memcpy(texels + (y * 4 + x) * 4, row + std::min(bx + x, width - 1) * 4, 4);
+		}
+		switch (format)
+		{
+		case BLOCK_BC1: compressBC1Block(texels, out, quality); break;
+		case BLOCK_BC3: compressBC3Block(texels, out, quality); break;
+		case BLOCK_BC4: compressBC4Block(texels, out, quality); break;
+		case BLOCK_BC5: compressBC5Block(texels, out, quality); break;
+		case BLOCK_BC7: compressBC7Block(texels, out, quality); break;
+		}
+		out += blockBytes(format);
+	}
+}
+
+void compressImage(BlockFormat format, const unsigned char* rgba, int width, int height, unsigned char* out,
+	CompressionQuality quality, unsigned int threads)
+{
+	int rows = (height + 3) / 4;
+	size_t rowBytes = (size_t)((width + 3) / 4) * blockBytes(format);
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min(threads, (unsigned int)rows);
+
+	// every block is independent, so workers take rows of blocks off a counter
+	std::atomic<int> next(0);
+	auto work = [&]()
+	{
+		for (int row = next++; row < rows; row = next++)
+			compressBlockRow(format, rgba, width, height, row * 4, out + row * rowBytes, quality);
+	};
+	std::vector<std::thread> workers;
+	for (unsigned int i = 1; i < threads; i++)
+		workers.emplace_back(work);
+	work();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+static void decodeBC1(const unsigned char* block, unsigned char texels[64])
+{
+	unsigned short colour0 = (unsigned short)(block[0] | (block[1] << 8));
+	unsigned short colour1 = (unsigned short)(block[2] | (block[3] << 8));
+	int palette[4][4];
+	from565(colour0, palette[0]);
+	from565(colour1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		if (colour0 > colour1)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = colour0 > colour1 ? 255 : 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int index = (block[4 + i / 4] >> (2 * (i % 4))) & 3;
+		for (int c = 0; c < 4; c++)
+			texels[i * 4 + c] = (unsigned char)palette[index][c];
+	}
+}
+
+static void decodeChannel(const unsigned char* block, int channel, unsigned char texels[64])
+{
+	int palette[8];
+	palette[0] = block[0];
+	palette[1] = block[1];
+	if (palette[0] > palette[1])
+		for (int k = 1; k < 7; k++)
+			palette[k + 1] = ((7 - k) * palette[0] + k * palette[1] + 3) / 7;
+	else
+	{
+		for (int k = 1; k < 5; k++)
+			palette[k + 1] = ((5 - k) * palette[0] + k * palette[1] + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+	unsigned long long indices = 0;
+	for (int i = 0; i < 6; i++)
+		indices |= (unsigned long long)block[2 + i] << (8 * i);
+	for (int i = 0; i < 16; i++)
+		texels[i * 4 + channel] = (unsigned char)palette[(indices >> (3 * i)) & 7];
+}
+
+static void decodeBC7(const unsigned char* block, unsigned char texels[64])
+{
+	// mode 6 is a 1 in bit 6 with zeros below it
+	if ((block[0] & 0x7f) != 0x40)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			texels[i * 4 + 0] = 255;
+			texels[i * 4 + 1] = 0;
+			texels[i * 4 + 2] = 255;
+			texels[i * 4 + 3] = 255;
+		}
+		return;
+	}
+	BlockBitsReader bits = { block, 7 };
+	int endpoints[2][4];
+	for (int c = 0; c < 4; c++)
+	{
+		endpoints[0][c] = (int)bits.read(7) << 1;
+		endpoints[1][c] = (int)bits.read(7) << 1;
+	}
+	unsigned int pbit0 = bits.read(1), pbit1 = bits.read(1);
+	for (int c = 0; c < 4; c++)
+	{
+		endpoints[0][c] |= pbit0;
+		endpoints[1][c] |= pbit1;
+	}
+	for (int i = 0; i < 16; i++)
+	{
+		int weight = BC7_WEIGHTS[bits.read(i == 0 ? 3 : 4)];
+		for (int c = 0; c < 4; c++)
+			texels[i * 4 + c] = (unsigned char)(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+	}
+}
+
+void decompressImage(BlockFormat format, const unsigned char* blocks, int width, int height, unsigned char* rgba)
+{
+	unsigned char texels[64];
+	for (int by = 0; by < height; by += 4)
+		for (int bx = 0; bx < width; bx += 4)
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				texels[i * 4 + 0] = texels[i * 4 + 1] = texels[i * 4 + 2] = 0;
+				texels[i * 4 + 3] = 255;
+			}
+			switch (format)
+			{
+			case BLOCK_BC1: decodeBC1(blocks, texels); break;
+			case BLOCK_BC3: decodeBC1(blocks + 8, texels); decodeChannel(blocks, 3, texels); break;
+			case BLOCK_BC4: decodeChannel(blocks, 0, texels); break;
+			case BLOCK_BC5: decodeChannel(blocks, 0, texels); decodeChannel(blocks + 8, 1, texels); break;
+			case BLOCK_BC7: decodeBC7(blocks, texels); break;
+			}
+			blocks += blockBytes(format);
+			for (int y = 0; y < 4 && by + y < height; y++)
+			{
+				int columns = std::min(4, width - bx);
+				memcpy(rgba + ((size_t)(by + y) * width + bx) * 4, texels + y * 16, (size_t)columns * 4);
+			}
+		}
+}
+
+double compressionPSNR(BlockFormat format, const unsigned char* original, const unsigned char* decoded, int width, int height)
+{
+	int channels = storedChannels(format);
+	size_t texels = (size_t)width * height;
+	double error = 0.0;
+	for (size_t i = 0; i < texels; i++)
+		for (int c = 0; c < channels; c++)
+		{
+			double d = (double)original[i * 4 + c] - decoded[i * 4 + c];
+			error += d * d;
+		}
+	error /= (double)texels * channels;
+	return error > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / error) : 99.0;
+}
+
+CompressionReport compressTexture(BlockFormat format, const unsigned char* rgba, int width, int height, unsigned char* out,
+	CompressionQuality quality, unsigned int threads)
+{
+	CompressionReport report;
+	report.format = format;
+	report.quality = quality;
+	report.width = width;
+	report.height = height;
+	auto start = std::chrono::steady_clock::now();
+	compressImage(format, rgba, width, height, out, quality, threads);
+	report.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<unsigned char> decoded((size_t)width * height * 4);
+	decompressImage(format, out, width, height, decoded.data());
+	report.psnr = compressionPSNR(format, rgba, decoded.data(), width, height);
+	return report;
+}
+
+void CompressionReport::print(const char* name) const
+{
+	std::cout << "TEXTURECOMPRESS::" << name << " " << blockFormatName(format) << " " << compressionQualityName(quality)
+		<< " " << width << "x" << height << " " << psnr << " dB in " << milliseconds << " ms" << std::endl;
+}
+
+const char* compressionPath()
+{
+#if DANK5_BCN_SSE
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
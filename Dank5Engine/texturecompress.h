@@ -0,0 +1,77 @@
+#ifndef TEXTURECOMPRESS_H
+#define TEXTURECOMPRESS_H
+
+#include <cstddef>
+
+// BCn block compression on the CPU, for baking textures offline (no GPU needed). Every
+// format codes 4x4 texel blocks; images are read as RGBA8 rows and blocks past the
+// right or bottom edge repeat the last column or row.
+enum BlockFormat {
+	// RGB, opaque: 8 bytes per block
+	BLOCK_BC1,
+	// RGBA, BC1 colour plus interpolated alpha: 16 bytes per block
+	BLOCK_BC3,
+	// R (e.g. roughness or height): 8 bytes per block
+	BLOCK_BC4,
+	// RG (e.g. tangent space normal xy): two BC4 blocks, 16 bytes
+	BLOCK_BC5,
+	// RGBA, mode 6 (one subset, 7.7.7.7 endpoints, 16 weights): 16 bytes per block
+	BLOCK_BC7
+};
+
+// quality/speed presets
+enum CompressionQuality {
+	// endpoints on the corners of the block's bounding box
+	COMPRESS_FAST,
+	// endpoints on the principal axis of the block's colours (BC1 and BC3 keep the
+	// bounding box where it codes the block better); a single channel (BC4, BC5, BC3
+	// alpha) tries its extremes and the extremes pulled in by half a palette step
+	COMPRESS_NORMAL,
+	// the principal axis, then endpoints refit to the chosen indices by least squares
+	COMPRESS_BEST
+};
+
+// what compressTexture() did to one image
+struct CompressionReport {
+	BlockFormat format;
+	CompressionQuality quality;
+	int width, height;
+	double milliseconds;
+	// over the channels the format stores: RGB for BC1, R for BC4, RG for BC5, else RGBA
+	double psnr;
+
+	void print(const char* name) const;
+};
+
+// bytes per 4x4 block
+unsigned int blockBytes(BlockFormat format);
+// bytes of a width x height image
+size_t compressedSize(BlockFormat format, int width, int height);
+// "BC1" .. "BC7", "fast" / "normal" / "best"
+const char* blockFormatName(BlockFormat format);
+const char* compressionQualityName(CompressionQuality quality);
+
+// compresses an RGBA8 image into rows of blocks, top to bottom. The rows of blocks are
+// split over threads (0 = one per hardware thread); the output doesn't depend on it.
+void compressImage(BlockFormat format, const unsigned char* rgba, int width, int height, unsigned char* out,
+	CompressionQuality quality = COMPRESS_NORMAL, unsigned int threads = 0);
+// decodes blocks back to RGBA8 (channels a format doesn't store come back as 0, alpha as 255).
+// BC7 decodes mode 6, the only mode compressImage writes.
+void decompressImage(BlockFormat format, const unsigned char* blocks, int width, int height, unsigned char* rgba);
+// PSNR between two RGBA8 images over the channels the format stores
+double compressionPSNR(BlockFormat format, const unsigned char* original, const unsigned char* decoded, int width, int height);
+// compressImage(), timed and checked against the source
+CompressionReport compressTexture(BlockFormat format, const unsigned char* rgba, int width, int height, unsigned char* out,
+	CompressionQuality quality = COMPRESS_NORMAL, unsigned int threads = 0);
+
+// one block of 16 RGBA8 texels in rows
+void compressBC1Block(const unsigned char texels[64], unsigned char out[8], CompressionQuality quality = COMPRESS_NORMAL);
+void compressBC3Block(const unsigned char texels[64], unsigned char out[16], CompressionQuality quality = COMPRESS_NORMAL);
+void compressBC4Block(const unsigned char texels[64], unsigned char out[8], CompressionQuality quality = COMPRESS_NORMAL);
+void compressBC5Block(const unsigned char texels[64], unsigned char out[16], CompressionQuality quality = COMPRESS_NORMAL);
+void compressBC7Block(const unsigned char texels[64], unsigned char out[16], CompressionQuality quality = COMPRESS_NORMAL);
+
+// "sse2" or "scalar": the path the index search uses in this build
+const char* compressionPath();
+
+#endif
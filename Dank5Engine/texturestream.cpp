@@ -0,0 +1,261 @@
+#include "texturestream.h"
+#include "glstate.h"
+#include "mipmap.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+TextureStreamer::TextureStreamer(unsigned int workerCount, GLsizeiptr segmentBytes, unsigned int frames)
+	: PBO(0), Frames(frames), SegmentBytes(segmentBytes), stopping(false), current(0), mapped(nullptr), stallCount(0)
+{
+	if (Frames < 1)
+		Frames = 1;
+	if (Frames > MAX_FRAMES)
+		Frames = MAX_FRAMES;
+	for (unsigned int i = 0; i < MAX_FRAMES; i++)
+		fences[i] = 0;
+	// rows are staged whole and 4-byte aligned
+	SegmentBytes = (SegmentBytes + 3) & ~(GLsizeiptr)3;
+
+	glGenBuffers(1, &PBO);
+	glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+	if (GLAD_GL_VERSION_4_4)
+	{
+		// immutable storage mapped once for the lifetime of the buffer
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, SegmentBytes * Frames, NULL, flags);
+		mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, SegmentBytes * Frames, flags);
+	}
+	else
+	{
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, SegmentBytes * Frames, NULL, GL_STREAM_DRAW);
+	}
+	// a bound unpack buffer turns every client pointer into an offset, never leave it bound
+	glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	current = Frames - 1;
+
+	if (workerCount < 1)
+		workerCount = 1;
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers.push_back(std::thread(&TextureStreamer::work, this));
+}
+
+unsigned int TextureStreamer::load(const std::string& path)
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glState().bindTexture(0, GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	// placeholder until the real levels arrive: a grey 2x2 checker
+	static const unsigned char placeholder[] = {
+		96, 96, 96, 255,	160, 160, 160, 255,
+		160, 160, 160, 255,	96, 96, 96, 255
+	};
+	glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+
+	streaming.insert(texture);
+	Request request = { texture, path };
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		requests.push_back(request);
+	}
+	wake.notify_one();
+	return texture;
+}
+
+void TextureStreamer::work()
+{
+	for (;;)
+	{
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !requests.empty(); });
+			if (stopping)
+				return;
+			request = requests.front();
+			requests.pop_front();
+		}
+		Decoded image;
+		decode(request, image);
+		std::lock_guard<std::mutex> lock(mutex);
+		decoded.push_back(std::move(image));
+	}
+}
+
+void TextureStreamer::decode(const Request& request, Decoded& out) const
+{
+	out.texture = request.texture;
+	out.path = request.path;
+	out.levels = 0;
+	out.started = false;
+	int channels;
+	unsigned char* data = stbi_load(request.path.c_str(), &out.width, &out.height, &channels, 4);
+	if (!data)
+	{
+		const char* reason = stbi_failure_reason();
+		out.error = reason ? reason : "unknown";
+		return;
+	}
+
+	size_t size = mipChainOffsets(out.width, out.height, out.offsets);
+	out.levels = (unsigned int)out.offsets.size();
+	out.texels.resize(size);
+	memcpy(out.texels.data(), data, (size_t)out.width * out.height * 4);
+	stbi_image_free(data);
+	// the workers already decode side by side, so each takes its share of the cores
+	unsigned int threads = std::max(1u, std::thread::hardware_concurrency() / (unsigned int)std::max<size_t>(workers.size(), 1));
+	buildMipChain(out.texels.data(), out.width, out.height, out.offsets, MIP_BOX, true, threads);
+	out.level = out.levels - 1;
+	out.row = 0;
+}
+
+void TextureStreamer::begin(Decoded& image)
+{
+	// immutable storage for the whole chain; only levels already uploaded are sampled
+	glState().bindTexture(0, GL_TEXTURE_2D, image.texture);
+	glTexStorage2D(GL_TEXTURE_2D, image.levels, GL_RGBA8, image.width, image.height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levels - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, image.levels - 1);
+	image.started = true;
+}
+
+GLsizeiptr TextureStreamer::stage(GLsizeiptr offset, const unsigned char* data, GLsizeiptr size)
+{
+	GLsizeiptr at = SegmentBytes * current + offset;
+	if (mapped)
+		std::memcpy(mapped + at, data, size);
+	else
+		glBufferSubData(GL_PIXEL_UNPACK_BUFFER, at, size, data);
+	return at;
+}
+
+void TextureStreamer::waitSegment()
+{
+	current = (current + 1) % Frames;
+	// wait until the GPU has copied out of this segment the last time round
+	if (fences[current])
+	{
+		GLenum status = glClientWaitSync(fences[current], 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+		{
+			stallCount++;
+			while (glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+				;
+		}
+		glDeleteSync(fences[current]);
+		fences[current] = 0;
+	}
+}
+
+size_t TextureStreamer::update(size_t budgetBytes)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		while (!decoded.empty())
+		{
+			uploading.push_back(std::move(decoded.front()));
+			decoded.pop_front();
+		}
+	}
+	if (uploading.empty())
+		return 0;
+
+	waitSegment();
+	GLsizeiptr budget = (GLsizeiptr)std::min(budgetBytes, (size_t)SegmentBytes);
+	GLsizeiptr used = 0;
+	glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+	while (!uploading.empty())
+	{
+		Decoded& image = uploading.front();
+		if (image.levels == 0)
+		{
+			std::cout << "ERROR::TEXTURESTREAM::FAILED_TO_LOAD " << image.path << " (" << image.error << ")" << std::endl;
+			streaming.erase(image.texture);
+			uploading.pop_front();
+			continue;
+		}
+
+		int w = std::max(1, image.width >> image.level), h = std::max(1, image.height >> image.level);
+		GLsizeiptr rowBytes = (GLsizeiptr)w * 4;
+		GLsizeiptr rows = (budget - used) / rowBytes;
+		// always make progress, even on a budget smaller than a row
+		if (rows == 0 && used == 0 && rowBytes <= SegmentBytes)
+			rows = 1;
+		if (rows == 0)
+			break;
+		rows = std::min(rows, (GLsizeiptr)(h - image.row));
+
+		if (!image.started)
+			begin(image);
+		const unsigned char* src = &image.texels[image.offsets[image.level] + (size_t)image.row * rowBytes];
+		GLsizeiptr offset = stage(used, src, rows * rowBytes);
+		glState().bindTexture(0, GL_TEXTURE_2D, image.texture);
+		glTexSubImage2D(GL_TEXTURE_2D, image.level, 0, image.row, w, (GLsizei)rows, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)offset);
+		used += rows * rowBytes;
+		image.row += (int)rows;
+
+		if (image.row == h)
+		{
+			// the level is complete: let the sampler see it
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, image.level);
+			image.level--;
+			image.row = 0;
+			if (image.level < 0)
+			{
+				streaming.erase(image.texture);
+				uploading.pop_front();
+			}
+		}
+	}
+	glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (used)
+		fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	return (size_t)used;
+}
+
+void TextureStreamer::finish()
+{
+	while (!streaming.empty())
+	{
+		if (update((size_t)SegmentBytes) == 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+void TextureStreamer::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	workers.clear();
+
+	for (unsigned int i = 0; i < MAX_FRAMES; i++)
+	{
+		if (fences[i])
+			glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+	if (mapped)
+	{
+		glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		mapped = nullptr;
+	}
+	glState().deleteBuffers(1, &PBO);
+	PBO = 0;
+}
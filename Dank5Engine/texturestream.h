@@ -0,0 +1,98 @@
+#ifndef TEXTURESTREAM_H
+#define TEXTURESTREAM_H
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Streams textures in without blocking the render thread. load() hands back a texture
+// name at once, showing a small placeholder; worker threads decode the file and build
+// the mip chain, and update() copies the levels into a persistently mapped pixel
+// unpack buffer and uploads them, smallest level first and within a per-frame byte
+// budget. GL_TEXTURE_BASE_LEVEL follows the uploads, so a texture sharpens over a
+// few frames instead of popping in at once.
+// Textures are RGBA8 with a box-filtered, gamma-correct mip chain. All methods but the workers'
+// decoding run on the GL thread; call destroy() while the context lives.
+class TextureStreamer {
+
+public:
+	// the staging pixel unpack buffer
+	unsigned int PBO;
+	// staging segments in the ring; update() fills one and fences it
+	unsigned int Frames;
+	// bytes per staging segment, an upper bound on what one update() uploads
+	GLsizeiptr SegmentBytes;
+
+	TextureStreamer(unsigned int workers = 2, GLsizeiptr segmentBytes = 4 << 20, unsigned int frames = 3);
+
+	// request a texture; the returned name is valid (and drawable) immediately
+	unsigned int load(const std::string& path);
+	// upload at most budgetBytes of decoded texels; call once per frame, returns the bytes uploaded
+	size_t update(size_t budgetBytes);
+	// block until every requested texture is resident (or failed)
+	void finish();
+
+	// all levels uploaded (also true for names the streamer doesn't know)
+	bool resident(unsigned int texture) const { return streaming.find(texture) == streaming.end(); }
+	// textures requested and not resident yet
+	unsigned int pending() const { return (unsigned int)streaming.size(); }
+	// how often update() had to wait for the GPU to release a staging segment
+	unsigned int stalls() const { return stallCount; }
+
+	// stop the workers and delete the staging buffer (the textures stay)
+	void destroy();
+
+private:
+	struct Request {
+		unsigned int texture;
+		std::string path;
+	};
+
+	// a decoded image and its mip chain, levels back to back from level 0
+	struct Decoded {
+		unsigned int texture;
+		std::string path;
+		int width, height;
+		unsigned int levels;
+		std::vector<size_t> offsets;
+		std::vector<unsigned char> texels;
+		// next level and row to upload, levels go from the smallest up
+		int level;
+		int row;
+		// storage allocated
+		bool started;
+		// why decoding failed (levels == 0)
+		std::string error;
+	};
+
+	static const unsigned int MAX_FRAMES = 4;
+
+	void work();
+	void decode(const Request& request, Decoded& out) const;
+	void begin(Decoded& image);
+	GLsizeiptr stage(GLsizeiptr offset, const unsigned char* data, GLsizeiptr size);
+	void waitSegment();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<Request> requests;
+	std::deque<Decoded> decoded;
+	bool stopping;
+
+	// owned by the GL thread
+	std::unordered_set<unsigned int> streaming;
+	std::deque<Decoded> uploading;
+	unsigned int current;
+	unsigned char* mapped;
+	GLsync fences[MAX_FRAMES];
+	unsigned int stallCount;
+};
+
+#endif
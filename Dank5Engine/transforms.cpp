@@ -0,0 +1,255 @@
+#include "transforms.h"
+#include "jobsystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+// nodes per job when a level is split over the job system; smaller levels aren't split,
+// scanning a clean node costs a few nanoseconds
+static const unsigned int UPDATE_GRAIN = 4096;
+
+// translate * rotate * scale
+static inline glm::mat4 composeLocal(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	glm::mat3 r = glm::mat3_cast(rotation);
+	return glm::mat4(
+		glm::vec4(r[0] * scale.x, 0.0f),
+		glm::vec4(r[1] * scale.y, 0.0f),
+		glm::vec4(r[2] * scale.z, 0.0f),
+		glm::vec4(position, 1.0f));
+}
+
+// parent * local for affine matrices: the bottom rows are (0 0 0 1), so a quarter of the
+// general product drops out
+static inline glm::mat4 combineAffine(const glm::mat4& parent, const glm::mat4& local)
+{
+	glm::mat4 result;
+	for (int c = 0; c < 3; c++)
+		result[c] = parent[0] * local[c].x + parent[1] * local[c].y + parent[2] * local[c].z;
+	result[3] = parent[0] * local[3].x + parent[1] * local[3].y + parent[2] * local[3].z + parent[3];
+	return result;
+}
+
+TransformHierarchy::TransformHierarchy() : unsorted(false), pass(0)
+{
+}
+
+void TransformHierarchy::reserve(unsigned int count)
+{
+	positions.reserve(count);
+	rotations.reserve(count);
+	scales.reserve(count);
+	worlds.reserve(count);
+	parents.reserve(count);
+	depths.reserve(count);
+	firstChild.reserve(count);
+	childCount.reserve(count);
+	dirty.reserve(count);
+	changedPass.reserve(count);
+	slotOf.reserve(count);
+	nodeOf.reserve(count);
+}
+
+unsigned int TransformHierarchy::create(unsigned int parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	unsigned int node = (unsigned int)slotOf.size();
+	unsigned int slot = (unsigned int)nodeOf.size();
+	unsigned int parentSlot = parent == TRANSFORM_NONE ? TRANSFORM_NONE : slotOf[parent];
+	unsigned int depth = parentSlot == TRANSFORM_NONE ? 0 : depths[parentSlot] + 1;
+
+	// appending keeps breadth-first order as long as nodes come by depth, and within a
+	// depth by parent
+	if (depths.empty() || (!unsorted && depth > depths.back()))
+		levelStart.push_back(slot);
+	else if (depth < depths.back() || (depth == depths.back() && parentSlot < parents.back()))
+		unsorted = true;
+	if (!unsorted && parentSlot != TRANSFORM_NONE && childCount[parentSlot]++ == 0)
+		firstChild[parentSlot] = slot;
+
+	positions.push_back(position);
+	rotations.push_back(rotation);
+	scales.push_back(scale);
+	worlds.push_back(glm::mat4(1.0f));
+	parents.push_back(parentSlot);
+	depths.push_back(depth);
+	firstChild.push_back(0);
+	childCount.push_back(0);
+	dirty.push_back(1);
+	changedPass.push_back(0);
+	slotOf.push_back(slot);
+	nodeOf.push_back(node);
+	return node;
+}
+
+unsigned int TransformHierarchy::parent(unsigned int node) const
+{
+	unsigned int parentSlot = parents[slotOf[node]];
+	return parentSlot == TRANSFORM_NONE ? TRANSFORM_NONE : nodeOf[parentSlot];
+}
+
+void TransformHierarchy::setPosition(unsigned int node, const glm::vec3& position)
+{
+	unsigned int slot = slotOf[node];
+	positions[slot] = position;
+	dirty[slot] = 1;
+}
+
+void TransformHierarchy::setRotation(unsigned int node, const glm::quat& rotation)
+{
+	unsigned int slot = slotOf[node];
+	rotations[slot] = rotation;
+	dirty[slot] = 1;
+}
+
+void TransformHierarchy::setScale(unsigned int node, const glm::vec3& scale)
+{
+	unsigned int slot = slotOf[node];
+	scales[slot] = scale;
+	dirty[slot] = 1;
+}
+
+void TransformHierarchy::setLocal(unsigned int node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	unsigned int slot = slotOf[node];
+	positions[slot] = position;
+	rotations[slot] = rotation;
+	scales[slot] = scale;
+	dirty[slot] = 1;
+}
+
+// breadth-first from the roots, which come first in the order they were created, as do the
+// children of every node
+void TransformHierarchy::sort()
+{
+	const unsigned int count = size();
+	// the children of every slot, in slot order
+	std::vector<unsigned int> childrenStart(count + 1, 0), children(count);
+	for (unsigned int slot = 0; slot < count; slot++)
+		if (parents[slot] != TRANSFORM_NONE)
+			childrenStart[parents[slot] + 1]++;
+	for (unsigned int slot = 0; slot < count; slot++)
+		childrenStart[slot + 1] += childrenStart[slot];
+	std::vector<unsigned int> next(childrenStart.begin(), childrenStart.end() - 1);
+	std::vector<unsigned int> order;
+	order.reserve(count);
+	for (unsigned int slot = 0; slot < count; slot++)
+	{
+		if (parents[slot] == TRANSFORM_NONE)
+			order.push_back(slot);
+		else
+			children[next[parents[slot]]++] = slot;
+	}
+	for (unsigned int i = 0; i < order.size(); i++)
+		for (unsigned int c = childrenStart[order[i]]; c < childrenStart[order[i] + 1]; c++)
+			order.push_back(children[c]);
+
+	// new slot of every old one
+	std::vector<unsigned int> moved(count);
+	for (unsigned int to = 0; to < count; to++)
+		moved[order[to]] = to;
+
+	std::vector<glm::vec3> sortedPositions(count), sortedScales(count);
+	std::vector<glm::quat> sortedRotations(count);
+	std::vector<glm::mat4> sortedWorlds(count);
+	std::vector<unsigned int> sortedParents(count), sortedDepths(count), sortedNodes(count);
+	std::vector<uint8_t> sortedDirty(count);
+	std::vector<uint32_t> sortedChanged(count);
+	levelStart.clear();
+	firstChild.assign(count, 0);
+	childCount.assign(count, 0);
+	for (unsigned int to = 0; to < count; to++)
+	{
+		unsigned int slot = order[to];
+		unsigned int parentSlot = parents[slot] == TRANSFORM_NONE ? TRANSFORM_NONE : moved[parents[slot]];
+		sortedPositions[to] = positions[slot];
+		sortedRotations[to] = rotations[slot];
+		sortedScales[to] = scales[slot];
+		sortedWorlds[to] = worlds[slot];
+		sortedParents[to] = parentSlot;
+		sortedDepths[to] = depths[slot];
+		sortedDirty[to] = dirty[slot];
+		sortedChanged[to] = changedPass[slot];
+		sortedNodes[to] = nodeOf[slot];
+		slotOf[nodeOf[slot]] = to;
+		if (to == 0 || depths[slot] != sortedDepths[to - 1])
+			levelStart.push_back(to);
+		if (parentSlot != TRANSFORM_NONE && childCount[parentSlot]++ == 0)
+			firstChild[parentSlot] = to;
+	}
+
+	positions.swap(sortedPositions);
+	rotations.swap(sortedRotations);
+	scales.swap(sortedScales);
+	worlds.swap(sortedWorlds);
+	parents.swap(sortedParents);
+	depths.swap(sortedDepths);
+	dirty.swap(sortedDirty);
+	changedPass.swap(sortedChanged);
+	nodeOf.swap(sortedNodes);
+	unsorted = false;
+}
+
+unsigned int TransformHierarchy::updateRange(unsigned int first, unsigned int last)
+{
+	unsigned int recomputed = 0;
+	unsigned int slot = first;
+	while (slot < last)
+	{
+		// eight clean nodes at once; only whole words inside the range, the bytes past it
+		// may be another job's
+		if ((slot & 7) == 0 && slot + 8 <= last)
+		{
+			uint64_t word;
+			memcpy(&word, &dirty[slot], sizeof(word));
+			if (!word)
+			{
+				slot += 8;
+				continue;
+			}
+		}
+		if (dirty[slot])
+		{
+			unsigned int parentSlot = parents[slot];
+			glm::mat4 local = composeLocal(positions[slot], rotations[slot], scales[slot]);
+			worlds[slot] = parentSlot == TRANSFORM_NONE ? local : combineAffine(worlds[parentSlot], local);
+			changedPass[slot] = pass;
+			dirty[slot] = 0;
+			if (childCount[slot])
+				memset(&dirty[firstChild[slot]], 1, childCount[slot]);
+			recomputed++;
+		}
+		slot++;
+	}
+	return recomputed;
+}
+
+unsigned int TransformHierarchy::update(JobSystem* jobs)
+{
+	if (unsorted)
+		sort();
+	// a pass number nothing was stamped with yet
+	if (++pass == 0)
+	{
+		std::fill(changedPass.begin(), changedPass.end(), 0);
+		pass = 1;
+	}
+
+	unsigned int recomputed = 0;
+	for (unsigned int level = 0; level < levels(); level++)
+	{
+		unsigned int first = levelStart[level];
+		unsigned int last = level + 1 < levels() ? levelStart[level + 1] : size();
+		if (!jobs || jobs->threads() < 2 || last - first < 2 * UPDATE_GRAIN)
+		{
+			recomputed += updateRange(first, last);
+			continue;
+		}
+		std::atomic<unsigned int> levelRecomputed(0);
+		jobs->parallelFor(first, last, UPDATE_GRAIN, [&](unsigned int a, unsigned int b) {
+			levelRecomputed += updateRange(a, b);
+		});
+		recomputed += levelRecomputed;
+	}
+	return recomputed;
+}
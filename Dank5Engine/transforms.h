@@ -0,0 +1,87 @@
+#ifndef TRANSFORMS_H
+#define TRANSFORMS_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// parent of a root node
+const unsigned int TRANSFORM_NONE = 0xffffffffu;
+
+// Scene transform hierarchy. Local position, rotation and scale are kept in SoA arrays
+// in breadth-first order (all roots, then their children grouped by parent, ...), so
+// parents come before their children, the children of a node sit next to each other and
+// update() recomputes the world matrices in one linear pass: setting a local transform
+// marks the node dirty, recomputing a node marks its children dirty, and runs of clean
+// nodes are skipped eight at a time. Each depth level only reads the levels above it, so
+// update(&jobs) splits the levels over the job system.
+// Nodes are named by the id create() returns, which stays the same when the arrays are
+// sorted again; nodes created out of breadth-first order are sorted in by the next update().
+class TransformHierarchy {
+
+public:
+	TransformHierarchy();
+
+	// room for count nodes without growing the arrays
+	void reserve(unsigned int count);
+	// a node under parent (TRANSFORM_NONE for a root), whose world matrix is valid after
+	// the next update()
+	unsigned int create(unsigned int parent = TRANSFORM_NONE, const glm::vec3& position = glm::vec3(0.0f),
+		const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+	unsigned int size() const { return (unsigned int)nodeOf.size(); }
+	// depth levels, 1 with only roots
+	unsigned int levels() const { return (unsigned int)levelStart.size(); }
+
+	// local transform relative to the parent; setting it marks the node dirty
+	void setPosition(unsigned int node, const glm::vec3& position);
+	void setRotation(unsigned int node, const glm::quat& rotation);
+	void setScale(unsigned int node, const glm::vec3& scale);
+	void setLocal(unsigned int node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+	const glm::vec3& position(unsigned int node) const { return positions[slotOf[node]]; }
+	const glm::quat& rotation(unsigned int node) const { return rotations[slotOf[node]]; }
+	const glm::vec3& scale(unsigned int node) const { return scales[slotOf[node]]; }
+	unsigned int parent(unsigned int node) const;
+
+	// parent world * local, as of the last update()
+	const glm::mat4& world(unsigned int node) const { return worlds[slotOf[node]]; }
+	// whether the last update() recomputed the world matrix of node
+	bool changed(unsigned int node) const { return changedPass[slotOf[node]] == pass; }
+
+	// recomputes the world matrices of dirty nodes and their subtrees, splitting big levels
+	// over jobs if given; the number of matrices recomputed
+	unsigned int update(JobSystem* jobs = nullptr);
+
+private:
+	// SoA, by slot (breadth-first order)
+	std::vector<glm::vec3> positions;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<glm::mat4> worlds;
+	// slot of the parent, TRANSFORM_NONE for roots
+	std::vector<unsigned int> parents;
+	std::vector<unsigned int> depths;
+	// the children of a slot are firstChild .. firstChild + childCount - 1
+	std::vector<unsigned int> firstChild, childCount;
+	// to be recomputed by the next update (a byte each, so jobs can write neighbouring ones)
+	std::vector<uint8_t> dirty;
+	// the update pass that last recomputed the world matrix
+	std::vector<uint32_t> changedPass;
+
+	// node id -> slot and back
+	std::vector<unsigned int> slotOf, nodeOf;
+	// first slot of every depth level
+	std::vector<unsigned int> levelStart;
+	// some node sits out of breadth-first order
+	bool unsorted;
+	uint32_t pass;
+
+	void sort();
+	unsigned int updateRange(unsigned int first, unsigned int last);
+};
+
+#endif
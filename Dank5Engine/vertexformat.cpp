@@ -0,0 +1,197 @@
+#include "vertexformat.h"
+
+#include <glm/gtc/packing.hpp>
+#include <glm/packing.hpp>
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+VertexFormat& VertexFormat::add(unsigned int location, unsigned int components, VertexEncoding encoding)
+{
+	if (count == MAX_ATTRIBUTES)
+	{
+		std::cout << "ERROR::VERTEXFORMAT::TOO_MANY_ATTRIBUTES" << std::endl;
+		return *this;
+	}
+	if ((encoding == VERTEX_POSITION_SNORM16 || encoding == VERTEX_NORMAL_OCT16) && components != 3)
+		std::cout << "ERROR::VERTEXFORMAT::ENCODING_NEEDS_3_COMPONENTS" << std::endl;
+	if (encoding == VERTEX_NORMAL_10_10_10_2 && components < 3)
+		std::cout << "ERROR::VERTEXFORMAT::ENCODING_NEEDS_3_OR_4_COMPONENTS" << std::endl;
+	VertexAttribute attribute = { location, components, encoding };
+	attributes[count++] = attribute;
+	return *this;
+}
+
+unsigned int VertexFormat::size(unsigned int i) const
+{
+	const VertexAttribute& a = attributes[i];
+	switch (a.encoding)
+	{
+	case VERTEX_POSITION_SNORM16:
+		// three shorts padded to keep the next attribute 4-byte aligned
+		return 8;
+	case VERTEX_HALF:
+		return (a.components * 2 + 3) & ~3u;
+	case VERTEX_NORMAL_OCT16:
+	case VERTEX_NORMAL_10_10_10_2:
+		return 4;
+	default:
+		return a.components * 4;
+	}
+}
+
+unsigned int VertexFormat::stride() const
+{
+	unsigned int bytes = 0;
+	for (unsigned int i = 0; i < count; i++)
+		bytes += size(i);
+	return bytes;
+}
+
+unsigned int VertexFormat::floats() const
+{
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < count; i++)
+		n += attributes[i].components;
+	return n;
+}
+
+VertexFormat VertexFormat::floatFormat(const unsigned int* attributeSizes, unsigned int attributeCount)
+{
+	VertexFormat format;
+	for (unsigned int i = 0; i < attributeCount; i++)
+		format.add(i, attributeSizes[i], VERTEX_FLOAT);
+	return format;
+}
+
+glm::vec2 octEncode(const glm::vec3& n)
+{
+	// project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half over the diagonals
+	glm::vec3 p = n / (fabsf(n.x) + fabsf(n.y) + fabsf(n.z));
+	if (p.z >= 0.0f)
+		return glm::vec2(p.x, p.y);
+	return glm::vec2((1.0f - fabsf(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f), (1.0f - fabsf(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+glm::vec3 octDecode(const glm::vec2& e)
+{
+	glm::vec3 n(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+	float t = glm::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return glm::normalize(n);
+}
+
+EncodedVertices encodeVertices(const float* vertices, unsigned int vertexCount, const VertexFormat& format)
+{
+	EncodedVertices encoded;
+	encoded.center = glm::vec3(0.0f);
+	encoded.extent = glm::vec3(1.0f);
+	const unsigned int floats = format.floats();
+	const unsigned int stride = format.stride();
+
+	// bounds of the quantised position
+	unsigned int offset = 0;
+	for (unsigned int i = 0; i < format.count; i++)
+	{
+		if (format.attributes[i].encoding == VERTEX_POSITION_SNORM16 && vertexCount)
+		{
+			glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+			for (unsigned int v = 0; v < vertexCount; v++)
+			{
+				const float* in = vertices + (size_t)v * floats + offset;
+				glm::vec3 p(in[0], in[1], in[2]);
+				min = glm::min(min, p);
+				max = glm::max(max, p);
+			}
+			encoded.center = (min + max) * 0.5f;
+			encoded.extent = (max - min) * 0.5f;
+			// a flat mesh: any scale works for that axis, avoid the division by zero
+			for (int k = 0; k < 3; k++)
+				if (encoded.extent[k] <= 0.0f)
+					encoded.extent[k] = 1.0f;
+			break;
+		}
+		offset += format.attributes[i].components;
+	}
+
+	encoded.bytes.assign((size_t)vertexCount * stride, 0);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		const float* in = vertices + (size_t)v * floats;
+		unsigned char* out = &encoded.bytes[(size_t)v * stride];
+		for (unsigned int i = 0; i < format.count; i++)
+		{
+			const VertexAttribute& a = format.attributes[i];
+			switch (a.encoding)
+			{
+			case VERTEX_POSITION_SNORM16:
+			{
+				glm::vec3 q = (glm::vec3(in[0], in[1], in[2]) - encoded.center) / encoded.extent;
+				glm::uint64 packed = glm::packSnorm4x16(glm::vec4(q, 0.0f));
+				memcpy(out, &packed, 8);
+				break;
+			}
+			case VERTEX_HALF:
+				for (unsigned int k = 0; k < a.components; k++)
+				{
+					glm::uint16 half = glm::packHalf1x16(in[k]);
+					memcpy(out + k * 2, &half, 2);
+				}
+				break;
+			case VERTEX_NORMAL_OCT16:
+			{
+				glm::uint packed = glm::packSnorm2x16(octEncode(glm::vec3(in[0], in[1], in[2])));
+				memcpy(out, &packed, 4);
+				break;
+			}
+			case VERTEX_NORMAL_10_10_10_2:
+			{
+				glm::vec4 n(in[0], in[1], in[2], a.components > 3 ? in[3] : 0.0f);
+				glm::uint32 packed = glm::packSnorm3x10_1x2(n);
+				memcpy(out, &packed, 4);
+				break;
+			}
+			default:
+				memcpy(out, in, a.components * sizeof(float));
+				break;
+			}
+			in += a.components;
+			out += format.size(i);
+		}
+	}
+	return encoded;
+}
+
+void setVertexAttributes(const VertexFormat& format)
+{
+	const GLsizei stride = format.stride();
+	size_t offset = 0;
+	for (unsigned int i = 0; i < format.count; i++)
+	{
+		const VertexAttribute& a = format.attributes[i];
+		const void* pointer = (const void*)offset;
+		switch (a.encoding)
+		{
+		case VERTEX_POSITION_SNORM16:
+			glVertexAttribPointer(a.location, 3, GL_SHORT, GL_TRUE, stride, pointer);
+			break;
+		case VERTEX_HALF:
+			glVertexAttribPointer(a.location, a.components, GL_HALF_FLOAT, GL_FALSE, stride, pointer);
+			break;
+		case VERTEX_NORMAL_OCT16:
+			glVertexAttribPointer(a.location, 2, GL_SHORT, GL_TRUE, stride, pointer);
+			break;
+		case VERTEX_NORMAL_10_10_10_2:
+			glVertexAttribPointer(a.location, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, pointer);
+			break;
+		default:
+			glVertexAttribPointer(a.location, a.components, GL_FLOAT, GL_FALSE, stride, pointer);
+			break;
+		}
+		glEnableVertexAttribArray(a.location);
+		offset += format.size(i);
+	}
+}
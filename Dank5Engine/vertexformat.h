@@ -0,0 +1,83 @@
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// How one attribute is stored in the vertex buffer. Everything but VERTEX_FLOAT is
+// packed with glm/gtc/packing.hpp and decoded by the vertex fetch (normalised integer
+// and half float attributes), except where noted.
+enum VertexEncoding {
+	// 32-bit floats, as given
+	VERTEX_FLOAT,
+	// xyz as 16-bit snorm relative to the mesh bounds (8 bytes with padding); the
+	// fetch yields [-1, 1], Mesh::dequantize() maps that back and is folded into the model matrix
+	VERTEX_POSITION_SNORM16,
+	// 16-bit floats, for texture coordinates
+	VERTEX_HALF,
+	// unit vector as octahedral coordinates in 2 x 16-bit snorm (4 bytes); the shader
+	// rebuilds it, see octDecode() below for the GLSL
+	VERTEX_NORMAL_OCT16,
+	// xyz (+ w, e.g. the bitangent sign of a tangent) as GL_INT_2_10_10_10_REV snorm
+	VERTEX_NORMAL_10_10_10_2
+};
+
+struct VertexAttribute {
+	unsigned int location;
+	// floats per vertex in the source data
+	unsigned int components;
+	VertexEncoding encoding;
+};
+
+// Layout of an interleaved vertex: the attributes in source order, each with its
+// shader location and encoding.
+//	VertexFormat format;
+//	format.add(0, 3, VERTEX_POSITION_SNORM16).add(1, 2, VERTEX_HALF);
+struct VertexFormat {
+	static const unsigned int MAX_ATTRIBUTES = 8;
+
+	VertexAttribute attributes[MAX_ATTRIBUTES];
+	unsigned int count;
+
+	VertexFormat() : count(0) {}
+
+	VertexFormat& add(unsigned int location, unsigned int components, VertexEncoding encoding);
+	// bytes of attribute i in the vertex buffer
+	unsigned int size(unsigned int i) const;
+	// bytes per encoded vertex
+	unsigned int stride() const;
+	// floats per source vertex
+	unsigned int floats() const;
+
+	// all attributes as floats at locations 0..n-1, the layout MeshData comes in
+	static VertexFormat floatFormat(const unsigned int* attributeSizes, unsigned int attributeCount);
+};
+
+// vertices packed by encodeVertices()
+struct EncodedVertices {
+	std::vector<unsigned char> bytes;
+	// bounds the VERTEX_POSITION_SNORM16 attribute was quantised against
+	// (position = center + extent * decoded); center 0 and extent 1 without one
+	glm::vec3 center;
+	glm::vec3 extent;
+};
+
+// pack vertexCount interleaved float vertices (format.floats() each) into format
+EncodedVertices encodeVertices(const float* vertices, unsigned int vertexCount, const VertexFormat& format);
+// point the attributes of the bound VAO at the bound GL_ARRAY_BUFFER
+void setVertexAttributes(const VertexFormat& format);
+
+// octahedral mapping of a unit vector to [-1, 1]^2 and back
+glm::vec2 octEncode(const glm::vec3& n);
+// GLSL equivalent:
+//	vec3 octDecode(vec2 e) {
+//		vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+//		float t = max(-n.z, 0.0);
+//		n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+//		return normalize(n);
+//	}
+glm::vec3 octDecode(const glm::vec2& e);
+
+#endif